@@ -0,0 +1,1123 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include "graph_storage.hpp"
+#include "graph_components.hpp"
+#include "graph_scc.hpp"
+#include "graph_timing.hpp"
+#include "simulation.hpp"
+#include "simulation_bytecode.hpp"
+#include "simulation_equivalence.hpp"
+#include "simulation_hashing.hpp"
+#include "simulation_history.hpp"
+#include "simulation_lanes.hpp"
+#include "simulation_patch.hpp"
+#include "simulation_parallel.hpp"
+#include "simulation_trace.hpp"
+#include "simulation_truth_table.hpp"
+#include "triple_buffer.hpp"
+#include "workers.hpp"
+#include "benchmark.hpp"
+
+namespace benchmark
+{
+	using Clock = std::chrono::steady_clock;
+
+	double SecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	void NodeStorage()
+	{
+		printf("Node storage\n");
+		printf("%10s %16s %16s\n", "nodes", "add (nodes/s)", "remove (nodes/s)");
+
+		constexpr size_t sizes[] = { 10'000, 100'000, 1'000'000 };
+
+		ChunkedList<graph::NodeHandle> handles;
+		std::mt19937 rng(1);
+
+		for (size_t n : sizes)
+		{
+			graph::ClearNodes();
+			Clear(handles);
+			Reserve(handles, n);
+
+			Clock::time_point addStart = Clock::now();
+			for (size_t i = 0; i < n; ++i)
+			{
+				Push(handles, graph::CreateNode(graph::NodeType::Any, (int)(i % 1024), (int)(i / 1024)));
+			}
+			double addSeconds = SecondsSince(addStart);
+
+			// Random order, so that removal isn't always taking from the end
+			for (size_t i = n - 1; i > 0; --i)
+			{
+				std::swap(At(handles, i), At(handles, rng() % (i + 1)));
+			}
+
+			Clock::time_point removeStart = Clock::now();
+			for (size_t i = 0; i < n; ++i)
+			{
+				graph::DestroyNode(At(handles, i));
+			}
+			double removeSeconds = SecondsSince(removeStart);
+
+			printf("%10zu %16.0f %16.0f\n", n, (double)n / addSeconds, (double)n / removeSeconds);
+		}
+
+		graph::ClearNodes();
+		Free(handles);
+	}
+
+	void BatchNodeRemoval()
+	{
+		printf("Batch node removal\n");
+		printf("%10s %10s %10s %12s\n", "nodes", "wires", "removed", "time (ms)");
+
+		constexpr size_t n = 200'000;
+		constexpr size_t numToRemove = 100'000;
+
+		ChunkedList<graph::NodeHandle> handles;
+		std::mt19937 rng(2);
+
+		graph::ClearNodes();
+		for (size_t i = 0; i < n; ++i)
+		{
+			Push(handles, graph::CreateNode(graph::NodeType::Any, (int)(i % 1024), (int)(i / 1024)));
+		}
+		for (size_t i = 0; i < n; ++i)
+		{
+			graph::CreateWire(graph::WireElbow::DiagonalHori, At(handles, i), At(handles, rng() % n));
+		}
+		size_t numWiresBefore = graph::numWires;
+
+		// Selection order shouldn't matter
+		for (size_t i = n - 1; i > 0; --i)
+		{
+			std::swap(At(handles, i), At(handles, rng() % (i + 1)));
+		}
+		Resize(handles, numToRemove);
+
+		Clock::time_point start = Clock::now();
+		graph::DestroyNodes(handles);
+		double seconds = SecondsSince(start);
+
+		printf("%10zu %10zu %10zu %12.3f\n", n, numWiresBefore, numToRemove, seconds * 1000.0);
+
+		graph::ClearNodes();
+		Free(handles);
+	}
+
+	// A feed-forward circuit of mostly two-input gates.
+	// Most inputs come from nearby gates, like a hand-built circuit; some come from anywhere, to defeat the cache.
+	void MakeRandomCircuit(simulation::Netlist& netlist, size_t numGates, std::mt19937& rng)
+	{
+		constexpr graph::NodeType types[] = { graph::NodeType::Any, graph::NodeType::All, graph::NodeType::Non, graph::NodeType::One };
+		constexpr size_t window = 1024;
+
+		netlist = {};
+		size_t numSources = numGates / 100 > 64 ? numGates / 100 : 64;
+		for (size_t g = 0; g < numGates; ++g)
+		{
+			simulation::GateID inputs[3];
+			size_t numInputs = g < numSources ? 0 : 1 + (rng() % 8 != 0) + (rng() % 8 == 0);
+			for (size_t i = 0; i < numInputs; ++i)
+			{
+				size_t reach = (rng() % 16 == 0 || g < window) ? g : window;
+				inputs[i] = (simulation::GateID)(g - 1 - rng() % reach);
+			}
+			simulation::AddGate(netlist, types[rng() % 4], inputs, numInputs);
+		}
+	}
+
+	void Simulation()
+	{
+		printf("Simulation\n");
+		printf("%10s %10s %10s %16s\n", "gates", "levels", "ticks", "gate evals/s");
+
+		constexpr size_t sizes[] = { 10'000, 100'000, 1'000'000 };
+
+		std::mt19937 rng(3);
+		simulation::Netlist netlist;
+		simulation::Program program;
+
+		for (size_t n : sizes)
+		{
+			MakeRandomCircuit(netlist, n, rng);
+			simulation::Compile(netlist, program);
+			// Nothing toggles here, so event-driven ticks would skip every gate
+			program.mode = simulation::StepMode::Sweep;
+
+			uint64_t ticks = 0;
+			Clock::time_point start = Clock::now();
+			double seconds;
+			do
+			{
+				simulation::Run(program, 8);
+				ticks += 8;
+				seconds = SecondsSince(start);
+			} while (seconds < 0.25);
+
+			printf("%10zu %10zu %10llu %16.0f\n", n, program.levelStart.size() - 1, (unsigned long long)ticks, (double)program.code.size() * (double)ticks / seconds);
+		}
+	}
+
+	// Ticks a program on a thread of its own, publishing its state after every tick,
+	// while this thread takes the newest state at 60 frames per second the way the render loop does
+	void StateHandoff()
+	{
+		printf("Simulation state handoff (60 frames per second)\n");
+		printf("%10s %14s %14s %10s %16s\n", "gates", "alone (t/s)", "handoff (t/s)", "frames", "max acquire (us)");
+
+		constexpr size_t sizes[] = { 10'000, 100'000, 1'000'000 };
+		constexpr double seconds = 0.5;
+
+		struct Snapshot
+		{
+			std::vector<uint64_t> state;
+			uint64_t tick = 0;
+		};
+
+		std::mt19937 rng(21);
+		simulation::Netlist netlist;
+		simulation::Program program;
+
+		for (size_t n : sizes)
+		{
+			MakeRandomCircuit(netlist, n, rng);
+			simulation::Compile(netlist, program);
+			program.mode = simulation::StepMode::Sweep;
+
+			uint64_t aloneTicks = 0;
+			Clock::time_point start = Clock::now();
+			while (SecondsSince(start) < seconds)
+			{
+				simulation::Step(program);
+				++aloneTicks;
+			}
+
+			TripleBuffer<Snapshot> snapshots;
+			std::atomic<bool> isStopping = false;
+			uint64_t handoffTicks = 0;
+			start = Clock::now();
+			std::thread simulator([&]
+			{
+				while (!isStopping.load(std::memory_order_relaxed))
+				{
+					simulation::Step(program);
+					++handoffTicks;
+					Snapshot& snapshot = BackItem(snapshots);
+					snapshot.state = program.state;
+					snapshot.tick = program.tick;
+					Publish(snapshots);
+				}
+			});
+
+			size_t numFrames = 0;
+			double maxAcquireSeconds = 0.0;
+			for (Clock::time_point frame = start; SecondsSince(start) < seconds; frame += std::chrono::microseconds(16'667))
+			{
+				std::this_thread::sleep_until(frame);
+				Clock::time_point acquireStart = Clock::now();
+				Acquire(snapshots);
+				maxAcquireSeconds = std::max(maxAcquireSeconds, SecondsSince(acquireStart));
+				++numFrames;
+			}
+			isStopping = true;
+			simulator.join();
+			double handoffSeconds = SecondsSince(start);
+
+			printf("%10zu %14.0f %14.0f %10zu %16.3f\n", n, aloneTicks / seconds, handoffTicks / handoffSeconds, numFrames, maxAcquireSeconds * 1e6);
+		}
+	}
+
+	// Edits patched into a running program, against compiling it again
+	void IncrementalCompile()
+	{
+		printf("Incremental compile (us per edit, mean/max)\n");
+		printf("%10s %14s %16s %16s %16s %16s %10s\n", "gates", "compile (ms)", "add gate", "add wire", "remove wire", "remove gate", "rebuilds");
+
+		constexpr size_t n = 500'000;
+		constexpr size_t numEdits = 2'000;
+		constexpr size_t reach = 1024;
+
+		std::mt19937 rng(22);
+		simulation::Netlist netlist;
+		simulation::PatchableProgram patchable;
+		MakeRandomCircuit(netlist, n, rng);
+
+		Clock::time_point compileStart = Clock::now();
+		simulation::CompilePatchable(netlist, patchable);
+		double compileSeconds = SecondsSince(compileStart);
+		simulation::Run(patchable.program, 16);
+
+		struct Timing
+		{
+			double total = 0.0;
+			double max = 0.0;
+		};
+		// Ticks between edits, as though the board were running, but only the edit is timed
+		auto TimeEdit = [&](Timing& timing, auto edit)
+		{
+			Clock::time_point start = Clock::now();
+			edit();
+			double seconds = SecondsSince(start);
+			timing.total += seconds;
+			timing.max = std::max(timing.max, seconds);
+			simulation::Step(patchable.program);
+		};
+		auto Column = [](const Timing& timing)
+		{
+			static char text[4][32];
+			static int next = 0;
+			next = (next + 1) % 4;
+			snprintf(text[next], sizeof(text[next]), "%.1f/%.1f", timing.total * 1e6 / numEdits, timing.max * 1e6);
+			return text[next];
+		};
+
+		Timing addGate, addWire, removeWire, removeGate;
+		for (size_t i = 0; i < numEdits; ++i)
+		{
+			TimeEdit(addGate, [&] { simulation::PatchAddGate(patchable, graph::NodeType::Any); });
+		}
+
+		// Between nearby gates, from earlier to later, the way a board is usually wired up
+		std::vector<std::pair<simulation::GateID, simulation::GateID>> added(numEdits);
+		for (size_t i = 0; i < numEdits; ++i)
+		{
+			simulation::GateID to = (simulation::GateID)(reach + rng() % (n - reach));
+			simulation::GateID from = (simulation::GateID)(to - 1 - rng() % reach);
+			added[i] = { from, to };
+			TimeEdit(addWire, [&] { simulation::PatchAddWire(patchable, from, to); });
+		}
+		for (size_t i = 0; i < numEdits; ++i)
+		{
+			TimeEdit(removeWire, [&] { simulation::PatchRemoveWire(patchable, added[i].first, added[i].second); });
+		}
+
+		// Gates with wires, from anywhere - the last gate takes each one's ID
+		for (size_t i = 0; i < numEdits; ++i)
+		{
+			simulation::GateID gate = (simulation::GateID)(rng() % patchable.program.gateOfNetlistGate.size());
+			TimeEdit(removeGate, [&] { simulation::PatchRemoveGate(patchable, gate); });
+		}
+
+		printf("%10zu %14.3f %16s %16s %16s %16s %10llu\n", n, compileSeconds * 1000.0,
+			Column(addGate), Column(addWire), Column(removeWire), Column(removeGate), (unsigned long long)patchable.numRebuilds);
+	}
+
+	void BytecodeSimulation()
+	{
+		printf("Bytecode simulation\n");
+		printf("%10s %16s %16s %14s %14s\n", "gates", "sweep evals/s", "bytecode evals/s", "compile (ms)", "load (ms)");
+
+		constexpr size_t sizes[] = { 10'000, 100'000, 1'000'000 };
+		constexpr const char* filename = "benchmark.bc";
+
+		std::mt19937 rng(3);
+		simulation::Netlist netlist;
+		simulation::Program program;
+		simulation::Bytecode bytecode;
+		simulation::BytecodeState state;
+
+		for (size_t n : sizes)
+		{
+			MakeRandomCircuit(netlist, n, rng);
+
+			Clock::time_point compileStart = Clock::now();
+			simulation::Compile(netlist, program);
+			simulation::Lower(program, bytecode);
+			double compileSeconds = SecondsSince(compileStart);
+			program.mode = simulation::StepMode::Sweep;
+
+			simulation::SaveBytecode(bytecode, filename);
+			Clock::time_point loadStart = Clock::now();
+			simulation::LoadBytecode(bytecode, filename);
+			double loadSeconds = SecondsSince(loadStart);
+			remove(filename);
+
+			uint64_t sweepTicks = 0;
+			Clock::time_point sweepStart = Clock::now();
+			double sweepSeconds;
+			do
+			{
+				simulation::Run(program, 8);
+				sweepTicks += 8;
+				sweepSeconds = SecondsSince(sweepStart);
+			} while (sweepSeconds < 0.25);
+
+			simulation::ResetBytecode(bytecode, state);
+			uint64_t bytecodeTicks = 0;
+			Clock::time_point bytecodeStart = Clock::now();
+			double bytecodeSeconds;
+			do
+			{
+				for (int i = 0; i < 8; ++i)
+				{
+					simulation::RunBytecode(bytecode, state);
+				}
+				bytecodeTicks += 8;
+				bytecodeSeconds = SecondsSince(bytecodeStart);
+			} while (bytecodeSeconds < 0.25);
+
+			double gatesPerTick = (double)program.code.size();
+			printf("%10zu %16.0f %16.0f %14.3f %14.3f\n", n, gatesPerTick * sweepTicks / sweepSeconds, gatesPerTick * bytecodeTicks / bytecodeSeconds, compileSeconds * 1000.0, loadSeconds * 1000.0);
+		}
+	}
+
+	void Rewind()
+	{
+		printf("Rewind history\n");
+		printf("%10s %10s %14s %16s %16s %14s\n", "gates", "toggled", "state (bytes)", "bytes per tick", "record (us)", "seek (us)");
+
+		constexpr size_t n = 1'000'000;
+		constexpr size_t toggledPerTick[] = { 1, 16, 256 };
+		constexpr uint64_t numTicks = 1024;
+
+		std::mt19937 rng(13);
+		simulation::Netlist netlist;
+		simulation::Program program;
+		simulation::History history;
+		history.memoryBudget = (size_t)1 << 30;
+
+		MakeRandomCircuit(netlist, n, rng);
+		simulation::Compile(netlist, program);
+
+		for (size_t toggled : toggledPerTick)
+		{
+			// Start from a settled state rather than from everything off
+			simulation::Reset(program);
+			simulation::Run(program, 64);
+			simulation::ClearHistory(history);
+			simulation::RecordTick(history, program);
+			uint64_t firstTick = program.tick;
+
+			double recordSeconds = 0.0;
+			for (uint64_t t = 0; t < numTicks; ++t)
+			{
+				for (size_t i = 0; i < toggled; ++i)
+				{
+					simulation::GateID source = (simulation::GateID)(rng() % program.numSources);
+					simulation::SetInput(program, source, !simulation::GetOutput(program, source));
+				}
+				simulation::Step(program);
+
+				Clock::time_point recordStart = Clock::now();
+				simulation::RecordTick(history, program);
+				recordSeconds += SecondsSince(recordStart);
+			}
+
+			constexpr size_t numSeeks = 256;
+			Clock::time_point seekStart = Clock::now();
+			for (size_t i = 0; i < numSeeks; ++i)
+			{
+				simulation::SeekTick(history, program, firstTick + rng() % numTicks);
+			}
+			double seekSeconds = SecondsSince(seekStart);
+
+			printf("%10zu %10zu %14zu %16.0f %16.3f %14.3f\n", n, toggled, program.state.size() * sizeof(uint64_t),
+				(double)history.bytesUsed / (numTicks + 1), recordSeconds * 1e6 / numTicks, seekSeconds * 1e6 / numSeeks);
+		}
+	}
+
+	void EventSimulation()
+	{
+		printf("Event-driven simulation (1M gates)\n");
+		printf("%12s %14s %14s %14s %14s\n", "toggles/tick", "evals/tick", "sweep (t/s)", "event (t/s)", "auto (t/s)");
+
+		constexpr size_t n = 1'000'000;
+		constexpr size_t toggleCounts[] = { 1, 16, 256, 4096 };
+		constexpr simulation::StepMode modes[] = { simulation::StepMode::Sweep, simulation::StepMode::Event, simulation::StepMode::Auto };
+
+		std::mt19937 rng(4);
+		simulation::Netlist netlist;
+		simulation::Program program;
+		MakeRandomCircuit(netlist, n, rng);
+		simulation::Compile(netlist, program);
+
+		std::vector<simulation::GateID> sources;
+		for (simulation::GateID g = 0; g < n; ++g)
+		{
+			if (netlist.inputStart[g] == netlist.inputStart[g + 1])
+			{
+				sources.push_back(g);
+			}
+		}
+
+		for (size_t toggles : toggleCounts)
+		{
+			double ticksPerSecond[3];
+			uint64_t eventEvaluations = 0;
+			for (size_t m = 0; m < 3; ++m)
+			{
+				program.mode = modes[m];
+				simulation::Reset(program);
+				simulation::Step(program);
+
+				uint64_t ticks = 0;
+				uint64_t evaluations = 0;
+				Clock::time_point start = Clock::now();
+				double seconds;
+				do
+				{
+					for (size_t i = 0; i < toggles; ++i)
+					{
+						simulation::GateID source = sources[rng() % sources.size()];
+						simulation::SetInput(program, source, !simulation::GetOutput(program, source));
+					}
+					simulation::Step(program);
+					evaluations += program.activity;
+					++ticks;
+					seconds = SecondsSince(start);
+				} while (seconds < 0.25);
+				ticksPerSecond[m] = (double)ticks / seconds;
+				if (modes[m] == simulation::StepMode::Event)
+				{
+					eventEvaluations = evaluations / ticks;
+				}
+			}
+			printf("%12zu %14llu %14.0f %14.0f %14.0f\n", toggles, (unsigned long long)eventEvaluations, ticksPerSecond[0], ticksPerSecond[1], ticksPerSecond[2]);
+		}
+	}
+
+	void Tracing()
+	{
+		printf("Waveform tracing (1M gates)\n");
+		printf("%8s %10s %14s %14s %10s %14s\n", "mode", "probes", "ticks/s", "traced/s", "overhead", "bytes/tick");
+
+		constexpr size_t n = 1'000'000;
+		constexpr size_t probeCounts[] = { 64, 4096 };
+		constexpr const char* filename = "benchmark.trace";
+
+		std::mt19937 rng(17);
+		simulation::Netlist netlist;
+		simulation::Program program;
+		simulation::Trace trace;
+		MakeRandomCircuit(netlist, n, rng);
+		simulation::Compile(netlist, program);
+
+		// Seconds to run `numTicks` ticks with a source toggled before each, tracing or not.
+		// Both runs toggle the same sources from the same state, since the cost of a tick depends on what changes.
+		auto Measure = [&](const simulation::Program& from, uint32_t seed, uint64_t numTicks, bool isTracing)
+		{
+			program = from;
+			std::mt19937 toggles(seed);
+			Clock::time_point start = Clock::now();
+			for (uint64_t t = 0; t < numTicks; ++t)
+			{
+				simulation::GateID source = (simulation::GateID)(toggles() % program.numSources);
+				simulation::SetInput(program, source, !simulation::GetOutput(program, source));
+				simulation::Step(program);
+				if (isTracing)
+				{
+					simulation::TraceTick(trace, program);
+				}
+			}
+			return SecondsSince(start);
+		};
+
+		for (simulation::StepMode mode : { simulation::StepMode::Sweep, simulation::StepMode::Event })
+		{
+			for (size_t numProbes : probeCounts)
+			{
+				std::vector<simulation::GateID> probes(numProbes);
+				std::vector<std::string> names(numProbes);
+				for (size_t i = 0; i < numProbes; ++i)
+				{
+					probes[i] = (simulation::GateID)(rng() % n);
+					names[i] = "g" + std::to_string(probes[i]);
+				}
+
+				simulation::Reset(program);
+				program.mode = mode;
+				simulation::Run(program, 64);
+				const simulation::Program start = program;
+
+				// Enough ticks for about half a second
+				uint64_t numTicks = 8;
+				while (Measure(start, 1, numTicks, false) < 0.5)
+				{
+					numTicks *= 2;
+				}
+				double plainSeconds = Measure(start, 1, numTicks, false);
+
+				simulation::StartTrace(trace, start, probes, names, filename);
+				double tracedSeconds = Measure(start, 1, numTicks, true);
+				simulation::EndTrace(trace);
+				double plainRate = numTicks / plainSeconds;
+				double tracedRate = numTicks / tracedSeconds;
+
+				std::ifstream file(filename, std::ios::binary | std::ios::ate);
+				double bytesPerTick = (double)file.tellg() / numTicks;
+				file.close();
+				remove(filename);
+
+				printf("%8s %10zu %14.0f %14.0f %9.1f%% %14.1f\n", mode == simulation::StepMode::Sweep ? "sweep" : "event",
+					numProbes, plainRate, tracedRate, (plainRate - tracedRate) * 100.0 / plainRate, bytesPerTick);
+			}
+		}
+	}
+
+	void LaneSimulation()
+	{
+		printf("Exhaustive truth table (%zu lanes)\n", simulation::NUM_LANES);
+		printf("%10s %10s %16s %16s %10s\n", "gates", "inputs", "scalar (rows/s)", "lanes (rows/s)", "speedup");
+
+		constexpr size_t n = 10'000;
+		constexpr size_t numInputs = 14;
+		constexpr uint64_t numRows = 1ull << numInputs;
+
+		std::mt19937 rng(5);
+		simulation::Netlist netlist;
+		simulation::Program program;
+		MakeRandomCircuit(netlist, n, rng);
+		simulation::Compile(netlist, program);
+
+		std::vector<simulation::GateID> inputs;
+		for (simulation::GateID g = 0; g < n && inputs.size() < numInputs; ++g)
+		{
+			if (netlist.inputStart[g] == netlist.inputStart[g + 1])
+			{
+				inputs.push_back(g);
+			}
+		}
+
+		// One row per tick
+		Clock::time_point scalarStart = Clock::now();
+		uint64_t scalarRows = 0;
+		double scalarSeconds;
+		do
+		{
+			for (size_t i = 0; i < numInputs; ++i)
+			{
+				simulation::SetInput(program, inputs[i], (scalarRows >> i) & 1);
+			}
+			simulation::Step(program);
+			++scalarRows;
+			scalarSeconds = SecondsSince(scalarStart);
+		} while (scalarSeconds < 0.5 && scalarRows < numRows);
+
+		// Every row
+		simulation::LaneState lanes;
+		simulation::ResetLanes(program, lanes);
+		Clock::time_point lanesStart = Clock::now();
+		for (uint64_t block = 0; block < numRows / simulation::NUM_LANES; ++block)
+		{
+			for (size_t i = 0; i < numInputs; ++i)
+			{
+				simulation::SetInputLanes(program, lanes, inputs[i], simulation::CountingPattern(i, block));
+			}
+			simulation::StepLanes(program, lanes);
+		}
+		double lanesSeconds = SecondsSince(lanesStart);
+
+		double scalarRate = (double)scalarRows / scalarSeconds;
+		double lanesRate = (double)numRows / lanesSeconds;
+		printf("%10zu %10zu %16.0f %16.0f %9.0fx\n", n, numInputs, scalarRate, lanesRate, lanesRate / scalarRate);
+	}
+
+	void ComponentSimulation()
+	{
+		printf("Parallel simulation of independent components (%zu threads)\n", workers::NumThreads());
+		printf("%10s %10s %12s %16s %16s %10s\n", "modules", "gates", "partitions", "serial (t/s)", "parallel (t/s)", "speedup");
+
+		constexpr size_t numModules = 48;
+		constexpr size_t moduleSize = 20'000;
+
+		// Modules side by side, with no wires between them
+		std::mt19937 rng(6);
+		simulation::Netlist netlist;
+		simulation::Netlist module;
+		std::vector<simulation::GateID> inputs;
+		for (size_t m = 0; m < numModules; ++m)
+		{
+			MakeRandomCircuit(module, moduleSize, rng);
+			simulation::GateID offset = (simulation::GateID)simulation::NumGates(netlist);
+			for (simulation::GateID g = 0; g < moduleSize; ++g)
+			{
+				inputs.clear();
+				for (uint32_t i = module.inputStart[g]; i < module.inputStart[g + 1]; ++i)
+				{
+					inputs.push_back(offset + module.inputs[i]);
+				}
+				simulation::AddGate(netlist, module.types[g], inputs.data(), inputs.size());
+			}
+		}
+
+		simulation::PartitionedProgram partitioned;
+		simulation::CompilePartitioned(netlist, partitioned);
+		for (simulation::Partition& partition : partitioned.partitions)
+		{
+			partition.program.mode = simulation::StepMode::Sweep;
+		}
+
+		uint64_t serialTicks = 0;
+		Clock::time_point serialStart = Clock::now();
+		double serialSeconds;
+		do
+		{
+			for (simulation::Partition& partition : partitioned.partitions)
+			{
+				simulation::Step(partition.program);
+			}
+			++serialTicks;
+			serialSeconds = SecondsSince(serialStart);
+		} while (serialSeconds < 0.5);
+
+		simulation::ResetPartitioned(partitioned);
+		uint64_t parallelTicks = 0;
+		Clock::time_point parallelStart = Clock::now();
+		double parallelSeconds;
+		do
+		{
+			simulation::StepPartitioned(partitioned);
+			++parallelTicks;
+			parallelSeconds = SecondsSince(parallelStart);
+		} while (parallelSeconds < 0.5);
+
+		double serialRate = (double)serialTicks / serialSeconds;
+		double parallelRate = (double)parallelTicks / parallelSeconds;
+		printf("%10zu %10zu %12zu %16.1f %16.1f %9.2fx\n", numModules, simulation::NumGates(netlist), partitioned.partitions.size(), serialRate, parallelRate, parallelRate / serialRate);
+
+		double fastest = partitioned.partitions[0].totalSeconds;
+		double slowest = fastest;
+		for (const simulation::Partition& partition : partitioned.partitions)
+		{
+			fastest = partition.totalSeconds < fastest ? partition.totalSeconds : fastest;
+			slowest = partition.totalSeconds > slowest ? partition.totalSeconds : slowest;
+		}
+		printf("per-partition time per tick: %.3f ms to %.3f ms\n", fastest * 1000.0 / parallelTicks, slowest * 1000.0 / parallelTicks);
+	}
+
+	void TruthTable()
+	{
+		printf("Truth table (24 inputs, 8 outputs)\n");
+		printf("%10s %16s %12s %16s\n", "gates", "rows", "seconds", "rows/s");
+
+		constexpr size_t numInputs = 24;
+		constexpr size_t numOutputs = 8;
+		constexpr size_t sizes[] = { 1'000, 10'000 };
+		constexpr const char* filename = "benchmark.tt";
+
+		std::mt19937 rng(5);
+		simulation::Netlist netlist;
+		ChunkedList<graph::NodeHandle> selection;
+
+		for (size_t n : sizes)
+		{
+			MakeRandomCircuit(netlist, n, rng);
+
+			// MakeRandomCircuit's sources come first; make the first few of them the inputs
+			graph::ClearNodes();
+			Clear(selection);
+			for (size_t g = 0; g < n; ++g)
+			{
+				Push(selection, graph::CreateNode(netlist.types[g], (int)(g % 1024), (int)(g / 1024)));
+			}
+			for (size_t g = 0; g < n; ++g)
+			{
+				for (uint32_t i = netlist.inputStart[g]; i < netlist.inputStart[g + 1]; ++i)
+				{
+					graph::CreateWire(graph::WireElbow::DiagonalHori, At(selection, netlist.inputs[i]), At(selection, g));
+				}
+			}
+			std::vector<graph::NodeHandle> inputs(numInputs);
+			std::vector<graph::NodeHandle> outputs(numOutputs);
+			for (size_t i = 0; i < numInputs; ++i)
+			{
+				inputs[i] = At(selection, i);
+			}
+			for (size_t i = 0; i < numOutputs; ++i)
+			{
+				outputs[i] = At(selection, n - 1 - i);
+			}
+
+			Clock::time_point start = Clock::now();
+			simulation::WriteTruthTable(selection, inputs, outputs, filename);
+			double seconds = SecondsSince(start);
+			remove(filename);
+
+			double rows = (double)(1ull << numInputs);
+			printf("%10zu %16.0f %12.3f %16.0f\n", n, rows, seconds, rows / seconds);
+		}
+
+		graph::ClearNodes();
+		Free(selection);
+	}
+
+	void EquivalenceChecking()
+	{
+		printf("Equivalence checking\n");
+		printf("%10s %10s %12s %16s %16s\n", "gates", "vectors", "seconds", "vectors/s", "mismatch at");
+
+		constexpr size_t sizes[] = { 1'000, 10'000 };
+		constexpr uint64_t numVectors = 1ull << 22;
+
+		std::mt19937 rng(23);
+		simulation::Netlist netlist;
+		ChunkedList<graph::NodeHandle> selections[2];
+		char name[24]; // "n" and any size_t
+
+		for (size_t n : sizes)
+		{
+			// Two copies of the same circuit, with the same names
+			MakeRandomCircuit(netlist, n, rng);
+			graph::ClearNodes();
+			for (ChunkedList<graph::NodeHandle>& selection : selections)
+			{
+				Clear(selection);
+				for (size_t g = 0; g < n; ++g)
+				{
+					graph::NodeHandle node = graph::CreateNode(netlist.types[g], (int)(g % 1024), (int)(g / 1024));
+					snprintf(name, sizeof(name), "n%zu", g);
+					At(graph::nodeName, graph::NodeIndex(node)) = graph::InternName(name, strlen(name));
+					Push(selection, node);
+				}
+				for (size_t g = 0; g < n; ++g)
+				{
+					for (uint32_t i = netlist.inputStart[g]; i < netlist.inputStart[g + 1]; ++i)
+					{
+						graph::CreateWire(graph::WireElbow::DiagonalHori, At(selection, netlist.inputs[i]), At(selection, g));
+					}
+				}
+			}
+
+			simulation::EquivalenceResult result;
+			simulation::CheckEquivalence(selections[0], selections[1], numVectors, 1, result);
+			printf("%10zu %10llu %12.3f %16.0f %16s\n", n, (unsigned long long)result.numVectors, result.seconds, result.vectorsPerSecond, "-");
+
+			// The last gate feeds nothing, so it's an output - inverting it makes every vector a counterexample
+			size_t last = graph::NodeIndex(At(selections[1], n - 1));
+			At(graph::nodeType, last) = At(graph::nodeType, last) == graph::NodeType::Non ? graph::NodeType::Any : graph::NodeType::Non;
+			simulation::CheckEquivalence(selections[0], selections[1], numVectors, 1, result);
+			printf("%10zu %10llu %12.3f %16.0f %16llu\n", n, (unsigned long long)result.numVectors, result.seconds, result.vectorsPerSecond,
+				(unsigned long long)result.counterexampleIndex);
+		}
+
+		graph::ClearNodes();
+		graph::ClearNames();
+		for (ChunkedList<graph::NodeHandle>& selection : selections)
+		{
+			Free(selection);
+		}
+	}
+
+	void ComponentInstancing()
+	{
+		printf("Component instancing (200 copies of a 2000-gate block)\n");
+		printf("%10s %10s %10s %12s %12s %12s %12s\n", "design", "nodes", "file (KB)", "load (ms)", "build (ms)", "rebuild (ms)", "gates");
+
+		constexpr size_t numCopies = 200;
+		constexpr size_t blockGates = 2'000;
+		constexpr size_t numPorts = 16; // Inputs, and again outputs
+		constexpr const char* filename = "benchmark.graph";
+
+		std::mt19937 rng(24);
+		simulation::Netlist block;
+		MakeRandomCircuit(block, blockGates, rng);
+		ChunkedList<graph::NodeHandle> nodes;
+
+		auto PlaceBlock = [&](int x, int y)
+		{
+			Clear(nodes);
+			for (size_t g = 0; g < blockGates; ++g)
+			{
+				Push(nodes, graph::CreateNode(block.types[g], x + (int)(g % 64), y + (int)(g / 64)));
+			}
+			for (size_t g = 0; g < blockGates; ++g)
+			{
+				for (uint32_t i = block.inputStart[g]; i < block.inputStart[g + 1]; ++i)
+				{
+					graph::CreateWire(graph::WireElbow::DiagonalHori, At(nodes, block.inputs[i]), At(nodes, g));
+				}
+			}
+		};
+		// Saves and loads the board, then builds its netlist twice - the first build of instances flattens their definition
+		auto Measure = [&](const char* design)
+		{
+			graph::Save(filename);
+			std::ifstream file(filename, std::ios::binary | std::ios::ate);
+			double kilobytes = (double)file.tellg() / 1024.0;
+			file.close();
+
+			Clock::time_point start = Clock::now();
+			graph::Load(filename);
+			double loadSeconds = SecondsSince(start);
+			remove(filename);
+
+			simulation::Netlist netlist;
+			start = Clock::now();
+			simulation::BuildNetlistFromGraph(netlist);
+			double buildSeconds = SecondsSince(start);
+			start = Clock::now();
+			simulation::BuildNetlistFromGraph(netlist);
+			double rebuildSeconds = SecondsSince(start);
+
+			printf("%10s %10zu %10.0f %12.3f %12.3f %12.3f %12zu\n", design, graph::numNodes, kilobytes,
+				loadSeconds * 1000.0, buildSeconds * 1000.0, rebuildSeconds * 1000.0, simulation::NumGates(netlist));
+		};
+
+		graph::ClearNodes();
+		for (size_t c = 0; c < numCopies; ++c)
+		{
+			PlaceBlock((int)(c % 16) * 80, (int)(c / 16) * 40);
+		}
+		Measure("flat");
+
+		// MakeRandomCircuit's sources come first, and its last gates are the likeliest to feed nothing
+		graph::ClearNodes();
+		PlaceBlock(0, 0);
+		std::vector<graph::NodeHandle> inputs(numPorts);
+		std::vector<graph::NodeHandle> outputs(numPorts);
+		for (size_t i = 0; i < numPorts; ++i)
+		{
+			inputs[i] = At(nodes, i);
+			outputs[i] = At(nodes, blockGates - 1 - i);
+		}
+		graph::DefinitionID definition = graph::DefineComponent(graph::InternName("block", 5), nodes, inputs, outputs);
+		graph::DestroyNodes(nodes);
+		std::vector<graph::NodeHandle> ports(numPorts * 2);
+		for (size_t c = 0; c < numCopies; ++c)
+		{
+			int x = (int)(c % 16) * 80;
+			int y = (int)(c / 16) * 40;
+			for (size_t i = 0; i < ports.size(); ++i)
+			{
+				ports[i] = graph::CreateNode(graph::NodeType::Any, x + (int)(i / numPorts) * 70, y + (int)(i % numPorts));
+			}
+			graph::PlaceInstance(definition, x + 2, y, 0, ports);
+		}
+		Measure("instanced");
+
+		graph::ClearNodes();
+		Free(nodes);
+	}
+
+	void StructuralHashing()
+	{
+		printf("Structural hashing (4 copies of a block on the same sources)\n");
+		printf("%10s %12s %12s %12s %12s %14s %14s\n", "gates", "duplicates", "find (ms)", "ns/gate", "compiled", "as is (t/s)", "merged (t/s)");
+
+		constexpr size_t sizes[] = { 100'000, 1'000'000, 4'000'000 };
+		constexpr size_t numCopies = 4;
+
+		std::mt19937 rng(25);
+		simulation::Netlist block;
+		simulation::Netlist netlist;
+		simulation::Program asIs;
+		simulation::Program merged;
+		std::vector<simulation::GateID> inputs;
+		std::vector<simulation::GateID> originalOf;
+
+		// Ticks per second of sweeping every gate, for half a second
+		auto TickRate = [](simulation::Program& program)
+		{
+			program.mode = simulation::StepMode::Sweep;
+			uint64_t ticks = 0;
+			Clock::time_point start = Clock::now();
+			double seconds;
+			do
+			{
+				simulation::Step(program);
+				++ticks;
+				seconds = SecondsSince(start);
+			} while (seconds < 0.5);
+			return (double)ticks / seconds;
+		};
+
+		for (size_t n : sizes)
+		{
+			// Copies share the first copy's sources, so everything else in them duplicates the first copy
+			MakeRandomCircuit(block, n / numCopies, rng);
+			netlist = block;
+			for (size_t c = 1; c < numCopies; ++c)
+			{
+				simulation::GateID offset = (simulation::GateID)simulation::NumGates(netlist);
+				for (simulation::GateID g = 0; g < simulation::NumGates(block); ++g)
+				{
+					if (block.inputStart[g] == block.inputStart[g + 1])
+					{
+						// Stands in for the source, so that gate IDs line up - but nothing reads it
+						simulation::AddGate(netlist, block.types[g], nullptr, 0);
+						continue;
+					}
+					inputs.clear();
+					for (uint32_t i = block.inputStart[g]; i < block.inputStart[g + 1]; ++i)
+					{
+						simulation::GateID input = block.inputs[i];
+						bool isSource = block.inputStart[input] == block.inputStart[input + 1];
+						inputs.push_back(isSource ? input : offset + input);
+					}
+					simulation::AddGate(netlist, block.types[g], inputs.data(), inputs.size());
+				}
+			}
+
+			Clock::time_point start = Clock::now();
+			size_t numDuplicates = simulation::FindDuplicateGates(netlist, originalOf);
+			double seconds = SecondsSince(start);
+
+			simulation::CompileUnoptimized(netlist, asIs);
+			simulation::Compile(netlist, merged);
+			double before = TickRate(asIs);
+			double after = TickRate(merged);
+			printf("%10zu %12zu %12.3f %12.1f %12u %14.1f %14.1f\n", simulation::NumGates(netlist), numDuplicates,
+				seconds * 1000.0, seconds * 1e9 / (double)simulation::NumGates(netlist), merged.numGates, before, after);
+		}
+	}
+
+	void LoopTracking()
+	{
+		printf("Feedback loop tracking\n");
+		printf("%10s %10s %16s %16s %16s\n", "nodes", "wires", "rebuild (ms)", "add wire (us)", "remove wire (us)");
+
+		constexpr size_t n = 200'000;
+		constexpr size_t numEdits = 10'000;
+
+		ChunkedList<graph::NodeHandle> handles;
+		std::mt19937 rng(7);
+
+		// Mostly local wiring, with the occasional wire back to make latches
+		graph::ClearNodes();
+		for (size_t i = 0; i < n; ++i)
+		{
+			Push(handles, graph::CreateNode(graph::NodeType::Non, (int)(i % 1024), (int)(i / 1024)));
+		}
+		graph::InvalidateSccs();
+		for (size_t i = 0; i < n; ++i)
+		{
+			size_t target = (rng() % 16 == 0) ? i - rng() % (i < 8 ? i + 1 : 8) : (i + 1 + rng() % 8) % n;
+			graph::CreateWire(graph::WireElbow::DiagonalHori, At(handles, i), At(handles, target));
+		}
+
+		Clock::time_point rebuildStart = Clock::now();
+		graph::NodeScc(At(handles, 0));
+		double rebuildSeconds = SecondsSince(rebuildStart);
+
+		std::vector<graph::WireHandle> added(numEdits);
+		Clock::time_point addStart = Clock::now();
+		for (size_t i = 0; i < numEdits; ++i)
+		{
+			size_t start = rng() % n;
+			size_t end = (start + 1 + rng() % 64) % n;
+			added[i] = graph::CreateWire(graph::WireElbow::DiagonalHori, At(handles, start), At(handles, end));
+		}
+		double addSeconds = SecondsSince(addStart);
+
+		Clock::time_point removeStart = Clock::now();
+		for (size_t i = 0; i < numEdits; ++i)
+		{
+			graph::DestroyWire(added[i]);
+		}
+		double removeSeconds = SecondsSince(removeStart);
+
+		printf("%10zu %10zu %16.3f %16.3f %16.3f\n", n, graph::numWires, rebuildSeconds * 1000.0, addSeconds * 1e6 / numEdits, removeSeconds * 1e6 / numEdits);
+
+		graph::ClearNodes();
+		Free(handles);
+	}
+
+	void GateDepthTracking()
+	{
+		printf("Gate depth tracking\n");
+		printf("%10s %10s %8s %16s %16s %16s %18s\n", "nodes", "wires", "depth", "rebuild (ms)", "add wire (us)", "remove wire (us)", "critical path (us)");
+
+		constexpr size_t width = 1024;
+		constexpr size_t n = 256 * width;
+		constexpr size_t numEdits = 10'000;
+
+		ChunkedList<graph::NodeHandle> handles;
+		std::mt19937 rng(11);
+
+		// Rows of gates, each driven by two gates of the row above - the depth of each is its row
+		graph::ClearNodes();
+		for (size_t i = 0; i < n; ++i)
+		{
+			Push(handles, graph::CreateNode(graph::NodeType::Non, (int)(i % width), (int)(i / width)));
+		}
+		graph::InvalidateSccs();
+		for (size_t i = width; i < n; ++i)
+		{
+			for (int input = 0; input < 2; ++input)
+			{
+				size_t column = (i % width + width + rng() % 5 - 2) % width;
+				size_t start = (i / width - 1) * width + column;
+				graph::CreateWire(graph::WireElbow::DiagonalHori, At(handles, start), At(handles, i));
+			}
+		}
+
+		Clock::time_point rebuildStart = Clock::now();
+		uint32_t depth = graph::CriticalPathDepth();
+		double rebuildSeconds = SecondsSince(rebuildStart);
+
+		// Wires from one row to any later row, queried after each edit like the graph panel does every frame
+		std::vector<graph::WireHandle> added(numEdits);
+		Clock::time_point addStart = Clock::now();
+		for (size_t i = 0; i < numEdits; ++i)
+		{
+			size_t end = width + rng() % (n - width);
+			size_t start = (rng() % (end / width)) * width + rng() % width;
+			added[i] = graph::CreateWire(graph::WireElbow::DiagonalHori, At(handles, start), At(handles, end));
+			graph::CriticalPathDepth();
+		}
+		double addSeconds = SecondsSince(addStart);
+
+		Clock::time_point removeStart = Clock::now();
+		for (size_t i = 0; i < numEdits; ++i)
+		{
+			graph::DestroyWire(added[i]);
+			graph::CriticalPathDepth();
+		}
+		double removeSeconds = SecondsSince(removeStart);
+
+		constexpr size_t numPathQueries = 100;
+		std::vector<graph::NodeHandle> pathNodes;
+		std::vector<graph::WireHandle> pathWires;
+		double pathSeconds = 0.0;
+		for (size_t i = 0; i < numPathQueries; ++i)
+		{
+			// Any edit throws the cached path away
+			graph::DestroyWire(graph::CreateWire(graph::WireElbow::DiagonalHori, At(handles, i), At(handles, width + i)));
+			graph::CriticalPathDepth();
+
+			Clock::time_point pathStart = Clock::now();
+			graph::CriticalPath(pathNodes, pathWires);
+			pathSeconds += SecondsSince(pathStart);
+		}
+
+		printf("%10zu %10zu %8u %16.3f %16.3f %16.3f %18.3f\n", n, graph::numWires, depth,
+			rebuildSeconds * 1000.0, addSeconds * 1e6 / numEdits, removeSeconds * 1e6 / numEdits, pathSeconds * 1e6 / numPathQueries);
+
+		graph::ClearNodes();
+		Free(handles);
+	}
+
+	void RunAll()
+	{
+		NodeStorage();
+		BatchNodeRemoval();
+		LoopTracking();
+		GateDepthTracking();
+		Simulation();
+		StateHandoff();
+		IncrementalCompile();
+		BytecodeSimulation();
+		Rewind();
+		EventSimulation();
+		Tracing();
+		LaneSimulation();
+		ComponentSimulation();
+		TruthTable();
+		EquivalenceChecking();
+		ComponentInstancing();
+		StructuralHashing();
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+// Timed stress tests of the program's data structures.
+// Results are printed to stdout, so run these from a terminal with `--bench`.
+namespace benchmark
+{
+	// Node creation and destruction throughput at increasing graph sizes
+	void NodeStorage();
+
+	// Deleting a large, shuffled selection of nodes along with their wires
+	void BatchNodeRemoval();
+
+	// Rebuilding the feedback loop index from scratch, versus keeping it up to date wire by wire
+	void LoopTracking();
+
+	// Settling gate depths after each wire edit on a deep board, versus settling every node, and finding the critical path
+	void GateDepthTracking();
+
+	// Gate evaluations per second of compiled random circuits at increasing sizes
+	void Simulation();
+
+	// The same circuits run through the bytecode interpreter, and how long saved bytecode takes to load versus compiling
+	void BytecodeSimulation();
+
+	// Memory per recorded tick of a large circuit as more of it changes each tick, and the cost of recording and seeking
+	void Rewind();
+
+	// Ticks per second of each step mode on a large circuit, as the number of inputs toggled per tick grows
+	void EventSimulation();
+
+	// Cost of recording transitions of a few and of thousands of probes, in each step mode
+	void Tracing();
+
+	// Rows per second of an exhaustive truth table, one row per tick against every lane at once
+	void LaneSimulation();
+
+	// Ticks per second of a board of independent modules, stepped serially and then across the worker pool
+	void ComponentSimulation();
+
+	// Seconds to write the whole truth table of a 24-input circuit
+	void TruthTable();
+
+	// Runs every benchmark
+	void RunAll();
+}
@@ -0,0 +1,157 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+#include "console_log.hpp"
+
+// A list without a maximum size, which grows by allocating fixed-size chunks.
+// Growing never moves items that are already in the list, so pointers and references to them stay valid.
+// Only the table of chunk pointers is ever reallocated.
+// Owns its chunks - it can be moved but not copied, and frees them when destroyed.
+template<typename T, size_t _CHUNK_SIZE = 4096> struct ChunkedList
+{
+	static_assert((_CHUNK_SIZE & (_CHUNK_SIZE - 1)) == 0, "Chunk size must be a power of two");
+
+	static constexpr size_t CHUNK_SIZE = _CHUNK_SIZE;
+	T** chunks = nullptr;
+	size_t numChunks = 0; // Number of chunks allocated
+	size_t maxChunks = 0; // Capacity of the chunk table
+	size_t num = 0;
+
+	ChunkedList() = default;
+	ChunkedList(const ChunkedList&) = delete;
+	ChunkedList& operator=(const ChunkedList&) = delete;
+
+	ChunkedList(ChunkedList&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	ChunkedList& operator=(ChunkedList&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Free(*this);
+			std::swap(chunks, other.chunks);
+			std::swap(numChunks, other.numChunks);
+			std::swap(maxChunks, other.maxChunks);
+			std::swap(num, other.num);
+		}
+		return *this;
+	}
+
+	~ChunkedList()
+	{
+		Free(*this);
+	}
+};
+
+template<typename T, size_t _CHUNK_SIZE> T& At(ChunkedList<T, _CHUNK_SIZE>& list, size_t index)
+{
+	return list.chunks[index / _CHUNK_SIZE][index % _CHUNK_SIZE];
+}
+
+template<typename T, size_t _CHUNK_SIZE> const T& At(const ChunkedList<T, _CHUNK_SIZE>& list, size_t index)
+{
+	return list.chunks[index / _CHUNK_SIZE][index % _CHUNK_SIZE];
+}
+
+// Number of chunks containing at least one item
+template<typename T, size_t _CHUNK_SIZE> size_t NumChunksUsed(const ChunkedList<T, _CHUNK_SIZE>& list)
+{
+	return (list.num + _CHUNK_SIZE - 1) / _CHUNK_SIZE;
+}
+
+// Number of items in the chunk - Loop over this and `list.chunks[chunkIndex]` to visit items in contiguous runs
+template<typename T, size_t _CHUNK_SIZE> size_t ChunkLength(const ChunkedList<T, _CHUNK_SIZE>& list, size_t chunkIndex)
+{
+	size_t start = chunkIndex * _CHUNK_SIZE;
+	return (list.num - start < _CHUNK_SIZE) ? (list.num - start) : _CHUNK_SIZE;
+}
+
+// Allocates chunks until the list can hold at least `capacity` items without allocating
+template<typename T, size_t _CHUNK_SIZE> void Reserve(ChunkedList<T, _CHUNK_SIZE>& list, size_t capacity)
+{
+	size_t chunksNeeded = (capacity + _CHUNK_SIZE - 1) / _CHUNK_SIZE;
+	if (chunksNeeded <= list.numChunks)
+	{
+		return;
+	}
+
+	if (chunksNeeded > list.maxChunks)
+	{
+		size_t newMaxChunks = list.maxChunks ? list.maxChunks * 2 : 8;
+		while (newMaxChunks < chunksNeeded)
+		{
+			newMaxChunks *= 2;
+		}
+		T** newChunks = new T*[newMaxChunks];
+		for (size_t i = 0; i < list.numChunks; ++i)
+		{
+			newChunks[i] = list.chunks[i];
+		}
+		delete[] list.chunks;
+		list.chunks = newChunks;
+		list.maxChunks = newMaxChunks;
+	}
+
+	for (; list.numChunks < chunksNeeded; ++list.numChunks)
+	{
+		list.chunks[list.numChunks] = new T[_CHUNK_SIZE]();
+	}
+}
+
+template<typename T, size_t _CHUNK_SIZE> void Push(ChunkedList<T, _CHUNK_SIZE>& list, const T& item)
+{
+	if (list.num == list.numChunks * _CHUNK_SIZE) [[unlikely]]
+	{
+		Reserve(list, list.num + 1);
+	}
+	At(list, list.num++) = item;
+}
+
+template<typename T, size_t _CHUNK_SIZE> void Push(ChunkedList<T, _CHUNK_SIZE>& list, T&& item)
+{
+	if (list.num == list.numChunks * _CHUNK_SIZE) [[unlikely]]
+	{
+		Reserve(list, list.num + 1);
+	}
+	At(list, list.num++) = std::move(item);
+}
+
+template<typename T, size_t _CHUNK_SIZE> T Pop(ChunkedList<T, _CHUNK_SIZE>& list)
+{
+	if (list.num == 0) [[unlikely]]
+	{
+		console::Error("ChunkedList: Tried to pop when empty.");
+		return T{};
+	}
+	return std::move(At(list, --list.num));
+}
+
+// Grows or shrinks the list to `num` items
+// New items keep whatever value their memory last held; items removed are not destroyed until the list is freed.
+template<typename T, size_t _CHUNK_SIZE> void Resize(ChunkedList<T, _CHUNK_SIZE>& list, size_t num)
+{
+	Reserve(list, num);
+	list.num = num;
+}
+
+// Empties the list without releasing its chunks
+template<typename T, size_t _CHUNK_SIZE> void Clear(ChunkedList<T, _CHUNK_SIZE>& list)
+{
+	list.num = 0;
+}
+
+// Empties the list and releases all of its memory
+template<typename T, size_t _CHUNK_SIZE> void Free(ChunkedList<T, _CHUNK_SIZE>& list)
+{
+	for (size_t i = 0; i < list.numChunks; ++i)
+	{
+		delete[] list.chunks[i];
+	}
+	delete[] list.chunks;
+	list.chunks = nullptr;
+	list.numChunks = 0;
+	list.maxChunks = 0;
+	list.num = 0;
+}
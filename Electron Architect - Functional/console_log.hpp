@@ -0,0 +1,21 @@
+#pragma once
+
+// Logging to the Console panel, declared apart from the panel itself so that code which doesn't draw can log without the window.
+// The headless runner links its own definitions, which print to the terminal instead.
+namespace console
+{
+	void Log    (const char* text);
+	void Logf   (const char* fmt...);
+
+	void Warn   (const char* text);
+	void Warnf  (const char* fmt...);
+
+	void Error  (const char* text);
+	void Errorf (const char* fmt...);
+
+	void Assert (bool condition, const char* text);
+	void Assertf(bool condition, const char* fmt...);
+
+	void Group(const char* groupName);
+	void GroupEnd();
+}
@@ -1,5 +1,5 @@
 #pragma once
-#include <string>
+#include "graph_storage.hpp"
 #include "panel.hpp"
 
 // Functions related to the circuit graphing feature of the program.
@@ -22,46 +22,13 @@ namespace graph
 	extern int gridDisplaySize;
 	extern int gridDisplaySize_WithLine;
 
-	enum class NodeType : char
-	{
-		Any = '|',
-		All = '&',
-		Non = '!',
-		One = '^',
-	};
-
-	struct Node
-	{
-		NodeType type;
-		int x, y;
-		std::string name;
-	};
-
-	constexpr size_t MAX_NODES = 4096;
-	extern size_t numNodes;
-	extern Node* nodes[MAX_NODES];
-
-	enum class WireElbow : unsigned char
-	{
-		DiagonalHori = 0,
-		DiagonalVert = 1,
-		HoriDiagonal = 2,
-		VertDiagonal = 3,
-	};
-
-	// @No null node pointers. A wire should not exist if it doesn't connect two existing nodes.
-	struct Wire
-	{
-		WireElbow elbow;
-		Node* startNode;
-		Node* endNode;
-	};
+	extern panel::Panel graphPanel;
 
-	constexpr size_t MAX_WIRES = 4096;
-	extern size_t numWires;
-	extern Wire* wires[MAX_WIRES];
+	// Depth of the critical path, refreshed by UpdateStats - for linking to the properties panel
+	extern int criticalPathDepth;
 
-	extern panel::Panel graphPanel;
+	// Gates with the same type and inputs as another, which Compile merges - counted by UpdateStats once edits settle, for linking to the properties panel
+	extern int redundantGates;
 
 	// Number of grid spaces offset horizontally
 	// This is *added* to the panel's xmin
@@ -74,6 +41,9 @@ namespace graph
 	// Call this after performing modifications to zoom/offset, and prior to placing elements
 	void UpdateGridDisplaySize();
 
+	// Refreshes criticalPathDepth and redundantGates - call once a frame, before drawing
+	void UpdateStats();
+
 	void DrawPanelContents(int mousexNow, int mouseyNow, int mousexMid, int mouseyMid, int mousexOld, int mouseyOld, bool allowHover);
 
 	void Zoom(int amount);
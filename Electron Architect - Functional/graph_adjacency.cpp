@@ -0,0 +1,145 @@
+#include "graph_adjacency.hpp"
+
+namespace graph
+{
+	// Heads of the node's wire lists
+	struct NodeWires
+	{
+		WireHandle firstOut = NULL_WIRE;
+		WireHandle firstIn = NULL_WIRE;
+		uint32_t numOut = 0;
+		uint32_t numIn = 0;
+	};
+
+	// Each wire is in two doubly-linked lists: the fan-out of its start node and the fan-in of its end node.
+	// Doubly-linked so that unlinking doesn't need to walk the list.
+	struct WireLinks
+	{
+		WireHandle prevOut, nextOut;
+		WireHandle prevIn, nextIn;
+	};
+
+	// Indexed by node handle slot
+	ChunkedList<NodeWires> nodeWires;
+
+	// Indexed by wire handle slot
+	ChunkedList<WireLinks> wireLinks;
+
+	NodeWires& Wires(NodeHandle node) { return At(nodeWires, HandleSlot(node)); }
+	WireLinks& Links(WireHandle wire) { return At(wireLinks, HandleSlot(wire)); }
+
+	void InitNodeAdjacency(NodeHandle node)
+	{
+		if (HandleSlot(node) >= nodeWires.num)
+		{
+			Resize(nodeWires, (size_t)HandleSlot(node) + 1);
+		}
+		Wires(node) = NodeWires();
+	}
+
+	void LinkWire(WireHandle wire, NodeHandle startNode, NodeHandle endNode)
+	{
+		if (HandleSlot(wire) >= wireLinks.num)
+		{
+			Resize(wireLinks, (size_t)HandleSlot(wire) + 1);
+		}
+
+		NodeWires& start = Wires(startNode);
+		NodeWires& end = Wires(endNode);
+		WireLinks& links = Links(wire);
+
+		links.prevOut = NULL_WIRE;
+		links.nextOut = start.firstOut;
+		if (start.firstOut != NULL_WIRE)
+		{
+			Links(start.firstOut).prevOut = wire;
+		}
+		start.firstOut = wire;
+		++start.numOut;
+
+		links.prevIn = NULL_WIRE;
+		links.nextIn = end.firstIn;
+		if (end.firstIn != NULL_WIRE)
+		{
+			Links(end.firstIn).prevIn = wire;
+		}
+		end.firstIn = wire;
+		++end.numIn;
+	}
+
+	void UnlinkWireOut(WireHandle wire, NodeHandle startNode)
+	{
+		NodeWires& start = Wires(startNode);
+		const WireLinks& links = Links(wire);
+		if (links.prevOut != NULL_WIRE) { Links(links.prevOut).nextOut = links.nextOut; }
+		else                            { start.firstOut = links.nextOut; }
+		if (links.nextOut != NULL_WIRE) { Links(links.nextOut).prevOut = links.prevOut; }
+		--start.numOut;
+	}
+
+	void UnlinkWireIn(WireHandle wire, NodeHandle endNode)
+	{
+		NodeWires& end = Wires(endNode);
+		const WireLinks& links = Links(wire);
+		if (links.prevIn != NULL_WIRE) { Links(links.prevIn).nextIn = links.nextIn; }
+		else                           { end.firstIn = links.nextIn; }
+		if (links.nextIn != NULL_WIRE) { Links(links.nextIn).prevIn = links.prevIn; }
+		--end.numIn;
+	}
+
+	void UnlinkWire(WireHandle wire, NodeHandle startNode, NodeHandle endNode)
+	{
+		UnlinkWireOut(wire, startNode);
+		UnlinkWireIn(wire, endNode);
+	}
+
+	void ClearWireAdjacency()
+	{
+		for (size_t i = 0; i < nodeWires.num; ++i)
+		{
+			At(nodeWires, i) = NodeWires();
+		}
+		Clear(wireLinks);
+	}
+
+	void ClearNodeAdjacency()
+	{
+		Clear(nodeWires);
+	}
+
+	WireHandle FirstWireOut(NodeHandle node) { return Wires(node).firstOut; }
+	WireHandle NextWireOut(WireHandle wire)  { return Links(wire).nextOut; }
+	uint32_t NumWiresOut(NodeHandle node)    { return Wires(node).numOut; }
+
+	WireHandle FirstWireIn(NodeHandle node) { return Wires(node).firstIn; }
+	WireHandle NextWireIn(WireHandle wire)  { return Links(wire).nextIn; }
+	uint32_t NumWiresIn(NodeHandle node)    { return Wires(node).numIn; }
+
+	void BuildWireGraphCSR(WireGraphCSR& csr)
+	{
+		csr.outStart.assign(numNodes + 1, 0);
+		csr.inStart.assign(numNodes + 1, 0);
+		csr.outNodes.resize(numWires);
+		csr.inNodes.resize(numWires);
+
+		// Degrees come straight from the adjacency heads
+		for (size_t i = 0; i < numNodes; ++i)
+		{
+			const NodeWires& node = Wires(At(nodeHandles, i));
+			csr.outStart[i + 1] = csr.outStart[i] + node.numOut;
+			csr.inStart[i + 1] = csr.inStart[i] + node.numIn;
+		}
+
+		// Fill each node's range from the front, using a running cursor per node
+		std::vector<uint32_t> outCursor(csr.outStart.begin(), csr.outStart.end() - 1);
+		std::vector<uint32_t> inCursor(csr.inStart.begin(), csr.inStart.end() - 1);
+		for (size_t i = 0; i < numWires; ++i)
+		{
+			const Wire& wire = At(wires, i);
+			uint32_t start = (uint32_t)NodeIndex(wire.startNode);
+			uint32_t end = (uint32_t)NodeIndex(wire.endNode);
+			csr.outNodes[outCursor[start]++] = end;
+			csr.inNodes[inCursor[end]++] = start;
+		}
+	}
+}
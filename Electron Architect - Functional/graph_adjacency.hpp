@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+#include "graph_storage.hpp"
+
+// Maps each node to the wires attached to it.
+// Kept up to date by the node and wire create/destroy functions - no need to call the modifiers yourself.
+namespace graph
+{
+	void InitNodeAdjacency(NodeHandle node);
+	void LinkWire(WireHandle wire, NodeHandle startNode, NodeHandle endNode);
+	void UnlinkWire(WireHandle wire, NodeHandle startNode, NodeHandle endNode);
+	// Only from the start's fan-out, or only from the end's fan-in - for when the node at the other end is being destroyed too
+	void UnlinkWireOut(WireHandle wire, NodeHandle startNode);
+	void UnlinkWireIn(WireHandle wire, NodeHandle endNode);
+
+	// Detaches every wire from every node
+	void ClearWireAdjacency();
+
+	// Forgets every node - Call ClearWireAdjacency first
+	void ClearNodeAdjacency();
+
+	// Wires starting at the node (fan-out)
+	// Visit all of them in O(degree) with `for (w = FirstWireOut(n); w != NULL_WIRE; w = NextWireOut(w))`
+	WireHandle FirstWireOut(NodeHandle node);
+	WireHandle NextWireOut(WireHandle wire);
+	uint32_t NumWiresOut(NodeHandle node);
+
+	// Wires ending at the node (fan-in)
+	// Visit all of them in O(degree) with `for (w = FirstWireIn(n); w != NULL_WIRE; w = NextWireIn(w))`
+	WireHandle FirstWireIn(NodeHandle node);
+	WireHandle NextWireIn(WireHandle wire);
+	uint32_t NumWiresIn(NodeHandle node);
+
+	// Compressed-sparse-row copy of the wire graph.
+	// Indexed by node *index* (not handle), and only valid until the next node or wire is created or destroyed.
+	// Neighbors of node `i` are `outNodes[outStart[i]]` through `outNodes[outStart[i + 1] - 1]`.
+	struct WireGraphCSR
+	{
+		std::vector<uint32_t> outStart; // numNodes + 1 items
+		std::vector<uint32_t> outNodes; // End node index of each wire, grouped by start node
+		std::vector<uint32_t> inStart;  // numNodes + 1 items
+		std::vector<uint32_t> inNodes;  // Start node index of each wire, grouped by end node
+	};
+
+	// O(nodes + wires)
+	void BuildWireGraphCSR(WireGraphCSR& csr);
+}
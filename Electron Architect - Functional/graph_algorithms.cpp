@@ -1,74 +1,44 @@
 #include <algorithm>
+#include <string.h>
+#include <vector>
 #include "graph_algorithms.hpp"
+#include "graph_names.hpp"
+#include "graph_spatial.hpp"
+#include "simulation_equivalence.hpp"
+#include "simulation_truth_table.hpp"
 
 namespace graph
 {
 	extern int gridDisplaySize_WithLine; // Defined in graph.cpp
 
-	const Node* nodesSelected[MAX_NODES] = {};
-	size_t numNodesSelected = 0;
+	ChunkedList<NodeHandle> nodesSelected;
+	ChunkedList<NodeHandle> nodesSelectedBefore;
 
-	const Wire* wiresSelected[MAX_WIRES] = {};
-	size_t numWiresSelected = 0;
+	ChunkedList<WireHandle> wiresSelected;
 
 	void AddNode(NodeType type, int screenx, int screeny)
 	{
 		int x = screenx / gridDisplaySize_WithLine;
 		int y = screeny / gridDisplaySize_WithLine;
-		Node* createdNode = new Node
-		{
-			.type = type,
-			.x = x,
-			.y = y,
-		};
-		nodes[numNodes++] = createdNode;
+		CreateNode(type, x, y);
 	}
 
-	void AddWire(WireElbow elbow, Node* startNode, Node* endNode)
+	void AddWire(WireElbow elbow, NodeHandle startNode, NodeHandle endNode)
 	{
-		Wire* createdWire = new Wire
-		{
-			.elbow = elbow,
-			.startNode = startNode,
-			.endNode = endNode,
-		};
-		wires[numWires++] = createdWire;
+		CreateWire(elbow, startNode, endNode);
 	}
 
-	// Removes the nodes in nodeIndicesToRemove and numNodesToRemove.
 	void RemoveSelectedNodes()
 	{
-		{
-			size_t index = 0;
-			auto pred = [&index](const Node* node)
-			{
-				if (index == numNodesSelected)
-				{
-					return true;
-				}
-
-				if (node == nodesSelected[index])
-				{
-					++index;
-					return false;
-				}
-				return true;
-			};
-			std::stable_partition(nodes, nodes + numNodes, pred);
-
-			for (size_t i = 0; i < numNodesSelected; ++i)
-			{
-				delete nodesSelected[i];
-			}
-
-			numNodes -= numNodesSelected;
-		}
+		DestroyNodes(nodesSelected);
+		Clear(nodesSelected);
 	}
 
-	// Deposits results in nodesSelected and numNodesSelected.
+	// Deposits results in nodesSelected.
 	void SelectNodesInRanges(panel::Bounds screenRanges[], size_t numRanges)
 	{
-		numNodesSelected = 0;
+		std::swap(nodesSelected, nodesSelectedBefore);
+		Clear(nodesSelected);
 
 		// Convert from screenspace to gridspace
 		for (size_t i = 0; i < numRanges; ++i)
@@ -81,39 +51,68 @@ namespace graph
 			range.ymax = range.ymax / gridDisplaySize_WithLine;
 		}
 
-		for (size_t i = 0; i < numNodes; ++i)
+		static std::vector<CellRange> cellRanges;
+		cellRanges.resize(numRanges);
+		for (size_t i = 0; i < numRanges; ++i)
 		{
-			const Node* node = nodes[i];
-
-			for (size_t j = 0; j < numRanges; ++j)
-			{
-				const panel::Bounds& range = screenRanges[j];
-
-				bool isInRange =
-					range.xmin <= node->x && node->x <= range.xmax &&
-					range.ymin <= node->y && node->y <= range.ymax;
-
-				if (isInRange)
-				{
-					nodesSelected[numNodesSelected++] = node;
-					break; // Only include once
-				}
-			}
+			const panel::Bounds& range = screenRanges[i];
+			cellRanges[i] = { range.xmin, range.ymin, range.xmax, range.ymax };
 		}
+		QueryRanges(cellRanges.data(), numRanges, nodesSelected);
 	}
 
 	void RemoveNode(int screenx, int screeny)
 	{
-		panel::Bounds ranges[1] =
+		int x = screenx / gridDisplaySize_WithLine;
+		int y = screeny / gridDisplaySize_WithLine;
+
+		// Destroying the first node in the cell unlinks it, so the next one is always first
+		for (NodeHandle handle = FirstNodeInCell(x, y); handle != NULL_NODE; handle = FirstNodeInCell(x, y))
 		{
-			{
-				.xmin = screenx,
-				.ymin = screeny,
-				.xmax = screenx,
-				.ymax = screeny,
-			}
-		};
-		SelectNodesInRanges(ranges, 1);
-		RemoveSelectedNodes();
+			DestroyNode(handle);
+		}
+	}
+
+	bool WriteSelectionTruthTable(const char* filename)
+	{
+		std::vector<NodeHandle> inputs;
+		std::vector<NodeHandle> outputs;
+		simulation::FindSelectionPins(nodesSelected, inputs, outputs);
+		return simulation::WriteTruthTable(nodesSelected, inputs, outputs, filename);
+	}
+
+	DefinitionID DefineSelectionComponent(const char* name)
+	{
+		std::vector<NodeHandle> inputs;
+		std::vector<NodeHandle> outputs;
+		simulation::FindSelectionPins(nodesSelected, inputs, outputs);
+		return DefineComponent(InternName(name, strlen(name)), nodesSelected, inputs, outputs);
+	}
+
+	bool CheckSelectionEquivalence()
+	{
+		simulation::EquivalenceResult result;
+		return simulation::CheckEquivalence(nodesSelectedBefore, nodesSelected, simulation::DEFAULT_EQUIVALENCE_VECTORS, 1, result);
+	}
+
+	bool PlaceComponent(DefinitionID definition, int screenx, int screeny)
+	{
+		if (definition >= definitions.size())
+		{
+			return false;
+		}
+		int x = screenx / gridDisplaySize_WithLine;
+		int y = screeny / gridDisplaySize_WithLine;
+
+		std::vector<NodeHandle> inputs;
+		std::vector<NodeHandle> outputs;
+		simulation::FindSelectionPins(nodesSelected, inputs, outputs);
+
+		// Pins past the definition's own are dropped, and ports past the selection's are left unbound
+		const ComponentDefinition& placed = definitions[definition];
+		std::vector<NodeHandle> ports(placed.inputs.size() + placed.outputs.size(), NULL_NODE);
+		std::copy_n(inputs.begin(), std::min(inputs.size(), placed.inputs.size()), ports.begin());
+		std::copy_n(outputs.begin(), std::min(outputs.size(), placed.outputs.size()), ports.begin() + placed.inputs.size());
+		return PlaceInstance(definition, x, y, 0, ports);
 	}
 }
@@ -1,8 +1,36 @@
 #pragma once
 #include "graph.hpp"
+#include "graph_components.hpp"
 
 namespace graph
 {
+	// Filled by SelectNodesInRanges
+	extern ChunkedList<NodeHandle> nodesSelected;
+
+	// What nodesSelected held before the last SelectNodesInRanges, for comparing two selections
+	extern ChunkedList<NodeHandle> nodesSelectedBefore;
+
+	// Ranges are in screenspace, and are converted to gridspace in place.
+	// Replaces the contents of nodesSelected with every node within any of the ranges, moving what it held to nodesSelectedBefore.
+	void SelectNodesInRanges(panel::Bounds screenRanges[], size_t numRanges);
+
+	// Removes the nodes in nodesSelected, along with every wire attached to them
+	void RemoveSelectedNodes();
+
+	// The truth table of nodesSelected, with pins found by simulation::FindSelectionPins - see simulation_truth_table.hpp
+	bool WriteSelectionTruthTable(const char* filename);
+
+	// A component definition of nodesSelected, with its ports found by simulation::FindSelectionPins - see graph_components.hpp
+	DefinitionID DefineSelectionComponent(const char* name);
+
+	// Checks that nodesSelectedBefore and nodesSelected compute the same function, with simulation::CheckEquivalence -
+	// see simulation_equivalence.hpp. Returns false if their pins couldn't be matched up.
+	bool CheckSelectionEquivalence();
+
+	// An instance of the definition with its origin at the screenspace position.
+	// Its ports are bound to the pins of nodesSelected, found the same way: inputs to inputs and outputs to outputs, in order.
+	bool PlaceComponent(DefinitionID definition, int screenx, int screeny);
+
 	void AddNode(NodeType type, int screenx, int screeny);
 	void RemoveNode(int screenx, int screeny);
 }
@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <climits>
+#include "console_log.hpp"
+#include "graph_adjacency.hpp"
+#include "graph_components.hpp"
+
+namespace graph
+{
+	std::vector<ComponentDefinition> definitions;
+	std::vector<ComponentInstance> instances;
+	uint64_t definitionsVersion = 0;
+
+	DefinitionID DefineComponent(NameID name, const ChunkedList<NodeHandle>& selection,
+		const std::vector<NodeHandle>& inputs, const std::vector<NodeHandle>& outputs)
+	{
+		ComponentDefinition definition = {};
+		definition.name = name;
+
+		// Index within the definition of each selected node, by node index
+		std::vector<uint32_t> localOfNode(numNodes, NULL_NODE);
+		std::vector<NodeHandle> nodes;
+		int xmin = INT_MAX, ymin = INT_MAX, xmax = INT_MIN, ymax = INT_MIN;
+		for (size_t i = 0; i < selection.num; ++i)
+		{
+			NodeHandle node = At(selection, i);
+			if (!IsNodeValid(node) || localOfNode[NodeIndex(node)] != NULL_NODE)
+			{
+				continue;
+			}
+			size_t index = NodeIndex(node);
+			localOfNode[index] = (uint32_t)nodes.size();
+			nodes.push_back(node);
+			xmin = std::min(xmin, At(nodeX, index));
+			ymin = std::min(ymin, At(nodeY, index));
+			xmax = std::max(xmax, At(nodeX, index));
+			ymax = std::max(ymax, At(nodeY, index));
+		}
+		auto LocalOf = [&](uint32_t node) { return IsNodeValid(node) ? localOfNode[NodeIndex(node)] : NULL_NODE; };
+
+		for (NodeHandle node : inputs)
+		{
+			definition.inputs.push_back(LocalOf(node));
+		}
+		for (NodeHandle node : outputs)
+		{
+			definition.outputs.push_back(LocalOf(node));
+		}
+		if (std::count(definition.inputs.begin(), definition.inputs.end(), NULL_NODE) != 0 ||
+			std::count(definition.outputs.begin(), definition.outputs.end(), NULL_NODE) != 0)
+		{
+			console::Error("graph: Every port of a component must be a selected node.");
+			return NULL_DEFINITION;
+		}
+
+		for (NodeHandle node : nodes)
+		{
+			size_t index = NodeIndex(node);
+			definition.nodeTypes.push_back(At(nodeType, index));
+			definition.nodeXs.push_back(At(nodeX, index) - xmin);
+			definition.nodeYs.push_back(At(nodeY, index) - ymin);
+			definition.nodeNames.push_back(At(nodeName, index));
+			for (WireHandle w = FirstWireIn(node); w != NULL_WIRE; w = NextWireIn(w))
+			{
+				const Wire& wire = At(wires, WireIndex(w));
+				uint32_t start = LocalOf(wire.startNode);
+				if (start != NULL_NODE)
+				{
+					definition.wires.push_back({ wire.elbow, start, localOfNode[index] });
+				}
+			}
+		}
+		definition.width = nodes.empty() ? 0 : xmax - xmin + 1;
+		definition.height = nodes.empty() ? 0 : ymax - ymin + 1;
+
+		for (const ComponentInstance& instance : instances)
+		{
+			bool isBoundInside = false;
+			bool isBoundOutside = false;
+			for (uint32_t port : instance.ports)
+			{
+				bool isBound = IsNodeValid(port);
+				isBoundInside |= isBound && LocalOf(port) != NULL_NODE;
+				isBoundOutside |= isBound && LocalOf(port) == NULL_NODE;
+			}
+			if (isBoundInside && !isBoundOutside)
+			{
+				ComponentInstance& child = definition.instances.emplace_back(instance);
+				child.x -= xmin;
+				child.y -= ymin;
+				for (uint32_t& port : child.ports)
+				{
+					port = LocalOf(port);
+				}
+			}
+		}
+
+		definitions.push_back(std::move(definition));
+		++definitionsVersion;
+		return (DefinitionID)(definitions.size() - 1);
+	}
+
+	bool PlaceInstance(DefinitionID definition, int x, int y, uint8_t rotation, const std::vector<NodeHandle>& ports)
+	{
+		if (definition >= definitions.size())
+		{
+			console::Errorf("graph: There is no component definition %u.", definition);
+			return false;
+		}
+		const ComponentDefinition& placed = definitions[definition];
+		size_t numPorts = placed.inputs.size() + placed.outputs.size();
+		if (ports.size() > numPorts)
+		{
+			console::Errorf("graph: \"%s\" has %zu ports, not %zu.", NameString(placed.name), numPorts, ports.size());
+			return false;
+		}
+
+		ComponentInstance& instance = instances.emplace_back();
+		instance.definition = definition;
+		instance.x = x;
+		instance.y = y;
+		instance.rotation = rotation % 4;
+		instance.ports.assign(ports.begin(), ports.end());
+		instance.ports.resize(numPorts, NULL_NODE);
+
+		++editVersion;
+		Journal({ .kind = EditKind::PlaceInstance, .type = NodeType::Any, .node = (uint32_t)(instances.size() - 1), .endNode = NULL_NODE });
+		return true;
+	}
+
+	void RemoveInstance(size_t index)
+	{
+		size_t last = instances.size() - 1;
+		if (index != last)
+		{
+			instances[index] = std::move(instances.back());
+		}
+		instances.pop_back();
+		++editVersion;
+		Journal({ .kind = EditKind::RemoveInstance, .type = NodeType::Any, .node = (uint32_t)index, .endNode = (uint32_t)last });
+	}
+
+	void ClearComponents()
+	{
+		if (definitions.empty() && instances.empty())
+		{
+			return;
+		}
+		definitions.clear();
+		instances.clear();
+		++definitionsVersion;
+		++editVersion;
+		BreakJournal();
+	}
+
+	void InstanceNodePosition(const ComponentInstance& instance, int localX, int localY, int& x, int& y)
+	{
+		for (uint8_t turn = 0; turn < instance.rotation; ++turn)
+		{
+			// Clockwise, with y pointing down
+			int turned = -localY;
+			localY = localX;
+			localX = turned;
+		}
+		x = instance.x + localX;
+		y = instance.y + localY;
+	}
+}
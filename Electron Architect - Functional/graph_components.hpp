@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "graph_storage.hpp"
+
+// Reusable components.
+// A definition is a small graph of its own - nodes, the wires between them, and instances of other definitions -
+// stored once, however many times it's used. An instance places a definition with nothing but a transform
+// and what its ports are bound to: its nodes are never copied into the node columns.
+// Flattening instances into gates is left to whatever evaluates them, which can do it once per definition
+// (see simulation_components.hpp).
+//
+// Definitions are made from what's already on the board, so one can only contain instances of definitions made before it -
+// there's no way for a definition to end up containing itself.
+namespace graph
+{
+	using DefinitionID = uint32_t;
+
+	constexpr DefinitionID NULL_DEFINITION = (DefinitionID)(-1);
+
+	// A definition placed either on the board, or within another definition
+	struct ComponentInstance
+	{
+		DefinitionID definition;
+
+		// Where the definition's origin goes, and how many quarter turns clockwise it's rotated about it
+		int x;
+		int y;
+		uint8_t rotation;
+
+		// What each port is bound to - the definition's inputs first, then its outputs.
+		// A NodeHandle on the board, or a node index of the containing definition; NULL_NODE if unbound.
+		std::vector<uint32_t> ports;
+	};
+
+	// A wire between two nodes of a definition, by index
+	struct LocalWire
+	{
+		WireElbow elbow;
+		uint32_t startNode;
+		uint32_t endNode;
+	};
+
+	struct ComponentDefinition
+	{
+		NameID name;
+
+		// Columns of the definition's nodes, with positions relative to its origin (its top-left node)
+		std::vector<NodeType> nodeTypes;
+		std::vector<int> nodeXs;
+		std::vector<int> nodeYs;
+		std::vector<NameID> nodeNames;
+
+		std::vector<LocalWire> wires;
+		std::vector<ComponentInstance> instances;
+
+		// Node index of each port. An input takes on the value of whatever it's bound to, and an output drives whatever it's bound to.
+		std::vector<uint32_t> inputs;
+		std::vector<uint32_t> outputs;
+
+		// Grid spaces covered by the definition's nodes, from its origin
+		int width;
+		int height;
+	};
+
+	extern std::vector<ComponentDefinition> definitions;
+
+	// Instances placed on the board
+	extern std::vector<ComponentInstance> instances;
+
+	// Bumped whenever a definition is made or they're all cleared, so that anything built from definitions can tell it's stale
+	extern uint64_t definitionsVersion;
+
+	// Makes a definition of the selected nodes, the wires between them,
+	// and the instances on the board that are bound to selected nodes and nothing else.
+	// Every port must be a selected node. Returns NULL_DEFINITION (making nothing) if one isn't.
+	DefinitionID DefineComponent(NameID name, const ChunkedList<NodeHandle>& selection,
+		const std::vector<NodeHandle>& inputs, const std::vector<NodeHandle>& outputs);
+
+	// Places an instance at the end of `instances`, with a port for each of the definition's inputs and then outputs -
+	// any ports not given are left unbound. Returns false (placing nothing) if the definition doesn't exist or there are too many ports.
+	bool PlaceInstance(DefinitionID definition, int x, int y, uint8_t rotation, const std::vector<NodeHandle>& ports);
+
+	// Moves the last instance into the removed instance's place
+	void RemoveInstance(size_t index);
+
+	// Removes every definition and instance. ClearNodes does this too, since it forgets the names definitions use.
+	void ClearComponents();
+
+	// Where the node at (localX, localY) of the instance's definition ends up
+	void InstanceNodePosition(const ComponentInstance& instance, int localX, int localY, int& x, int& y);
+}
@@ -1,7 +1,12 @@
+#include <vector>
 #include <raylib.h>
 #include <raymath.h>
 #include "panel.hpp"
 #include "graph.hpp"
+#include "graph_algorithms.hpp"
+#include "graph_components.hpp"
+#include "graph_timing.hpp"
+#include "simulation_live.hpp"
 
 using panel::Panel;
 using panel::PanelID;
@@ -17,6 +22,11 @@ namespace graph
 	constexpr Color     gridlineColor = { 127,127,127,  63 };
 	constexpr Color   backgroundColor = {  20, 20, 20, 255 };
 	constexpr Color hoveredSpaceColor = { 255,255,  0, 200 };
+	constexpr Color criticalPathColor = { 255,127,  0, 255 };
+	constexpr Color     instanceColor = { 190, 33, 55, 255 };
+	constexpr Color    selectionColor = { 255,255,255, 200 };
+	constexpr Color      nodeOffColor = {   0,121,241, 255 };
+	constexpr Color       nodeOnColor = { 102,191,255, 255 };
 
 	// Todo: Change to use a shader instead
 	void DrawGrid(const Bounds& clientBounds, const Rect& clientRect)
@@ -66,6 +76,84 @@ namespace graph
 		DrawLineBezierQuad(mouseOld, mouseNow, mouseMid, (float)gridDisplaySize, ColorAlpha(hoveredSpaceColor, smearAlpha));
 	}
 
+	Vector2 NodeDisplayPosition(NodeHandle node)
+	{
+		float nodeRadius = (float)gridDisplaySize / 2.0f;
+		size_t index = NodeIndex(node);
+		return {
+			.x = (float)(At(nodeX, index) * gridDisplaySize_WithLine) + nodeRadius - 1.0f,
+			.y = (float)(At(nodeY, index) * gridDisplaySize_WithLine) + nodeRadius,
+		};
+	}
+
+	// Draws over the nodes and wires along the longest path
+	void DrawCriticalPath()
+	{
+		static std::vector<NodeHandle> pathNodes;
+		static std::vector<WireHandle> pathWires;
+		static uint64_t pathVersion = (uint64_t)(-1);
+		if (pathVersion != TimingVersion())
+		{
+			CriticalPath(pathNodes, pathWires);
+			pathVersion = TimingVersion();
+		}
+		if (pathWires.empty())
+		{
+			return;
+		}
+
+		float nodeRadius = (float)gridDisplaySize / 2.0f;
+		for (size_t i = 0; i < pathWires.size(); ++i)
+		{
+			if (pathWires[i] == NULL_WIRE) // Crossing a loop
+			{
+				continue;
+			}
+			DrawLineEx(NodeDisplayPosition(pathNodes[i]), NodeDisplayPosition(pathNodes[i + 1]), nodeRadius * 0.5f, criticalPathColor);
+		}
+		for (NodeHandle node : pathNodes)
+		{
+			DrawCircleV(NodeDisplayPosition(node), nodeRadius, criticalPathColor);
+		}
+	}
+
+	// Draws an outline over the space each instance on the board covers - its nodes aren't nodes on the board, so there's nothing else to draw
+	void DrawInstances()
+	{
+		for (const ComponentInstance& instance : instances)
+		{
+			const ComponentDefinition& definition = definitions[instance.definition];
+			if (definition.width == 0)
+			{
+				continue;
+			}
+			int x0, y0, x1, y1;
+			InstanceNodePosition(instance, 0, 0, x0, y0);
+			InstanceNodePosition(instance, definition.width - 1, definition.height - 1, x1, y1);
+			int xmin = x0 < x1 ? x0 : x1;
+			int ymin = y0 < y1 ? y0 : y1;
+			int w = abs(x1 - x0) + 1;
+			int h = abs(y1 - y0) + 1;
+			DrawRectangleLines(xmin * gridDisplaySize_WithLine - 1, ymin * gridDisplaySize_WithLine,
+				w * gridDisplaySize_WithLine, h * gridDisplaySize_WithLine, instanceColor);
+		}
+	}
+
+	// Rings the selected nodes - the selection isn't cleared by edits, so any destroyed since are skipped
+	void DrawSelection()
+	{
+		float nodeRadius = (float)gridDisplaySize / 2.0f;
+		for (size_t i = 0; i < nodesSelected.num; ++i)
+		{
+			NodeHandle node = At(nodesSelected, i);
+			if (IsNodeValid(node))
+			{
+				Vector2 position = NodeDisplayPosition(node);
+				DrawCircleLines((int)position.x, (int)position.y, nodeRadius + 1.0f, selectionColor);
+			}
+		}
+	}
+
 	void DrawPanelContents(int mousexNow, int mouseyNow, int mousexMid, int mouseyMid, int mousexOld, int mouseyOld, bool allowHover)
 	{
 		Bounds clientBounds = panel::PanelClientBounds(graphPanel);
@@ -108,15 +196,25 @@ namespace graph
 		// Draw nodes
 		{
 			float nodeRadius = (float)gridDisplaySize / 2.0f;
-			for (size_t i = 0; i < numNodes; ++i)
+			for (size_t c = 0; c < NumChunksUsed(nodeX); ++c)
 			{
-				Vector2 position =
+				const int* xs = nodeX.chunks[c];
+				const int* ys = nodeY.chunks[c];
+				for (size_t i = 0; i < ChunkLength(nodeX, c); ++i)
 				{
-					.x = (float)(nodes[i]->x * gridDisplaySize_WithLine) + nodeRadius - 1.0f,
-					.y = (float)(nodes[i]->y * gridDisplaySize_WithLine) + nodeRadius,
-				};
-				DrawCircleV(position, nodeRadius, BLUE);
+					Vector2 position =
+					{
+						.x = (float)(xs[i] * gridDisplaySize_WithLine) + nodeRadius - 1.0f,
+						.y = (float)(ys[i] * gridDisplaySize_WithLine) + nodeRadius,
+					};
+					bool isOn = simulation::LiveNodeValue(c * nodeX.CHUNK_SIZE + i);
+					DrawCircleV(position, nodeRadius, isOn ? nodeOnColor : nodeOffColor);
+				}
 			}
 		}
+
+		DrawInstances();
+		DrawSelection();
+		DrawCriticalPath();
 	}
 }
@@ -0,0 +1,173 @@
+#include <cstring>
+#include "chunked_list.hpp"
+#include "graph_names.hpp"
+
+namespace graph
+{
+	// Names are packed into large blocks, and a name never spans two blocks.
+	// Blocks are never moved or freed until ClearNames, so NameString pointers stay valid.
+	constexpr size_t NAME_BLOCK_SIZE = 64 * 1024;
+
+	ChunkedList<char*> nameBlocks;
+	size_t nameBlockUsed = NAME_BLOCK_SIZE; // Bytes used in the last block - starts "full" so the first intern allocates
+	size_t nameBlockBytes = 0; // Total size of all blocks
+
+	// Indexed by NameID
+	ChunkedList<const char*> nameStrings;
+	ChunkedList<uint32_t> nameLengths;
+	ChunkedList<uint32_t> nameHashes;
+
+	// Open addressing with linear probing; holds NameIDs, with EMPTY_NAME marking an empty slot.
+	// (The empty name itself is never looked up through the table.)
+	NameID* nameTable = nullptr;
+	size_t nameTableCapacity = 0;
+
+	uint32_t HashName(const char* str, size_t length)
+	{
+		// FNV-1a
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < length; ++i)
+		{
+			hash ^= (unsigned char)str[i];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	void InitNames()
+	{
+		if (nameStrings.num == 0)
+		{
+			Push(nameStrings, (const char*)"");
+			Push(nameLengths, 0u);
+			Push(nameHashes, 0u);
+		}
+	}
+
+	void GrowNameTable()
+	{
+		delete[] nameTable;
+		nameTableCapacity = nameTableCapacity ? nameTableCapacity * 2 : 256;
+		nameTable = new NameID[nameTableCapacity]();
+
+		const size_t mask = nameTableCapacity - 1;
+		for (NameID id = 1; id < nameStrings.num; ++id)
+		{
+			size_t slot = At(nameHashes, id) & mask;
+			while (nameTable[slot] != EMPTY_NAME)
+			{
+				slot = (slot + 1) & mask;
+			}
+			nameTable[slot] = id;
+		}
+	}
+
+	const char* StoreNameString(const char* str, size_t length)
+	{
+		size_t needed = length + 1;
+		char* dest;
+		if (needed > NAME_BLOCK_SIZE)
+		{
+			// Oversized names get a block of their own, slotted in before the current block so it keeps filling up
+			dest = new char[needed];
+			nameBlockBytes += needed;
+			char* current = nameBlocks.num ? Pop(nameBlocks) : nullptr;
+			Push(nameBlocks, dest);
+			if (current)
+			{
+				Push(nameBlocks, current);
+			}
+		}
+		else
+		{
+			if (nameBlockUsed + needed > NAME_BLOCK_SIZE)
+			{
+				Push(nameBlocks, new char[NAME_BLOCK_SIZE]);
+				nameBlockBytes += NAME_BLOCK_SIZE;
+				nameBlockUsed = 0;
+			}
+			dest = At(nameBlocks, nameBlocks.num - 1) + nameBlockUsed;
+			nameBlockUsed += needed;
+		}
+		memcpy(dest, str, length);
+		dest[length] = '\0';
+		return dest;
+	}
+
+	NameID InternName(const char* str, size_t length)
+	{
+		InitNames();
+
+		if (length == 0)
+		{
+			return EMPTY_NAME;
+		}
+
+		// Keep load at or below 1/2
+		if (nameStrings.num * 2 >= nameTableCapacity)
+		{
+			GrowNameTable();
+		}
+
+		const uint32_t hash = HashName(str, length);
+		const size_t mask = nameTableCapacity - 1;
+		size_t slot = hash & mask;
+		for (; nameTable[slot] != EMPTY_NAME; slot = (slot + 1) & mask)
+		{
+			NameID id = nameTable[slot];
+			if (At(nameHashes, id) == hash && At(nameLengths, id) == length && memcmp(At(nameStrings, id), str, length) == 0)
+			{
+				return id;
+			}
+		}
+
+		NameID id = (NameID)nameStrings.num;
+		Push(nameStrings, StoreNameString(str, length));
+		Push(nameLengths, (uint32_t)length);
+		Push(nameHashes, hash);
+		nameTable[slot] = id;
+		return id;
+	}
+
+	const char* NameString(NameID name)
+	{
+		return name == EMPTY_NAME ? "" : At(nameStrings, name);
+	}
+
+	size_t NameLength(NameID name)
+	{
+		return name == EMPTY_NAME ? 0 : At(nameLengths, name);
+	}
+
+	size_t NumNames()
+	{
+		return nameStrings.num ? nameStrings.num : 1;
+	}
+
+	size_t NameMemoryUsage()
+	{
+		size_t perNameBytes = nameStrings.num * (sizeof(const char*) + sizeof(uint32_t) * 2);
+		return nameBlockBytes + perNameBytes + nameTableCapacity * sizeof(NameID);
+	}
+
+	void ClearNames()
+	{
+		for (size_t i = 0; i < nameBlocks.num; ++i)
+		{
+			delete[] At(nameBlocks, i);
+		}
+		Clear(nameBlocks);
+		nameBlockUsed = NAME_BLOCK_SIZE;
+		nameBlockBytes = 0;
+
+		Clear(nameStrings);
+		Clear(nameLengths);
+		Clear(nameHashes);
+		InitNames();
+
+		for (size_t i = 0; i < nameTableCapacity; ++i)
+		{
+			nameTable[i] = EMPTY_NAME;
+		}
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+
+// Interned node names.
+// Every distinct name is stored once, in a shared arena, and nodes refer to it by ID.
+// Two names are equal exactly when their IDs are equal.
+namespace graph
+{
+	using NameID = uint32_t;
+
+	// The empty string. Always exists, even after ClearNames.
+	constexpr NameID EMPTY_NAME = 0;
+
+	// Returns the ID of the string, adding it to the arena if it is new.
+	// `str` does not need to be null-terminated, and is copied - it can be freed after this returns.
+	NameID InternName(const char* str, size_t length);
+
+	// Null-terminated. Valid until ClearNames.
+	const char* NameString(NameID name);
+	size_t NameLength(NameID name);
+
+	// Number of distinct names, including the empty name
+	size_t NumNames();
+
+	// Bytes held by the arena and lookup table
+	size_t NameMemoryUsage();
+
+	// Forgets every name except the empty name. Invalidates every NameID other than EMPTY_NAME.
+	void ClearNames();
+}
@@ -0,0 +1,657 @@
+#include <algorithm>
+#include "graph_adjacency.hpp"
+#include "graph_scc.hpp"
+#include "graph_timing.hpp"
+
+namespace graph
+{
+	constexpr uint32_t NULL_SCC = (uint32_t)(-1);
+
+	struct Scc
+	{
+		// Singly-linked through nextSccMember
+		NodeHandle firstMember;
+		NodeHandle lastMember;
+		uint32_t size;
+
+		// Index into sccByPosition
+		uint32_t position;
+	};
+
+	// Indexed by node handle slot
+	ChunkedList<uint32_t> sccOfNode;
+	ChunkedList<NodeHandle> nextSccMember;
+
+	// Indexed by component ID
+	std::vector<Scc> sccs;
+	std::vector<uint32_t> freeSccs;
+
+	// The topological order.
+	// Removing and merging components leaves holes (NULL_SCC), which are compacted away once they're half of it.
+	std::vector<uint32_t> sccByPosition;
+	size_t numPositionHoles = 0;
+
+	bool sccsValid = true;
+
+	// Marks for the two searches of SccAddWire, stamped so they never need clearing
+	std::vector<uint32_t> forwardMark;
+	std::vector<uint32_t> backwardMark;
+	uint32_t searchStamp = 0;
+
+	// Tarjan scratch, indexed by node handle slot
+	std::vector<uint32_t> visitIndex;
+	std::vector<uint32_t> lowLink;
+	std::vector<bool> onTarjanStack;
+
+	uint32_t& SccOf(NodeHandle node) { return At(sccOfNode, HandleSlot(node)); }
+	NodeHandle& NextMember(NodeHandle node) { return At(nextSccMember, HandleSlot(node)); }
+	NodeHandle WireStart(WireHandle wire) { return At(wires, WireIndex(wire)).startNode; }
+	NodeHandle WireEnd(WireHandle wire) { return At(wires, WireIndex(wire)).endNode; }
+
+	void EnsureSlot(NodeHandle node)
+	{
+		size_t slot = HandleSlot(node);
+		if (slot >= sccOfNode.num)
+		{
+			Resize(sccOfNode, slot + 1);
+			Resize(nextSccMember, slot + 1);
+		}
+	}
+
+	uint32_t NewScc(uint32_t position)
+	{
+		uint32_t scc;
+		if (freeSccs.empty())
+		{
+			scc = (uint32_t)sccs.size();
+			sccs.push_back({});
+			forwardMark.push_back(0);
+			backwardMark.push_back(0);
+		}
+		else
+		{
+			scc = freeSccs.back();
+			freeSccs.pop_back();
+		}
+		sccs[scc] = { NULL_NODE, NULL_NODE, 0, position };
+		return scc;
+	}
+
+	void AppendMember(uint32_t scc, NodeHandle node)
+	{
+		Scc& component = sccs[scc];
+		SccOf(node) = scc;
+		NextMember(node) = NULL_NODE;
+		if (component.size == 0)
+		{
+			component.firstMember = node;
+		}
+		else
+		{
+			NextMember(component.lastMember) = node;
+		}
+		component.lastMember = node;
+		++component.size;
+	}
+
+	void CompactPositions()
+	{
+		size_t write = 0;
+		for (uint32_t scc : sccByPosition)
+		{
+			if (scc != NULL_SCC)
+			{
+				sccs[scc].position = (uint32_t)write;
+				sccByPosition[write++] = scc;
+			}
+		}
+		sccByPosition.resize(write);
+		numPositionHoles = 0;
+	}
+
+	// Positions stay put until the end of the edit, so that positions gathered earlier in it stay correct
+	void LeaveHole(uint32_t position)
+	{
+		sccByPosition[position] = NULL_SCC;
+		++numPositionHoles;
+	}
+
+	void CompactIfSparse()
+	{
+		if (numPositionHoles * 2 > sccByPosition.size() && sccByPosition.size() > 64)
+		{
+			CompactPositions();
+		}
+	}
+
+	// Tarjan's algorithm from each of `roots`, only following wires between nodes of component `within` (any wires, for NULL_SCC).
+	// Components come out sinks first: each one's nodes are appended to `members`, with where it starts appended to `starts`.
+	void Tarjan(const std::vector<NodeHandle>& roots, uint32_t within, std::vector<NodeHandle>& members, std::vector<uint32_t>& starts)
+	{
+		constexpr uint32_t UNVISITED = (uint32_t)(-1);
+
+		struct Frame
+		{
+			NodeHandle node;
+			WireHandle nextWire;
+		};
+
+		for (NodeHandle root : roots)
+		{
+			visitIndex[HandleSlot(root)] = UNVISITED;
+		}
+
+		std::vector<NodeHandle> stack;
+		std::vector<Frame> frames;
+		uint32_t nextIndex = 0;
+
+		auto Visit = [&](NodeHandle node)
+		{
+			uint32_t slot = HandleSlot(node);
+			visitIndex[slot] = lowLink[slot] = nextIndex++;
+			onTarjanStack[slot] = true;
+			stack.push_back(node);
+			frames.push_back({ node, FirstWireOut(node) });
+		};
+
+		for (NodeHandle root : roots)
+		{
+			if (visitIndex[HandleSlot(root)] != UNVISITED)
+			{
+				continue;
+			}
+			Visit(root);
+
+			while (!frames.empty())
+			{
+				Frame& frame = frames.back();
+				NodeHandle node = frame.node;
+				uint32_t slot = HandleSlot(node);
+
+				if (frame.nextWire != NULL_WIRE)
+				{
+					NodeHandle next = WireEnd(frame.nextWire);
+					frame.nextWire = NextWireOut(frame.nextWire);
+					if (within != NULL_SCC && SccOf(next) != within)
+					{
+						continue;
+					}
+					uint32_t nextSlot = HandleSlot(next);
+					if (visitIndex[nextSlot] == UNVISITED)
+					{
+						Visit(next); // Invalidates `frame`
+					}
+					else if (onTarjanStack[nextSlot] && visitIndex[nextSlot] < lowLink[slot])
+					{
+						lowLink[slot] = visitIndex[nextSlot];
+					}
+					continue;
+				}
+
+				frames.pop_back();
+				if (!frames.empty())
+				{
+					uint32_t parentSlot = HandleSlot(frames.back().node);
+					if (lowLink[slot] < lowLink[parentSlot])
+					{
+						lowLink[parentSlot] = lowLink[slot];
+					}
+				}
+				if (lowLink[slot] == visitIndex[slot])
+				{
+					starts.push_back((uint32_t)members.size());
+					NodeHandle member;
+					do
+					{
+						member = stack.back();
+						stack.pop_back();
+						onTarjanStack[HandleSlot(member)] = false;
+						members.push_back(member);
+					} while (member != node);
+				}
+			}
+		}
+	}
+
+	void RebuildSccs()
+	{
+		size_t numSlots = 0;
+		std::vector<NodeHandle> roots(numNodes);
+		for (size_t i = 0; i < numNodes; ++i)
+		{
+			roots[i] = At(nodeHandles, i);
+			numSlots = HandleSlot(roots[i]) + 1 > numSlots ? HandleSlot(roots[i]) + 1 : numSlots;
+		}
+		Resize(sccOfNode, numSlots);
+		Resize(nextSccMember, numSlots);
+		visitIndex.resize(numSlots);
+		lowLink.resize(numSlots);
+		onTarjanStack.assign(numSlots, false);
+
+		sccs.clear();
+		freeSccs.clear();
+		forwardMark.clear();
+		backwardMark.clear();
+		sccByPosition.clear();
+		numPositionHoles = 0;
+
+		std::vector<NodeHandle> members;
+		std::vector<uint32_t> starts;
+		members.reserve(numNodes);
+		Tarjan(roots, NULL_SCC, members, starts);
+		starts.push_back((uint32_t)members.size());
+
+		// Sinks came out first, so the topological order is the reverse
+		size_t numSccs = starts.size() - 1;
+		sccByPosition.resize(numSccs);
+		for (size_t i = 0; i < numSccs; ++i)
+		{
+			uint32_t position = (uint32_t)(numSccs - 1 - i);
+			uint32_t scc = NewScc(position);
+			sccByPosition[position] = scc;
+			for (uint32_t j = starts[i]; j < starts[i + 1]; ++j)
+			{
+				AppendMember(scc, members[j]);
+			}
+		}
+
+		sccsValid = true;
+	}
+
+	void EnsureSccs()
+	{
+		if (!sccsValid)
+		{
+			RebuildSccs();
+		}
+	}
+
+	void SccAddNode(NodeHandle node)
+	{
+		if (!sccsValid)
+		{
+			return;
+		}
+		EnsureSlot(node);
+		if (visitIndex.size() < sccOfNode.num)
+		{
+			visitIndex.resize(sccOfNode.num);
+			lowLink.resize(sccOfNode.num);
+			onTarjanStack.resize(sccOfNode.num, false);
+		}
+		uint32_t scc = NewScc((uint32_t)sccByPosition.size());
+		sccByPosition.push_back(scc);
+		AppendMember(scc, node);
+	}
+
+	void SccRemoveNode(NodeHandle node)
+	{
+		if (!sccsValid)
+		{
+			return;
+		}
+		uint32_t scc = SccOf(node);
+		if (sccs[scc].size != 1)
+		{
+			// Still has wires to the rest of its loop - shouldn't happen, but recover rather than corrupt the order
+			InvalidateSccs();
+			return;
+		}
+		freeSccs.push_back(scc);
+		LeaveHole(sccs[scc].position);
+		CompactIfSparse();
+	}
+
+	void SccRemoveNodes(const std::vector<NodeHandle>& nodes)
+	{
+		if (!sccsValid)
+		{
+			return;
+		}
+		for (NodeHandle node : nodes)
+		{
+			uint32_t scc = SccOf(node);
+			if (sccs[scc].size != 1)
+			{
+				// Rebuilt from scratch, so those already freed don't matter
+				InvalidateSccs();
+				return;
+			}
+			freeSccs.push_back(scc);
+			LeaveHole(sccs[scc].position);
+		}
+		CompactIfSparse();
+	}
+
+	// Finds every component reachable from `from` (through outputs if `forward`, otherwise inputs)
+	// without leaving the positions between `from` and `limit`. Marks each one found with the current stamp.
+	void SearchSccs(uint32_t from, bool forward, uint32_t limit, std::vector<uint32_t>& mark, std::vector<uint32_t>& found)
+	{
+		std::vector<uint32_t> stack = { from };
+		mark[from] = searchStamp;
+		found.push_back(from);
+		while (!stack.empty())
+		{
+			uint32_t scc = stack.back();
+			stack.pop_back();
+			for (NodeHandle member = sccs[scc].firstMember; member != NULL_NODE; member = NextMember(member))
+			{
+				WireHandle wire = forward ? FirstWireOut(member) : FirstWireIn(member);
+				for (; wire != NULL_WIRE; wire = forward ? NextWireOut(wire) : NextWireIn(wire))
+				{
+					uint32_t other = SccOf(forward ? WireEnd(wire) : WireStart(wire));
+					if (other == scc || mark[other] == searchStamp)
+					{
+						continue;
+					}
+					uint32_t position = sccs[other].position;
+					if (forward ? position > limit : position < limit)
+					{
+						continue;
+					}
+					mark[other] = searchStamp;
+					found.push_back(other);
+					stack.push_back(other);
+				}
+			}
+		}
+	}
+
+	void SccAddWire(NodeHandle startNode, NodeHandle endNode)
+	{
+		if (!sccsValid)
+		{
+			return;
+		}
+		uint32_t startScc = SccOf(startNode);
+		uint32_t endScc = SccOf(endNode);
+		uint32_t startPosition = sccs[startScc].position;
+		uint32_t endPosition = sccs[endScc].position;
+		if (startScc == endScc || startPosition < endPosition)
+		{
+			// Already in order
+			return;
+		}
+
+		// Only components positioned between the two ends can be affected
+		++searchStamp;
+		std::vector<uint32_t> forward;
+		std::vector<uint32_t> backward;
+		SearchSccs(endScc, true, startPosition, forwardMark, forward);
+		SearchSccs(startScc, false, endPosition, backwardMark, backward);
+		bool closesLoop = forwardMark[startScc] == searchStamp;
+
+		auto ByPosition = [](uint32_t a, uint32_t b) { return sccs[a].position < sccs[b].position; };
+
+		// The affected components are given the same set of positions, reordered
+		std::vector<uint32_t> positions;
+		for (uint32_t scc : backward)
+		{
+			positions.push_back(sccs[scc].position);
+		}
+		for (uint32_t scc : forward)
+		{
+			if (backwardMark[scc] != searchStamp)
+			{
+				positions.push_back(sccs[scc].position);
+			}
+		}
+		std::sort(positions.begin(), positions.end());
+
+		// Everything leading to the start takes the lowest of the positions and everything following from the end takes the highest,
+		// so each component only moves toward the side its outside neighbors are already on
+		std::vector<uint32_t> before;
+		std::vector<uint32_t> after;
+		uint32_t merged = NULL_SCC;
+		if (closesLoop)
+		{
+			// Everything both reachable from the end and leading to the start is now one loop
+			for (uint32_t scc : backward)
+			{
+				if (forwardMark[scc] != searchStamp)
+				{
+					before.push_back(scc);
+				}
+				else if (merged == NULL_SCC || sccs[scc].size > sccs[merged].size)
+				{
+					merged = scc;
+				}
+			}
+			for (uint32_t scc : forward)
+			{
+				if (backwardMark[scc] != searchStamp)
+				{
+					after.push_back(scc);
+				}
+			}
+			for (uint32_t scc : backward)
+			{
+				if (forwardMark[scc] != searchStamp || scc == merged)
+				{
+					continue;
+				}
+				// Relabel the smaller lists onto the largest
+				for (NodeHandle member = sccs[scc].firstMember; member != NULL_NODE; member = NextMember(member))
+				{
+					SccOf(member) = merged;
+				}
+				NextMember(sccs[merged].lastMember) = sccs[scc].firstMember;
+				sccs[merged].lastMember = sccs[scc].lastMember;
+				sccs[merged].size += sccs[scc].size;
+				freeSccs.push_back(scc);
+			}
+		}
+		else
+		{
+			before = std::move(backward);
+			after = std::move(forward);
+		}
+		std::sort(before.begin(), before.end(), ByPosition);
+		std::sort(after.begin(), after.end(), ByPosition);
+
+		size_t next = 0;
+		for (uint32_t scc : before)
+		{
+			sccs[scc].position = positions[next];
+			sccByPosition[positions[next++]] = scc;
+		}
+		if (merged != NULL_SCC)
+		{
+			sccs[merged].position = positions[next];
+			sccByPosition[positions[next++]] = merged;
+		}
+		for (; next < positions.size() - after.size(); ++next)
+		{
+			LeaveHole(positions[next]);
+		}
+		for (uint32_t scc : after)
+		{
+			sccs[scc].position = positions[next];
+			sccByPosition[positions[next++]] = scc;
+		}
+		CompactIfSparse();
+	}
+
+	// Re-runs Tarjan's algorithm over just the loop, after it has lost wires, and puts the pieces it came apart into in its place
+	void SplitScc(uint32_t scc)
+	{
+		std::vector<NodeHandle> roots;
+		roots.reserve(sccs[scc].size);
+		for (NodeHandle member = sccs[scc].firstMember; member != NULL_NODE; member = NextMember(member))
+		{
+			roots.push_back(member);
+		}
+		std::vector<NodeHandle> members;
+		std::vector<uint32_t> starts;
+		members.reserve(roots.size());
+		Tarjan(roots, scc, members, starts);
+		if (starts.size() == 1)
+		{
+			return;
+		}
+		starts.push_back((uint32_t)members.size());
+		size_t numPieces = starts.size() - 1;
+
+		// The pieces take the loop's place in the order, in topological order among themselves
+		uint32_t position = sccs[scc].position;
+		size_t room = 1;
+		while (room < numPieces && position + room < sccByPosition.size() && sccByPosition[position + room] == NULL_SCC)
+		{
+			++room;
+		}
+		if (room < numPieces)
+		{
+			sccByPosition.insert(sccByPosition.begin() + position + room, numPieces - room, NULL_SCC);
+			for (size_t p = position + numPieces; p < sccByPosition.size(); ++p)
+			{
+				if (sccByPosition[p] != NULL_SCC)
+				{
+					sccs[sccByPosition[p]].position = (uint32_t)p;
+				}
+			}
+		}
+		numPositionHoles -= room - 1;
+
+		// Sinks came out first
+		for (size_t i = 0; i < numPieces; ++i)
+		{
+			uint32_t piecePosition = position + (uint32_t)(numPieces - 1 - i);
+			uint32_t piece = (i == 0) ? scc : NewScc(piecePosition);
+			sccs[piece] = { NULL_NODE, NULL_NODE, 0, piecePosition };
+			sccByPosition[piecePosition] = piece;
+			for (uint32_t j = starts[i]; j < starts[i + 1]; ++j)
+			{
+				AppendMember(piece, members[j]);
+			}
+		}
+	}
+
+	void SccRemoveWire(NodeHandle startNode, NodeHandle endNode)
+	{
+		if (!sccsValid)
+		{
+			return;
+		}
+		uint32_t scc = SccOf(startNode);
+		if (scc != SccOf(endNode) || sccs[scc].size == 1)
+		{
+			// Removing a wire can't break the order, only a loop
+			return;
+		}
+		SplitScc(scc);
+	}
+
+	void SccRemoveWires(const std::vector<Wire>& removed)
+	{
+		if (!sccsValid)
+		{
+			return;
+		}
+		static std::vector<uint32_t> loops;
+		loops.clear();
+		for (const Wire& wire : removed)
+		{
+			uint32_t scc = SccOf(wire.startNode);
+			if (scc == SccOf(wire.endNode) && sccs[scc].size != 1)
+			{
+				loops.push_back(scc);
+			}
+		}
+		std::sort(loops.begin(), loops.end());
+		loops.erase(std::unique(loops.begin(), loops.end()), loops.end());
+
+		// Splitting one loop only gives out IDs that were free, so the rest are still the loops they were
+		for (uint32_t scc : loops)
+		{
+			SplitScc(scc);
+		}
+	}
+
+	void InvalidateSccs()
+	{
+		sccsValid = false;
+		InvalidateTiming();
+	}
+
+	void SccClearWires()
+	{
+		sccs.clear();
+		freeSccs.clear();
+		forwardMark.clear();
+		backwardMark.clear();
+		sccByPosition.clear();
+		numPositionHoles = 0;
+		for (size_t i = 0; i < numNodes; ++i)
+		{
+			NodeHandle node = At(nodeHandles, i);
+			EnsureSlot(node);
+			uint32_t scc = NewScc((uint32_t)i);
+			sccByPosition.push_back(scc);
+			AppendMember(scc, node);
+		}
+		visitIndex.resize(sccOfNode.num);
+		lowLink.resize(sccOfNode.num);
+		onTarjanStack.resize(sccOfNode.num, false);
+		sccsValid = true;
+		TimingClearWires();
+	}
+
+	void ClearSccs()
+	{
+		Clear(sccOfNode);
+		Clear(nextSccMember);
+		sccs.clear();
+		freeSccs.clear();
+		forwardMark.clear();
+		backwardMark.clear();
+		sccByPosition.clear();
+		numPositionHoles = 0;
+		sccsValid = true;
+		ClearTiming();
+	}
+
+	uint32_t NodeScc(NodeHandle node)
+	{
+		EnsureSccs();
+		return SccOf(node);
+	}
+
+	uint32_t NodeSccOrder(NodeHandle node)
+	{
+		EnsureSccs();
+		return sccs[SccOf(node)].position;
+	}
+
+	uint32_t SccSize(uint32_t scc)
+	{
+		EnsureSccs();
+		return sccs[scc].size;
+	}
+
+	bool IsNodeInLoop(NodeHandle node)
+	{
+		EnsureSccs();
+		if (sccs[SccOf(node)].size > 1)
+		{
+			return true;
+		}
+		for (WireHandle wire = FirstWireOut(node); wire != NULL_WIRE; wire = NextWireOut(wire))
+		{
+			if (WireEnd(wire) == node)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void SccMembers(NodeHandle node, std::vector<NodeHandle>& members)
+	{
+		EnsureSccs();
+		members.clear();
+		for (NodeHandle member = sccs[SccOf(node)].firstMember; member != NULL_NODE; member = NextMember(member))
+		{
+			members.push_back(member);
+		}
+	}
+}
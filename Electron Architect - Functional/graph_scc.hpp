@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include "graph_storage.hpp"
+
+// Strongly connected components of the wire graph - the feedback loops - and a topological order of them.
+// Kept up to date by the node and wire create/destroy functions - no need to call the modifiers yourself.
+//
+// Edits are incremental: creating a wire reorders (or merges) only the components between its two ends
+// in the topological order (Pearce-Kelly), and destroying wires within a loop re-runs Tarjan's algorithm over just that loop.
+// Load invalidates the index instead, and it's built in O(nodes + wires) on the next query.
+namespace graph
+{
+	void SccAddNode(NodeHandle node);
+	// Only once the node has no wires
+	void SccRemoveNode(NodeHandle node);
+	// For many nodes destroyed at once, once none of them has wires
+	void SccRemoveNodes(const std::vector<NodeHandle>& nodes);
+	// Call after the wire has been linked/unlinked in the adjacency lists
+	void SccAddWire(NodeHandle startNode, NodeHandle endNode);
+	void SccRemoveWire(NodeHandle startNode, NodeHandle endNode);
+
+	// For many wires destroyed at once, after they've all been unlinked: each loop that lost any is re-run once
+	void SccRemoveWires(const std::vector<Wire>& removed);
+
+	// Makes every node a component of its own, once every wire is gone. O(nodes)
+	void SccClearWires();
+
+	// Forgets everything until the next query, which rebuilds from scratch
+	void InvalidateSccs();
+
+	// Forgets every node
+	void ClearSccs();
+
+	// ID of the node's component. IDs are recycled, so only compare them between edits.
+	uint32_t NodeScc(NodeHandle node);
+
+	// Position of the node's component in a topological order of the components: if any path of wires
+	// leads from node A to node B outside of a loop, A's position is lower. Nodes in the same loop share a position.
+	uint32_t NodeSccOrder(NodeHandle node);
+
+	// Number of nodes in the component
+	uint32_t SccSize(uint32_t scc);
+
+	// Whether the node is part of a feedback loop, including a wire from itself to itself
+	bool IsNodeInLoop(NodeHandle node);
+
+	// Every node in the same component as `node`, including itself
+	void SccMembers(NodeHandle node, std::vector<NodeHandle>& members);
+}
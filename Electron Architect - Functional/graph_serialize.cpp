@@ -0,0 +1,372 @@
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include "console_log.hpp"
+#include "graph_storage.hpp"
+#include "graph_components.hpp"
+#include "graph_scc.hpp"
+
+namespace graph
+{
+	// Written at the top of every file. Files of another major version can't be read;
+	// minor versions only add optional regions at the end, which older versions skip.
+	constexpr int FILE_MAJOR_VERSION = 2;
+	constexpr int FILE_MINOR_VERSION = 1;
+	constexpr int FILE_PATCH_VERSION = 0;
+
+	void SaveInstance(std::ofstream& file, const ComponentInstance& instance, bool isOnBoard)
+	{
+		file << '\n' << instance.definition << ' ' << instance.x << ' ' << instance.y << ' ' << (int)instance.rotation << ' ' << instance.ports.size();
+		for (uint32_t port : instance.ports)
+		{
+			// Board instances are bound to handles, which are saved as the node's index like wires' are
+			if (isOnBoard ? !IsNodeValid(port) : port == NULL_NODE)
+			{
+				file << " -1";
+			}
+			else
+			{
+				file << ' ' << (isOnBoard ? NodeIndex(port) : port);
+			}
+		}
+	}
+
+	// Each definition is written once, however many instances of it there are
+	void SaveComponents(std::ofstream& file)
+	{
+		file << "c " << definitions.size();
+		for (const ComponentDefinition& definition : definitions)
+		{
+			file << "\nd " << definition.nodeTypes.size() << ' ' << definition.wires.size() << ' ' << definition.instances.size() << ' '
+				<< definition.inputs.size() << ' ' << definition.outputs.size() << ' ' << definition.width << ' ' << definition.height
+				<< " ```" << NameString(definition.name) << "```";
+			for (size_t i = 0; i < definition.nodeTypes.size(); ++i)
+			{
+				file << '\n' << (char)definition.nodeTypes[i] << ' ' << definition.nodeXs[i] << ' ' << definition.nodeYs[i]
+					<< " ```" << NameString(definition.nodeNames[i]) << "```";
+			}
+			for (const LocalWire& wire : definition.wires)
+			{
+				file << '\n' << (int)wire.elbow << ' ' << wire.startNode << ' ' << wire.endNode;
+			}
+			for (const ComponentInstance& instance : definition.instances)
+			{
+				SaveInstance(file, instance, false);
+			}
+			file << '\n';
+			for (uint32_t port : definition.inputs)
+			{
+				file << port << ' ';
+			}
+			file << '\n';
+			for (uint32_t port : definition.outputs)
+			{
+				file << port << ' ';
+			}
+		}
+		file << std::endl;
+
+		file << "i " << instances.size();
+		for (const ComponentInstance& instance : instances)
+		{
+			SaveInstance(file, instance, true);
+		}
+		file << std::endl;
+	}
+
+	void Save(const char* filename)
+	{
+		std::ofstream file(filename);
+
+		file << "v " << FILE_MAJOR_VERSION << ' ' << FILE_MINOR_VERSION << ' ' << FILE_PATCH_VERSION << std::endl;
+
+		file << "n " << numNodes;
+		for (size_t i = 0; i < numNodes; ++i)
+		{
+			file << '\n' << (char)At(nodeType, i) << ' ' << At(nodeX, i) << ' ' << At(nodeY, i) << " ```" << NameString(At(nodeName, i)) << "```";
+		}
+		file << std::endl;
+
+		file << "w " << numWires;
+		for (size_t i = 0; i < numWires; ++i)
+		{
+			const Wire& wire = At(wires, i);
+			file << '\n' << (int)wire.elbow << ' ' << NodeIndex(wire.startNode) << ' ' << NodeIndex(wire.endNode);
+		}
+		file << std::endl;
+
+		SaveComponents(file);
+
+		file.close();
+	}
+
+	// Reads tokens straight out of a loaded file
+	struct LoadCursor
+	{
+		const char* at;
+		const char* end;
+	};
+
+	void SkipWhitespace(LoadCursor& cursor)
+	{
+		while (cursor.at < cursor.end && (*cursor.at == ' ' || *cursor.at == '\t' || *cursor.at == '\r' || *cursor.at == '\n'))
+		{
+			++cursor.at;
+		}
+	}
+
+	char ReadChar(LoadCursor& cursor)
+	{
+		SkipWhitespace(cursor);
+		return (cursor.at < cursor.end) ? *cursor.at++ : '\0';
+	}
+
+	template<typename T> T ReadNumber(LoadCursor& cursor)
+	{
+		SkipWhitespace(cursor);
+		T value = 0;
+		cursor.at = std::from_chars(cursor.at, cursor.end, value).ptr;
+		return value;
+	}
+
+	// Names are written between triple backticks, and end the line
+	NameID ReadName(LoadCursor& cursor)
+	{
+		while (cursor.at < cursor.end && *cursor.at == ' ')
+		{
+			++cursor.at;
+		}
+
+		const char* lineEnd = cursor.at;
+		while (lineEnd < cursor.end && *lineEnd != '\n' && *lineEnd != '\r')
+		{
+			++lineEnd;
+		}
+
+		const char* nameStart = cursor.at;
+		const char* nameEnd = lineEnd;
+		if (lineEnd - nameStart >= 6 && strncmp(nameStart, "```", 3) == 0 && strncmp(lineEnd - 3, "```", 3) == 0)
+		{
+			nameStart += 3;
+			nameEnd -= 3;
+		}
+
+		cursor.at = lineEnd;
+		return InternName(nameStart, nameEnd - nameStart);
+	}
+
+	// Reads an instance written by SaveInstance, whose ports are node indices below `numPortNodes`.
+	// Returns false if it refers to anything that doesn't exist.
+	bool LoadInstance(LoadCursor& cursor, ComponentInstance& instance, size_t numDefinitions, size_t numPortNodes)
+	{
+		instance.definition = ReadNumber<DefinitionID>(cursor);
+		instance.x = ReadNumber<int>(cursor);
+		instance.y = ReadNumber<int>(cursor);
+		instance.rotation = (uint8_t)(ReadNumber<int>(cursor) % 4);
+		instance.ports.resize(ReadNumber<size_t>(cursor));
+		if (instance.definition >= numDefinitions ||
+			instance.ports.size() != definitions[instance.definition].inputs.size() + definitions[instance.definition].outputs.size())
+		{
+			return false;
+		}
+		for (uint32_t& port : instance.ports)
+		{
+			long long index = ReadNumber<long long>(cursor);
+			if (index >= (long long)numPortNodes)
+			{
+				return false;
+			}
+			port = index < 0 ? NULL_NODE : (uint32_t)index;
+		}
+		return true;
+	}
+
+	// Reads what SaveComponents wrote, if the file has it - files from before components don't.
+	// Nodes and wires must already be loaded, for board instances to bind to.
+	void LoadComponents(LoadCursor& cursor)
+	{
+		if (ReadChar(cursor) != 'c')
+		{
+			return;
+		}
+		size_t numDefinitionsToLoad = ReadNumber<size_t>(cursor);
+		definitions.reserve(numDefinitionsToLoad);
+		for (size_t d = 0; d < numDefinitionsToLoad; ++d)
+		{
+			if (ReadChar(cursor) != 'd')
+			{
+				console::Error("graph: File is malformed: Expected a component DEFINITION (d). Skipping components.");
+				ClearComponents();
+				return;
+			}
+			ComponentDefinition& definition = definitions.emplace_back();
+			size_t numDefinitionNodes = ReadNumber<size_t>(cursor);
+			definition.wires.resize(ReadNumber<size_t>(cursor));
+			definition.instances.resize(ReadNumber<size_t>(cursor));
+			definition.inputs.resize(ReadNumber<size_t>(cursor));
+			definition.outputs.resize(ReadNumber<size_t>(cursor));
+			definition.width = ReadNumber<int>(cursor);
+			definition.height = ReadNumber<int>(cursor);
+			definition.name = ReadName(cursor);
+
+			definition.nodeTypes.resize(numDefinitionNodes);
+			definition.nodeXs.resize(numDefinitionNodes);
+			definition.nodeYs.resize(numDefinitionNodes);
+			definition.nodeNames.resize(numDefinitionNodes);
+			for (size_t i = 0; i < numDefinitionNodes; ++i)
+			{
+				definition.nodeTypes[i] = (NodeType)ReadChar(cursor);
+				definition.nodeXs[i] = ReadNumber<int>(cursor);
+				definition.nodeYs[i] = ReadNumber<int>(cursor);
+				definition.nodeNames[i] = ReadName(cursor);
+			}
+
+			bool isValid = true;
+			for (LocalWire& wire : definition.wires)
+			{
+				wire.elbow = (WireElbow)ReadNumber<int>(cursor);
+				wire.startNode = ReadNumber<uint32_t>(cursor);
+				wire.endNode = ReadNumber<uint32_t>(cursor);
+				isValid &= wire.startNode < numDefinitionNodes && wire.endNode < numDefinitionNodes;
+			}
+			// Only earlier definitions, so that none can contain itself
+			for (ComponentInstance& instance : definition.instances)
+			{
+				isValid &= LoadInstance(cursor, instance, d, numDefinitionNodes);
+			}
+			for (uint32_t& port : definition.inputs)
+			{
+				port = ReadNumber<uint32_t>(cursor);
+				isValid &= port < numDefinitionNodes;
+			}
+			for (uint32_t& port : definition.outputs)
+			{
+				port = ReadNumber<uint32_t>(cursor);
+				isValid &= port < numDefinitionNodes;
+			}
+			if (!isValid)
+			{
+				console::Error("graph: File is malformed: A component definition refers to something that doesn't exist. Skipping components.");
+				ClearComponents();
+				return;
+			}
+		}
+		++definitionsVersion;
+
+		if (ReadChar(cursor) != 'i')
+		{
+			console::Error("graph: File is malformed or incompatible: Expected INSTANCE (i) region. Skipping instances.");
+			return;
+		}
+		size_t numInstancesToLoad = ReadNumber<size_t>(cursor);
+		instances.reserve(numInstancesToLoad);
+		for (size_t i = 0; i < numInstancesToLoad; ++i)
+		{
+			ComponentInstance instance;
+			if (!LoadInstance(cursor, instance, definitions.size(), numNodes))
+			{
+				console::Error("graph: File is malformed: Instance refers to something that doesn't exist. Skipping instance.");
+				continue;
+			}
+			for (uint32_t& port : instance.ports)
+			{
+				port = port == NULL_NODE ? NULL_NODE : At(nodeHandles, port);
+			}
+			instances.push_back(std::move(instance));
+		}
+	}
+
+	void Load(const char* filename)
+	{
+		// The whole file is read at once, so that names can be interned directly out of the buffer
+		std::ifstream file(filename, std::ios::binary | std::ios::ate);
+		if (!file)
+		{
+			console::Errorf("graph: Could not open \"%s\".", filename);
+			return;
+		}
+		std::vector<char> buffer((size_t)file.tellg());
+		file.seekg(0);
+		file.read(buffer.data(), buffer.size());
+		file.close();
+
+		LoadCursor cursor = { buffer.data(), buffer.data() + buffer.size() };
+
+		if (ReadChar(cursor) != 'v')
+		{
+			console::Error("graph: File is malformed or incompatible: Expected VERSION (v) region. Cancelling.");
+			return;
+		}
+		int majorVersion = ReadNumber<int>(cursor);
+		int minorVersion = ReadNumber<int>(cursor);
+		int patchVersion = ReadNumber<int>(cursor);
+		if (majorVersion != FILE_MAJOR_VERSION)
+		{
+			console::Errorf("graph: \"%s\" is format version %i.%i.%i, which can't be read as version %i.%i.%i. Cancelling.",
+				filename, majorVersion, minorVersion, patchVersion, FILE_MAJOR_VERSION, FILE_MINOR_VERSION, FILE_PATCH_VERSION);
+			return;
+		}
+		if (minorVersion > FILE_MINOR_VERSION)
+		{
+			console::Warnf("graph: \"%s\" is format version %i.%i.%i, newer than %i.%i.%i. Anything added since will be skipped.",
+				filename, majorVersion, minorVersion, patchVersion, FILE_MAJOR_VERSION, FILE_MINOR_VERSION, FILE_PATCH_VERSION);
+		}
+
+		if (ReadChar(cursor) != 'n')
+		{
+			console::Error("graph: File is malformed or incompatible: Expected NODE (n) region. Cancelling.");
+			return;
+		}
+		size_t numNodesToLoad = ReadNumber<size_t>(cursor);
+
+		ClearNodes();
+		// Cheaper to find the loops once everything is loaded than to keep them up to date wire by wire
+		InvalidateSccs();
+		Reserve(nodeType, numNodesToLoad);
+		Reserve(nodeX, numNodesToLoad);
+		Reserve(nodeY, numNodesToLoad);
+		Reserve(nodeName, numNodesToLoad);
+		Reserve(nodeHandles, numNodesToLoad);
+		for (size_t i = 0; i < numNodesToLoad; ++i)
+		{
+			NodeType type = (NodeType)ReadChar(cursor);
+			int x = ReadNumber<int>(cursor);
+			int y = ReadNumber<int>(cursor);
+			NodeHandle handle = CreateNode(type, x, y);
+			if (handle == NULL_NODE)
+			{
+				return;
+			}
+			At(nodeName, NodeIndex(handle)) = ReadName(cursor);
+		}
+
+		if (ReadChar(cursor) != 'w')
+		{
+			console::Error("graph: File is malformed or incompatible: Expected WIRE (w) region. Cancelling.");
+			return;
+		}
+		size_t numWiresToLoad = ReadNumber<size_t>(cursor);
+
+		Reserve(wires, numWiresToLoad);
+		Reserve(wireHandles, numWiresToLoad);
+		for (size_t i = 0; i < numWiresToLoad; ++i)
+		{
+			WireElbow elbow = (WireElbow)ReadNumber<int>(cursor);
+			size_t startNodeIndex = ReadNumber<size_t>(cursor);
+			size_t endNodeIndex = ReadNumber<size_t>(cursor);
+			if (startNodeIndex >= numNodes || endNodeIndex >= numNodes)
+			{
+				console::Error("graph: File is malformed: Wire refers to a node that doesn't exist. Skipping wire.");
+				continue;
+			}
+			CreateWire(elbow, At(nodeHandles, startNodeIndex), At(nodeHandles, endNodeIndex));
+		}
+
+		// Files from before 2.1 end here
+		if (minorVersion >= 1)
+		{
+			LoadComponents(cursor);
+		}
+	}
+}
@@ -0,0 +1,335 @@
+#include "graph_spatial.hpp"
+
+namespace graph
+{
+	// Open addressing with linear probing.
+	// `cellHeads[i] == NULL_NODE` marks an empty slot.
+	uint64_t* cellKeys = nullptr;
+	NodeHandle* cellHeads = nullptr;
+	size_t cellCapacity = 0; // Always a power of two, or zero before the first insert
+	size_t numCells = 0;
+
+	// Indexed by handle slot - the next node in the same cell, forming a list starting at the cell's head.
+	ChunkedList<NodeHandle> nodeNextInCell;
+
+	uint64_t CellKey(int x, int y)
+	{
+		return ((uint64_t)(uint32_t)x << 32) | (uint64_t)(uint32_t)y;
+	}
+
+	size_t CellHash(uint64_t key)
+	{
+		// Full avalanche mix (MurmurHash3 finalizer).
+		// Rows of cells form a lattice of keys, which a plain multiplicative hash would pile into the same probe runs.
+		key ^= key >> 33;
+		key *= 0xFF51AFD7ED558CCDull;
+		key ^= key >> 33;
+		key *= 0xC4CEB9FE1A85EC53ull;
+		key ^= key >> 33;
+		return (size_t)key;
+	}
+
+	// Slot holding `key`, or the empty slot where it would go
+	size_t FindCellSlot(uint64_t key)
+	{
+		const size_t mask = cellCapacity - 1;
+		size_t slot = CellHash(key) & mask;
+		while (cellHeads[slot] != NULL_NODE && cellKeys[slot] != key)
+		{
+			slot = (slot + 1) & mask;
+		}
+		return slot;
+	}
+
+	void GrowCells()
+	{
+		uint64_t* oldKeys = cellKeys;
+		NodeHandle* oldHeads = cellHeads;
+		size_t oldCapacity = cellCapacity;
+
+		cellCapacity = cellCapacity ? cellCapacity * 2 : 1024;
+		cellKeys = new uint64_t[cellCapacity];
+		cellHeads = new NodeHandle[cellCapacity];
+		for (size_t i = 0; i < cellCapacity; ++i)
+		{
+			cellHeads[i] = NULL_NODE;
+		}
+
+		for (size_t i = 0; i < oldCapacity; ++i)
+		{
+			if (oldHeads[i] != NULL_NODE)
+			{
+				size_t slot = FindCellSlot(oldKeys[i]);
+				cellKeys[slot] = oldKeys[i];
+				cellHeads[slot] = oldHeads[i];
+			}
+		}
+
+		delete[] oldKeys;
+		delete[] oldHeads;
+	}
+
+	void SpatialInsert(NodeHandle handle, int x, int y)
+	{
+		// Keep load at or below 1/2 so probe sequences stay short
+		if ((numCells + 1) * 2 > cellCapacity)
+		{
+			GrowCells();
+		}
+
+		if (HandleSlot(handle) >= nodeNextInCell.num)
+		{
+			Resize(nodeNextInCell, (size_t)HandleSlot(handle) + 1);
+		}
+
+		uint64_t key = CellKey(x, y);
+		size_t slot = FindCellSlot(key);
+		if (cellHeads[slot] == NULL_NODE)
+		{
+			cellKeys[slot] = key;
+			++numCells;
+		}
+		At(nodeNextInCell, HandleSlot(handle)) = cellHeads[slot];
+		cellHeads[slot] = handle;
+	}
+
+	void SpatialRemove(NodeHandle handle, int x, int y)
+	{
+		if (cellCapacity == 0)
+		{
+			return;
+		}
+
+		size_t slot = FindCellSlot(CellKey(x, y));
+		if (cellHeads[slot] == NULL_NODE)
+		{
+			return;
+		}
+
+		// Unlink from the cell's list
+		if (cellHeads[slot] == handle)
+		{
+			cellHeads[slot] = At(nodeNextInCell, HandleSlot(handle));
+		}
+		else
+		{
+			NodeHandle prev = cellHeads[slot];
+			while (prev != NULL_NODE && At(nodeNextInCell, HandleSlot(prev)) != handle)
+			{
+				prev = At(nodeNextInCell, HandleSlot(prev));
+			}
+			if (prev != NULL_NODE)
+			{
+				At(nodeNextInCell, HandleSlot(prev)) = At(nodeNextInCell, HandleSlot(handle));
+			}
+		}
+
+		if (cellHeads[slot] != NULL_NODE)
+		{
+			return;
+		}
+
+		// The cell is now empty.
+		// Shift later members of the probe sequence back so that lookups don't stop early at the hole.
+		--numCells;
+		const size_t mask = cellCapacity - 1;
+		size_t hole = slot;
+		for (size_t next = (hole + 1) & mask; cellHeads[next] != NULL_NODE; next = (next + 1) & mask)
+		{
+			size_t home = CellHash(cellKeys[next]) & mask;
+			bool isHomeBetweenHoleAndNext = (hole <= next)
+				? (hole < home && home <= next)
+				: (hole < home || home <= next);
+			if (!isHomeBetweenHoleAndNext)
+			{
+				cellKeys[hole] = cellKeys[next];
+				cellHeads[hole] = cellHeads[next];
+				cellHeads[next] = NULL_NODE;
+				hole = next;
+			}
+		}
+	}
+
+	void SpatialRemoveMarked(const std::vector<uint64_t>& isSlotRemoved)
+	{
+		auto IsRemoved = [&isSlotRemoved](NodeHandle handle)
+		{
+			uint32_t slot = HandleSlot(handle);
+			return (isSlotRemoved[slot / 64] >> (slot % 64)) & 1;
+		};
+
+		// Filter every cell's list, leaving holes where cells become empty
+		bool isAnyCellEmptied = false;
+		for (size_t i = 0; i < cellCapacity; ++i)
+		{
+			if (cellHeads[i] == NULL_NODE)
+			{
+				continue;
+			}
+
+			NodeHandle* link = &cellHeads[i];
+			while (*link != NULL_NODE)
+			{
+				if (IsRemoved(*link))
+				{
+					*link = At(nodeNextInCell, HandleSlot(*link));
+				}
+				else
+				{
+					link = &At(nodeNextInCell, HandleSlot(*link));
+				}
+			}
+
+			if (cellHeads[i] == NULL_NODE)
+			{
+				--numCells;
+				isAnyCellEmptied = true;
+			}
+		}
+
+		if (!isAnyCellEmptied)
+		{
+			return;
+		}
+
+		// Holes can cut probe sequences short, so re-place every cell.
+		// Starting just after an empty slot means every run of cells is visited from its beginning,
+		// so each cell can only move backward into a slot that was already settled or emptied.
+		const size_t mask = cellCapacity - 1;
+		size_t start = 0;
+		while (cellHeads[start] != NULL_NODE)
+		{
+			++start;
+		}
+		for (size_t k = 1; k <= cellCapacity; ++k)
+		{
+			size_t i = (start + k) & mask;
+			if (cellHeads[i] == NULL_NODE)
+			{
+				continue;
+			}
+			uint64_t key = cellKeys[i];
+			NodeHandle head = cellHeads[i];
+			cellHeads[i] = NULL_NODE;
+			size_t slot = FindCellSlot(key);
+			cellKeys[slot] = key;
+			cellHeads[slot] = head;
+		}
+	}
+
+	void SpatialClear()
+	{
+		for (size_t i = 0; i < cellCapacity; ++i)
+		{
+			cellHeads[i] = NULL_NODE;
+		}
+		numCells = 0;
+		Clear(nodeNextInCell);
+	}
+
+	NodeHandle FirstNodeInCell(int x, int y)
+	{
+		if (cellCapacity == 0)
+		{
+			return NULL_NODE;
+		}
+		return cellHeads[FindCellSlot(CellKey(x, y))];
+	}
+
+	NodeHandle NextNodeInCell(NodeHandle handle)
+	{
+		return At(nodeNextInCell, HandleSlot(handle));
+	}
+
+	void QueryCells(int xmin, int ymin, int xmax, int ymax, const CellRange skipRanges[], size_t numSkipRanges, ChunkedList<NodeHandle>& results)
+	{
+		for (int y = ymin; y <= ymax; ++y)
+		{
+			for (int x = xmin; x <= xmax; ++x)
+			{
+				bool isSkipped = false;
+				for (size_t i = 0; i < numSkipRanges && !isSkipped; ++i)
+				{
+					const CellRange& skip = skipRanges[i];
+					isSkipped = skip.xmin <= x && x <= skip.xmax && skip.ymin <= y && y <= skip.ymax;
+				}
+				if (isSkipped)
+				{
+					continue;
+				}
+
+				for (NodeHandle handle = FirstNodeInCell(x, y); handle != NULL_NODE; handle = NextNodeInCell(handle))
+				{
+					Push(results, handle);
+				}
+			}
+		}
+	}
+
+	void QueryRanges(const CellRange ranges[], size_t numRanges, ChunkedList<NodeHandle>& results)
+	{
+		size_t numCellsInRanges = 0;
+		for (size_t i = 0; i < numRanges; ++i)
+		{
+			const CellRange& range = ranges[i];
+			numCellsInRanges += (size_t)(range.xmax - range.xmin + 1) * (size_t)(range.ymax - range.ymin + 1);
+		}
+
+		if (numCellsInRanges <= numNodes)
+		{
+			for (size_t i = 0; i < numRanges; ++i)
+			{
+				const CellRange& range = ranges[i];
+				QueryCells(range.xmin, range.ymin, range.xmax, range.ymax, ranges, i, results);
+			}
+			return;
+		}
+
+		// One flag per node, so that each range test is a branchless pass over the position columns
+		static ChunkedList<bool> isNodeInRanges;
+		Resize(isNodeInRanges, numNodes);
+
+		const size_t numChunks = NumChunksUsed(isNodeInRanges);
+
+		for (size_t c = 0; c < numChunks; ++c)
+		{
+			bool* isInRanges = isNodeInRanges.chunks[c];
+			const size_t chunkLength = ChunkLength(isNodeInRanges, c);
+			for (size_t i = 0; i < chunkLength; ++i)
+			{
+				isInRanges[i] = false;
+			}
+		}
+
+		for (size_t j = 0; j < numRanges; ++j)
+		{
+			const int xmin = ranges[j].xmin;
+			const int ymin = ranges[j].ymin;
+			const int xmax = ranges[j].xmax;
+			const int ymax = ranges[j].ymax;
+
+			for (size_t c = 0; c < numChunks; ++c)
+			{
+				const int* xs = nodeX.chunks[c];
+				const int* ys = nodeY.chunks[c];
+				bool* isInRanges = isNodeInRanges.chunks[c];
+				const size_t chunkLength = ChunkLength(isNodeInRanges, c);
+				for (size_t i = 0; i < chunkLength; ++i)
+				{
+					isInRanges[i] |=
+						(xmin <= xs[i]) & (xs[i] <= xmax) &
+						(ymin <= ys[i]) & (ys[i] <= ymax);
+				}
+			}
+		}
+
+		// Each node is only included once, even if it is in multiple ranges
+		for (size_t i = 0; i < numNodes; ++i)
+		{
+			if (At(isNodeInRanges, i))
+			{
+				Push(results, At(nodeHandles, i));
+			}
+		}
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <vector>
+#include "graph_storage.hpp"
+
+// Spatial index of the nodes, hashed by the grid cell each node occupies.
+// Kept up to date by CreateNode, DestroyNode and ClearNodes - no need to call the modifiers yourself.
+namespace graph
+{
+	void SpatialInsert(NodeHandle handle, int x, int y);
+	void SpatialRemove(NodeHandle handle, int x, int y);
+	void SpatialClear();
+
+	// Removes every node whose handle slot has its bit set.
+	// One sequential pass over the table, which beats SpatialRemove per node once many nodes are removed at once.
+	void SpatialRemoveMarked(const std::vector<uint64_t>& isSlotRemoved);
+
+	// First node in the cell, or NULL_NODE if the cell is empty. O(1)
+	NodeHandle FirstNodeInCell(int x, int y);
+
+	// Next node sharing a cell with `handle`, or NULL_NODE if it was the last.
+	NodeHandle NextNodeInCell(NodeHandle handle);
+
+	// Inclusive rectangle of gridspace cells
+	struct CellRange
+	{
+		int xmin, ymin, xmax, ymax;
+	};
+
+	// Appends every node within the inclusive gridspace rectangle to `results`. O(cells + hits)
+	// @param skipRanges: Cells which are also within any of these are not visited (so that overlapping queries don't report a node twice)
+	void QueryCells(int xmin, int ymin, int xmax, int ymax, const CellRange skipRanges[], size_t numSkipRanges, ChunkedList<NodeHandle>& results);
+
+	// Appends every node within any of the inclusive gridspace rectangles to `results`, once each.
+	// Small ranges are looked up cell by cell with QueryCells. Once they cover more cells than there are nodes, scanning every node is cheaper.
+	void QueryRanges(const CellRange ranges[], size_t numRanges, ChunkedList<NodeHandle>& results);
+}
@@ -0,0 +1,385 @@
+#include <algorithm>
+#include <vector>
+#include "console_log.hpp"
+#include "graph_storage.hpp"
+#include "graph_components.hpp"
+#include "graph_spatial.hpp"
+#include "graph_adjacency.hpp"
+#include "graph_scc.hpp"
+#include "graph_timing.hpp"
+
+namespace graph
+{
+	size_t numNodes = 0;
+	uint64_t editVersion = 0;
+	ChunkedList<NodeType> nodeType;
+	ChunkedList<int> nodeX;
+	ChunkedList<int> nodeY;
+	ChunkedList<NameID> nodeName;
+	ChunkedList<NodeHandle> nodeHandles;
+	HandleTable nodeHandleTable;
+
+	size_t numWires = 0;
+	ChunkedList<Wire> wires;
+	ChunkedList<WireHandle> wireHandles;
+	HandleTable wireHandleTable;
+
+	// Past this, replaying the edits would cost about as much as rebuilding whatever they'd be replayed into
+	constexpr size_t maxJournalLength = 4096;
+
+	// Edits from position `journalStart` onward
+	std::vector<Edit> journal;
+	uint64_t journalStart = 0;
+
+	uint64_t JournalPosition()
+	{
+		return journalStart + journal.size();
+	}
+
+	void Journal(const Edit& edit)
+	{
+		if (journal.size() == maxJournalLength)
+		{
+			journal.erase(journal.begin(), journal.begin() + maxJournalLength / 2);
+			journalStart += maxJournalLength / 2;
+		}
+		journal.push_back(edit);
+	}
+
+	void BreakJournal()
+	{
+		journalStart = JournalPosition() + 1;
+		journal.clear();
+	}
+
+	bool EditsSince(uint64_t position, std::vector<Edit>& edits)
+	{
+		if (position < journalStart || position > JournalPosition())
+		{
+			return false;
+		}
+		edits.insert(edits.end(), journal.begin() + (position - journalStart), journal.end());
+		return true;
+	}
+
+	NodeHandle CreateNode(NodeType type, int x, int y)
+	{
+		NodeHandle handle = NewHandle(nodeHandleTable, (uint32_t)numNodes);
+		if (handle == NULL_NODE) [[unlikely]]
+		{
+			console::Error("graph: Out of node handles. Node not created.");
+			return NULL_NODE;
+		}
+		++editVersion;
+		++numNodes;
+
+		Push(nodeType, type);
+		Push(nodeX, x);
+		Push(nodeY, y);
+		Push(nodeName, EMPTY_NAME);
+		Push(nodeHandles, handle);
+		SpatialInsert(handle, x, y);
+		InitNodeAdjacency(handle);
+		SccAddNode(handle);
+		TimingAddNode(handle);
+		Journal({ .kind = EditKind::AddNode, .type = type, .node = (uint32_t)(numNodes - 1), .endNode = NULL_NODE });
+		return handle;
+	}
+
+	// Moves the last node into the node's place in the columns, and frees its handle
+	void EraseNode(NodeHandle handle)
+	{
+		size_t index = NodeIndex(handle);
+		size_t lastIndex = --numNodes;
+		if (index != lastIndex)
+		{
+			At(nodeType, index) = At(nodeType, lastIndex);
+			At(nodeX, index) = At(nodeX, lastIndex);
+			At(nodeY, index) = At(nodeY, lastIndex);
+			At(nodeName, index) = At(nodeName, lastIndex);
+			At(nodeHandles, index) = At(nodeHandles, lastIndex);
+			SetHandleIndex(nodeHandleTable, At(nodeHandles, index), (uint32_t)index);
+		}
+		Pop(nodeType);
+		Pop(nodeX);
+		Pop(nodeY);
+		Pop(nodeName);
+		Pop(nodeHandles);
+
+		FreeHandle(nodeHandleTable, handle);
+	}
+
+	// Moves the last wire into the wire's place, and frees its handle
+	void EraseWire(WireHandle handle)
+	{
+		size_t index = WireIndex(handle);
+		size_t lastIndex = --numWires;
+		if (index != lastIndex)
+		{
+			At(wires, index) = At(wires, lastIndex);
+			At(wireHandles, index) = At(wireHandles, lastIndex);
+			SetHandleIndex(wireHandleTable, At(wireHandles, index), (uint32_t)index);
+		}
+		Pop(wires);
+		Pop(wireHandles);
+
+		FreeHandle(wireHandleTable, handle);
+	}
+
+	void DestroyNode(NodeHandle handle)
+	{
+		if (!IsNodeValid(handle))
+		{
+			return;
+		}
+		++editVersion;
+
+		for (WireHandle wire = FirstWireOut(handle); wire != NULL_WIRE; wire = FirstWireOut(handle))
+		{
+			DestroyWire(wire);
+		}
+		for (WireHandle wire = FirstWireIn(handle); wire != NULL_WIRE; wire = FirstWireIn(handle))
+		{
+			DestroyWire(wire);
+		}
+
+		size_t index = NodeIndex(handle);
+		SpatialRemove(handle, At(nodeX, index), At(nodeY, index));
+		SccRemoveNode(handle);
+		TimingRemoveNode(handle);
+		Journal({ .kind = EditKind::RemoveNode, .type = At(nodeType, index), .node = (uint32_t)index, .endNode = NULL_NODE });
+		EraseNode(handle);
+	}
+
+	// Below this many nodes, destroying them one at a time costs less than the batch's passes over every node and wire
+	constexpr size_t minBatchSize = 256;
+
+	void DestroyNodes(const ChunkedList<NodeHandle>& handles)
+	{
+		if (handles.num < minBatchSize)
+		{
+			// Repeats are already invalid by the time they come up again
+			for (size_t i = 0; i < handles.num; ++i)
+			{
+				DestroyNode(At(handles, i));
+			}
+			return;
+		}
+
+		// One bit per node handle slot.
+		// Testing by slot rather than by index means wires can be tested without looking up their nodes' indices.
+		static std::vector<uint64_t> isVictim;
+		static std::vector<NodeHandle> victims;
+		isVictim.assign((NumHandlesIssued(nodeHandleTable) + 63) / 64, 0);
+		victims.clear();
+		for (size_t i = 0; i < handles.num; ++i)
+		{
+			NodeHandle handle = At(handles, i);
+			if (!IsNodeValid(handle))
+			{
+				continue;
+			}
+			uint32_t slot = HandleSlot(handle);
+			uint64_t bit = 1ull << (slot % 64);
+			if (!(isVictim[slot / 64] & bit))
+			{
+				isVictim[slot / 64] |= bit;
+				victims.push_back(handle);
+			}
+		}
+		if (victims.empty())
+		{
+			return;
+		}
+		++editVersion;
+
+		auto IsVictim = [](NodeHandle handle)
+		{
+			uint32_t slot = HandleSlot(handle);
+			return (isVictim[slot / 64] >> (slot % 64)) & 1;
+		};
+
+		// Victims leave the columns in whatever order they're packed in, which edit-by-edit replay couldn't follow
+		BreakJournal();
+
+		// One pass over the wires: those touching a victim are unlinked from whichever end survives, and the rest are packed down in order
+		static std::vector<Wire> removedWires;
+		removedWires.clear();
+		size_t numKept = 0;
+		for (size_t i = 0; i < numWires; ++i)
+		{
+			Wire wire = At(wires, i);
+			WireHandle handle = At(wireHandles, i);
+			bool isStartVictim = IsVictim(wire.startNode);
+			bool isEndVictim = IsVictim(wire.endNode);
+			if (!isStartVictim && !isEndVictim)
+			{
+				if (numKept != i)
+				{
+					At(wires, numKept) = wire;
+					At(wireHandles, numKept) = handle;
+					SetHandleIndex(wireHandleTable, handle, (uint32_t)numKept);
+				}
+				++numKept;
+				continue;
+			}
+			if (!isStartVictim)
+			{
+				UnlinkWireOut(handle, wire.startNode);
+			}
+			if (!isEndVictim)
+			{
+				UnlinkWireIn(handle, wire.endNode);
+			}
+			removedWires.push_back(wire);
+			FreeHandle(wireHandleTable, handle);
+		}
+		numWires = numKept;
+		Resize(wires, numKept);
+		Resize(wireHandles, numKept);
+
+		// The victims' own wire lists went with their wires
+		for (NodeHandle victim : victims)
+		{
+			InitNodeAdjacency(victim);
+		}
+
+		// Each loop that lost wires is split once, rather than once per wire; the victims are left on their own
+		TimingRemoveWires(removedWires);
+		SccRemoveWires(removedWires);
+		SccRemoveNodes(victims);
+		TimingRemoveNodes(victims);
+		SpatialRemoveMarked(isVictim);
+
+		// Likewise one pass over the nodes
+		numKept = 0;
+		for (size_t i = 0; i < numNodes; ++i)
+		{
+			NodeHandle handle = At(nodeHandles, i);
+			if (IsVictim(handle))
+			{
+				FreeHandle(nodeHandleTable, handle);
+				continue;
+			}
+			if (numKept != i)
+			{
+				At(nodeType, numKept) = At(nodeType, i);
+				At(nodeX, numKept) = At(nodeX, i);
+				At(nodeY, numKept) = At(nodeY, i);
+				At(nodeName, numKept) = At(nodeName, i);
+				At(nodeHandles, numKept) = handle;
+				SetHandleIndex(nodeHandleTable, handle, (uint32_t)numKept);
+			}
+			++numKept;
+		}
+		numNodes = numKept;
+		Resize(nodeType, numKept);
+		Resize(nodeX, numKept);
+		Resize(nodeY, numKept);
+		Resize(nodeName, numKept);
+		Resize(nodeHandles, numKept);
+	}
+
+	// Forgets every wire without touching the components, for whoever clears those after
+	void ClearWireStorage()
+	{
+		numWires = 0;
+		Clear(wires);
+		Clear(wireHandles);
+		ClearHandles(wireHandleTable);
+		ClearWireAdjacency();
+	}
+
+	void ClearNodes()
+	{
+		++editVersion;
+		BreakJournal();
+		ClearWireStorage();
+
+		numNodes = 0;
+		Clear(nodeType);
+		Clear(nodeX);
+		Clear(nodeY);
+		Clear(nodeName);
+		Clear(nodeHandles);
+		ClearHandles(nodeHandleTable);
+		SpatialClear();
+		ClearNodeAdjacency();
+		ClearSccs();
+		ClearComponents(); // Before the names its definitions use are forgotten
+		ClearNames();
+	}
+
+	size_t NodeIndex(NodeHandle handle)
+	{
+		return HandleIndex(nodeHandleTable, handle);
+	}
+
+	bool IsNodeValid(NodeHandle handle)
+	{
+		return IsHandleValid(nodeHandleTable, handle);
+	}
+
+	WireHandle CreateWire(WireElbow elbow, NodeHandle startNode, NodeHandle endNode)
+	{
+		if (!IsNodeValid(startNode) || !IsNodeValid(endNode))
+		{
+			console::Error("graph: Tried to create a wire to a node that doesn't exist.");
+			return NULL_WIRE;
+		}
+		WireHandle handle = NewHandle(wireHandleTable, (uint32_t)numWires);
+		if (handle == NULL_WIRE) [[unlikely]]
+		{
+			console::Error("graph: Out of wire handles. Wire not created.");
+			return NULL_WIRE;
+		}
+		++editVersion;
+		++numWires;
+
+		Push(wires, {
+			.elbow = elbow,
+			.startNode = startNode,
+			.endNode = endNode,
+		});
+		Push(wireHandles, handle);
+		LinkWire(handle, startNode, endNode);
+		SccAddWire(startNode, endNode);
+		TimingAddWire(startNode, endNode);
+		Journal({ .kind = EditKind::AddWire, .type = NodeType::Any, .node = (uint32_t)NodeIndex(startNode), .endNode = (uint32_t)NodeIndex(endNode) });
+		return handle;
+	}
+
+	void DestroyWire(WireHandle handle)
+	{
+		if (!IsWireValid(handle))
+		{
+			return;
+		}
+		++editVersion;
+
+		const Wire& wire = At(wires, WireIndex(handle));
+		UnlinkWire(handle, wire.startNode, wire.endNode);
+		TimingRemoveWire(wire.startNode, wire.endNode);
+		SccRemoveWire(wire.startNode, wire.endNode);
+		Journal({ .kind = EditKind::RemoveWire, .type = NodeType::Any, .node = (uint32_t)NodeIndex(wire.startNode), .endNode = (uint32_t)NodeIndex(wire.endNode) });
+		EraseWire(handle);
+	}
+
+	void ClearWires()
+	{
+		++editVersion;
+		BreakJournal();
+		ClearWireStorage();
+		SccClearWires();
+	}
+
+	size_t WireIndex(WireHandle handle)
+	{
+		return HandleIndex(wireHandleTable, handle);
+	}
+
+	bool IsWireValid(WireHandle handle)
+	{
+		return IsHandleValid(wireHandleTable, handle);
+	}
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "chunked_list.hpp"
+#include "handle_table.hpp"
+#include "graph_names.hpp"
+
+// The nodes and wires themselves, and saving and loading them.
+// Nothing here draws or depends on the window, so it can be used headless.
+namespace graph
+{
+	enum class NodeType : char
+	{
+		Any = '|',
+		All = '&',
+		Non = '!',
+		One = '^',
+	};
+
+	// Identifies a node for as long as it exists, regardless of where it is moved to within the node columns.
+	// Slots of destroyed nodes are recycled by later nodes, but with a new generation - see HandleTable.
+	using NodeHandle = uint32_t;
+
+	constexpr NodeHandle NULL_NODE = HandleTable::NULL_HANDLE;
+
+	extern size_t numNodes;
+
+	// Bumped by every node and wire creation and destruction, so that anything built from the graph can tell it's stale
+	extern uint64_t editVersion;
+
+	enum class EditKind : char
+	{
+		AddNode,    // A node of `type` was placed at index numNodes
+		RemoveNode, // The node at `node` was destroyed (after its wires), and the last node moved into its index
+		AddWire,    // A wire from `node` to `endNode` was created
+		RemoveWire, // A wire from `node` to `endNode` was destroyed
+		PlaceInstance,  // An instance was placed at index `node` of graph::instances
+		RemoveInstance, // The instance at `node` was removed, and the instance at `endNode` (the last) moved into its index
+	};
+
+	// One edit, in terms of node (or instance) indices as they were when it was made
+	struct Edit
+	{
+		EditKind kind;
+		NodeType type;
+		uint32_t node;
+		uint32_t endNode;
+	};
+
+	// Where the journal is up to. Pass to EditsSince later to find out what changed in between.
+	uint64_t JournalPosition();
+
+	// Appends every edit made since `position`, in order, to `edits`.
+	// Returns false (appending nothing) if any of them weren't journaled - anything built from the graph must then be rebuilt.
+	// Bulk edits (ClearNodes, ClearWires, large DestroyNodes, and so Load) aren't journaled,
+	// and only the latest `maxJournalLength` edits are kept.
+	bool EditsSince(uint64_t position, std::vector<Edit>& edits);
+
+	// Forgets every edit so far, so that nothing can catch up across an edit that wasn't journaled.
+	// Called by bulk edits, and by anything else that changes what the graph builds into.
+	void BreakJournal();
+
+	// Records an edit made outside of the node and wire functions, such as to the instances
+	void Journal(const Edit& edit);
+
+	// Nodes are stored as parallel columns, so that a loop only pulls in the fields it reads.
+	// Each column holds numNodes items, packed; and grows in chunks, so nodes are never relocated by growth.
+	// Order is not preserved when a node is destroyed.
+
+	extern ChunkedList<NodeType> nodeType;
+	extern ChunkedList<int> nodeX;
+	extern ChunkedList<int> nodeY;
+
+	// Rarely read, so kept away from the other columns.
+	// Interned - compare names by ID, and use NameString to read the text.
+	extern ChunkedList<NameID> nodeName;
+
+	// The handle of each node, at the same index as its columns.
+	extern ChunkedList<NodeHandle> nodeHandles;
+
+	// Places a node at the end of the node columns
+	NodeHandle CreateNode(NodeType type, int x, int y);
+
+	// Destroys every wire attached to the node, then moves the last node into the destroyed node's place
+	void DestroyNode(NodeHandle handle);
+
+	// Destroys many nodes and their wires, whatever order the handles are in. Invalid and repeated handles are skipped.
+	// Small batches go through DestroyNode one at a time. Larger ones pack the wire columns and then the node columns
+	// in one pass each, keeping the order of what's left, and break the journal rather than journaling every removal.
+	void DestroyNodes(const ChunkedList<NodeHandle>& handles);
+
+	// Destroys every node and wire, and resets the handles
+	void ClearNodes();
+
+	// Index of the node within the node columns
+	size_t NodeIndex(NodeHandle handle);
+
+	// Whether the handle refers to a node that still exists. O(1)
+	bool IsNodeValid(NodeHandle handle);
+
+	enum class WireElbow : unsigned char
+	{
+		DiagonalHori = 0,
+		DiagonalVert = 1,
+		HoriDiagonal = 2,
+		VertDiagonal = 3,
+	};
+
+	// @No null node handles. A wire should not exist if it doesn't connect two existing nodes.
+	// CreateWire refuses stale handles, and DestroyNode destroys the node's wires, so this always holds.
+	struct Wire
+	{
+		WireElbow elbow;
+		NodeHandle startNode;
+		NodeHandle endNode;
+	};
+	static_assert(sizeof(Wire) <= 12, "Wires are iterated in bulk; keep them small");
+
+	// Identifies a wire for as long as it exists, the same way NodeHandle does for nodes.
+	using WireHandle = uint32_t;
+
+	constexpr WireHandle NULL_WIRE = HandleTable::NULL_HANDLE;
+
+	// Packed - Order is not preserved when a wire is destroyed.
+	extern size_t numWires;
+	extern ChunkedList<Wire> wires;
+
+	// The handle of each wire, at the same index as `wires`.
+	extern ChunkedList<WireHandle> wireHandles;
+
+	// Returns NULL_WIRE (and creates nothing) if either node doesn't exist.
+	WireHandle CreateWire(WireElbow elbow, NodeHandle startNode, NodeHandle endNode);
+
+	// Moves the last wire into the destroyed wire's place
+	void DestroyWire(WireHandle handle);
+
+	// Destroys every wire and resets the handles
+	void ClearWires();
+
+	// Index of the wire within `wires`
+	size_t WireIndex(WireHandle handle);
+
+	// Whether the handle refers to a wire that still exists. O(1)
+	bool IsWireValid(WireHandle handle);
+
+	// Writes every node and wire to a text file
+	void Save(const char* filename);
+
+	// Replaces every node and wire with those in a file written by Save
+	void Load(const char* filename);
+}
@@ -0,0 +1,453 @@
+#include <algorithm>
+#include <queue>
+#include <functional>
+#include "graph_adjacency.hpp"
+#include "graph_scc.hpp"
+#include "graph_timing.hpp"
+
+namespace graph
+{
+	// Indexed by node handle slot
+	ChunkedList<uint32_t> depthOfNode;
+	std::vector<uint32_t> settleStamp;
+	uint32_t currentSettleStamp = 0;
+
+	// Number of nodes at each depth, so the deepest is known without a scan
+	std::vector<uint32_t> nodesAtDepth;
+	uint32_t maxDepth = 0;
+
+	// Usually a node at maxDepth - checked before use, since it isn't kept when depths fall
+	NodeHandle deepestNode = NULL_NODE;
+
+	// Nodes whose inputs changed since the last query
+	std::vector<NodeHandle> dirtyNodes;
+
+	bool timingValid = true;
+
+	// Bumped by every edit, so the cached path is only rebuilt when something could have moved it
+	uint64_t timingVersion = 0;
+	uint64_t criticalPathVersion = (uint64_t)(-1);
+	std::vector<NodeHandle> criticalPathNodes;
+	std::vector<WireHandle> criticalPathWires;
+
+	uint32_t& DepthOf(NodeHandle node) { return At(depthOfNode, HandleSlot(node)); }
+
+	void EnsureTimingSlot(NodeHandle node)
+	{
+		size_t slot = HandleSlot(node);
+		if (slot >= depthOfNode.num)
+		{
+			Resize(depthOfNode, slot + 1);
+			settleStamp.resize(slot + 1, 0);
+		}
+	}
+
+	void CountDepth(uint32_t depth)
+	{
+		if (depth >= nodesAtDepth.size())
+		{
+			nodesAtDepth.resize(depth + 1, 0);
+		}
+		++nodesAtDepth[depth];
+		if (depth > maxDepth)
+		{
+			maxDepth = depth;
+		}
+	}
+
+	void UncountDepth(uint32_t depth)
+	{
+		--nodesAtDepth[depth];
+		while (maxDepth > 0 && nodesAtDepth[maxDepth] == 0)
+		{
+			--maxDepth;
+		}
+	}
+
+	void SetDepth(NodeHandle node, uint32_t depth)
+	{
+		uint32_t& current = DepthOf(node);
+		UncountDepth(current);
+		current = depth;
+		CountDepth(depth);
+		if (depth == maxDepth)
+		{
+			deepestNode = node;
+		}
+	}
+
+	using SettleEntry = std::pair<uint32_t, NodeHandle>; // Component position, node
+	std::priority_queue<SettleEntry, std::vector<SettleEntry>, std::greater<SettleEntry>> settleQueue;
+
+	// Sets every node of the node's component to the component's depth.
+	// If `propagate`, queues the outputs of the members whose depth changed.
+	void SettleComponent(NodeHandle node, bool propagate)
+	{
+		static std::vector<NodeHandle> members;
+
+		uint32_t scc = NodeScc(node);
+		SccMembers(node, members);
+
+		uint32_t depth = 0;
+		for (NodeHandle member : members)
+		{
+			settleStamp[HandleSlot(member)] = currentSettleStamp;
+			for (WireHandle wire = FirstWireIn(member); wire != NULL_WIRE; wire = NextWireIn(wire))
+			{
+				NodeHandle input = At(wires, WireIndex(wire)).startNode;
+				if (NodeScc(input) != scc && DepthOf(input) + 1 > depth)
+				{
+					depth = DepthOf(input) + 1;
+				}
+			}
+		}
+
+		for (NodeHandle member : members)
+		{
+			if (DepthOf(member) == depth)
+			{
+				continue;
+			}
+			SetDepth(member, depth);
+			if (!propagate)
+			{
+				continue;
+			}
+			for (WireHandle wire = FirstWireOut(member); wire != NULL_WIRE; wire = NextWireOut(wire))
+			{
+				NodeHandle output = At(wires, WireIndex(wire)).endNode;
+				if (NodeScc(output) != scc)
+				{
+					settleQueue.push({ NodeSccOrder(output), output });
+				}
+			}
+		}
+	}
+
+	void NextSettleStamp()
+	{
+		if (++currentSettleStamp == 0)
+		{
+			std::fill(settleStamp.begin(), settleStamp.end(), 0);
+			currentSettleStamp = 1;
+		}
+	}
+
+	// Settles every dirty node and whatever downstream of them changes as a result.
+	// Components are visited in topological order, so each is settled once, after everything driving it.
+	void SettleDirtyNodes()
+	{
+		NextSettleStamp();
+		for (NodeHandle node : dirtyNodes)
+		{
+			if (IsNodeValid(node))
+			{
+				settleQueue.push({ NodeSccOrder(node), node });
+			}
+		}
+		dirtyNodes.clear();
+
+		while (!settleQueue.empty())
+		{
+			NodeHandle node = settleQueue.top().second;
+			settleQueue.pop();
+			if (settleStamp[HandleSlot(node)] != currentSettleStamp)
+			{
+				SettleComponent(node, true);
+			}
+		}
+	}
+
+	// Starts every node over at depth 0 and settles all of them, in one sorted sweep rather than through the queue
+	void RebuildTiming()
+	{
+		static std::vector<SettleEntry> order;
+
+		nodesAtDepth.assign(1, 0);
+		maxDepth = 0;
+		deepestNode = NULL_NODE;
+		dirtyNodes.clear();
+		order.clear();
+		for (size_t i = 0; i < numNodes; ++i)
+		{
+			NodeHandle node = At(nodeHandles, i);
+			EnsureTimingSlot(node);
+			DepthOf(node) = 0;
+			++nodesAtDepth[0];
+			order.push_back({ NodeSccOrder(node), node });
+		}
+		timingValid = true;
+		if (numNodes != 0)
+		{
+			deepestNode = At(nodeHandles, 0);
+		}
+
+		std::sort(order.begin(), order.end());
+		NextSettleStamp();
+		for (const SettleEntry& entry : order)
+		{
+			if (settleStamp[HandleSlot(entry.second)] != currentSettleStamp)
+			{
+				SettleComponent(entry.second, false);
+			}
+		}
+	}
+
+	void EnsureTiming()
+	{
+		if (!timingValid)
+		{
+			RebuildTiming();
+		}
+		else if (!dirtyNodes.empty())
+		{
+			SettleDirtyNodes();
+		}
+	}
+
+	void TimingAddNode(NodeHandle node)
+	{
+		++timingVersion;
+		if (!timingValid)
+		{
+			return;
+		}
+		EnsureTimingSlot(node);
+		DepthOf(node) = 0;
+		CountDepth(0);
+		if (maxDepth == 0)
+		{
+			deepestNode = node;
+		}
+	}
+
+	void TimingRemoveNode(NodeHandle node)
+	{
+		++timingVersion;
+		if (!timingValid)
+		{
+			return;
+		}
+		UncountDepth(DepthOf(node));
+	}
+
+	void TimingRemoveNodes(const std::vector<NodeHandle>& nodes)
+	{
+		++timingVersion;
+		if (!timingValid)
+		{
+			return;
+		}
+		// The deepest depth left is found once, rather than after each node
+		for (NodeHandle node : nodes)
+		{
+			--nodesAtDepth[DepthOf(node)];
+		}
+		while (maxDepth > 0 && nodesAtDepth[maxDepth] == 0)
+		{
+			--maxDepth;
+		}
+	}
+
+	void TimingAddWire(NodeHandle startNode, NodeHandle endNode)
+	{
+		++timingVersion;
+		if (!timingValid)
+		{
+			return;
+		}
+		if (NodeScc(startNode) != NodeScc(endNode) && DepthOf(startNode) < DepthOf(endNode))
+		{
+			// Can't deepen the end. Should the start be deepened by a pending edit, settling it reaches the end through this wire.
+			return;
+		}
+		// If the wire closed a loop, endNode's component is the merged loop, and settling it settles all of it
+		dirtyNodes.push_back(endNode);
+	}
+
+	void TimingRemoveWire(NodeHandle startNode, NodeHandle endNode)
+	{
+		++timingVersion;
+		if (!timingValid)
+		{
+			return;
+		}
+		if (NodeScc(startNode) == NodeScc(endNode))
+		{
+			// The loop may be about to break into pieces with depths of their own
+			static std::vector<NodeHandle> members;
+			SccMembers(endNode, members);
+			dirtyNodes.insert(dirtyNodes.end(), members.begin(), members.end());
+		}
+		else
+		{
+			dirtyNodes.push_back(endNode);
+		}
+	}
+
+	void TimingRemoveWires(const std::vector<Wire>& removed)
+	{
+		++timingVersion;
+		if (!timingValid)
+		{
+			return;
+		}
+		static std::vector<std::pair<uint32_t, NodeHandle>> loops; // Component, a member
+		static std::vector<NodeHandle> members;
+		loops.clear();
+		for (const Wire& wire : removed)
+		{
+			uint32_t scc = NodeScc(wire.endNode);
+			if (NodeScc(wire.startNode) == scc)
+			{
+				loops.push_back({ scc, wire.endNode });
+			}
+			else
+			{
+				dirtyNodes.push_back(wire.endNode);
+			}
+		}
+
+		// Each loop that may break is marked once, however many of its wires went
+		std::sort(loops.begin(), loops.end(), [](auto a, auto b) { return a.first < b.first; });
+		for (size_t i = 0; i < loops.size(); ++i)
+		{
+			if (i == 0 || loops[i].first != loops[i - 1].first)
+			{
+				SccMembers(loops[i].second, members);
+				dirtyNodes.insert(dirtyNodes.end(), members.begin(), members.end());
+			}
+		}
+	}
+
+	void TimingClearWires()
+	{
+		++timingVersion;
+		nodesAtDepth.assign(1, (uint32_t)numNodes);
+		maxDepth = 0;
+		deepestNode = (numNodes != 0) ? At(nodeHandles, 0) : NULL_NODE;
+		dirtyNodes.clear();
+		for (size_t i = 0; i < numNodes; ++i)
+		{
+			NodeHandle node = At(nodeHandles, i);
+			EnsureTimingSlot(node);
+			DepthOf(node) = 0;
+		}
+		timingValid = true;
+	}
+
+	void InvalidateTiming()
+	{
+		++timingVersion;
+		timingValid = false;
+	}
+
+	void ClearTiming()
+	{
+		++timingVersion;
+		Clear(depthOfNode);
+		settleStamp.clear();
+		nodesAtDepth.assign(1, 0);
+		maxDepth = 0;
+		deepestNode = NULL_NODE;
+		dirtyNodes.clear();
+		timingValid = true;
+	}
+
+	uint32_t NodeDepth(NodeHandle node)
+	{
+		EnsureTiming();
+		return DepthOf(node);
+	}
+
+	uint32_t CriticalPathDepth()
+	{
+		EnsureTiming();
+		return maxDepth;
+	}
+
+	void FindCriticalPath()
+	{
+		static std::vector<NodeHandle> members;
+
+		criticalPathNodes.clear();
+		criticalPathWires.clear();
+		if (maxDepth == 0)
+		{
+			// Not a single wire between stages
+			return;
+		}
+
+		NodeHandle node = deepestNode;
+		if (!IsNodeValid(node) || DepthOf(node) != maxDepth)
+		{
+			node = NULL_NODE;
+			for (size_t i = 0; i < numNodes; ++i)
+			{
+				if (DepthOf(At(nodeHandles, i)) == maxDepth)
+				{
+					node = deepestNode = At(nodeHandles, i);
+					break;
+				}
+			}
+		}
+		if (node == NULL_NODE)
+		{
+			return;
+		}
+
+		// Walk back from the deepest node, always through an input exactly one gate shallower
+		criticalPathNodes.push_back(node);
+		while (DepthOf(node) > 0)
+		{
+			uint32_t scc = NodeScc(node);
+			uint32_t inputDepth = DepthOf(node) - 1;
+			SccMembers(node, members);
+
+			NodeHandle enteredBy = NULL_NODE;
+			WireHandle inputWire = NULL_WIRE;
+			for (size_t i = 0; i < members.size() && inputWire == NULL_WIRE; ++i)
+			{
+				for (WireHandle wire = FirstWireIn(members[i]); wire != NULL_WIRE; wire = NextWireIn(wire))
+				{
+					NodeHandle input = At(wires, WireIndex(wire)).startNode;
+					if (NodeScc(input) != scc && DepthOf(input) == inputDepth)
+					{
+						enteredBy = members[i];
+						inputWire = wire;
+						break;
+					}
+				}
+			}
+
+			if (enteredBy != node)
+			{
+				criticalPathNodes.push_back(enteredBy);
+				criticalPathWires.push_back(NULL_WIRE);
+			}
+			node = At(wires, WireIndex(inputWire)).startNode;
+			criticalPathNodes.push_back(node);
+			criticalPathWires.push_back(inputWire);
+		}
+
+		std::reverse(criticalPathNodes.begin(), criticalPathNodes.end());
+		std::reverse(criticalPathWires.begin(), criticalPathWires.end());
+	}
+
+	uint64_t TimingVersion()
+	{
+		return timingVersion;
+	}
+
+	void CriticalPath(std::vector<NodeHandle>& nodes, std::vector<WireHandle>& pathWires)
+	{
+		EnsureTiming();
+		if (criticalPathVersion != timingVersion)
+		{
+			FindCriticalPath();
+			criticalPathVersion = timingVersion;
+		}
+		nodes = criticalPathNodes;
+		pathWires = criticalPathWires;
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include "graph_storage.hpp"
+
+// Static timing: the depth of each node in gates, and the longest (critical) path through the wire graph.
+// Kept up to date by the node and wire create/destroy functions - no need to call the modifiers yourself.
+//
+// A node's depth is 0 if nothing outside its loop drives it, otherwise one more than the deepest node driving it from outside.
+// Every node of a feedback loop shares the loop's depth, so loops count as a single stage.
+//
+// Edits only mark nodes dirty. The next query re-settles just the marked nodes and the nodes downstream of them
+// whose depth actually changes, in topological order (see NodeSccOrder), so there is never a full recomputation.
+// Load invalidates the loop index (InvalidateSccs), and timing with it, so both are found once for the whole file.
+namespace graph
+{
+	void TimingAddNode(NodeHandle node);
+	// Only once the node has no wires
+	void TimingRemoveNode(NodeHandle node);
+	// For many nodes destroyed at once, once none of them has wires
+	void TimingRemoveNodes(const std::vector<NodeHandle>& nodes);
+	// Call after SccAddWire
+	void TimingAddWire(NodeHandle startNode, NodeHandle endNode);
+	// Call before SccRemoveWire, while the loop the wire may be breaking is still known
+	void TimingRemoveWire(NodeHandle startNode, NodeHandle endNode);
+	// For many wires destroyed at once: call after they've all been unlinked and before SccRemoveWires
+	void TimingRemoveWires(const std::vector<Wire>& removed);
+	// Every node back to depth 0, once every wire is gone
+	void TimingClearWires();
+
+	// Forgets every depth until the next query, which settles every node
+	void InvalidateTiming();
+
+	// Forgets every node
+	void ClearTiming();
+
+	// Gates between the node and the furthest node with no inputs from outside its loop
+	uint32_t NodeDepth(NodeHandle node);
+
+	// Changes with every edit that could move a depth or the critical path, for caching whatever is worked out from them
+	uint64_t TimingVersion();
+
+	// Depth of the deepest node - the number of gates along the critical path, not counting its first
+	uint32_t CriticalPathDepth();
+
+	// One of the longest paths, from its first node to its last.
+	// `pathWires[i]` joins `nodes[i]` to `nodes[i + 1]`. Where the path crosses a loop, both the node it enters by
+	// and the node it leaves by are listed, with NULL_WIRE between them. Empty while every depth is 0. Only valid until the next edit.
+	void CriticalPath(std::vector<NodeHandle>& nodes, std::vector<WireHandle>& pathWires);
+}
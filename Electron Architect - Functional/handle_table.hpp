@@ -0,0 +1,127 @@
+#pragma once
+#include <cstdint>
+#include "chunked_list.hpp"
+
+// Maps stable handles to the current index of a packed item.
+// Items can be moved around (to keep them packed) without invalidating their handles;
+// only the table entry needs updating with SetHandleIndex.
+//
+// A handle is 32 bits: the low 24 are the slot in the table, the high 8 are the slot's generation.
+// A slot's generation changes every time it is freed, so a handle kept after its item was destroyed
+// no longer matches and can be detected in O(1) with IsHandleValid - even after the slot is recycled.
+// A slot whose generation reaches RETIRED_GENERATION is never given out again, so generations can't wrap
+// around to match an old handle. That costs one slot of table space per 255 frees of it.
+struct HandleTable
+{
+	static constexpr uint32_t NULL_HANDLE = (uint32_t)(-1);
+
+	static constexpr uint32_t SLOT_BITS = 24;
+	static constexpr uint32_t SLOT_MASK = (1u << SLOT_BITS) - 1;
+
+	// The all-ones slot is reserved so that no handle can equal NULL_HANDLE
+	static constexpr uint32_t MAX_SLOTS = SLOT_MASK;
+
+	static constexpr uint8_t RETIRED_GENERATION = 0xFF;
+
+	// Indexed by slot - one item for every slot given out since the last clear.
+	// For live slots, the index of the item.
+	// For free slots, the next free slot (forming a free list).
+	ChunkedList<uint32_t> slots;
+
+	// Indexed by slot - the generation of the handle currently (or next) using the slot.
+	ChunkedList<uint8_t> generations;
+
+	// Most recently freed slot - NULL_HANDLE when there are none to recycle
+	uint32_t freeList = NULL_HANDLE;
+};
+
+// The slot part of a handle - use this to index arrays that are parallel to the handle table.
+inline uint32_t HandleSlot(uint32_t handle)
+{
+	return handle & HandleTable::SLOT_MASK;
+}
+
+inline uint32_t HandleGeneration(uint32_t handle)
+{
+	return handle >> HandleTable::SLOT_BITS;
+}
+
+// Returns a handle referring to `index`, recycling a freed slot if there is one.
+// Returns NULL_HANDLE if every slot is in use or retired.
+inline uint32_t NewHandle(HandleTable& table, uint32_t index)
+{
+	uint32_t slot;
+	if (table.freeList != HandleTable::NULL_HANDLE)
+	{
+		slot = table.freeList;
+		table.freeList = At(table.slots, slot);
+		At(table.slots, slot) = index;
+	}
+	else
+	{
+		if (table.slots.num == HandleTable::MAX_SLOTS) [[unlikely]]
+		{
+			return HandleTable::NULL_HANDLE;
+		}
+		slot = (uint32_t)table.slots.num;
+		Push(table.slots, index);
+		Push(table.generations, (uint8_t)0);
+	}
+	return ((uint32_t)At(table.generations, slot) << HandleTable::SLOT_BITS) | slot;
+}
+
+inline void FreeHandle(HandleTable& table, uint32_t handle)
+{
+	uint32_t slot = HandleSlot(handle);
+	if (++At(table.generations, slot) == HandleTable::RETIRED_GENERATION) [[unlikely]]
+	{
+		At(table.slots, slot) = HandleTable::NULL_HANDLE;
+		return;
+	}
+	At(table.slots, slot) = table.freeList;
+	table.freeList = slot;
+}
+
+// Whether the handle refers to an item that still exists.
+// A retired slot stays at RETIRED_GENERATION, which no handle is given out at - so its stale handles, and NULL_HANDLE, never match.
+inline bool IsHandleValid(const HandleTable& table, uint32_t handle)
+{
+	uint32_t slot = HandleSlot(handle);
+	return HandleGeneration(handle) != HandleTable::RETIRED_GENERATION
+		&& slot < table.slots.num
+		&& At(table.generations, slot) == HandleGeneration(handle);
+}
+
+inline uint32_t HandleIndex(const HandleTable& table, uint32_t handle)
+{
+	return At(table.slots, HandleSlot(handle));
+}
+
+inline void SetHandleIndex(HandleTable& table, uint32_t handle, uint32_t index)
+{
+	At(table.slots, HandleSlot(handle)) = index;
+}
+
+// Upper bound of slots in use - for sizing arrays indexed by slot
+inline size_t NumHandlesIssued(const HandleTable& table)
+{
+	return table.slots.num;
+}
+
+// Generations are kept rather than reset, so that handles from before the clear stay invalid
+inline void ClearHandles(HandleTable& table)
+{
+	// Rebuilt back to front so that the lowest slots are given out first
+	table.freeList = HandleTable::NULL_HANDLE;
+	for (size_t i = table.slots.num; i-- > 0;)
+	{
+		uint8_t& generation = At(table.generations, i);
+		if (generation == HandleTable::RETIRED_GENERATION || ++generation == HandleTable::RETIRED_GENERATION)
+		{
+			At(table.slots, i) = HandleTable::NULL_HANDLE;
+			continue;
+		}
+		At(table.slots, i) = table.freeList;
+		table.freeList = (uint32_t)i;
+	}
+}
@@ -1,4 +1,5 @@
 #include <thread>
+#include <string.h>
 #include <raylib.h>
 #include <raymath.h>
 #include "panel.hpp"
@@ -6,6 +7,9 @@
 #include "properties.hpp"
 #include "tools.hpp"
 #include "graph.hpp"
+#include "graph_algorithms.hpp"
+#include "simulation_live.hpp"
+#include "benchmark.hpp"
 
 int ClampInt(int x, int min, int max);
 template<size_t NUM_PANELS> void ShiftToFront(panel::Panel* panels[NUM_PANELS], panel::Panel* panel);
@@ -27,10 +31,17 @@ using console::consolePanel;
 
 #pragma endregion
 
-int main()
+int main(int argc, char* argv[])
 {
 #pragma region // Pre-loop
 
+    // Benchmarks run instead of the editor, without opening a window
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+    {
+        benchmark::RunAll();
+        return 0;
+    }
+
     int windowWidth = 1280;
     int windowHeight = 720;
     panel::windowBounds.xmax = &windowWidth;
@@ -135,6 +146,18 @@ int main()
     graph::UpdateGridDisplaySize();
 #endif
 
+    properties::AddObjectHeader("Graph"); {
+        properties::AddLinkedInt("Critical path depth", "%i", &graph::criticalPathDepth);
+        properties::AddLinkedInt("Redundant gates", "%i", &graph::redundantGates);
+    } properties::AddCloser();
+    properties::AddObjectHeader("Simulation"); {
+        properties::AddLinkedBool("Running", &simulation::liveIsRunning);
+        properties::AddLinkedInt("Tick rate (0 = max)", "%i", &simulation::liveTickRate);
+        properties::AddLinkedInt("Ticks per second", "%i", &simulation::liveMeasuredTickRate);
+        properties::AddLinkedInt("Tick", "%i", &simulation::liveTick);
+        properties::AddLinkedInt("History (KiB)", "%i", &simulation::liveHistoryKilobytes);
+    } properties::AddCloser();
+
     Panel* currentlyWithin = nullptr;
     Panel* currentlyResizing = nullptr;
     PanelHover draggingInfo = PanelHover();
@@ -147,6 +170,13 @@ int main()
     int mousePrevXs[2] {};
     int mousePrevYs[2] {};
 
+    // Corner the selection box is being dragged from - Set when drag begins
+    bool isSelecting = false;
+    int selectStartX{ }, selectStartY{ };
+
+    // Most recently defined component, for placing
+    graph::DefinitionID lastDefinition = graph::NULL_DEFINITION;
+
 #pragma endregion
 
 #pragma region // Loop
@@ -314,7 +344,92 @@ int main()
             {
                 graph::AddNode(graph::NodeType::Any, mouseCurrX, mouseCurrY);
             }
+            if (IsMouseButtonPressed(MOUSE_BUTTON_MIDDLE))
+            {
+                isSelecting = true;
+                selectStartX = mouseCurrX;
+                selectStartY = mouseCurrY;
+            }
+        }
+
+        // Selection input - drag with the middle button to select every node in the box, and delete them with Delete.
+        // 'C' defines a component of the selection, and 'V' places the last one defined at the mouse, its ports bound to the selection's pins.
+        // 'T' writes the selection's truth table to "selection.eatt" in the working directory,
+        // and 'E' checks that the selection computes the same as the one before it, logging a counterexample if it doesn't.
+        if (isSelecting && IsMouseButtonReleased(MOUSE_BUTTON_MIDDLE))
+        {
+            isSelecting = false;
+            Bounds box = {
+                .xmin = selectStartX < mouseCurrX ? selectStartX : mouseCurrX,
+                .ymin = selectStartY < mouseCurrY ? selectStartY : mouseCurrY,
+                .xmax = selectStartX < mouseCurrX ? mouseCurrX : selectStartX,
+                .ymax = selectStartY < mouseCurrY ? mouseCurrY : selectStartY,
+            };
+            graph::SelectNodesInRanges(&box, 1);
+        }
+        if (IsKeyPressed(KEY_DELETE))
+        {
+            graph::RemoveSelectedNodes();
+        }
+        if (IsKeyPressed(KEY_C) && graph::nodesSelected.num != 0)
+        {
+            const char* name = TextFormat("Component %i", (int)graph::definitions.size() + 1);
+            graph::DefinitionID definition = graph::DefineSelectionComponent(name);
+            if (definition != graph::NULL_DEFINITION)
+            {
+                lastDefinition = definition;
+                console::Logf("graph: Defined \"%s\" from %zu selected nodes.", name, graph::nodesSelected.num);
+            }
+        }
+        if (IsKeyPressed(KEY_T) && graph::nodesSelected.num != 0)
+        {
+            graph::WriteSelectionTruthTable("selection.eatt");
+        }
+        if (IsKeyPressed(KEY_E) && graph::nodesSelected.num != 0 && graph::nodesSelectedBefore.num != 0)
+        {
+            graph::CheckSelectionEquivalence();
+        }
+        if (IsKeyPressed(KEY_V) && !hoverDisabled && currentlyWithin->id == PanelID::Graph)
+        {
+            if (lastDefinition == graph::NULL_DEFINITION)
+            {
+                console::Warn("graph: Define a component with 'C' before placing one.");
+            }
+            else
+            {
+                graph::PlaceComponent(lastDefinition, mouseCurrX, mouseCurrY);
+            }
+        }
+
+        // Simulation input - run or pause with space, step forward with '.' and back with ',',
+        // and halve or double the tick rate with '[' and ']' (past the fastest rate is as fast as possible)
+        if (IsKeyPressed(KEY_SPACE))
+        {
+            simulation::SetLiveRunning(!simulation::liveIsRunning);
+        }
+        if (IsKeyPressed(KEY_PERIOD))
+        {
+            simulation::StepLive();
+        }
+        if (IsKeyPressed(KEY_COMMA))
+        {
+            simulation::RewindLive();
         }
+        constexpr int maxTickRate = 1 << 16;
+        if (IsKeyPressed(KEY_LEFT_BRACKET))
+        {
+            int rate = simulation::liveTickRate;
+            simulation::SetLiveTickRate(rate == 0 ? maxTickRate : (rate > 1 ? rate / 2 : 1));
+        }
+        if (IsKeyPressed(KEY_RIGHT_BRACKET))
+        {
+            int rate = simulation::liveTickRate;
+            simulation::SetLiveTickRate((rate == 0 || rate * 2 > maxTickRate) ? 0 : rate * 2);
+        }
+
+        // Take the newest state the simulation thread has published, so the whole frame draws the same tick
+        simulation::SyncLive();
+        graph::UpdateStats();
 
 #if _DEBUG
         propertiesPanelWidth = propertiesPanel.bounds.xmax - propertiesPanel.bounds.xmin;
@@ -381,6 +496,13 @@ int main()
             panel::DrawPanelDragElement(currentlyResizing->bounds, draggingInfo);
         }
 
+        if (isSelecting)
+        {
+            int x = selectStartX < mouseCurrX ? selectStartX : mouseCurrX;
+            int y = selectStartY < mouseCurrY ? selectStartY : mouseCurrY;
+            DrawRectangleLines(x, y, abs(mouseCurrX - selectStartX), abs(mouseCurrY - selectStartY), WHITE);
+        }
+
         EndDrawing();
 
         {
@@ -398,6 +520,7 @@ int main()
 
 #pragma region // Post-loop
 
+    simulation::StopLive();
     CloseWindow();
 
     properties::Clear();
@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <bit>
+#include "simulation.hpp"
+
+namespace simulation
+{
+	// What a gate outputs when nothing is wired into it
+	bool SourceDefault(NodeType type)
+	{
+		return type == NodeType::Non;
+	}
+
+	bool Evaluate(NodeType type, const uint64_t* state, const GateID* inputs, uint32_t numInputs)
+	{
+		switch (type)
+		{
+		case NodeType::Any:
+			for (uint32_t i = 0; i < numInputs; ++i)
+			{
+				if (GetBit(state, inputs[i])) return true;
+			}
+			return false;
+
+		case NodeType::All:
+			for (uint32_t i = 0; i < numInputs; ++i)
+			{
+				if (!GetBit(state, inputs[i])) return false;
+			}
+			return numInputs != 0;
+
+		case NodeType::Non:
+			for (uint32_t i = 0; i < numInputs; ++i)
+			{
+				if (GetBit(state, inputs[i])) return false;
+			}
+			return true;
+
+		case NodeType::One:
+		{
+			bool seen = false;
+			for (uint32_t i = 0; i < numInputs; ++i)
+			{
+				if (GetBit(state, inputs[i]))
+				{
+					if (seen) return false;
+					seen = true;
+				}
+			}
+			return seen;
+		}
+
+		default:
+			return false;
+		}
+	}
+
+	void Reset(Program& program)
+	{
+		std::fill(program.state.begin(), program.state.end(), 0);
+		for (GateID g = 0; g < program.numSources; ++g)
+		{
+			SetBit(program.state.data(), g, SourceDefault(program.sourceTypes[g]));
+		}
+		program.pending.clear();
+		program.needsSweep = true;
+		program.activity = 0;
+		program.evaluations = 0;
+		program.tick = 0;
+	}
+
+	// Returns whether the gate's value changed
+	inline bool Store(uint64_t* state, GateID gate, bool value)
+	{
+		uint64_t& word = state[gate / 64];
+		uint64_t mask = 1ull << (gate % 64);
+		bool changed = ((word & mask) != 0) != value;
+		word ^= changed ? mask : 0;
+		return changed;
+	}
+
+	// Evaluates the loop's gates in order until a pass changes nothing, or the loop runs out of passes.
+	// A loop that runs out is oscillating, and is made pending so that it carries on next tick.
+	// Returns the number of times a gate changed.
+	uint64_t SettleLoop(Program& program, const Loop& loop, uint64_t& evaluations)
+	{
+		uint64_t* state = program.state.data();
+		const GateID* operands = program.operands.data();
+		const Instruction* code = program.code.data();
+		const GateID numSources = program.numSources;
+
+		uint64_t changes = 0;
+		for (uint32_t pass = 0; pass < program.maxLoopPasses; ++pass)
+		{
+			uint64_t passChanges = 0;
+			for (GateID gate = loop.first; gate < loop.end; ++gate)
+			{
+				const Instruction& instruction = code[gate - numSources];
+				passChanges += Store(state, gate, Evaluate(instruction.type, state, operands + instruction.firstInput, instruction.numInputs));
+			}
+			evaluations += loop.end - loop.first;
+			changes += passChanges;
+			if (passChanges == 0)
+			{
+				return changes;
+			}
+		}
+		program.pending.push_back(loop.first);
+		return changes;
+	}
+
+	void StepSweep(Program& program)
+	{
+		uint64_t* state = program.state.data();
+		const GateID* operands = program.operands.data();
+		const Instruction* code = program.code.data();
+		const GateID numSources = program.numSources;
+
+		// Nothing stays pending through a sweep, since every gate is evaluated
+		program.pending.clear();
+
+		uint64_t changes = 0;
+		uint64_t evaluations = 0;
+		GateID gate = numSources;
+		for (const Loop& loop : program.loops)
+		{
+			evaluations += loop.first - gate;
+			for (; gate < loop.first; ++gate)
+			{
+				const Instruction& instruction = code[gate - numSources];
+				changes += Store(state, gate, Evaluate(instruction.type, state, operands + instruction.firstInput, instruction.numInputs));
+			}
+			changes += SettleLoop(program, loop, evaluations);
+			gate = loop.end;
+		}
+		evaluations += program.numGates - gate;
+		for (; gate < program.numGates; ++gate)
+		{
+			const Instruction& instruction = code[gate - numSources];
+			changes += Store(state, gate, Evaluate(instruction.type, state, operands + instruction.firstInput, instruction.numInputs));
+		}
+
+		// Each change would have cost its fan-out in evaluations
+		program.activity = program.numGates ? changes * program.operands.size() / program.numGates : 0;
+		program.evaluations = evaluations;
+		program.needsSweep = false;
+		++program.tick;
+	}
+
+	inline void Schedule(Program& program, GateID gate)
+	{
+		program.scheduled[gate / 64] |= 1ull << (gate % 64);
+		program.scheduledWords[gate / 4096] |= 1ull << ((gate / 64) % 64);
+	}
+
+	inline void Unschedule(Program& program, GateID first, GateID end)
+	{
+		for (GateID gate = first; gate < end; ++gate)
+		{
+			program.scheduled[gate / 64] &= ~(1ull << (gate % 64));
+		}
+	}
+
+	void StepEvents(Program& program)
+	{
+		if (program.needsSweep)
+		{
+			StepSweep(program);
+			return;
+		}
+
+		uint64_t* state = program.state.data();
+		uint64_t* scheduled = program.scheduled.data();
+		uint64_t* scheduledWords = program.scheduledWords.data();
+		const GateID* operands = program.operands.data();
+		const Instruction* code = program.code.data();
+		const GateID numSources = program.numSources;
+
+		for (GateID gate : program.pending)
+		{
+			Schedule(program, gate);
+		}
+		program.pending.clear();
+
+		std::vector<bool>& before = program.loopBefore;
+
+		// Gates only schedule gates after themselves, so a single forward scan visits everything scheduled.
+		uint64_t evaluations = 0;
+		for (size_t summaryIndex = 0; summaryIndex < program.scheduledWords.size(); ++summaryIndex)
+		{
+			while (scheduledWords[summaryIndex])
+			{
+				size_t wordIndex = summaryIndex * 64 + std::countr_zero(scheduledWords[summaryIndex]);
+				while (scheduled[wordIndex])
+				{
+					GateID gate = (GateID)(wordIndex * 64 + std::countr_zero(scheduled[wordIndex]));
+					scheduled[wordIndex] &= scheduled[wordIndex] - 1;
+
+					const Instruction& instruction = code[gate - numSources];
+					if (instruction.inLoop)
+					{
+						// The whole loop settles together, as in a sweep
+						const Loop& loop = *(std::upper_bound(program.loops.begin(), program.loops.end(), gate,
+							[](GateID gate, const Loop& loop) { return gate < loop.first; }) - 1);
+						Unschedule(program, gate, loop.end);
+
+						before.resize(loop.end - loop.first);
+						for (GateID member = loop.first; member < loop.end; ++member)
+						{
+							before[member - loop.first] = GetBit(state, member);
+						}
+						SettleLoop(program, loop, evaluations);
+						for (GateID member = loop.first; member < loop.end; ++member)
+						{
+							if (GetBit(state, member) == before[member - loop.first])
+							{
+								continue;
+							}
+							for (uint32_t i = program.outStart[member]; i < program.outEnd[member]; ++i)
+							{
+								if (program.outGates[i] >= loop.end)
+								{
+									Schedule(program, program.outGates[i]);
+								}
+							}
+						}
+						continue;
+					}
+
+					++evaluations;
+					if (Store(state, gate, Evaluate(instruction.type, state, operands + instruction.firstInput, instruction.numInputs)))
+					{
+						for (uint32_t i = program.outStart[gate]; i < program.outEnd[gate]; ++i)
+						{
+							Schedule(program, program.outGates[i]);
+						}
+					}
+				}
+				scheduledWords[summaryIndex] &= ~(1ull << (wordIndex % 64));
+			}
+		}
+
+		program.activity = evaluations;
+		program.evaluations = evaluations;
+		++program.tick;
+	}
+
+	// How many times more an event-driven evaluation costs than a swept one, roughly.
+	// Measured with benchmark::EventSimulation.
+	constexpr uint64_t EVENT_COST_RATIO = 2;
+
+	void Step(Program& program)
+	{
+		switch (program.mode)
+		{
+		case StepMode::Sweep:
+			StepSweep(program);
+			break;
+
+		case StepMode::Event:
+			StepEvents(program);
+			break;
+
+		case StepMode::Auto:
+			if ((program.activity + program.pending.size()) * EVENT_COST_RATIO < program.code.size())
+			{
+				StepEvents(program);
+			}
+			else
+			{
+				StepSweep(program);
+			}
+			break;
+		}
+	}
+
+	void Run(Program& program, uint64_t numTicks)
+	{
+		for (uint64_t i = 0; i < numTicks; ++i)
+		{
+			Step(program);
+		}
+	}
+
+	bool GetOutput(const Program& program, GateID netlistGate)
+	{
+		return GetBit(program.state.data(), program.gateOfNetlistGate[netlistGate]);
+	}
+
+	void SetInput(Program& program, GateID netlistGate, bool value)
+	{
+		// A gate merged into a source isn't one itself
+		GateID gate = program.gateOfNetlistGate[netlistGate];
+		if (gate < program.numSources && program.netlistGateOfGate[gate] == netlistGate && Store(program.state.data(), gate, value))
+		{
+			program.pending.insert(program.pending.end(), program.outGates.begin() + program.outStart[gate], program.outGates.begin() + program.outEnd[gate]);
+		}
+	}
+}
@@ -0,0 +1,203 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "graph_storage.hpp"
+
+// Evaluation of the circuit formed by the graph's nodes and wires.
+// Nothing here draws, so it can all run without a window.
+//
+// Each node is a gate whose output is computed from the nodes wired into it:
+// - Any: on if any input is on (OR)
+// - All: on if every input is on (AND)
+// - Non: on if no input is on (NOT/NOR)
+// - One: on if exactly one input is on (XOR for two inputs)
+// Gates with no inputs are *sources*. They keep whatever value they are given with SetInput,
+// and start out as a gate with no inputs would evaluate (so a Non source starts on and the rest start off).
+//
+// Feedback loops (latches, oscillators) are found as strongly connected components.
+// Each loop is evaluated over and over within a tick until it settles, or until it has had `maxLoopPasses` passes,
+// in which case it is oscillating and carries on from where it stopped next tick.
+namespace simulation
+{
+	using graph::NodeType;
+
+	// Index of a gate within a Netlist
+	using GateID = uint32_t;
+
+	constexpr GateID NULL_GATE = (GateID)(-1);
+
+	// A flat description of a circuit, independent of how it is drawn.
+	// Gate `g`'s inputs are `inputs[inputStart[g]]` through `inputs[inputStart[g + 1] - 1]`.
+	struct Netlist
+	{
+		std::vector<NodeType> types;
+		std::vector<uint32_t> inputStart = { 0 }; // numGates + 1 items
+		std::vector<GateID> inputs;
+
+		// The node each gate was built from - NULL_NODE for gates that weren't built from a node
+		std::vector<graph::NodeHandle> nodes;
+
+		// Optional. Position of each gate's strongly connected component in a topological order of the components,
+		// where gates in the same loop share a position. Compile finds the components itself if this is empty.
+		std::vector<uint32_t> sccOrder;
+	};
+
+	inline size_t NumGates(const Netlist& netlist)
+	{
+		return netlist.types.size();
+	}
+
+	GateID AddGate(Netlist& netlist, NodeType type, const GateID inputs[], size_t numInputs, graph::NodeHandle node = graph::NULL_NODE);
+
+	// One gate per node, numbered by node index, with an input for every wire -
+	// followed by the gates of every component instance on the board (see simulation_components.hpp).
+	void BuildNetlistFromGraph(Netlist& netlist);
+
+	// Every gate grouped by strongly connected component, with the components in evaluation order:
+	// component `c` is `sccGates[sccStart[c]]` through `sccGates[sccStart[c + 1] - 1]`.
+	// Uses `netlist.sccOrder` when it's filled in.
+	void GroupGatesByScc(const Netlist& netlist, std::vector<uint32_t>& sccStart, std::vector<GateID>& sccGates);
+
+	// A netlist compiled for evaluation.
+	// Gates are renumbered so that sources come first, followed by every other gate in the order it is evaluated.
+	// Instruction `i` always writes gate `numSources + i`, so instructions don't need to store where they write.
+	struct Instruction
+	{
+		NodeType type;
+		bool inLoop; // Whether the gate belongs to one of the program's Loops
+		uint32_t numInputs;
+		uint32_t firstInput; // Index into `operands`
+	};
+
+	// A run of gates that feed back into each other, numbered `first` through `end - 1`
+	struct Loop
+	{
+		GateID first;
+		GateID end;
+	};
+
+	enum class StepMode : char
+	{
+		Auto,  // Event-driven while few gates are changing, otherwise full sweeps
+		Sweep, // Evaluate every gate every tick
+		Event, // Only evaluate gates whose inputs changed
+	};
+
+	struct Program
+	{
+		uint32_t numGates = 0;
+		uint32_t numSources = 0;
+
+		// Type of each source, for Reset - sources have no instructions
+		std::vector<NodeType> sourceTypes;
+
+		// Evaluation order - each gate comes after all of its inputs, except for inputs from within its own loop.
+		std::vector<Instruction> code;
+
+		// Input gates of each instruction, already renumbered
+		std::vector<GateID> operands;
+
+		// Instructions of level `L` are `code[levelStart[L]]` through `code[levelStart[L + 1] - 1]`.
+		// Gates fed only by sources are level 0, and every other gate is one level above its highest input.
+		// All gates of a loop share a level, and only count inputs from outside the loop.
+		// (A patched program keeps these as they were laid out - see simulation_patch.hpp.)
+		std::vector<uint32_t> levelStart;
+
+		// In gate order
+		std::vector<Loop> loops;
+
+		// Passes a loop gets per tick to settle before it's treated as oscillating.
+		// Odd, so that a loop flipping every pass (like a Non wired to itself) still visibly flips every tick.
+		uint32_t maxLoopPasses = 63;
+
+		// Mapping between netlist gate IDs and the renumbered gates. Netlist gates that Compile merged share a gate,
+		// which maps back to the one it was simplified from.
+		std::vector<GateID> gateOfNetlistGate;
+		std::vector<GateID> netlistGateOfGate;
+
+		// Netlist gates Compile merged into another: single-input gates, which are only wires, and duplicates of another gate
+		uint32_t numWiresMerged = 0;
+		uint32_t numDuplicatesMerged = 0;
+		// Netlist gates Compile found could never change, and those no pin depends on - none of either with Pins::Every
+		uint32_t numConstantsFolded = 0;
+		uint32_t numUnusedRemoved = 0;
+
+		// Gates fed by each gate, renumbered: `outGates[outStart[g]]` through `outGates[outEnd[g] - 1]`.
+		// Compile packs them, so that `outEnd[g] == outStart[g + 1]`, but patching may move a gate's list elsewhere.
+		std::vector<uint32_t> outStart;
+		std::vector<uint32_t> outEnd;
+		std::vector<GateID> outGates;
+
+		// One bit per renumbered gate
+		std::vector<uint64_t> state;
+
+		uint64_t tick = 0;
+
+		StepMode mode = StepMode::Auto;
+
+		// Event-driven bookkeeping - see StepEvents
+
+		// Gates to evaluate this tick, one bit each. Scanned in gate order, which is evaluation order.
+		std::vector<uint64_t> scheduled;
+		// One bit per word of `scheduled`, set if the word may be nonzero
+		std::vector<uint64_t> scheduledWords;
+		// Gates to evaluate next tick - fed by a changed input, or in a loop that is still oscillating
+		std::vector<GateID> pending;
+		// Scratch for StepEvents: a loop's values from before it settled. Not a static, since partitions step on several threads at once.
+		std::vector<bool> loopBefore;
+
+		// Whether gates may disagree with their inputs without being pending, which only a sweep can fix
+		bool needsSweep = true;
+
+		// Number of gate evaluations the last tick needed, or would have needed, when event-driven
+		uint64_t activity = 0;
+		// Number of gates evaluated by the last tick
+		uint64_t evaluations = 0;
+	};
+
+	// Merges the gates that always have the same value as another first (see simulation_optimize.hpp), which changes nothing
+	// that can be seen through the netlist's gate IDs.
+	void Compile(const Netlist& netlist, Program& program);
+
+	// Compiles every gate of the netlist as it is
+	void CompileUnoptimized(const Netlist& netlist, Program& program);
+
+	// Logs how many gates a program from Compile has, and what became of the rest
+	void LogCompiled(const Program& program);
+
+	// What a gate outputs when nothing is wired into it
+	bool SourceDefault(NodeType type);
+
+	// Sets every source back to its starting value and turns every other gate off
+	void Reset(Program& program);
+
+	// Evaluates every gate once, in order
+	void StepSweep(Program& program);
+
+	// Evaluates only the gates with a changed input, in the same order StepSweep would have.
+	// Costs O(changed gates + their fan-out) rather than O(gates), plus a scan of one bit per 4096 gates.
+	void StepEvents(Program& program);
+
+	// Steps with StepSweep or StepEvents according to `program.mode`.
+	// In Auto mode the choice is made each tick from how many gates the last tick changed.
+	void Step(Program& program);
+
+	void Run(Program& program, uint64_t numTicks);
+
+	// Value of a netlist gate as of the last tick
+	bool GetOutput(const Program& program, GateID netlistGate);
+
+	// Only has an effect on sources. Takes effect on the next tick, in either mode.
+	void SetInput(Program& program, GateID netlistGate, bool value);
+
+	inline bool GetBit(const uint64_t* bits, size_t index)
+	{
+		return (bits[index / 64] >> (index % 64)) & 1;
+	}
+
+	inline void SetBit(uint64_t* bits, size_t index, bool value)
+	{
+		uint64_t mask = 1ull << (index % 64);
+		bits[index / 64] = (bits[index / 64] & ~mask) | (value ? mask : 0);
+	}
+}
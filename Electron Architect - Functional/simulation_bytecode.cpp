@@ -0,0 +1,497 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include "console_log.hpp"
+#include "simulation_bytecode.hpp"
+
+namespace simulation
+{
+	constexpr char BYTECODE_MAGIC[4] = { 'E', 'A', 'B', 'C' };
+	constexpr uint32_t BYTECODE_VERSION = 1;
+
+	// FNV-1a
+	void HashBytes(uint64_t& hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+		}
+	}
+
+	uint64_t HashNetlist(const Netlist& netlist)
+	{
+		uint64_t hash = 0xCBF29CE484222325ull;
+		HashBytes(hash, netlist.types.data(), netlist.types.size() * sizeof(NodeType));
+		HashBytes(hash, netlist.inputStart.data(), netlist.inputStart.size() * sizeof(uint32_t));
+		HashBytes(hash, netlist.inputs.data(), netlist.inputs.size() * sizeof(GateID));
+		return hash;
+	}
+
+	uint32_t OpWord(Op op, uint32_t count = 0)
+	{
+		return (uint32_t)op | (count << OP_COUNT_SHIFT);
+	}
+
+	void Lower(const Program& program, Bytecode& bytecode)
+	{
+		bytecode.numGates = program.numGates;
+		bytecode.numSources = program.numSources;
+		bytecode.maxLoopPasses = program.maxLoopPasses;
+		bytecode.maxLoopWords = 0;
+		bytecode.sourceTypes = program.sourceTypes;
+		bytecode.gateOfNetlistGate = program.gateOfNetlistGate;
+		bytecode.netlistGateOfGate = program.netlistGateOfGate;
+
+		std::vector<uint32_t>& code = bytecode.code;
+		code.clear();
+		code.reserve(program.code.size() + program.operands.size() + program.loops.size() * 5 + 1);
+
+		size_t nextLoop = 0;
+		size_t loopBodyStart = 0;
+		for (GateID gate = program.numSources; gate < program.numGates; ++gate)
+		{
+			if (nextLoop < program.loops.size() && program.loops[nextLoop].first == gate)
+			{
+				const Loop& loop = program.loops[nextLoop];
+				code.push_back(OpWord(Op::LoopBegin));
+				code.push_back(loop.first);
+				code.push_back(loop.end);
+				code.push_back(0); // Body size, once known
+				loopBodyStart = code.size();
+
+				uint32_t numWords = (loop.end - 1) / 64 - loop.first / 64 + 1;
+				bytecode.maxLoopWords = numWords > bytecode.maxLoopWords ? numWords : bytecode.maxLoopWords;
+			}
+
+			const Instruction& instruction = program.code[gate - program.numSources];
+			const GateID* inputs = program.operands.data() + instruction.firstInput;
+			switch (instruction.numInputs)
+			{
+			case 1:
+				code.push_back(OpWord(instruction.type == NodeType::Non ? Op::Not : Op::Buf));
+				break;
+
+			case 2:
+				switch (instruction.type)
+				{
+				case NodeType::Any: code.push_back(OpWord(Op::Any2)); break;
+				case NodeType::All: code.push_back(OpWord(Op::All2)); break;
+				case NodeType::One: code.push_back(OpWord(Op::One2)); break;
+				case NodeType::Non: code.push_back(OpWord(Op::Non2)); break;
+				}
+				break;
+
+			default:
+				switch (instruction.type)
+				{
+				case NodeType::Any: code.push_back(OpWord(Op::AnyN, instruction.numInputs)); break;
+				case NodeType::All: code.push_back(OpWord(Op::AllN, instruction.numInputs)); break;
+				case NodeType::One: code.push_back(OpWord(Op::OneN, instruction.numInputs)); break;
+				case NodeType::Non: code.push_back(OpWord(Op::NonN, instruction.numInputs)); break;
+				}
+				break;
+			}
+			code.insert(code.end(), inputs, inputs + instruction.numInputs);
+
+			if (nextLoop < program.loops.size() && program.loops[nextLoop].end == gate + 1)
+			{
+				code[loopBodyStart - 1] = (uint32_t)(code.size() - loopBodyStart);
+				code.push_back(OpWord(Op::LoopEnd));
+				++nextLoop;
+			}
+		}
+		code.push_back(OpWord(Op::Halt));
+	}
+
+	void ResetBytecode(const Bytecode& bytecode, BytecodeState& state)
+	{
+		state.bits.assign((bytecode.numGates + 63) / 64, 0);
+		state.loopSnapshot.resize(bytecode.maxLoopWords);
+		for (GateID g = 0; g < bytecode.numSources; ++g)
+		{
+			SetBit(state.bits.data(), g, bytecode.sourceTypes[g] == NodeType::Non);
+		}
+	}
+
+	void RunBytecode(const Bytecode& bytecode, BytecodeState& state)
+	{
+		uint64_t* bits = state.bits.data();
+		uint64_t* snapshot = state.loopSnapshot.data();
+		const uint32_t* pc = bytecode.code.data();
+		GateID out = bytecode.numSources;
+
+		// The loop being settled
+		const uint32_t* loopBody = nullptr;
+		GateID loopFirst = 0;
+		uint32_t loopFirstWord = 0;
+		uint32_t loopNumWords = 0;
+		uint32_t loopPasses = 0;
+
+		// Threaded dispatch where the compiler allows taking the address of a label; a switch everywhere else.
+#if defined(__GNUC__)
+		static const void* const labels[(size_t)Op::Count] = {
+			&&op_Halt, &&op_Buf, &&op_Not,
+			&&op_Any2, &&op_All2, &&op_One2, &&op_Non2,
+			&&op_AnyN, &&op_AllN, &&op_OneN, &&op_NonN,
+			&&op_LoopBegin, &&op_LoopEnd,
+		};
+#define OP(name) op_##name:
+#define NEXT() goto *labels[*pc & OP_MASK]
+		NEXT();
+#else
+#define OP(name) case Op::name:
+#define NEXT() continue
+		for (;;) switch ((Op)(*pc & OP_MASK))
+		{
+#endif
+		OP(Halt)
+		{
+			return;
+		}
+		OP(Buf)
+		{
+			SetBit(bits, out++, GetBit(bits, pc[1]));
+			pc += 2;
+			NEXT();
+		}
+		OP(Not)
+		{
+			SetBit(bits, out++, !GetBit(bits, pc[1]));
+			pc += 2;
+			NEXT();
+		}
+		OP(Any2)
+		{
+			SetBit(bits, out++, GetBit(bits, pc[1]) | GetBit(bits, pc[2]));
+			pc += 3;
+			NEXT();
+		}
+		OP(All2)
+		{
+			SetBit(bits, out++, GetBit(bits, pc[1]) & GetBit(bits, pc[2]));
+			pc += 3;
+			NEXT();
+		}
+		OP(One2)
+		{
+			SetBit(bits, out++, GetBit(bits, pc[1]) ^ GetBit(bits, pc[2]));
+			pc += 3;
+			NEXT();
+		}
+		OP(Non2)
+		{
+			SetBit(bits, out++, !(GetBit(bits, pc[1]) | GetBit(bits, pc[2])));
+			pc += 3;
+			NEXT();
+		}
+		OP(AnyN)
+		{
+			uint32_t count = *pc >> OP_COUNT_SHIFT;
+			bool value = false;
+			for (uint32_t i = 1; i <= count; ++i)
+			{
+				value |= GetBit(bits, pc[i]);
+			}
+			SetBit(bits, out++, value);
+			pc += 1 + count;
+			NEXT();
+		}
+		OP(AllN)
+		{
+			uint32_t count = *pc >> OP_COUNT_SHIFT;
+			bool value = count != 0;
+			for (uint32_t i = 1; i <= count; ++i)
+			{
+				value &= GetBit(bits, pc[i]);
+			}
+			SetBit(bits, out++, value);
+			pc += 1 + count;
+			NEXT();
+		}
+		OP(OneN)
+		{
+			uint32_t count = *pc >> OP_COUNT_SHIFT;
+			bool once = false;
+			bool twice = false;
+			for (uint32_t i = 1; i <= count; ++i)
+			{
+				bool value = GetBit(bits, pc[i]);
+				twice |= once & value;
+				once |= value;
+			}
+			SetBit(bits, out++, once & !twice);
+			pc += 1 + count;
+			NEXT();
+		}
+		OP(NonN)
+		{
+			uint32_t count = *pc >> OP_COUNT_SHIFT;
+			bool value = false;
+			for (uint32_t i = 1; i <= count; ++i)
+			{
+				value |= GetBit(bits, pc[i]);
+			}
+			SetBit(bits, out++, !value);
+			pc += 1 + count;
+			NEXT();
+		}
+		OP(LoopBegin)
+		{
+			loopFirst = pc[1];
+			loopFirstWord = loopFirst / 64;
+			loopNumWords = (pc[2] - 1) / 64 - loopFirstWord + 1;
+			loopPasses = 0;
+			memcpy(snapshot, bits + loopFirstWord, loopNumWords * sizeof(uint64_t));
+			loopBody = pc + 4;
+			pc = loopBody;
+			NEXT();
+		}
+		OP(LoopEnd)
+		{
+			// Whole words are compared, but gates outside the loop can't change while it runs
+			if (++loopPasses < bytecode.maxLoopPasses && memcmp(snapshot, bits + loopFirstWord, loopNumWords * sizeof(uint64_t)) != 0)
+			{
+				memcpy(snapshot, bits + loopFirstWord, loopNumWords * sizeof(uint64_t));
+				out = loopFirst;
+				pc = loopBody;
+			}
+			else
+			{
+				pc += 1;
+			}
+			NEXT();
+		}
+#if !defined(__GNUC__)
+		default:
+			return;
+		}
+#endif
+#undef OP
+#undef NEXT
+	}
+
+	bool GetOutput(const Bytecode& bytecode, const BytecodeState& state, GateID netlistGate)
+	{
+		return GetBit(state.bits.data(), bytecode.gateOfNetlistGate[netlistGate]);
+	}
+
+	void SetInput(const Bytecode& bytecode, BytecodeState& state, GateID netlistGate, bool value)
+	{
+		GateID gate = bytecode.gateOfNetlistGate[netlistGate];
+		if (gate < bytecode.numSources && bytecode.netlistGateOfGate[gate] == netlistGate)
+		{
+			SetBit(state.bits.data(), gate, value);
+		}
+	}
+
+	std::string BytecodePath(const char* graphFilename)
+	{
+		return std::string(graphFilename) + ".bc";
+	}
+
+	template<typename T> void WriteValue(std::ofstream& file, const T& value)
+	{
+		file.write((const char*)&value, sizeof(T));
+	}
+
+	template<typename T> void WriteArray(std::ofstream& file, const std::vector<T>& values)
+	{
+		WriteValue(file, (uint64_t)values.size());
+		file.write((const char*)values.data(), values.size() * sizeof(T));
+	}
+
+	template<typename T> bool ReadValue(std::ifstream& file, T& value)
+	{
+		return (bool)file.read((char*)&value, sizeof(T));
+	}
+
+	template<typename T> bool ReadArray(std::ifstream& file, std::vector<T>& values)
+	{
+		uint64_t size;
+		if (!ReadValue(file, size) || size > (1ull << 32))
+		{
+			return false;
+		}
+		values.resize((size_t)size);
+		return (bool)file.read((char*)values.data(), values.size() * sizeof(T));
+	}
+
+	bool SaveBytecode(const Bytecode& bytecode, const char* filename)
+	{
+		std::ofstream file(filename, std::ios::binary);
+		if (!file)
+		{
+			console::Errorf("simulation: Could not write \"%s\".", filename);
+			return false;
+		}
+		file.write(BYTECODE_MAGIC, sizeof(BYTECODE_MAGIC));
+		WriteValue(file, BYTECODE_VERSION);
+		WriteValue(file, bytecode.numGates);
+		WriteValue(file, bytecode.numSources);
+		WriteValue(file, bytecode.maxLoopPasses);
+		WriteValue(file, bytecode.maxLoopWords);
+		WriteValue(file, bytecode.netlistHash);
+		WriteArray(file, bytecode.code);
+		WriteArray(file, bytecode.sourceTypes);
+		WriteArray(file, bytecode.gateOfNetlistGate);
+		WriteArray(file, bytecode.netlistGateOfGate);
+		return (bool)file;
+	}
+
+	// Walks the code once the way RunBytecode would, without running it:
+	// every op is known, every operand is a gate, every gate is written in order, and every loop fits within what's left of the code.
+	bool IsCodeValid(const Bytecode& bytecode)
+	{
+		const std::vector<uint32_t>& code = bytecode.code;
+		GateID out = bytecode.numSources;
+		size_t loopBodyEnd = 0;
+		GateID loopEnd = 0;
+		bool inLoop = false;
+
+		size_t pc = 0;
+		while (pc < code.size())
+		{
+			Op op = (Op)(code[pc] & OP_MASK);
+			size_t numInputs;
+			switch (op)
+			{
+			case Op::Halt:
+				return pc == code.size() - 1 && !inLoop && out == bytecode.numGates;
+
+			case Op::Buf: case Op::Not:
+				numInputs = 1;
+				break;
+
+			case Op::Any2: case Op::All2: case Op::One2: case Op::Non2:
+				numInputs = 2;
+				break;
+
+			case Op::AnyN: case Op::AllN: case Op::OneN: case Op::NonN:
+				numInputs = code[pc] >> OP_COUNT_SHIFT;
+				break;
+
+			case Op::LoopBegin:
+			{
+				if (inLoop || code.size() - pc < 4)
+				{
+					return false;
+				}
+				GateID first = code[pc + 1];
+				GateID end = code[pc + 2];
+				uint32_t bodySize = code[pc + 3];
+				pc += 4;
+				// The body is followed by at least its LoopEnd and the Halt
+				if (first != out || end <= first || end > bytecode.numGates || pc + bodySize + 2 > code.size() ||
+					(end - 1) / 64 - first / 64 + 1 > bytecode.maxLoopWords)
+				{
+					return false;
+				}
+				inLoop = true;
+				loopBodyEnd = pc + bodySize;
+				loopEnd = end;
+				continue;
+			}
+
+			case Op::LoopEnd:
+				if (!inLoop || pc != loopBodyEnd || out != loopEnd)
+				{
+					return false;
+				}
+				inLoop = false;
+				pc += 1;
+				continue;
+
+			default:
+				return false;
+			}
+
+			if (out >= bytecode.numGates || code.size() - pc - 1 < numInputs)
+			{
+				return false;
+			}
+			for (size_t i = 1; i <= numInputs; ++i)
+			{
+				if (code[pc + i] >= bytecode.numGates)
+				{
+					return false;
+				}
+			}
+			++out;
+			pc += 1 + numInputs;
+		}
+		return false;
+	}
+
+	bool LoadBytecode(Bytecode& bytecode, const char* filename)
+	{
+		std::ifstream file(filename, std::ios::binary);
+		if (!file)
+		{
+			return false;
+		}
+		char magic[sizeof(BYTECODE_MAGIC)];
+		uint32_t version;
+		if (!file.read(magic, sizeof(magic)) || memcmp(magic, BYTECODE_MAGIC, sizeof(magic)) != 0 ||
+			!ReadValue(file, version) || version != BYTECODE_VERSION)
+		{
+			return false;
+		}
+		bool ok =
+			ReadValue(file, bytecode.numGates) &&
+			ReadValue(file, bytecode.numSources) &&
+			ReadValue(file, bytecode.maxLoopPasses) &&
+			ReadValue(file, bytecode.maxLoopWords) &&
+			ReadValue(file, bytecode.netlistHash) &&
+			ReadArray(file, bytecode.code) &&
+			ReadArray(file, bytecode.sourceTypes) &&
+			ReadArray(file, bytecode.gateOfNetlistGate) &&
+			ReadArray(file, bytecode.netlistGateOfGate);
+
+		// The interpreter trusts the code completely, so anything it could read or write out of bounds is rejected here.
+		// Merged netlist gates share a gate, so there can be more netlist gates than gates.
+		return ok &&
+			bytecode.numSources <= bytecode.numGates &&
+			bytecode.sourceTypes.size() == bytecode.numSources &&
+			bytecode.netlistGateOfGate.size() == bytecode.numGates &&
+			std::all_of(bytecode.gateOfNetlistGate.begin(), bytecode.gateOfNetlistGate.end(),
+				[&](GateID gate) { return gate < bytecode.numGates; }) &&
+			IsCodeValid(bytecode);
+	}
+
+	void SaveGraphAndBytecode(const char* graphFilename)
+	{
+		graph::Save(graphFilename);
+
+		Netlist netlist;
+		Program program;
+		Bytecode bytecode;
+		BuildNetlistFromGraph(netlist);
+		Compile(netlist, program);
+		LogCompiled(program);
+		Lower(program, bytecode);
+		bytecode.netlistHash = HashNetlist(netlist);
+		SaveBytecode(bytecode, BytecodePath(graphFilename).c_str());
+	}
+
+	bool LoadGraphAndBytecode(const char* graphFilename, Bytecode& bytecode)
+	{
+		graph::Load(graphFilename);
+
+		Netlist netlist;
+		BuildNetlistFromGraph(netlist);
+		uint64_t hash = HashNetlist(netlist);
+		if (LoadBytecode(bytecode, BytecodePath(graphFilename).c_str()) && bytecode.netlistHash == hash)
+		{
+			return true;
+		}
+
+		console::Logf("simulation: Saved bytecode for \"%s\" is missing or out of date. Recompiling.", graphFilename);
+		Program program;
+		Compile(netlist, program);
+		LogCompiled(program);
+		Lower(program, bytecode);
+		bytecode.netlistHash = hash;
+		return false;
+	}
+}
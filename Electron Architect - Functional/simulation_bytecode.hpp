@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "simulation.hpp"
+
+// A compiled program lowered to a flat stream of 32-bit words, run by a threaded interpreter.
+// Each gate is one op word followed by its inputs inline, so a tick reads the code front to back with no indirection.
+// Compact enough to save next to the graph, so that a large design can skip compiling at startup.
+namespace simulation
+{
+	enum class Op : uint32_t
+	{
+		Halt,
+
+		// One input, of any type but Non
+		Buf,
+		// One input, Non
+		Not,
+
+		Any2,
+		All2,
+		One2,
+		Non2,
+
+		// Input count in the upper bits of the op word
+		AnyN,
+		AllN,
+		OneN,
+		NonN,
+
+		// Followed by the loop's first gate, its end gate, and the number of words in its body.
+		// The body runs until a pass leaves its gates unchanged, or it has run `maxLoopPasses` times.
+		LoopBegin,
+		LoopEnd,
+
+		Count
+	};
+
+	constexpr uint32_t OP_MASK = 0xFF;
+	constexpr uint32_t OP_COUNT_SHIFT = 8;
+
+	struct Bytecode
+	{
+		uint32_t numGates = 0;
+		uint32_t numSources = 0;
+		uint32_t maxLoopPasses = 0;
+
+		// Most state words a loop spans, for the interpreter's scratch space
+		uint32_t maxLoopWords = 0;
+
+		std::vector<uint32_t> code;
+
+		// As in Program
+		std::vector<NodeType> sourceTypes;
+		std::vector<GateID> gateOfNetlistGate;
+		std::vector<GateID> netlistGateOfGate;
+
+		// HashNetlist of the netlist it was compiled from, to tell whether a saved copy is stale
+		uint64_t netlistHash = 0;
+	};
+
+	struct BytecodeState
+	{
+		// One bit per gate, numbered like the Program the bytecode was lowered from
+		std::vector<uint64_t> bits;
+
+		// The gates of the loop being settled, as of the start of its last pass
+		std::vector<uint64_t> loopSnapshot;
+	};
+
+	// Identifies a netlist's gate types and wiring (not its node handles)
+	uint64_t HashNetlist(const Netlist& netlist);
+
+	// Leaves `netlistHash` for the caller, which has the netlist
+	void Lower(const Program& program, Bytecode& bytecode);
+
+	// Sets every source back to its starting value and turns every other gate off
+	void ResetBytecode(const Bytecode& bytecode, BytecodeState& state);
+
+	// Evaluates every gate once, in order - the same as StepSweep
+	void RunBytecode(const Bytecode& bytecode, BytecodeState& state);
+
+	bool GetOutput(const Bytecode& bytecode, const BytecodeState& state, GateID netlistGate);
+
+	// Only has an effect on sources
+	void SetInput(const Bytecode& bytecode, BytecodeState& state, GateID netlistGate, bool value);
+
+	// Where the bytecode for a graph file is kept: the same path, with ".bc" appended
+	std::string BytecodePath(const char* graphFilename);
+
+	bool SaveBytecode(const Bytecode& bytecode, const char* filename);
+
+	// Fails if the file is missing, malformed, or was made by a different version
+	bool LoadBytecode(Bytecode& bytecode, const char* filename);
+
+	// Saves the graph, then lowers it and saves its bytecode alongside
+	void SaveGraphAndBytecode(const char* graphFilename);
+
+	// Loads the graph, then its saved bytecode if that is still up to date; otherwise compiles it afresh.
+	// Returns whether the saved bytecode was used.
+	bool LoadGraphAndBytecode(const char* graphFilename, Bytecode& bytecode);
+}
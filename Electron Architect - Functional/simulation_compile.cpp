@@ -0,0 +1,403 @@
+#include <algorithm>
+#include "graph_adjacency.hpp"
+#include "console_log.hpp"
+#include "graph_scc.hpp"
+#include "simulation_components.hpp"
+#include "simulation_optimize.hpp"
+#include "simulation.hpp"
+
+namespace simulation
+{
+	GateID AddGate(Netlist& netlist, NodeType type, const GateID inputs[], size_t numInputs, graph::NodeHandle node)
+	{
+		GateID gate = (GateID)netlist.types.size();
+		netlist.types.push_back(type);
+		netlist.inputs.insert(netlist.inputs.end(), inputs, inputs + numInputs);
+		netlist.inputStart.push_back((uint32_t)netlist.inputs.size());
+		netlist.nodes.push_back(node);
+		return gate;
+	}
+
+	void BuildNetlistFromGraph(Netlist& netlist)
+	{
+		graph::WireGraphCSR csr;
+		graph::BuildWireGraphCSR(csr);
+
+		netlist.types.resize(graph::numNodes);
+		netlist.nodes.resize(graph::numNodes);
+		for (size_t i = 0; i < graph::numNodes; ++i)
+		{
+			netlist.types[i] = At(graph::nodeType, i);
+			netlist.nodes[i] = At(graph::nodeHandles, i);
+		}
+		// Node indices are already dense, so the CSR fan-in is the netlist as-is
+		netlist.inputStart = std::move(csr.inStart);
+		netlist.inputs = std::move(csr.inNodes);
+
+		// The graph keeps its loops up to date as it's edited, so Compile doesn't need to find them again
+		netlist.sccOrder.resize(graph::numNodes);
+		for (size_t i = 0; i < graph::numNodes; ++i)
+		{
+			netlist.sccOrder[i] = graph::NodeSccOrder(netlist.nodes[i]);
+		}
+
+		if (graph::instances.empty())
+		{
+			return;
+		}
+		std::vector<std::pair<GateID, GateID>> extraInputs;
+		std::vector<GateID> portGates;
+		for (const graph::ComponentInstance& instance : graph::instances)
+		{
+			portGates.resize(instance.ports.size());
+			for (size_t i = 0; i < instance.ports.size(); ++i)
+			{
+				portGates[i] = graph::IsNodeValid(instance.ports[i]) ? (GateID)graph::NodeIndex(instance.ports[i]) : NULL_GATE;
+			}
+			AppendInstance(netlist, instance.definition, portGates.data(), extraInputs);
+		}
+		AddInputs(netlist, extraInputs);
+
+		// The graph's loops don't know about the wires through instances
+		netlist.sccOrder.clear();
+	}
+
+	// Tarjan's algorithm, following inputs rather than outputs so that components come out in evaluation order.
+	// Fills `sccGates` with every gate grouped by component, with each component's gates in netlist order,
+	// and `sccStart` with where each component begins.
+	void FindSccs(const Netlist& netlist, std::vector<uint32_t>& sccStart, std::vector<GateID>& sccGates)
+	{
+		const uint32_t n = (uint32_t)NumGates(netlist);
+		constexpr uint32_t UNVISITED = (uint32_t)(-1);
+
+		struct Frame
+		{
+			GateID gate;
+			uint32_t nextInput;
+		};
+
+		std::vector<uint32_t> index(n, UNVISITED);
+		std::vector<uint32_t> lowLink(n);
+		std::vector<bool> onStack(n, false);
+		std::vector<GateID> stack;
+		std::vector<Frame> frames;
+		uint32_t nextIndex = 0;
+
+		sccStart.clear();
+		sccGates.clear();
+		sccGates.reserve(n);
+
+		for (GateID root = 0; root < n; ++root)
+		{
+			if (index[root] != UNVISITED)
+			{
+				continue;
+			}
+			index[root] = lowLink[root] = nextIndex++;
+			stack.push_back(root);
+			onStack[root] = true;
+			frames.push_back({ root, netlist.inputStart[root] });
+
+			while (!frames.empty())
+			{
+				Frame& frame = frames.back();
+				GateID gate = frame.gate;
+				if (frame.nextInput < netlist.inputStart[gate + 1])
+				{
+					GateID input = netlist.inputs[frame.nextInput++];
+					if (index[input] == UNVISITED)
+					{
+						index[input] = lowLink[input] = nextIndex++;
+						stack.push_back(input);
+						onStack[input] = true;
+						frames.push_back({ input, netlist.inputStart[input] }); // Invalidates `frame`
+					}
+					else if (onStack[input] && index[input] < lowLink[gate])
+					{
+						lowLink[gate] = index[input];
+					}
+					continue;
+				}
+
+				frames.pop_back();
+				if (!frames.empty() && lowLink[gate] < lowLink[frames.back().gate])
+				{
+					lowLink[frames.back().gate] = lowLink[gate];
+				}
+				if (lowLink[gate] == index[gate])
+				{
+					size_t start = sccGates.size();
+					GateID member;
+					do
+					{
+						member = stack.back();
+						stack.pop_back();
+						onStack[member] = false;
+						sccGates.push_back(member);
+					} while (member != gate);
+					std::sort(sccGates.begin() + start, sccGates.end());
+					sccStart.push_back((uint32_t)start);
+				}
+			}
+		}
+		sccStart.push_back(n);
+	}
+
+	// Groups gates by a topological order of components someone else already found
+	void GroupBySccOrder(const Netlist& netlist, std::vector<uint32_t>& sccStart, std::vector<GateID>& sccGates)
+	{
+		const uint32_t n = (uint32_t)NumGates(netlist);
+		uint32_t numPositions = 0;
+		for (uint32_t position : netlist.sccOrder)
+		{
+			numPositions = position + 1 > numPositions ? position + 1 : numPositions;
+		}
+
+		std::vector<uint32_t> positionStart(numPositions + 1, 0);
+		for (uint32_t position : netlist.sccOrder)
+		{
+			++positionStart[position + 1];
+		}
+		for (uint32_t p = 0; p < numPositions; ++p)
+		{
+			positionStart[p + 1] += positionStart[p];
+		}
+		sccGates.resize(n);
+		std::vector<uint32_t> cursor(positionStart.begin(), positionStart.end() - 1);
+		for (GateID g = 0; g < n; ++g)
+		{
+			sccGates[cursor[netlist.sccOrder[g]]++] = g;
+		}
+
+		sccStart.clear();
+		for (uint32_t p = 0; p < numPositions; ++p)
+		{
+			if (positionStart[p] != positionStart[p + 1])
+			{
+				sccStart.push_back(positionStart[p]);
+			}
+		}
+		sccStart.push_back(n);
+	}
+
+	void GroupGatesByScc(const Netlist& netlist, std::vector<uint32_t>& sccStart, std::vector<GateID>& sccGates)
+	{
+		if (netlist.sccOrder.size() == NumGates(netlist) && NumGates(netlist) != 0)
+		{
+			GroupBySccOrder(netlist, sccStart, sccGates);
+		}
+		else
+		{
+			FindSccs(netlist, sccStart, sccGates);
+		}
+	}
+
+	void CompileUnoptimized(const Netlist& netlist, Program& program)
+	{
+		const uint32_t n = (uint32_t)NumGates(netlist);
+
+		std::vector<uint32_t> sccStart;
+		std::vector<GateID> sccGates;
+		GroupGatesByScc(netlist, sccStart, sccGates);
+		const uint32_t numSccs = (uint32_t)sccStart.size() - 1;
+
+		// Levelize the components, which are already in topological order.
+		// A component's gates only count inputs from outside of it.
+		std::vector<uint32_t> sccOfGate(n);
+		for (uint32_t c = 0; c < numSccs; ++c)
+		{
+			for (uint32_t i = sccStart[c]; i < sccStart[c + 1]; ++i)
+			{
+				sccOfGate[sccGates[i]] = c;
+			}
+		}
+		std::vector<uint32_t> sccLevel(numSccs, 0);
+		std::vector<bool> sccIsLoop(numSccs, false);
+		uint32_t numSources = 0;
+		uint32_t numLevels = 1; // Level 0 only holds sources
+		for (uint32_t c = 0; c < numSccs; ++c)
+		{
+			uint32_t level = 0;
+			bool isSource = true;
+			for (uint32_t i = sccStart[c]; i < sccStart[c + 1]; ++i)
+			{
+				GateID g = sccGates[i];
+				for (uint32_t j = netlist.inputStart[g]; j < netlist.inputStart[g + 1]; ++j)
+				{
+					isSource = false;
+					uint32_t inputScc = sccOfGate[netlist.inputs[j]];
+					if (inputScc == c)
+					{
+						sccIsLoop[c] = true;
+					}
+					else if (level < sccLevel[inputScc])
+					{
+						level = sccLevel[inputScc];
+					}
+				}
+			}
+			if (isSource)
+			{
+				++numSources;
+				continue;
+			}
+			sccLevel[c] = level + 1;
+			numLevels = sccLevel[c] + 1 > numLevels ? sccLevel[c] + 1 : numLevels;
+		}
+
+		// Counting sort by level - stable, so components stay contiguous and in topological order
+		std::vector<uint32_t> levelStart(numLevels + 1, 0);
+		for (uint32_t c = 0; c < numSccs; ++c)
+		{
+			levelStart[sccLevel[c] + 1] += sccStart[c + 1] - sccStart[c];
+		}
+		for (size_t l = 1; l < levelStart.size(); ++l)
+		{
+			levelStart[l] += levelStart[l - 1];
+		}
+
+		program.numGates = n;
+		program.numSources = numSources;
+		program.gateOfNetlistGate.assign(n, NULL_GATE);
+		program.netlistGateOfGate.assign(n, NULL_GATE);
+		program.loops.clear();
+		{
+			std::vector<uint32_t> cursor(levelStart.begin(), levelStart.end() - 1);
+			for (uint32_t c = 0; c < numSccs; ++c)
+			{
+				GateID first = cursor[sccLevel[c]];
+				for (uint32_t i = sccStart[c]; i < sccStart[c + 1]; ++i)
+				{
+					GateID renumbered = cursor[sccLevel[c]]++;
+					program.gateOfNetlistGate[sccGates[i]] = renumbered;
+					program.netlistGateOfGate[renumbered] = sccGates[i];
+				}
+				if (sccIsLoop[c])
+				{
+					program.loops.push_back({ first, cursor[sccLevel[c]] });
+				}
+			}
+		}
+		std::sort(program.loops.begin(), program.loops.end(), [](const Loop& a, const Loop& b) { return a.first < b.first; });
+
+		// Level 0 is the sources, which aren't instructions
+		program.levelStart.resize(levelStart.size() - 1);
+		for (size_t l = 1; l < levelStart.size(); ++l)
+		{
+			program.levelStart[l - 1] = levelStart[l] - numSources;
+		}
+
+		program.sourceTypes.resize(numSources);
+		for (GateID renumbered = 0; renumbered < numSources; ++renumbered)
+		{
+			program.sourceTypes[renumbered] = netlist.types[program.netlistGateOfGate[renumbered]];
+		}
+
+		program.code.resize(n - numSources);
+		program.operands.clear();
+		program.operands.reserve(netlist.inputs.size());
+		for (GateID renumbered = numSources; renumbered < n; ++renumbered)
+		{
+			GateID g = program.netlistGateOfGate[renumbered];
+			Instruction& instruction = program.code[renumbered - numSources];
+			instruction.type = netlist.types[g];
+			instruction.inLoop = false;
+			instruction.firstInput = (uint32_t)program.operands.size();
+			instruction.numInputs = netlist.inputStart[g + 1] - netlist.inputStart[g];
+			for (uint32_t i = netlist.inputStart[g]; i < netlist.inputStart[g + 1]; ++i)
+			{
+				program.operands.push_back(program.gateOfNetlistGate[netlist.inputs[i]]);
+			}
+		}
+		for (const Loop& loop : program.loops)
+		{
+			for (GateID g = loop.first; g < loop.end; ++g)
+			{
+				program.code[g - numSources].inLoop = true;
+			}
+		}
+
+		program.outStart.assign(n + 1, 0);
+		for (GateID input : program.operands)
+		{
+			++program.outStart[input + 1];
+		}
+		for (GateID g = 0; g < n; ++g)
+		{
+			program.outStart[g + 1] += program.outStart[g];
+		}
+		program.outEnd.assign(program.outStart.begin() + 1, program.outStart.end());
+		program.outGates.resize(program.operands.size());
+		{
+			std::vector<uint32_t> cursor(program.outStart.begin(), program.outStart.end() - 1);
+			for (uint32_t i = 0; i < program.code.size(); ++i)
+			{
+				const Instruction& instruction = program.code[i];
+				for (uint32_t j = 0; j < instruction.numInputs; ++j)
+				{
+					program.outGates[cursor[program.operands[instruction.firstInput + j]]++] = numSources + i;
+				}
+			}
+		}
+
+		program.numWiresMerged = 0;
+		program.numDuplicatesMerged = 0;
+		program.numConstantsFolded = 0;
+		program.numUnusedRemoved = 0;
+
+		program.state.assign((n + 63) / 64, 0);
+		program.scheduled.assign((n + 63) / 64, 0);
+		program.scheduledWords.assign((program.scheduled.size() + 63) / 64, 0);
+		Reset(program);
+	}
+
+	// Compiles an optimized netlist in place of the one it was optimized from
+	void CompileOptimized(const Netlist& netlist, const Optimized& optimized, Program& program)
+	{
+		CompileUnoptimized(optimized.netlist, program);
+
+		// Map through the optimization, so that the netlist's gate IDs still work
+		std::vector<GateID> gateOfOptimizedGate;
+		gateOfOptimizedGate.swap(program.gateOfNetlistGate);
+		program.gateOfNetlistGate.resize(NumGates(netlist));
+		for (GateID g = 0; g < NumGates(netlist); ++g)
+		{
+			GateID optimizedGate = optimized.gateOfOriginal[g];
+			program.gateOfNetlistGate[g] = optimizedGate == NULL_GATE ? NULL_GATE : gateOfOptimizedGate[optimizedGate];
+		}
+		for (GateID& g : program.netlistGateOfGate)
+		{
+			g = optimized.originalOfGate[g];
+		}
+		program.numWiresMerged = optimized.numWires;
+		program.numDuplicatesMerged = optimized.numDuplicates;
+		program.numConstantsFolded = optimized.numConstant;
+		program.numUnusedRemoved = optimized.numUnused;
+	}
+
+	void Compile(const Netlist& netlist, Program& program)
+	{
+		Compile(netlist, Pins::Every, program);
+	}
+
+	void Compile(const Netlist& netlist, Pins pins, Program& program)
+	{
+		Optimized optimized;
+		Optimize(netlist, pins, optimized);
+		CompileOptimized(netlist, optimized, program);
+	}
+
+	void Compile(const Netlist& netlist, const std::vector<GateID>& inputs, const std::vector<GateID>& outputs, Program& program)
+	{
+		Optimized optimized;
+		Optimize(netlist, inputs, outputs, optimized);
+		CompileOptimized(netlist, optimized, program);
+	}
+
+	void LogCompiled(const Program& program)
+	{
+		console::Logf("simulation: Compiled %zu gates into %u (%u merged as wires, %u as duplicates, %u folded to constants, %u unused).",
+			program.gateOfNetlistGate.size(), program.numGates, program.numWiresMerged, program.numDuplicatesMerged,
+			program.numConstantsFolded, program.numUnusedRemoved);
+	}
+}
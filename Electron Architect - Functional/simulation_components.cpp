@@ -0,0 +1,132 @@
+#include "simulation_components.hpp"
+
+namespace simulation
+{
+	// Flattened definitions, by ID, as of graph::definitionsVersion `flattenedVersion`
+	std::vector<Netlist> flatDefinitions;
+	std::vector<bool> isDefinitionFlattened;
+	uint64_t flattenedVersion = (uint64_t)(-1);
+
+	const Netlist& FlattenDefinition(graph::DefinitionID id)
+	{
+		if (flattenedVersion != graph::definitionsVersion)
+		{
+			flatDefinitions.assign(graph::definitions.size(), {});
+			isDefinitionFlattened.assign(graph::definitions.size(), false);
+			flattenedVersion = graph::definitionsVersion;
+		}
+		Netlist& netlist = flatDefinitions[id];
+		if (isDefinitionFlattened[id])
+		{
+			return netlist;
+		}
+
+		const graph::ComponentDefinition& definition = graph::definitions[id];
+		const size_t numNodes = definition.nodeTypes.size();
+		netlist.types = definition.nodeTypes;
+		netlist.nodes.assign(numNodes, graph::NULL_NODE);
+		netlist.inputStart.assign(numNodes + 1, 0);
+		netlist.inputs.resize(definition.wires.size());
+		for (const graph::LocalWire& wire : definition.wires)
+		{
+			++netlist.inputStart[wire.endNode + 1];
+		}
+		for (size_t i = 0; i < numNodes; ++i)
+		{
+			netlist.inputStart[i + 1] += netlist.inputStart[i];
+		}
+		std::vector<uint32_t> cursor(netlist.inputStart.begin(), netlist.inputStart.end() - 1);
+		for (const graph::LocalWire& wire : definition.wires)
+		{
+			netlist.inputs[cursor[wire.endNode]++] = wire.startNode;
+		}
+
+		// Nested definitions are always older, so they're never this one - and each is flattened once, however deep
+		std::vector<std::pair<GateID, GateID>> extraInputs;
+		std::vector<GateID> portGates;
+		for (const graph::ComponentInstance& instance : definition.instances)
+		{
+			portGates.assign(instance.ports.begin(), instance.ports.end()); // Node indices of this definition are its gates
+			AppendInstance(netlist, instance.definition, portGates.data(), extraInputs);
+		}
+		AddInputs(netlist, extraInputs);
+
+		isDefinitionFlattened[id] = true;
+		return netlist;
+	}
+
+	void AppendInstance(Netlist& netlist, graph::DefinitionID definition, const GateID portGates[],
+		std::vector<std::pair<GateID, GateID>>& extraInputs)
+	{
+		const Netlist& flat = FlattenDefinition(definition);
+		const GateID base = (GateID)NumGates(netlist);
+		const uint32_t inputBase = (uint32_t)netlist.inputs.size();
+
+		netlist.types.insert(netlist.types.end(), flat.types.begin(), flat.types.end());
+		netlist.nodes.insert(netlist.nodes.end(), NumGates(flat), graph::NULL_NODE);
+		for (size_t g = 1; g < flat.inputStart.size(); ++g)
+		{
+			netlist.inputStart.push_back(inputBase + flat.inputStart[g]);
+		}
+		for (GateID input : flat.inputs)
+		{
+			netlist.inputs.push_back(base + input);
+		}
+
+		// Ports are nodes of the definition, so they're also its first gates
+		const graph::ComponentDefinition& placed = graph::definitions[definition];
+		for (size_t i = 0; i < placed.inputs.size(); ++i)
+		{
+			if (portGates[i] != NULL_GATE)
+			{
+				extraInputs.push_back({ base + placed.inputs[i], portGates[i] });
+			}
+		}
+		for (size_t i = 0; i < placed.outputs.size(); ++i)
+		{
+			GateID bound = portGates[placed.inputs.size() + i];
+			if (bound != NULL_GATE)
+			{
+				extraInputs.push_back({ bound, base + placed.outputs[i] });
+			}
+		}
+	}
+
+	void AddInputs(Netlist& netlist, const std::vector<std::pair<GateID, GateID>>& extraInputs)
+	{
+		if (extraInputs.empty())
+		{
+			return;
+		}
+		const size_t n = NumGates(netlist);
+		std::vector<uint32_t> inputStart(n + 1, 0);
+		for (size_t g = 0; g < n; ++g)
+		{
+			inputStart[g + 1] = netlist.inputStart[g + 1] - netlist.inputStart[g];
+		}
+		for (const std::pair<GateID, GateID>& extra : extraInputs)
+		{
+			++inputStart[extra.first + 1];
+		}
+		for (size_t g = 0; g < n; ++g)
+		{
+			inputStart[g + 1] += inputStart[g];
+		}
+
+		std::vector<GateID> inputs(inputStart[n]);
+		std::vector<uint32_t> cursor(inputStart.begin(), inputStart.end() - 1);
+		for (size_t g = 0; g < n; ++g)
+		{
+			for (uint32_t i = netlist.inputStart[g]; i < netlist.inputStart[g + 1]; ++i)
+			{
+				inputs[cursor[g]++] = netlist.inputs[i];
+			}
+		}
+		for (const std::pair<GateID, GateID>& extra : extraInputs)
+		{
+			inputs[cursor[extra.first]++] = extra.second;
+		}
+		netlist.inputStart = std::move(inputStart);
+		netlist.inputs = std::move(inputs);
+	}
+}
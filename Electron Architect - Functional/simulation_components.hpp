@@ -0,0 +1,25 @@
+#pragma once
+#include <utility>
+#include <vector>
+#include "graph_components.hpp"
+#include "simulation.hpp"
+
+// Flattening component instances into gates.
+// Each definition is flattened the first time it's needed - instances within it included - into a netlist of its own,
+// which is kept until the definitions change. Flattening an instance is then only a copy of that netlist with its gates offset,
+// so however many instances there are, each definition is only ever walked once.
+namespace simulation
+{
+	// The definition's nodes first, by index within the definition, followed by the gates of its instances.
+	// Flattened along with every definition within it, if it hasn't been since the definitions last changed.
+	const Netlist& FlattenDefinition(graph::DefinitionID definition);
+
+	// Appends a copy of the definition's flattened netlist, and adds the wires to and from its ports to `extraInputs`
+	// as (gate, input) pairs - for AddInputs, once every instance is appended.
+	// `portGates` is the gate each port is bound to, inputs first and then outputs; NULL_GATE if unbound.
+	void AppendInstance(Netlist& netlist, graph::DefinitionID definition, const GateID portGates[],
+		std::vector<std::pair<GateID, GateID>>& extraInputs);
+
+	// Adds inputs to gates already in the netlist, in O(gates + inputs)
+	void AddInputs(Netlist& netlist, const std::vector<std::pair<GateID, GateID>>& extraInputs);
+}
@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include "console_log.hpp"
+#include "simulation_lanes.hpp"
+#include "simulation_optimize.hpp"
+#include "simulation_truth_table.hpp"
+#include "workers.hpp"
+#include "simulation_equivalence.hpp"
+
+namespace simulation
+{
+	// Blocks dealt out to the pool at a time, which bounds how many jobs are queued at once
+	constexpr uint64_t EQUIVALENCE_BATCH_BLOCKS = 4096;
+
+	// Blocks per job, so that each job is worth handing to another thread
+	constexpr uint64_t EQUIVALENCE_JOB_BLOCKS = 64;
+
+	// Both parts being compared, compiled, with their pins in matching order
+	struct EquivalencePair
+	{
+		Program programs[2];
+		std::vector<GateID> inputGates[2];
+		std::vector<GateID> outputGates[2];
+	};
+
+	// SplitMix64's finalizer
+	uint64_t MixBits(uint64_t x)
+	{
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+		return x ^ (x >> 31);
+	}
+
+	// Values of `input` across the lanes of block `block`. Only depends on its arguments,
+	// so the vectors tried don't depend on which thread evaluates which block.
+	Lanes RandomLanes(uint64_t seed, uint64_t block, size_t numInputs, size_t input)
+	{
+		uint64_t words[LANE_WORDS];
+		uint64_t counter = (block * numInputs + input) * LANE_WORDS;
+		for (size_t w = 0; w < LANE_WORDS; ++w)
+		{
+			words[w] = MixBits(seed + (counter + w) * 0x9E3779B97F4A7C15ull);
+		}
+		return LanesLoad(words);
+	}
+
+	// Lanes of the block that are within the first `numVectors` vectors
+	Lanes LanesInBudget(uint64_t block, uint64_t numVectors)
+	{
+		uint64_t words[LANE_WORDS];
+		for (size_t w = 0; w < LANE_WORDS; ++w)
+		{
+			uint64_t first = block * NUM_LANES + w * 64;
+			words[w] = first >= numVectors ? 0 : numVectors - first >= 64 ? ~0ull : (1ull << (numVectors - first)) - 1;
+		}
+		return LanesLoad(words);
+	}
+
+	// Evaluates both parts with one block of vectors, and returns the lanes where any of their outputs differ
+	Lanes EvaluateBlock(const EquivalencePair& pair, LaneState lanes[2], uint64_t seed, uint64_t block)
+	{
+		const size_t numInputs = pair.inputGates[0].size();
+		for (int side = 0; side < 2; ++side)
+		{
+			ResetLanes(pair.programs[side], lanes[side]);
+		}
+		for (size_t i = 0; i < numInputs; ++i)
+		{
+			Lanes value = RandomLanes(seed, block, numInputs, i);
+			for (int side = 0; side < 2; ++side)
+			{
+				SetInputLanes(pair.programs[side], lanes[side], pair.inputGates[side][i], value);
+			}
+		}
+		for (int side = 0; side < 2; ++side)
+		{
+			StepLanes(pair.programs[side], lanes[side]);
+		}
+
+		Lanes differ = LanesZero();
+		for (size_t o = 0; o < pair.outputGates[0].size(); ++o)
+		{
+			Lanes a = GetOutputLanes(pair.programs[0], lanes[0], pair.outputGates[0][o]);
+			Lanes b = GetOutputLanes(pair.programs[1], lanes[1], pair.outputGates[1][o]);
+			differ = LanesOr(differ, LanesOr(LanesAndNot(a, b), LanesAndNot(b, a)));
+		}
+		return differ;
+	}
+
+	// First lane set in `lanes`, or NUM_LANES if none are
+	size_t FirstLane(Lanes lanes)
+	{
+		uint64_t words[LANE_WORDS];
+		LanesStore(words, lanes);
+		for (size_t w = 0; w < LANE_WORDS; ++w)
+		{
+			if (words[w] != 0)
+			{
+				return w * 64 + std::countr_zero(words[w]);
+			}
+		}
+		return NUM_LANES;
+	}
+
+	// The name of each pin, checking that every pin has one and no two share one
+	bool NamePins(const std::vector<graph::NodeHandle>& pins, const char* kind, const char* side, std::vector<graph::NameID>& names)
+	{
+		std::unordered_map<graph::NameID, size_t> seen;
+		names.resize(pins.size());
+		for (size_t i = 0; i < pins.size(); ++i)
+		{
+			names[i] = At(graph::nodeName, graph::NodeIndex(pins[i]));
+			if (names[i] == graph::EMPTY_NAME)
+			{
+				console::Errorf("simulation: An %s of the %s selection has no name, so it can't be matched to the other's.", kind, side);
+				return false;
+			}
+			if (!seen.emplace(names[i], i).second)
+			{
+				console::Errorf("simulation: The %s selection has more than one %s named \"%s\".", side, kind, graph::NameString(names[i]));
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Puts the second selection's pins in the order of the first's names
+	bool MatchPins(const std::vector<graph::NameID>& names, std::vector<graph::NodeHandle>& pins, const char* kind)
+	{
+		std::vector<graph::NameID> otherNames;
+		if (!NamePins(pins, kind, "second", otherNames))
+		{
+			return false;
+		}
+		std::unordered_map<graph::NameID, graph::NodeHandle> pinOfName;
+		for (size_t i = 0; i < pins.size(); ++i)
+		{
+			pinOfName.emplace(otherNames[i], pins[i]);
+		}
+
+		std::vector<graph::NodeHandle> matched(names.size());
+		for (size_t i = 0; i < names.size(); ++i)
+		{
+			auto it = pinOfName.find(names[i]);
+			if (it == pinOfName.end())
+			{
+				console::Errorf("simulation: The second selection has no %s named \"%s\".", kind, graph::NameString(names[i]));
+				return false;
+			}
+			matched[i] = it->second;
+			pinOfName.erase(it);
+		}
+		if (!pinOfName.empty())
+		{
+			console::Errorf("simulation: The first selection has no %s named \"%s\".", kind, graph::NameString(pinOfName.begin()->first));
+			return false;
+		}
+		pins = std::move(matched);
+		return true;
+	}
+
+	bool CheckEquivalence(const ChunkedList<graph::NodeHandle>& selectionA, const ChunkedList<graph::NodeHandle>& selectionB,
+		uint64_t numVectors, uint64_t seed, EquivalenceResult& result)
+	{
+		result = {};
+
+		std::vector<graph::NodeHandle> inputs[2];
+		std::vector<graph::NodeHandle> outputs[2];
+		std::vector<graph::NameID> outputNames;
+		FindSelectionPins(selectionA, inputs[0], outputs[0]);
+		FindSelectionPins(selectionB, inputs[1], outputs[1]);
+		if (!NamePins(inputs[0], "input", "first", result.inputNames) ||
+			!NamePins(outputs[0], "output", "first", outputNames) ||
+			!MatchPins(result.inputNames, inputs[1], "input") ||
+			!MatchPins(outputNames, outputs[1], "output"))
+		{
+			return false;
+		}
+
+		EquivalencePair pair;
+		const ChunkedList<graph::NodeHandle>* selections[2] = { &selectionA, &selectionB };
+		for (int side = 0; side < 2; ++side)
+		{
+			Netlist netlist;
+			if (!BuildSelectionNetlist(*selections[side], inputs[side], outputs[side], netlist, pair.inputGates[side], pair.outputGates[side]))
+			{
+				return false;
+			}
+			Compile(netlist, pair.inputGates[side], pair.outputGates[side], pair.programs[side]);
+			LogCompiled(pair.programs[side]);
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		const uint64_t numBlocks = numVectors / NUM_LANES + (numVectors % NUM_LANES != 0);
+
+		// The earliest block found to have a mismatch - jobs stop at it, since everything after is a later vector
+		std::atomic<uint64_t> mismatchBlock = numBlocks;
+		std::atomic<uint64_t> numBlocksEvaluated = 0;
+		for (uint64_t batchStart = 0; batchStart < numBlocks && mismatchBlock == numBlocks; batchStart += EQUIVALENCE_BATCH_BLOCKS)
+		{
+			const uint64_t batchEnd = numBlocks - batchStart < EQUIVALENCE_BATCH_BLOCKS ? numBlocks : batchStart + EQUIVALENCE_BATCH_BLOCKS;
+			workers::ParallelFor((size_t)((batchEnd - batchStart + EQUIVALENCE_JOB_BLOCKS - 1) / EQUIVALENCE_JOB_BLOCKS), [&](size_t job)
+			{
+				LaneState lanes[2];
+				const uint64_t jobStart = batchStart + job * EQUIVALENCE_JOB_BLOCKS;
+				const uint64_t jobEnd = batchEnd - jobStart < EQUIVALENCE_JOB_BLOCKS ? batchEnd : jobStart + EQUIVALENCE_JOB_BLOCKS;
+				uint64_t block = jobStart;
+				for (; block < jobEnd && block < mismatchBlock.load(std::memory_order_relaxed); ++block)
+				{
+					Lanes differ = LanesAnd(EvaluateBlock(pair, lanes, seed, block), LanesInBudget(block, numVectors));
+					if (LanesDiffer(differ, LanesZero()))
+					{
+						uint64_t earliest = mismatchBlock.load(std::memory_order_relaxed);
+						while (block < earliest && !mismatchBlock.compare_exchange_weak(earliest, block, std::memory_order_relaxed));
+						++block;
+						break;
+					}
+				}
+				numBlocksEvaluated.fetch_add(block - jobStart, std::memory_order_relaxed);
+			});
+		}
+		result.numVectors = std::min(numBlocksEvaluated * NUM_LANES, numVectors);
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		result.vectorsPerSecond = result.seconds > 0.0 ? result.numVectors / result.seconds : 0.0;
+
+		if (mismatchBlock == numBlocks)
+		{
+			console::Logf("simulation: Both selections gave the same outputs for all %llu random vectors (%.2f seconds, %.0f vectors per second).",
+				(unsigned long long)result.numVectors, result.seconds, result.vectorsPerSecond);
+			return true;
+		}
+
+		// Only the block is known - evaluating it again finds the vector, and the first output that differed on it
+		LaneState lanes[2];
+		Lanes differ = LanesAnd(EvaluateBlock(pair, lanes, seed, mismatchBlock), LanesInBudget(mismatchBlock, numVectors));
+		size_t lane = FirstLane(differ);
+		result.isEquivalent = false;
+		result.counterexampleIndex = mismatchBlock * NUM_LANES + lane;
+		result.counterexample.resize(inputs[0].size());
+		for (size_t i = 0; i < inputs[0].size(); ++i)
+		{
+			result.counterexample[i] = GetLane(RandomLanes(seed, mismatchBlock, inputs[0].size(), i), lane);
+		}
+		for (size_t o = 0; o < outputNames.size(); ++o)
+		{
+			bool a = GetLane(GetOutputLanes(pair.programs[0], lanes[0], pair.outputGates[0][o]), lane);
+			bool b = GetLane(GetOutputLanes(pair.programs[1], lanes[1], pair.outputGates[1][o]), lane);
+			if (a != b)
+			{
+				result.mismatchedOutput = outputNames[o];
+				result.outputA = a;
+				result.outputB = b;
+				break;
+			}
+		}
+
+		std::string vector;
+		for (size_t i = 0; i < result.inputNames.size(); ++i)
+		{
+			vector += i == 0 ? "" : ", ";
+			vector += graph::NameString(result.inputNames[i]);
+			vector += result.counterexample[i] ? "=1" : "=0";
+		}
+		console::Logf("simulation: The selections differ on random vector %llu (%s): \"%s\" is %d in the first and %d in the second. "
+			"Found after %llu vectors (%.2f seconds, %.0f vectors per second).",
+			(unsigned long long)result.counterexampleIndex, vector.c_str(), graph::NameString(result.mismatchedOutput), (int)result.outputA, (int)result.outputB,
+			(unsigned long long)result.numVectors, result.seconds, result.vectorsPerSecond);
+		return true;
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+#include "chunked_list.hpp"
+#include "graph_names.hpp"
+#include "simulation.hpp"
+
+// Checking that two parts of the graph compute the same function, by driving both with the same random input vectors,
+// bit-parallel across the worker pool, and comparing their outputs.
+//
+// Each part's pins are found by FindSelectionPins, and matched to the other's by node name - so both parts need
+// the same set of named inputs and the same set of named outputs. Every vector starts both parts over from their
+// starting values, like a row of a truth table.
+// Random vectors can only ever show that two parts differ: agreeing on every vector tried is evidence, not proof.
+namespace simulation
+{
+	constexpr uint64_t DEFAULT_EQUIVALENCE_VECTORS = 1ull << 24;
+
+	struct EquivalenceResult
+	{
+		// Whether both parts agreed on every vector tried
+		bool isEquivalent = true;
+
+		// Vectors tried - the whole budget, unless a mismatch stopped the check early
+		uint64_t numVectors = 0;
+		double seconds = 0.0;
+		double vectorsPerSecond = 0.0;
+
+		// The first vector the parts disagreed on, if any: its number, the value it gives each input (in the order of
+		// `inputNames`), and the first output that differed, with each part's value for it
+		uint64_t counterexampleIndex = 0;
+		std::vector<graph::NameID> inputNames;
+		std::vector<bool> counterexample;
+		graph::NameID mismatchedOutput = graph::EMPTY_NAME;
+		bool outputA = false;
+		bool outputB = false;
+	};
+
+	// Tries up to `numVectors` random vectors, stopping at the first the parts disagree on.
+	// The same seed always tries the same vectors, however the work is spread across threads.
+	// Returns false if the pins couldn't be matched up.
+	bool CheckEquivalence(const ChunkedList<graph::NodeHandle>& selectionA, const ChunkedList<graph::NodeHandle>& selectionB,
+		uint64_t numVectors, uint64_t seed, EquivalenceResult& result);
+}
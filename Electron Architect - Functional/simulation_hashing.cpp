@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <numeric>
+#include "simulation_hashing.hpp"
+
+namespace simulation
+{
+	void ResetStructureTable(StructureTable& table, size_t maxGates)
+	{
+		// At most half full, so probes stay short
+		size_t capacity = 16;
+		while (capacity < maxGates * 2)
+		{
+			capacity *= 2;
+		}
+		table.slots.assign(capacity, NULL_GATE);
+		table.slotHashes.resize(capacity);
+	}
+
+	uint64_t HashStructure(NodeType type, const GateID inputs[], size_t numInputs)
+	{
+		uint64_t hash = ((uint64_t)type + 1) * 0x9E3779B97F4A7C15ull;
+		for (size_t i = 0; i < numInputs; ++i)
+		{
+			hash = (hash ^ inputs[i]) * 0xBF58476D1CE4E5B9ull;
+			hash ^= hash >> 29;
+		}
+		// The low bits pick the slot, so fold the high bits into them
+		return hash ^ (hash >> 32);
+	}
+
+	size_t FindDuplicateGates(const Netlist& netlist, std::vector<GateID>& originalOf)
+	{
+		const uint32_t n = (uint32_t)NumGates(netlist);
+		originalOf.resize(n);
+		std::iota(originalOf.begin(), originalOf.end(), (GateID)0);
+
+		std::vector<uint32_t> sccStart;
+		std::vector<GateID> sccGates;
+		GroupGatesByScc(netlist, sccStart, sccGates);
+
+		StructureTable table;
+		ResetStructureTable(table, n);
+
+		// Each gate's inputs as they're compared: replaced by what they duplicate, and sorted
+		std::vector<uint32_t> keyStart(n);
+		std::vector<uint32_t> keyLength(n, 0);
+		std::vector<GateID> keys;
+		keys.reserve(netlist.inputs.size());
+
+		size_t numDuplicates = 0;
+		for (size_t c = 0; c + 1 < sccStart.size(); ++c)
+		{
+			if (sccStart[c + 1] - sccStart[c] != 1)
+			{
+				continue;
+			}
+			const GateID g = sccGates[sccStart[c]];
+			const uint32_t first = netlist.inputStart[g];
+			const uint32_t last = netlist.inputStart[g + 1];
+			if (first == last || std::find(netlist.inputs.begin() + first, netlist.inputs.begin() + last, g) != netlist.inputs.begin() + last)
+			{
+				continue;
+			}
+
+			const uint32_t start = (uint32_t)keys.size();
+			for (uint32_t i = first; i < last; ++i)
+			{
+				keys.push_back(originalOf[netlist.inputs[i]]);
+			}
+			std::sort(keys.begin() + start, keys.end());
+			// Seeing an input twice changes nothing for these, but does for One
+			if (netlist.types[g] != NodeType::One)
+			{
+				keys.erase(std::unique(keys.begin() + start, keys.end()), keys.end());
+			}
+			keyStart[g] = start;
+			keyLength[g] = (uint32_t)keys.size() - start;
+
+			const GateID* key = keys.data() + start;
+			GateID original = FindOrAddStructure(table, g, HashStructure(netlist.types[g], key, keyLength[g]), [&](GateID other)
+			{
+				return netlist.types[other] == netlist.types[g] && keyLength[other] == keyLength[g] &&
+					std::equal(key, key + keyLength[g], keys.data() + keyStart[other]);
+			});
+			if (original != g)
+			{
+				originalOf[g] = original;
+				++numDuplicates;
+				keys.resize(start);
+			}
+		}
+		return numDuplicates;
+	}
+}
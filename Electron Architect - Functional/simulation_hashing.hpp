@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include "simulation.hpp"
+
+// Structural hashing: finding gates with the same type and the same inputs as another gate.
+// Two such gates always have the same value, so one of them is redundant - as with copies of a decoder wired to the same lines.
+// Gates are visited in evaluation order, so once a gate is known to duplicate another,
+// gates fed by it can be compared as though they were fed by the other - finding whole duplicated blocks in one pass.
+// Optimize uses this to merge them, so every program from Compile evaluates each such set of gates once (see simulation_optimize.hpp).
+// The live program is compiled gate for gate so that edits stay local (see simulation_patch.hpp), so the editor only counts them.
+namespace simulation
+{
+	// Open-addressed table of gates keyed on their type and inputs, for finding whether a gate with the same structure has been seen.
+	// Only holds gate IDs - whatever uses it knows where each gate's type and inputs are kept.
+	struct StructureTable
+	{
+		std::vector<GateID> slots; // NULL_GATE where empty
+		std::vector<uint64_t> slotHashes;
+	};
+
+	// Empties the table, making room for up to `maxGates` gates
+	void ResetStructureTable(StructureTable& table, size_t maxGates);
+
+	// `inputs` must be in a canonical order, such as sorted
+	uint64_t HashStructure(NodeType type, const GateID inputs[], size_t numInputs);
+
+	// Returns a gate in the table with the same hash for which `isSame(gate)` is true, or adds `gate` and returns it if there is none
+	template<class IsSame>
+	GateID FindOrAddStructure(StructureTable& table, GateID gate, uint64_t hash, IsSame isSame)
+	{
+		const size_t mask = table.slots.size() - 1;
+		for (size_t slot = (size_t)hash & mask; ; slot = (slot + 1) & mask)
+		{
+			GateID other = table.slots[slot];
+			if (other == NULL_GATE)
+			{
+				table.slots[slot] = gate;
+				table.slotHashes[slot] = hash;
+				return gate;
+			}
+			if (table.slotHashes[slot] == hash && isSame(other))
+			{
+				return other;
+			}
+		}
+	}
+
+	// Fills `originalOf` with the gate each gate duplicates - the first of them in evaluation order - or the gate itself if it duplicates none,
+	// and returns how many gates duplicate another. Expected O(gates + inputs).
+	// Sources never duplicate each other, since they're set independently, and neither do gates in feedback loops.
+	size_t FindDuplicateGates(const Netlist& netlist, std::vector<GateID>& originalOf);
+}
@@ -0,0 +1,270 @@
+#include <algorithm>
+#include <cstring>
+#include "simulation_history.hpp"
+
+namespace simulation
+{
+	void WriteVarint(std::vector<uint8_t>& bytes, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			bytes.push_back((uint8_t)(value | 0x80));
+			value >>= 7;
+		}
+		bytes.push_back((uint8_t)value);
+	}
+
+	const uint8_t* ReadVarint(const uint8_t* bytes, uint64_t& value)
+	{
+		value = 0;
+		for (int shift = 0; ; shift += 7)
+		{
+			uint8_t byte = *bytes++;
+			value |= (uint64_t)(byte & 0x7F) << shift;
+			if (!(byte & 0x80))
+			{
+				return bytes;
+			}
+		}
+	}
+
+	void EncodeRuns(const uint64_t* words, size_t numWords, std::vector<uint8_t>& bytes)
+	{
+		size_t i = 0;
+		while (i < numWords)
+		{
+			size_t zeroStart = i;
+			while (i < numWords && words[i] == 0)
+			{
+				++i;
+			}
+			size_t literalStart = i;
+			while (i < numWords && words[i] != 0)
+			{
+				++i;
+			}
+			WriteVarint(bytes, literalStart - zeroStart);
+			WriteVarint(bytes, i - literalStart);
+
+			size_t at = bytes.size();
+			bytes.resize(at + (i - literalStart) * sizeof(uint64_t));
+			memcpy(bytes.data() + at, words + literalStart, (i - literalStart) * sizeof(uint64_t));
+		}
+	}
+
+	const uint8_t* ApplyRuns(const uint8_t* bytes, uint64_t* words, size_t numWords)
+	{
+		size_t i = 0;
+		while (i < numWords)
+		{
+			uint64_t numZeros, numLiterals;
+			bytes = ReadVarint(bytes, numZeros);
+			bytes = ReadVarint(bytes, numLiterals);
+			i += numZeros;
+			for (uint64_t end = i + numLiterals; i < end; ++i)
+			{
+				uint64_t word;
+				memcpy(&word, bytes, sizeof(uint64_t));
+				bytes += sizeof(uint64_t);
+				words[i] ^= word;
+			}
+		}
+		return bytes;
+	}
+
+	size_t GroupBytes(const HistoryGroup& group)
+	{
+		return sizeof(HistoryGroup) + group.bytes.capacity() + group.frameStart.capacity() * sizeof(uint32_t);
+	}
+
+	size_t NumFrames(const HistoryGroup& group)
+	{
+		return group.frameStart.size() - 1;
+	}
+
+	// Overwrites `words` with the group's keyframe
+	void DecodeKeyframe(const HistoryGroup& group, uint64_t* words, size_t numWords)
+	{
+		std::fill(words, words + numWords, 0);
+		ApplyRuns(group.bytes.data(), words, numWords);
+	}
+
+	void ClearHistory(History& history)
+	{
+		history.groups.clear();
+		history.bytesUsed = 0;
+		history.keyframe.clear();
+	}
+
+	bool HasHistory(const History& history)
+	{
+		return !history.groups.empty();
+	}
+
+	uint64_t OldestTick(const History& history)
+	{
+		return history.groups.front().firstTick;
+	}
+
+	uint64_t NewestTick(const History& history)
+	{
+		const HistoryGroup& newest = history.groups.back();
+		return newest.firstTick + NumFrames(newest) - 1;
+	}
+
+	// Forgets `tick` and everything after it
+	void TruncateHistory(History& history, uint64_t tick)
+	{
+		bool lostKeyframe = false;
+		while (!history.groups.empty() && history.groups.back().firstTick >= tick)
+		{
+			history.bytesUsed -= GroupBytes(history.groups.back());
+			history.groups.pop_back();
+			lostKeyframe = true;
+		}
+		if (history.groups.empty())
+		{
+			return;
+		}
+
+		HistoryGroup& newest = history.groups.back();
+		size_t numFrames = std::min<size_t>(NumFrames(newest), tick - newest.firstTick);
+		newest.bytes.resize(newest.frameStart[numFrames]);
+		newest.frameStart.resize(numFrames + 1);
+		if (lostKeyframe)
+		{
+			history.keyframe.resize(newest.numWords);
+			DecodeKeyframe(newest, history.keyframe.data(), newest.numWords);
+		}
+	}
+
+	void RecordTick(History& history, const Program& program, uint64_t layout)
+	{
+		static std::vector<uint64_t> delta;
+
+		const size_t numWords = program.state.size();
+		if (HasHistory(history) && history.groups.back().layout == layout && history.groups.back().numWords != numWords)
+		{
+			ClearHistory(history);
+		}
+		if (HasHistory(history))
+		{
+			if (program.tick <= OldestTick(history) || program.tick > NewestTick(history) + 1)
+			{
+				ClearHistory(history);
+			}
+			else
+			{
+				TruncateHistory(history, program.tick);
+			}
+		}
+
+		bool needsKeyframe = history.groups.empty() || NumFrames(history.groups.back()) >= history.keyframeInterval ||
+			history.groups.back().layout != layout;
+		if (!needsKeyframe)
+		{
+			HistoryGroup& group = history.groups.back();
+			history.bytesUsed -= GroupBytes(group);
+			delta.resize(numWords);
+			for (size_t i = 0; i < numWords; ++i)
+			{
+				delta[i] = program.state[i] ^ history.keyframe[i];
+			}
+			size_t deltaStart = group.bytes.size();
+			EncodeRuns(delta.data(), numWords, group.bytes);
+
+			// Once the state has drifted far from the keyframe, a new keyframe is cheaper than the deltas to come
+			if ((group.bytes.size() - deltaStart) * 2 > group.frameStart[1])
+			{
+				group.bytes.resize(deltaStart);
+				needsKeyframe = true;
+			}
+			else
+			{
+				group.frameStart.push_back((uint32_t)group.bytes.size());
+			}
+			history.bytesUsed += GroupBytes(group);
+		}
+
+		if (needsKeyframe)
+		{
+			if (!history.groups.empty())
+			{
+				// Finished with, so only hold what it needs
+				HistoryGroup& previous = history.groups.back();
+				history.bytesUsed -= GroupBytes(previous);
+				previous.bytes.shrink_to_fit();
+				previous.frameStart.shrink_to_fit();
+				history.bytesUsed += GroupBytes(previous);
+			}
+
+			history.groups.push_back({ .firstTick = program.tick, .layout = layout, .numWords = numWords, .frameStart = { 0 }, .bytes = {} });
+			HistoryGroup& group = history.groups.back();
+			history.keyframe = program.state;
+			EncodeRuns(program.state.data(), numWords, group.bytes);
+			group.frameStart.push_back((uint32_t)group.bytes.size());
+			history.bytesUsed += GroupBytes(group);
+		}
+
+		// The newest group is never forgotten, however large
+		while (history.bytesUsed > history.memoryBudget && history.groups.size() > 1)
+		{
+			history.bytesUsed -= GroupBytes(history.groups.front());
+			history.groups.pop_front();
+		}
+	}
+
+	uint64_t OldestLayout(const History& history)
+	{
+		return history.groups.front().layout;
+	}
+
+	bool DecodeTick(const History& history, uint64_t tick, std::vector<uint64_t>& state, uint64_t& layout)
+	{
+		if (!HasHistory(history) || tick < OldestTick(history) || tick > NewestTick(history))
+		{
+			return false;
+		}
+
+		auto it = std::upper_bound(history.groups.begin(), history.groups.end(), tick,
+			[](uint64_t tick, const HistoryGroup& group) { return tick < group.firstTick; }) - 1;
+		const HistoryGroup& group = *it;
+		size_t frame = tick - group.firstTick;
+
+		state.resize(group.numWords);
+		DecodeKeyframe(group, state.data(), group.numWords);
+		if (frame != 0)
+		{
+			ApplyRuns(group.bytes.data() + group.frameStart[frame], state.data(), group.numWords);
+		}
+		layout = group.layout;
+		return true;
+	}
+
+	void RestoreState(Program& program, std::vector<uint64_t>& state, uint64_t tick)
+	{
+		program.state.swap(state);
+		program.tick = tick;
+
+		// Whatever the event-driven bookkeeping knew is about another state; a sweep starts it over
+		program.pending.clear();
+		program.needsSweep = true;
+	}
+
+	bool SeekTick(const History& history, Program& program, uint64_t tick, uint64_t layout)
+	{
+		static std::vector<uint64_t> state;
+		uint64_t recordedLayout;
+		if (!DecodeTick(history, tick, state, recordedLayout) || recordedLayout != layout || state.size() != program.state.size())
+		{
+			return false;
+		}
+		RestoreState(program, state, tick);
+		return true;
+	}
+
+	bool StepBack(const History& history, Program& program, uint64_t layout)
+	{
+		return program.tick != 0 && SeekTick(history, program, program.tick - 1, layout);
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "simulation.hpp"
+
+// A rewindable record of a program's past states, for stepping backwards while debugging.
+//
+// Every `keyframeInterval` recorded ticks a keyframe of the whole state is kept, and each tick in between
+// is kept as the XOR of its state with that keyframe. Both are run-length compressed: most words of a delta are zero,
+// and most of a keyframe usually is too. Seeking to a tick decodes its keyframe and applies at most one delta.
+// A keyframe is also taken early when the state has drifted far enough from the last one that deltas stop paying off.
+//
+// When the record outgrows `memoryBudget`, whole keyframe groups are forgotten from the oldest end.
+//
+// States are recorded as the program lays its gates out. Each group also notes which layout that was,
+// and a keyframe is taken whenever it changes - so a program that's patched as it runs (see simulation_patch.hpp)
+// can keep its history, and translate older states into its current layout when seeking to them.
+namespace simulation
+{
+	// A keyframe and the deltas recorded against it.
+	// Frame `f` is `bytes[frameStart[f]]` through `bytes[frameStart[f + 1] - 1]`, and is the state as of `firstTick + f`.
+	struct HistoryGroup
+	{
+		uint64_t firstTick;
+
+		// The layout it was recorded under, as passed to RecordTick, and its number of state words
+		uint64_t layout;
+		size_t numWords;
+
+		std::vector<uint32_t> frameStart = { 0 };
+		std::vector<uint8_t> bytes;
+	};
+
+	struct History
+	{
+		uint32_t keyframeInterval = 64;
+		size_t memoryBudget = 64 << 20;
+
+		// Oldest first. Ticks are consecutive across groups.
+		std::deque<HistoryGroup> groups;
+
+		// Bytes held by the groups, including their bookkeeping
+		size_t bytesUsed = 0;
+
+		// Decoded keyframe of the newest group
+		std::vector<uint64_t> keyframe;
+	};
+
+	// Forgets every recorded tick
+	void ClearHistory(History& history);
+
+	// Records the program's current state as its current tick, with its gates laid out as `layout`.
+	// Anything recorded at or after that tick is forgotten first, so that stepping again after a seek
+	// replaces the old future. A tick that doesn't follow on from the newest one starts the history over,
+	// as does a program of another size under the same layout.
+	void RecordTick(History& history, const Program& program, uint64_t layout = 0);
+
+	// Whether anything has been recorded
+	bool HasHistory(const History& history);
+
+	uint64_t OldestTick(const History& history);
+	uint64_t NewestTick(const History& history);
+
+	// Layout the oldest recorded tick was recorded under
+	uint64_t OldestLayout(const History& history);
+
+	// Decodes the state as of a recorded tick, as it was laid out then - under `layout`.
+	// Returns false if the tick isn't recorded.
+	bool DecodeTick(const History& history, uint64_t tick, std::vector<uint64_t>& state, uint64_t& layout);
+
+	// Restores the program's state as of a recorded tick, so that the next Step carries on from there.
+	// Returns false (and leaves the program alone) if the tick isn't recorded, or was recorded under another layout.
+	bool SeekTick(const History& history, Program& program, uint64_t tick, uint64_t layout = 0);
+
+	// Seeks one tick back. Returns false if the previous tick isn't recorded under `layout`.
+	bool StepBack(const History& history, Program& program, uint64_t layout = 0);
+
+	// Swaps `state` into the program and sets its tick, as seeking does - for a state from DecodeTick
+	void RestoreState(Program& program, std::vector<uint64_t>& state, uint64_t tick);
+
+	// LEB128: seven bits per byte, low bits first, with the top bit set on every byte but the last
+	void WriteVarint(std::vector<uint8_t>& bytes, uint64_t value);
+	const uint8_t* ReadVarint(const uint8_t* bytes, uint64_t& value);
+
+	// Encodes `words` as alternating runs of zero words and literal words, appending to `bytes`
+	void EncodeRuns(const uint64_t* words, size_t numWords, std::vector<uint8_t>& bytes);
+
+	// XORs the words encoded at `bytes` into `words`. Returns the byte after the encoding.
+	const uint8_t* ApplyRuns(const uint8_t* bytes, uint64_t* words, size_t numWords);
+}
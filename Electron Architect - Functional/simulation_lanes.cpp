@@ -0,0 +1,140 @@
+#include "simulation_lanes.hpp"
+
+namespace simulation
+{
+	Lanes CountingPattern(size_t input, uint64_t block)
+	{
+		// Bit patterns that count through the first six inputs within each word
+		constexpr uint64_t wordPatterns[6] = {
+			0xAAAAAAAAAAAAAAAAull,
+			0xCCCCCCCCCCCCCCCCull,
+			0xF0F0F0F0F0F0F0F0ull,
+			0xFF00FF00FF00FF00ull,
+			0xFFFF0000FFFF0000ull,
+			0xFFFFFFFF00000000ull,
+		};
+
+		uint64_t words[LANE_WORDS];
+		for (size_t w = 0; w < LANE_WORDS; ++w)
+		{
+			if (input < 6)
+			{
+				words[w] = wordPatterns[input];
+			}
+			else
+			{
+				// Higher inputs are constant within a word - first counting through words, then through blocks
+				uint64_t row = block * NUM_LANES + w * 64;
+				words[w] = ((row >> input) & 1) ? ~0ull : 0;
+			}
+		}
+		return LanesLoad(words);
+	}
+
+	void ResetLanes(const Program& program, LaneState& lanes)
+	{
+		lanes.values.assign(program.numGates, LanesZero());
+		for (GateID g = 0; g < program.numSources; ++g)
+		{
+			lanes.values[g] = (program.sourceTypes[g] == NodeType::Non) ? LanesOnes() : LanesZero();
+		}
+	}
+
+	void SetInputLanes(const Program& program, LaneState& lanes, GateID netlistGate, Lanes value)
+	{
+		GateID gate = program.gateOfNetlistGate[netlistGate];
+		if (gate < program.numSources && program.netlistGateOfGate[gate] == netlistGate)
+		{
+			lanes.values[gate] = value;
+		}
+	}
+
+	Lanes GetOutputLanes(const Program& program, const LaneState& lanes, GateID netlistGate)
+	{
+		return lanes.values[program.gateOfNetlistGate[netlistGate]];
+	}
+
+	inline Lanes EvaluateLanes(const Instruction& instruction, const Lanes* values, const GateID* operands)
+	{
+		const GateID* inputs = operands + instruction.firstInput;
+		const uint32_t numInputs = instruction.numInputs;
+		Lanes result;
+
+		switch (instruction.type)
+		{
+		case NodeType::Any:
+		case NodeType::Non:
+			result = LanesZero();
+			for (uint32_t i = 0; i < numInputs; ++i)
+			{
+				result = LanesOr(result, values[inputs[i]]);
+			}
+			if (instruction.type == NodeType::Non)
+			{
+				result = LanesNot(result);
+			}
+			return result;
+
+		case NodeType::All:
+			result = numInputs ? LanesOnes() : LanesZero();
+			for (uint32_t i = 0; i < numInputs; ++i)
+			{
+				result = LanesAnd(result, values[inputs[i]]);
+			}
+			return result;
+
+		case NodeType::One:
+		{
+			// Lanes that have seen at least one input on, and at least two
+			Lanes once = LanesZero();
+			Lanes twice = LanesZero();
+			for (uint32_t i = 0; i < numInputs; ++i)
+			{
+				Lanes value = values[inputs[i]];
+				twice = LanesOr(twice, LanesAnd(once, value));
+				once = LanesOr(once, value);
+			}
+			return LanesAndNot(once, twice);
+		}
+
+		default:
+			return LanesZero();
+		}
+	}
+
+	void StepLanes(const Program& program, LaneState& lanes)
+	{
+		Lanes* values = lanes.values.data();
+		const GateID* operands = program.operands.data();
+		const Instruction* code = program.code.data();
+		const GateID numSources = program.numSources;
+
+		GateID gate = numSources;
+		for (const Loop& loop : program.loops)
+		{
+			for (; gate < loop.first; ++gate)
+			{
+				values[gate] = EvaluateLanes(code[gate - numSources], values, operands);
+			}
+			for (uint32_t pass = 0; pass < program.maxLoopPasses; ++pass)
+			{
+				bool changed = false;
+				for (GateID member = loop.first; member < loop.end; ++member)
+				{
+					Lanes result = EvaluateLanes(code[member - numSources], values, operands);
+					changed |= LanesDiffer(result, values[member]);
+					values[member] = result;
+				}
+				if (!changed)
+				{
+					break;
+				}
+			}
+			gate = loop.end;
+		}
+		for (; gate < program.numGates; ++gate)
+		{
+			values[gate] = EvaluateLanes(code[gate - numSources], values, operands);
+		}
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "simulation.hpp"
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Bit-sliced evaluation: every gate holds one bit per lane, and each lane is an independent copy of the circuit.
+// One pass over the program evaluates every lane at once - 64 per uint64_t, or 256/512 with AVX2/AVX-512.
+namespace simulation
+{
+	// Vector types are wrapped so they can be stored in containers without losing their alignment
+#if defined(__AVX512F__)
+	struct Lanes { __m512i v; };
+	constexpr size_t LANE_WORDS = 8;
+
+	inline Lanes LanesZero() { return { _mm512_setzero_si512() }; }
+	inline Lanes LanesOnes() { return { _mm512_set1_epi64(-1) }; }
+	inline Lanes LanesAnd(Lanes a, Lanes b) { return { _mm512_and_si512(a.v, b.v) }; }
+	inline Lanes LanesOr(Lanes a, Lanes b) { return { _mm512_or_si512(a.v, b.v) }; }
+	inline Lanes LanesAndNot(Lanes a, Lanes b) { return { _mm512_andnot_si512(b.v, a.v) }; }
+	inline Lanes LanesNot(Lanes a) { return { _mm512_xor_si512(a.v, _mm512_set1_epi64(-1)) }; }
+	inline bool LanesDiffer(Lanes a, Lanes b) { return _mm512_cmpneq_epi64_mask(a.v, b.v) != 0; }
+	inline Lanes LanesLoad(const uint64_t words[LANE_WORDS]) { return { _mm512_loadu_si512(words) }; }
+	inline void LanesStore(uint64_t words[LANE_WORDS], Lanes a) { _mm512_storeu_si512(words, a.v); }
+#elif defined(__AVX2__)
+	struct Lanes { __m256i v; };
+	constexpr size_t LANE_WORDS = 4;
+
+	inline Lanes LanesZero() { return { _mm256_setzero_si256() }; }
+	inline Lanes LanesOnes() { return { _mm256_set1_epi64x(-1) }; }
+	inline Lanes LanesAnd(Lanes a, Lanes b) { return { _mm256_and_si256(a.v, b.v) }; }
+	inline Lanes LanesOr(Lanes a, Lanes b) { return { _mm256_or_si256(a.v, b.v) }; }
+	inline Lanes LanesAndNot(Lanes a, Lanes b) { return { _mm256_andnot_si256(b.v, a.v) }; }
+	inline Lanes LanesNot(Lanes a) { return { _mm256_xor_si256(a.v, _mm256_set1_epi64x(-1)) }; }
+	inline bool LanesDiffer(Lanes a, Lanes b) { return !_mm256_testz_si256(_mm256_xor_si256(a.v, b.v), _mm256_xor_si256(a.v, b.v)); }
+	inline Lanes LanesLoad(const uint64_t words[LANE_WORDS]) { return { _mm256_loadu_si256((const __m256i*)words) }; }
+	inline void LanesStore(uint64_t words[LANE_WORDS], Lanes a) { _mm256_storeu_si256((__m256i*)words, a.v); }
+#else
+	using Lanes = uint64_t;
+	constexpr size_t LANE_WORDS = 1;
+
+	inline Lanes LanesZero() { return 0; }
+	inline Lanes LanesOnes() { return ~0ull; }
+	inline Lanes LanesAnd(Lanes a, Lanes b) { return a & b; }
+	inline Lanes LanesOr(Lanes a, Lanes b) { return a | b; }
+	inline Lanes LanesAndNot(Lanes a, Lanes b) { return a & ~b; }
+	inline Lanes LanesNot(Lanes a) { return ~a; }
+	inline bool LanesDiffer(Lanes a, Lanes b) { return a != b; }
+	inline Lanes LanesLoad(const uint64_t words[LANE_WORDS]) { return words[0]; }
+	inline void LanesStore(uint64_t words[LANE_WORDS], Lanes a) { words[0] = a; }
+#endif
+
+	constexpr size_t NUM_LANES = LANE_WORDS * 64;
+
+	// Lane `l` is bit `l % 64` of word `l / 64`
+	inline bool GetLane(Lanes lanes, size_t lane)
+	{
+		uint64_t words[LANE_WORDS];
+		LanesStore(words, lanes);
+		return (words[lane / 64] >> (lane % 64)) & 1;
+	}
+
+	// Values of `input` across the lanes of block `block` when counting through every input combination.
+	// Lane `l` of block `b` holds combination number `b * NUM_LANES + l`, whose bit `input` is that input's value.
+	Lanes CountingPattern(size_t input, uint64_t block);
+
+	// A value for every lane of every gate of a compiled program, indexed by renumbered gate
+	struct LaneState
+	{
+		std::vector<Lanes> values;
+	};
+
+	// Sizes the state for the program, with sources at their starting values in every lane and all else off
+	void ResetLanes(const Program& program, LaneState& lanes);
+
+	// Only has an effect on sources
+	void SetInputLanes(const Program& program, LaneState& lanes, GateID netlistGate, Lanes value);
+
+	Lanes GetOutputLanes(const Program& program, const LaneState& lanes, GateID netlistGate);
+
+	// Evaluates every gate once, in order, in every lane - the lane-wise equivalent of StepSweep.
+	// Loops get passes until every lane has settled, or `maxLoopPasses`.
+	void StepLanes(const Program& program, LaneState& lanes);
+}
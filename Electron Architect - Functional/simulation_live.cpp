@@ -0,0 +1,478 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include "console_log.hpp"
+#include "graph_components.hpp"
+#include "simulation_components.hpp"
+#include "simulation_history.hpp"
+#include "simulation_live.hpp"
+#include "simulation_patch.hpp"
+#include "triple_buffer.hpp"
+
+namespace simulation
+{
+	using LiveClock = std::chrono::steady_clock;
+
+	int liveTick = 0;
+	int liveHistoryKilobytes = 0;
+	int liveTickRate = 60;
+	int liveMeasuredTickRate = 0;
+	bool liveIsRunning = false;
+
+	// Only touched by the thread
+	PatchableProgram livePatchable;
+	Program& liveProgram = livePatchable.program;
+	History liveHistory;
+	uint64_t liveEditVersion = (uint64_t)(-1);
+
+	TripleBuffer<LiveSnapshot> liveSnapshots;
+
+	// What the render loop has asked of the thread since it last looked
+	struct LiveRequests
+	{
+		// A whole new netlist to compile, and/or edits to patch into what was compiled - in that order
+		bool hasNetlist = false;
+		Netlist netlist;
+		std::vector<uint32_t> instanceGateCounts;
+		std::vector<graph::Edit> edits;
+		std::vector<PlacedInstance> placed;
+		uint64_t editVersion = 0;
+
+		bool isRunning = false;
+		int tickRate = 60;
+		int numSteps = 0;
+		int numRewinds = 0;
+		bool isStopping = false;
+	};
+
+	std::thread liveThread;
+	std::mutex liveMutex; // Guards liveRequests - only ever held long enough to copy them
+	std::condition_variable liveWake;
+	LiveRequests liveRequests;
+
+	// Set along with any change to liveRequests, so the thread can check for them without the lock every tick
+	std::atomic<bool> liveHasRequests = false;
+
+	// graph::editVersion and journal position as of the last netlist or edits handed to the thread
+	uint64_t handedEditVersion = (uint64_t)(-1);
+	uint64_t handedJournalPosition = (uint64_t)(-1);
+
+	// Measured over windows of this long
+	constexpr LiveClock::duration measureWindow = std::chrono::milliseconds(250);
+
+	void PublishLive(double measuredTicksPerSecond)
+	{
+		LiveSnapshot& snapshot = BackItem(liveSnapshots);
+		if (snapshot.editVersion != liveEditVersion)
+		{
+			// The mapping only changes with an edit, so most publishes only copy the state
+			snapshot.editVersion = liveEditVersion;
+			snapshot.gateOfNode.resize(livePatchable.gateOfNode.size());
+			for (size_t node = 0; node < livePatchable.gateOfNode.size(); ++node)
+			{
+				snapshot.gateOfNode[node] = liveProgram.gateOfNetlistGate[livePatchable.gateOfNode[node]];
+			}
+		}
+		snapshot.state = liveProgram.state;
+		snapshot.tick = liveProgram.tick;
+		snapshot.oldestRecordedTick = HasHistory(liveHistory) ? OldestTick(liveHistory) : liveProgram.tick;
+		snapshot.historyBytes = liveHistory.bytesUsed;
+		snapshot.measuredTicksPerSecond = measuredTicksPerSecond;
+		Publish(liveSnapshots);
+	}
+
+	void RecordLive()
+	{
+		RecordTick(liveHistory, liveProgram, LayoutPosition(livePatchable));
+		ForgetLayoutsBefore(livePatchable, OldestLayout(liveHistory));
+	}
+
+	void StepAndRecordLive()
+	{
+		Step(liveProgram);
+		RecordLive();
+	}
+
+	// Seeks one tick back, translating the state if it was recorded before edits moved gates
+	bool StepBackLive()
+	{
+		static std::vector<uint64_t> state;
+		uint64_t layout;
+		if (liveProgram.tick == 0 ||
+			!DecodeTick(liveHistory, liveProgram.tick - 1, state, layout) ||
+			!TranslateState(livePatchable, layout, state))
+		{
+			return false;
+		}
+		RestoreState(liveProgram, state, liveProgram.tick - 1);
+		return true;
+	}
+
+	void LiveThread()
+	{
+		LiveRequests requests;
+		LiveClock::time_point nextTick = LiveClock::now();
+
+		LiveClock::time_point windowStart = nextTick;
+		uint64_t ticksInWindow = 0;
+		double measuredTicksPerSecond = 0.0;
+
+		while (true)
+		{
+			// Sleep while paused, or until the next tick is due - unless asked for something first
+			LiveClock::time_point now = LiveClock::now();
+			bool isIdle = !requests.isRunning || (requests.tickRate != 0 && now < nextTick);
+			if (isIdle || liveHasRequests.load(std::memory_order_relaxed))
+			{
+				std::unique_lock<std::mutex> lock(liveMutex);
+				auto hasRequests = [] { return liveHasRequests.load(std::memory_order_relaxed); };
+				if (!requests.isRunning)
+				{
+					liveWake.wait(lock, hasRequests);
+				}
+				else if (isIdle)
+				{
+					liveWake.wait_until(lock, nextTick, hasRequests);
+				}
+
+				if (liveHasRequests.load(std::memory_order_relaxed))
+				{
+					bool wasRunning = requests.isRunning;
+					int oldTickRate = requests.tickRate;
+
+					// Swapped rather than copied, so the lock isn't held for the netlist's size
+					std::swap(requests.netlist, liveRequests.netlist);
+					std::swap(requests.instanceGateCounts, liveRequests.instanceGateCounts);
+					std::swap(requests.edits, liveRequests.edits);
+					std::swap(requests.placed, liveRequests.placed);
+					requests.hasNetlist = liveRequests.hasNetlist;
+					requests.editVersion = liveRequests.editVersion;
+					requests.isRunning = liveRequests.isRunning;
+					requests.tickRate = liveRequests.tickRate;
+					requests.numSteps = liveRequests.numSteps;
+					requests.numRewinds = liveRequests.numRewinds;
+					requests.isStopping = liveRequests.isStopping;
+					liveRequests.hasNetlist = false;
+					liveRequests.numSteps = 0;
+					liveRequests.numRewinds = 0;
+					liveHasRequests.store(false, std::memory_order_relaxed);
+
+					if (requests.isRunning != wasRunning || requests.tickRate != oldTickRate)
+					{
+						nextTick = windowStart = LiveClock::now();
+						ticksInWindow = 0;
+						measuredTicksPerSecond = 0.0;
+					}
+				}
+			}
+			if (requests.isStopping)
+			{
+				return;
+			}
+
+			bool hasChanged = false;
+			if (requests.hasNetlist || !requests.edits.empty())
+			{
+				if (requests.hasNetlist)
+				{
+					CompileBoard(requests.netlist, requests.instanceGateCounts, livePatchable);
+					requests.hasNetlist = false;
+
+					// Nothing recorded can be translated into a program compiled from scratch
+					ClearHistory(liveHistory);
+				}
+				PatchEdits(livePatchable, requests.edits, requests.placed);
+				requests.edits.clear();
+				requests.placed.clear();
+				RecordLive();
+				liveEditVersion = requests.editVersion;
+				hasChanged = true;
+			}
+			for (; requests.numRewinds > 0; --requests.numRewinds)
+			{
+				hasChanged |= StepBackLive();
+			}
+			for (; requests.numSteps > 0; --requests.numSteps)
+			{
+				StepAndRecordLive();
+				hasChanged = true;
+			}
+
+			now = LiveClock::now();
+			if (requests.isRunning && (requests.tickRate == 0 || now >= nextTick))
+			{
+				StepAndRecordLive();
+				hasChanged = true;
+				++ticksInWindow;
+
+				if (requests.tickRate != 0)
+				{
+					// Falling behind drops the ticks missed rather than bursting to catch up
+					nextTick = std::max(nextTick + std::chrono::nanoseconds(1'000'000'000 / requests.tickRate), now);
+				}
+				if (now - windowStart >= measureWindow)
+				{
+					measuredTicksPerSecond = ticksInWindow / std::chrono::duration<double>(now - windowStart).count();
+					windowStart = now;
+					ticksInWindow = 0;
+				}
+			}
+
+			if (hasChanged)
+			{
+				PublishLive(measuredTicksPerSecond);
+			}
+		}
+	}
+
+	// Makes a change to liveRequests under the lock and wakes the thread to take it
+	template<typename Change>
+	void RequestLive(Change change)
+	{
+		{
+			std::lock_guard<std::mutex> lock(liveMutex);
+			change(liveRequests);
+			liveHasRequests.store(true, std::memory_order_relaxed);
+		}
+		liveWake.notify_one();
+	}
+
+	// The gates of each instance placed by the edits, with its ports bound to node indices as they were just after it was placed.
+	// Instances removed again by later edits are left empty.
+	void FlattenPlacedInstances(const std::vector<graph::Edit>& edits, std::vector<PlacedInstance>& placed)
+	{
+		constexpr size_t REMOVED = (size_t)(-1);
+
+		// Where each placed instance is now
+		std::vector<size_t> instanceNow;
+		for (const graph::Edit& edit : edits)
+		{
+			if (edit.kind == graph::EditKind::PlaceInstance)
+			{
+				instanceNow.push_back(edit.node);
+			}
+			else if (edit.kind == graph::EditKind::RemoveInstance)
+			{
+				for (size_t& instance : instanceNow)
+				{
+					if (instance == edit.node)
+					{
+						instance = REMOVED;
+					}
+					else if (instance == edit.endNode)
+					{
+						instance = edit.node;
+					}
+				}
+			}
+		}
+
+		placed.resize(instanceNow.size());
+		for (size_t i = 0; i < instanceNow.size(); ++i)
+		{
+			placed[i] = {};
+			if (instanceNow[i] == REMOVED)
+			{
+				continue;
+			}
+			const graph::ComponentInstance& instance = graph::instances[instanceNow[i]];
+			const graph::ComponentDefinition& definition = graph::definitions[instance.definition];
+			placed[i].netlist = FlattenDefinition(instance.definition);
+			for (size_t port = 0; port < instance.ports.size(); ++port)
+			{
+				if (!graph::IsNodeValid(instance.ports[port]))
+				{
+					continue;
+				}
+				uint32_t node = (uint32_t)graph::NodeIndex(instance.ports[port]);
+				if (port < definition.inputs.size())
+				{
+					placed[i].inputPorts.push_back({ definition.inputs[port], node });
+				}
+				else
+				{
+					placed[i].outputPorts.push_back({ definition.outputs[port - definition.inputs.size()], node });
+				}
+			}
+		}
+
+		// Back through the edits, undoing each node removal's move on the ports of the instances placed before it
+		size_t numNodes = graph::numNodes;
+		size_t numPlacedBefore = placed.size();
+		for (size_t i = edits.size(); i-- > 0;)
+		{
+			const graph::Edit& edit = edits[i];
+			if (edit.kind == graph::EditKind::PlaceInstance)
+			{
+				--numPlacedBefore;
+			}
+			else if (edit.kind == graph::EditKind::AddNode)
+			{
+				--numNodes;
+			}
+			else if (edit.kind == graph::EditKind::RemoveNode)
+			{
+				// The node at its index was the last one, before
+				for (size_t j = 0; j < numPlacedBefore; ++j)
+				{
+					for (std::pair<GateID, uint32_t>& port : placed[j].inputPorts)
+					{
+						port.second = port.second == edit.node ? (uint32_t)numNodes : port.second;
+					}
+					for (std::pair<GateID, uint32_t>& port : placed[j].outputPorts)
+					{
+						port.second = port.second == edit.node ? (uint32_t)numNodes : port.second;
+					}
+				}
+				++numNodes;
+			}
+		}
+	}
+
+	// Starts the thread if needed, and hands it the graph if it has been edited since it was last handed over.
+	// Called before any other request, so that steps apply to the graph as it is now.
+	void HandOverEdits()
+	{
+		if (!liveThread.joinable())
+		{
+			liveRequests.isRunning = liveIsRunning;
+			liveRequests.tickRate = liveTickRate;
+			liveThread = std::thread(LiveThread);
+		}
+
+		if (handedEditVersion != graph::editVersion)
+		{
+			static std::vector<graph::Edit> edits;
+			static std::vector<PlacedInstance> placed;
+			uint64_t editVersion = graph::editVersion;
+			edits.clear();
+			if (graph::EditsSince(handedJournalPosition, edits))
+			{
+				// Only what changed, for the thread to patch in. Instances are flattened here, where the definitions live.
+				FlattenPlacedInstances(edits, placed);
+				RequestLive([&](LiveRequests& requests)
+				{
+					requests.edits.insert(requests.edits.end(), edits.begin(), edits.end());
+					requests.placed.insert(requests.placed.end(), std::make_move_iterator(placed.begin()), std::make_move_iterator(placed.end()));
+					requests.editVersion = editVersion;
+				});
+			}
+			else
+			{
+				// Built here, where the graph lives, and compiled on the thread
+				Netlist netlist;
+				BuildNetlistFromGraph(netlist);
+				std::vector<uint32_t> instanceGateCounts;
+				for (const graph::ComponentInstance& instance : graph::instances)
+				{
+					instanceGateCounts.push_back((uint32_t)NumGates(FlattenDefinition(instance.definition)));
+				}
+				RequestLive([&](LiveRequests& requests)
+				{
+					std::swap(requests.netlist, netlist);
+					std::swap(requests.instanceGateCounts, instanceGateCounts);
+					requests.edits.clear();
+					requests.placed.clear();
+					requests.editVersion = editVersion;
+					requests.hasNetlist = true;
+				});
+			}
+			handedEditVersion = editVersion;
+			handedJournalPosition = graph::JournalPosition();
+		}
+	}
+
+	void SyncLive()
+	{
+		HandOverEdits();
+
+		Acquire(liveSnapshots);
+		const LiveSnapshot& snapshot = FrontItem(liveSnapshots);
+		liveTick = (int)snapshot.tick;
+		liveHistoryKilobytes = (int)(snapshot.historyBytes / 1024);
+		liveMeasuredTickRate = liveIsRunning ? (int)(snapshot.measuredTicksPerSecond + 0.5) : 0;
+	}
+
+	void StopLive()
+	{
+		if (!liveThread.joinable())
+		{
+			return;
+		}
+		RequestLive([](LiveRequests& requests) { requests.isStopping = true; });
+		liveThread.join();
+		liveRequests = LiveRequests();
+		liveHasRequests = false;
+		handedEditVersion = (uint64_t)(-1);
+		handedJournalPosition = (uint64_t)(-1);
+	}
+
+	// Joins the thread before the statics it uses are destroyed
+	struct StopLiveAtExit
+	{
+		~StopLiveAtExit()
+		{
+			StopLive();
+		}
+	} stopLiveAtExit;
+
+	const LiveSnapshot& CurrentLiveSnapshot()
+	{
+		return FrontItem(liveSnapshots);
+	}
+
+	bool IsLiveCurrent()
+	{
+		return CurrentLiveSnapshot().editVersion == graph::editVersion;
+	}
+
+	void SetLiveRunning(bool running)
+	{
+		HandOverEdits();
+		liveIsRunning = running;
+		RequestLive([=](LiveRequests& requests) { requests.isRunning = running; });
+	}
+
+	void SetLiveTickRate(int ticksPerSecond)
+	{
+		liveTickRate = std::max(ticksPerSecond, 0);
+		RequestLive([](LiveRequests& requests) { requests.tickRate = liveTickRate; });
+	}
+
+	void StepLive()
+	{
+		HandOverEdits();
+		liveIsRunning = false;
+		RequestLive([](LiveRequests& requests)
+		{
+			requests.isRunning = false;
+			++requests.numSteps;
+		});
+	}
+
+	void RewindLive()
+	{
+		HandOverEdits();
+		liveIsRunning = false;
+		const LiveSnapshot& snapshot = CurrentLiveSnapshot();
+		if (IsLiveCurrent() && snapshot.tick <= snapshot.oldestRecordedTick)
+		{
+			console::Warn("simulation: No earlier tick is recorded.");
+		}
+		RequestLive([](LiveRequests& requests)
+		{
+			requests.isRunning = false;
+			++requests.numRewinds;
+		});
+	}
+
+	bool LiveNodeValue(size_t nodeIndex)
+	{
+		const LiveSnapshot& snapshot = CurrentLiveSnapshot();
+		return IsLiveCurrent() && nodeIndex < snapshot.gateOfNode.size() && GetBit(snapshot.state.data(), snapshot.gateOfNode[nodeIndex]);
+	}
+}
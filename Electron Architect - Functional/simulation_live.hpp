@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "simulation.hpp"
+
+// The simulation of the graph being edited, evaluated on a thread of its own at its own tick rate,
+// so that it's neither capped by nor slows down the frame rate.
+//
+// The thread owns the program and its history. After each tick it publishes a snapshot through a triple buffer,
+// and the render loop picks up the newest one once per frame with SyncLive - so everything drawn in a frame
+// is from the same tick, and neither side ever waits for the other.
+// The graph is only read on the render loop: SyncLive hands the thread the graph's journaled edits,
+// which it patches into the program without compiling it again (see simulation_patch.hpp) - or a whole new netlist
+// when the edits weren't all journaled. Patching keeps the history, which can be rewound across edits.
+namespace simulation
+{
+	// What the render loop sees of the live simulation
+	struct LiveSnapshot
+	{
+		// graph::editVersion of the graph the program was compiled from - none yet if -1
+		uint64_t editVersion = (uint64_t)(-1);
+
+		// Renumbered gate of each node, by node index
+		std::vector<GateID> gateOfNode;
+
+		// One bit per renumbered gate, as of `tick`
+		std::vector<uint64_t> state;
+
+		uint64_t tick = 0;
+		uint64_t oldestRecordedTick = 0;
+		size_t historyBytes = 0;
+
+		// Ticks actually evaluated per second, averaged over the last fraction of a second
+		double measuredTicksPerSecond = 0.0;
+	};
+
+	// Mirrors of the newest snapshot and the settings, for linking to the properties panel
+	extern int liveTick;
+	extern int liveHistoryKilobytes;
+	extern int liveTickRate;
+	extern int liveMeasuredTickRate;
+	extern bool liveIsRunning;
+
+	// Called once per frame, before drawing. Starts the thread if it isn't running,
+	// hands it the graph if it has been edited, and takes the newest snapshot.
+	void SyncLive();
+
+	// Joins the thread. Called automatically at exit.
+	void StopLive();
+
+	// The snapshot taken by the last SyncLive
+	const LiveSnapshot& CurrentLiveSnapshot();
+
+	// Whether the current snapshot was simulated from the graph as it is now
+	bool IsLiveCurrent();
+
+	// Runs or pauses the thread's ticking. Paused, it only steps when asked to.
+	void SetLiveRunning(bool running);
+
+	// Ticks per second while running. 0 runs as fast as the thread can.
+	void SetLiveTickRate(int ticksPerSecond);
+
+	// Pauses, then steps once and records the tick
+	void StepLive();
+
+	// Pauses, then seeks one tick back through the history
+	void RewindLive();
+
+	// Output of the node at `nodeIndex` as of the current snapshot. Off if the graph has changed since it was compiled.
+	bool LiveNodeValue(size_t nodeIndex);
+}
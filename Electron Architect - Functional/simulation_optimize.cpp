@@ -0,0 +1,402 @@
+#include <algorithm>
+#include "simulation_hashing.hpp"
+#include "simulation_optimize.hpp"
+
+namespace simulation
+{
+	enum class Fold : char
+	{
+		Live,  // Still a gate, with simplified inputs
+		Off,   // Always off
+		On,    // Always on
+		Alias, // Always the same as another gate
+	};
+
+	// What each gate of the original netlist has been simplified to so far
+	struct Folding
+	{
+		std::vector<Fold> fold;
+		std::vector<GateID> alias; // For Alias gates: the Live gate they equal
+
+		// Live gates' simplified type and inputs - a rewritten gate's inputs are appended to `inputs` afresh
+		std::vector<NodeType> type;
+		std::vector<uint32_t> firstInput;
+		std::vector<uint32_t> numInputs;
+		std::vector<GateID> inputs;
+
+		std::vector<bool> inLoop;
+	};
+
+	bool IsNamed(const Netlist& netlist, GateID gate)
+	{
+		if (netlist.nodes.empty() || !graph::IsNodeValid(netlist.nodes[gate]))
+		{
+			return false;
+		}
+		return At(graph::nodeName, graph::NodeIndex(netlist.nodes[gate])) != graph::EMPTY_NAME;
+	}
+
+	// Simplifies a gate whose inputs have all been simplified already (other than those from its own loop).
+	// Returns whether anything about the gate changed.
+	bool Simplify(Folding& folding, GateID gate, std::vector<GateID>& kept)
+	{
+		kept.clear();
+		uint32_t numOn = 0;
+		uint32_t numOff = 0;
+		const uint32_t first = folding.firstInput[gate];
+		const uint32_t count = folding.numInputs[gate];
+		for (uint32_t i = first; i < first + count; ++i)
+		{
+			GateID input = folding.inputs[i];
+			if (folding.fold[input] == Fold::Alias)
+			{
+				input = folding.alias[input];
+			}
+			switch (folding.fold[input])
+			{
+			case Fold::On:  ++numOn;  break;
+			case Fold::Off: ++numOff; break;
+			default: kept.push_back(input); break;
+			}
+		}
+
+		NodeType type = folding.type[gate];
+		Fold fold = Fold::Live;
+		switch (type)
+		{
+		case NodeType::Any:
+			fold = numOn ? Fold::On : kept.empty() ? Fold::Off : Fold::Live;
+			break;
+		case NodeType::All:
+			fold = numOff ? Fold::Off : kept.empty() ? Fold::On : Fold::Live;
+			break;
+		case NodeType::Non:
+			fold = numOn ? Fold::Off : kept.empty() ? Fold::On : Fold::Live;
+			break;
+		case NodeType::One:
+			if (numOn >= 2)
+			{
+				fold = Fold::Off;
+			}
+			else if (kept.empty())
+			{
+				fold = numOn ? Fold::On : Fold::Off;
+			}
+			else if (numOn)
+			{
+				// Exactly one input is stuck on, so the rest must all be off
+				type = NodeType::Non;
+			}
+			break;
+		}
+
+		// Sorted, so that gates with the same inputs can be matched up. Seeing an input twice changes nothing for these, but does for One.
+		if (fold == Fold::Live)
+		{
+			std::sort(kept.begin(), kept.end());
+			if (type != NodeType::One)
+			{
+				kept.erase(std::unique(kept.begin(), kept.end()), kept.end());
+			}
+		}
+
+		if (fold == Fold::Live && !folding.inLoop[gate] && kept.size() == 1)
+		{
+			GateID input = kept[0];
+			if (type != NodeType::Non)
+			{
+				fold = Fold::Alias;
+				folding.alias[gate] = input;
+			}
+			else if (folding.type[input] == NodeType::Non && folding.numInputs[input] == 1 && !folding.inLoop[input])
+			{
+				fold = Fold::Alias;
+				folding.alias[gate] = folding.inputs[folding.firstInput[input]];
+			}
+		}
+
+		if (fold != Fold::Live)
+		{
+			folding.fold[gate] = fold;
+			return true;
+		}
+		if (type == folding.type[gate] && kept.size() == count && std::equal(kept.begin(), kept.end(), folding.inputs.begin() + first))
+		{
+			return false;
+		}
+		folding.type[gate] = type;
+		folding.firstInput[gate] = (uint32_t)folding.inputs.size();
+		folding.numInputs[gate] = (uint32_t)kept.size();
+		folding.inputs.insert(folding.inputs.end(), kept.begin(), kept.end());
+		return true;
+	}
+
+	// Aliases a simplified gate to a gate already in `table` with the same type and inputs, or adds it to the table if there is none.
+	// Returns whether the gate was aliased.
+	bool MergeDuplicate(Folding& folding, StructureTable& table, GateID gate)
+	{
+		const GateID* inputs = folding.inputs.data() + folding.firstInput[gate];
+		const uint32_t numInputs = folding.numInputs[gate];
+		GateID original = FindOrAddStructure(table, gate, HashStructure(folding.type[gate], inputs, numInputs), [&](GateID other)
+		{
+			return folding.type[other] == folding.type[gate] && folding.numInputs[other] == numInputs &&
+				std::equal(inputs, inputs + numInputs, folding.inputs.data() + folding.firstInput[other]);
+		});
+		if (original == gate)
+		{
+			return false;
+		}
+		folding.fold[gate] = Fold::Alias;
+		folding.alias[gate] = original;
+		return true;
+	}
+
+	// Optimizes for pins already found, one flag per gate
+	void OptimizeForPins(const Netlist& netlist, const std::vector<bool>& isInput, const std::vector<bool>& isOutput, Optimized& optimized)
+	{
+		const uint32_t n = (uint32_t)NumGates(netlist);
+
+		// Simplify each component once its inputs have been, repeating a loop's passes until none of its gates change
+		Folding folding;
+		folding.fold.assign(n, Fold::Live);
+		folding.alias.assign(n, NULL_GATE);
+		folding.type = netlist.types;
+		folding.firstInput.assign(netlist.inputStart.begin(), netlist.inputStart.end() - 1);
+		folding.numInputs.resize(n);
+		for (GateID g = 0; g < n; ++g)
+		{
+			folding.numInputs[g] = netlist.inputStart[g + 1] - netlist.inputStart[g];
+		}
+		folding.inputs = netlist.inputs;
+		folding.inLoop.assign(n, false);
+
+		std::vector<uint32_t> sccStart;
+		std::vector<GateID> sccGates;
+		GroupGatesByScc(netlist, sccStart, sccGates);
+
+		// Gates outside of loops that are still gates once simplified, to merge later ones with the same inputs into
+		StructureTable table;
+		ResetStructureTable(table, n);
+		uint32_t numDuplicates = 0;
+
+		std::vector<GateID> kept;
+		for (size_t c = 0; c + 1 < sccStart.size(); ++c)
+		{
+			const uint32_t begin = sccStart[c];
+			const uint32_t end = sccStart[c + 1];
+			if (end - begin == 1)
+			{
+				GateID g = sccGates[begin];
+				const uint32_t first = netlist.inputStart[g];
+				const uint32_t last = netlist.inputStart[g + 1];
+				folding.inLoop[g] = std::find(netlist.inputs.begin() + first, netlist.inputs.begin() + last, g) != netlist.inputs.begin() + last;
+			}
+			else
+			{
+				for (uint32_t i = begin; i < end; ++i)
+				{
+					folding.inLoop[sccGates[i]] = true;
+				}
+			}
+
+			bool changed;
+			do
+			{
+				changed = false;
+				for (uint32_t i = begin; i < end; ++i)
+				{
+					GateID g = sccGates[i];
+					if (folding.fold[g] != Fold::Live)
+					{
+						continue;
+					}
+					if (folding.numInputs[g] == 0)
+					{
+						if (!isInput[g])
+						{
+							folding.fold[g] = netlist.types[g] == NodeType::Non ? Fold::On : Fold::Off;
+						}
+						continue;
+					}
+					changed |= Simplify(folding, g, kept);
+					if (folding.fold[g] == Fold::Live && !folding.inLoop[g] && MergeDuplicate(folding, table, g))
+					{
+						++numDuplicates;
+					}
+				}
+			} while (changed && folding.inLoop[sccGates[begin]]);
+		}
+
+		// Keep only what the pins need
+		std::vector<bool> needed(n, false);
+		std::vector<GateID> stack;
+		bool needOff = false;
+		bool needOn = false;
+		for (GateID g = 0; g < n; ++g)
+		{
+			if (!isInput[g] && !isOutput[g])
+			{
+				continue;
+			}
+			GateID gate = folding.fold[g] == Fold::Alias ? folding.alias[g] : g;
+			needOff |= folding.fold[gate] == Fold::Off;
+			needOn |= folding.fold[gate] == Fold::On;
+			if (folding.fold[gate] == Fold::Live && !needed[gate])
+			{
+				needed[gate] = true;
+				stack.push_back(gate);
+			}
+		}
+		while (!stack.empty())
+		{
+			GateID gate = stack.back();
+			stack.pop_back();
+			for (uint32_t i = folding.firstInput[gate]; i < folding.firstInput[gate] + folding.numInputs[gate]; ++i)
+			{
+				GateID input = folding.inputs[i];
+				if (!needed[input])
+				{
+					needed[input] = true;
+					stack.push_back(input);
+				}
+			}
+		}
+
+		// Renumber what's left, keeping the original order
+		std::vector<GateID> newGate(n, NULL_GATE);
+		GateID numKept = 0;
+		for (GateID g = 0; g < n; ++g)
+		{
+			if (needed[g])
+			{
+				newGate[g] = numKept++;
+			}
+		}
+
+		Netlist& result = optimized.netlist;
+		const bool hasSccOrder = netlist.sccOrder.size() == n && n != 0;
+		uint32_t endOfSccOrder = 0;
+		result = {};
+		optimized.originalOfGate.clear();
+		for (GateID g = 0; g < n; ++g)
+		{
+			if (hasSccOrder)
+			{
+				endOfSccOrder = std::max(endOfSccOrder, netlist.sccOrder[g] + 1);
+			}
+			if (!needed[g])
+			{
+				continue;
+			}
+			const uint32_t first = folding.firstInput[g];
+			for (uint32_t i = first; i < first + folding.numInputs[g]; ++i)
+			{
+				result.inputs.push_back(newGate[folding.inputs[i]]);
+			}
+			result.types.push_back(folding.type[g]);
+			result.inputStart.push_back((uint32_t)result.inputs.size());
+			result.nodes.push_back(netlist.nodes.empty() ? graph::NULL_NODE : netlist.nodes[g]);
+			optimized.originalOfGate.push_back(g);
+
+			// Merging only ever points a gate at one earlier in evaluation order, so the order still holds
+			if (hasSccOrder)
+			{
+				result.sccOrder.push_back(netlist.sccOrder[g]);
+			}
+		}
+		// Nothing reads the constants, so they can go anywhere in the order - as long as they don't share a place with a loop
+		GateID offGate = NULL_GATE;
+		GateID onGate = NULL_GATE;
+		if (needOff)
+		{
+			offGate = AddGate(result, NodeType::Any, nullptr, 0);
+			optimized.originalOfGate.push_back(NULL_GATE);
+			if (hasSccOrder)
+			{
+				result.sccOrder.push_back(endOfSccOrder++);
+			}
+		}
+		if (needOn)
+		{
+			onGate = AddGate(result, NodeType::Non, nullptr, 0);
+			optimized.originalOfGate.push_back(NULL_GATE);
+			if (hasSccOrder)
+			{
+				result.sccOrder.push_back(endOfSccOrder++);
+			}
+		}
+
+		std::vector<GateID>& gateOfOriginal = optimized.gateOfOriginal;
+		gateOfOriginal.resize(n);
+		uint32_t numConstant = 0;
+		uint32_t numAliased = 0;
+		for (GateID g = 0; g < n; ++g)
+		{
+			switch (folding.fold[g])
+			{
+			case Fold::Live:  gateOfOriginal[g] = newGate[g]; break;
+			case Fold::Off:   gateOfOriginal[g] = offGate; ++numConstant; break;
+			case Fold::On:    gateOfOriginal[g] = onGate;  ++numConstant; break;
+			case Fold::Alias: gateOfOriginal[g] = newGate[folding.alias[g]]; ++numAliased; break;
+			}
+		}
+		optimized.numConstant = numConstant;
+		optimized.numWires = numAliased - numDuplicates;
+		optimized.numDuplicates = numDuplicates;
+		optimized.numUnused = n - numConstant - numAliased - numKept;
+	}
+
+	void Optimize(const Netlist& netlist, Pins pins, Optimized& optimized)
+	{
+		const uint32_t n = (uint32_t)NumGates(netlist);
+
+		// Find the pins
+		std::vector<bool> isInput(n, false);
+		std::vector<bool> isOutput(n, false);
+		std::vector<bool> hasFanOut(n, false);
+		for (GateID input : netlist.inputs)
+		{
+			hasFanOut[input] = true;
+		}
+		bool anyNamedInputs = false;
+		bool anyNamedOutputs = false;
+		for (GateID g = 0; g < n && pins == Pins::Named; ++g)
+		{
+			bool isSource = netlist.inputStart[g] == netlist.inputStart[g + 1];
+			if (IsNamed(netlist, g))
+			{
+				(isSource ? isInput : isOutput)[g] = true;
+				(isSource ? anyNamedInputs : anyNamedOutputs) = true;
+			}
+		}
+		for (GateID g = 0; g < n; ++g)
+		{
+			bool isSource = netlist.inputStart[g] == netlist.inputStart[g + 1];
+			if (!anyNamedInputs && isSource)
+			{
+				isInput[g] = true;
+			}
+			if (!anyNamedOutputs && (!hasFanOut[g] || pins == Pins::Every))
+			{
+				isOutput[g] = true;
+			}
+		}
+		OptimizeForPins(netlist, isInput, isOutput, optimized);
+	}
+
+	void Optimize(const Netlist& netlist, const std::vector<GateID>& inputs, const std::vector<GateID>& outputs, Optimized& optimized)
+	{
+		const uint32_t n = (uint32_t)NumGates(netlist);
+		std::vector<bool> isInput(n, false);
+		std::vector<bool> isOutput(n, false);
+		for (GateID g : inputs)
+		{
+			isInput[g] = true;
+		}
+		for (GateID g : outputs)
+		{
+			isOutput[g] = true;
+		}
+		OptimizeForPins(netlist, isInput, isOutput, optimized);
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <vector>
+#include "simulation.hpp"
+
+// Shrinking a netlist before it's compiled, without touching the graph it came from.
+//
+// Names mark a circuit's pins: a named source is an input, and a named gate with inputs is an output.
+// Unnamed sources are constants, stuck at their starting value.
+// A circuit with no named sources treats every source as an input,
+// and one with no named gates fed by anything treats every gate that feeds nothing as an output.
+namespace simulation
+{
+	// Which gates are pins
+	enum class Pins : char
+	{
+		Named, // As above
+		Every, // Every source is an input and every gate is an output - so only wires and duplicates are merged away, which is exact
+	};
+
+	struct Optimized
+	{
+		Netlist netlist;
+
+		// `gateOfOriginal[g]` is the optimized gate that always has the same value as gate `g` of the original netlist,
+		// or NULL_GATE if `g` was removed. `originalOfGate` goes the other way, to the gate each optimized gate was simplified from -
+		// NULL_GATE for the constant gates.
+		std::vector<GateID> gateOfOriginal;
+		std::vector<GateID> originalOfGate;
+
+		// What became of the original gates that aren't still gates
+		uint32_t numConstant = 0;
+		uint32_t numWires = 0;
+		uint32_t numDuplicates = 0;
+		uint32_t numUnused = 0;
+	};
+
+	// Writes a netlist with the same inputs and outputs as `netlist`, but usually fewer gates:
+	// - Gates whose value can't change are folded into their readers, or into a single constant gate where an output needs one
+	// - Single-input Any, All and One gates become wires to their input
+	// - A Non of a single-input Non becomes a wire to the inner gate's input
+	// - Repeated inputs of Any, All and Non gates are dropped
+	// - Gates with the same type and inputs as another gate are merged into it (see simulation_hashing.hpp)
+	// - Gates that no output depends on are removed
+	// Gates within feedback loops are only ever folded to constants, so loops that settle still settle to the same values.
+	// A loop that oscillates may end each tick at a different point in its cycle than it would have.
+	// The optimized netlist keeps `netlist.sccOrder`, if it has one.
+	void Optimize(const Netlist& netlist, Pins pins, Optimized& optimized);
+
+	// As above, for pins the caller has already found: `inputs` are the only sources whose value can change,
+	// and `outputs` the only gates anything reads. Every other source is a constant, stuck at its starting value.
+	void Optimize(const Netlist& netlist, const std::vector<GateID>& inputs, const std::vector<GateID>& outputs, Optimized& optimized);
+
+	// Compiles what's left of the netlist once it's optimized for its pins. The program still takes the netlist's gate IDs,
+	// but only those of the pins are sure to have a gate - the rest may have been removed, and map to NULL_GATE.
+	// (Compile itself optimizes with Pins::Every, which keeps every gate.)
+	void Compile(const Netlist& netlist, Pins pins, Program& program);
+	void Compile(const Netlist& netlist, const std::vector<GateID>& inputs, const std::vector<GateID>& outputs, Program& program);
+}
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <chrono>
+#include "workers.hpp"
+#include "simulation_parallel.hpp"
+
+namespace simulation
+{
+	// Components smaller than this are bundled together, so that a tick isn't all scheduling overhead
+	constexpr uint32_t MIN_PARTITION_GATES = 4096;
+
+	uint32_t FindRoot(std::vector<uint32_t>& parent, uint32_t gate)
+	{
+		while (parent[gate] != gate)
+		{
+			parent[gate] = parent[parent[gate]]; // Path halving
+			gate = parent[gate];
+		}
+		return gate;
+	}
+
+	uint32_t FindComponents(const Netlist& netlist, std::vector<uint32_t>& componentOfGate)
+	{
+		const uint32_t n = (uint32_t)NumGates(netlist);
+
+		std::vector<uint32_t> parent(n);
+		for (uint32_t g = 0; g < n; ++g)
+		{
+			parent[g] = g;
+		}
+		for (GateID g = 0; g < n; ++g)
+		{
+			for (uint32_t i = netlist.inputStart[g]; i < netlist.inputStart[g + 1]; ++i)
+			{
+				uint32_t a = FindRoot(parent, g);
+				uint32_t b = FindRoot(parent, netlist.inputs[i]);
+				// Lower root wins, which also keeps the numbering below in order of lowest gate
+				if (a < b) parent[b] = a;
+				else       parent[a] = b;
+			}
+		}
+
+		constexpr uint32_t UNNUMBERED = (uint32_t)(-1);
+		componentOfGate.assign(n, UNNUMBERED);
+		uint32_t numComponents = 0;
+		for (GateID g = 0; g < n; ++g)
+		{
+			uint32_t root = FindRoot(parent, g);
+			if (componentOfGate[root] == UNNUMBERED)
+			{
+				componentOfGate[root] = numComponents++;
+			}
+			componentOfGate[g] = componentOfGate[root];
+		}
+		return numComponents;
+	}
+
+	void CompilePartitioned(const Netlist& netlist, PartitionedProgram& partitioned)
+	{
+		const uint32_t n = (uint32_t)NumGates(netlist);
+
+		std::vector<uint32_t> componentOfGate;
+		uint32_t numComponents = FindComponents(netlist, componentOfGate);
+
+		std::vector<uint32_t> componentSize(numComponents, 0);
+		for (GateID g = 0; g < n; ++g)
+		{
+			++componentSize[componentOfGate[g]];
+		}
+
+		// Largest first, so that big components start early and small ones fill in the gaps
+		std::vector<uint32_t> order(numComponents);
+		for (uint32_t c = 0; c < numComponents; ++c)
+		{
+			order[c] = c;
+		}
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return componentSize[a] > componentSize[b]; });
+
+		std::vector<uint32_t> partitionOfComponent(numComponents);
+		uint32_t numPartitions = 0;
+		uint32_t bundleSize = 0;
+		for (uint32_t c : order)
+		{
+			if (componentSize[c] >= MIN_PARTITION_GATES)
+			{
+				partitionOfComponent[c] = numPartitions++;
+				continue;
+			}
+			if (bundleSize == 0)
+			{
+				++numPartitions;
+			}
+			partitionOfComponent[c] = numPartitions - 1;
+			bundleSize += componentSize[c];
+			if (bundleSize >= MIN_PARTITION_GATES)
+			{
+				bundleSize = 0;
+			}
+		}
+
+		partitioned.partitions.clear();
+		partitioned.partitions.resize(numPartitions);
+		for (uint32_t c = 0; c < numComponents; ++c)
+		{
+			++partitioned.partitions[partitionOfComponent[c]].numComponents;
+		}
+
+		// Gates keep their relative order within a partition
+		partitioned.partitionOfGate.resize(n);
+		partitioned.gateInPartition.resize(n);
+		for (GateID g = 0; g < n; ++g)
+		{
+			uint32_t p = partitionOfComponent[componentOfGate[g]];
+			partitioned.partitionOfGate[g] = p;
+			partitioned.gateInPartition[g] = (GateID)partitioned.partitions[p].netlistGates.size();
+			partitioned.partitions[p].netlistGates.push_back(g);
+		}
+
+		workers::ParallelFor(numPartitions, [&](size_t p)
+		{
+			Partition& partition = partitioned.partitions[p];
+			Netlist part;
+			std::vector<GateID> inputs;
+			for (GateID g : partition.netlistGates)
+			{
+				inputs.clear();
+				for (uint32_t i = netlist.inputStart[g]; i < netlist.inputStart[g + 1]; ++i)
+				{
+					inputs.push_back(partitioned.gateInPartition[netlist.inputs[i]]);
+				}
+				AddGate(part, netlist.types[g], inputs.data(), inputs.size(), netlist.nodes.empty() ? graph::NULL_NODE : netlist.nodes[g]);
+			}
+			Compile(part, partition.program);
+		});
+
+		partitioned.tick = 0;
+	}
+
+	void ResetPartitioned(PartitionedProgram& partitioned)
+	{
+		for (Partition& partition : partitioned.partitions)
+		{
+			Reset(partition.program);
+			partition.lastTickSeconds = 0;
+			partition.totalSeconds = 0;
+		}
+		partitioned.tick = 0;
+	}
+
+	void StepPartitioned(PartitionedProgram& partitioned)
+	{
+		// ParallelFor only returns once every partition is done, which is what keeps ticks in lock-step
+		workers::ParallelFor(partitioned.partitions.size(), [&](size_t p)
+		{
+			Partition& partition = partitioned.partitions[p];
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			Step(partition.program);
+			partition.lastTickSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			partition.totalSeconds += partition.lastTickSeconds;
+		});
+		++partitioned.tick;
+	}
+
+	bool GetOutput(const PartitionedProgram& partitioned, GateID netlistGate)
+	{
+		return GetOutput(partitioned.partitions[partitioned.partitionOfGate[netlistGate]].program, partitioned.gateInPartition[netlistGate]);
+	}
+
+	void SetInput(PartitionedProgram& partitioned, GateID netlistGate, bool value)
+	{
+		SetInput(partitioned.partitions[partitioned.partitionOfGate[netlistGate]].program, partitioned.gateInPartition[netlistGate], value);
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include "simulation.hpp"
+
+// Simulation of a circuit split at the boundaries of its connected components.
+// Components can't affect each other, so each one is stepped on whichever worker thread gets to it first.
+namespace simulation
+{
+	// Labels each gate with its connected component, ignoring which way the wires point.
+	// Components are numbered from 0 in order of their lowest gate. Returns the number of components.
+	// Union-find over the wires - O(gates + wires)
+	uint32_t FindComponents(const Netlist& netlist, std::vector<uint32_t>& componentOfGate);
+
+	// One unit of work: a whole component, or a bundle of components too small to be worth a task each
+	struct Partition
+	{
+		Program program;
+
+		// Netlist gate of each of the partition's own netlist gates
+		std::vector<GateID> netlistGates;
+
+		uint32_t numComponents = 0;
+
+		// Time spent stepping this partition, for profiling
+		double lastTickSeconds = 0;
+		double totalSeconds = 0;
+	};
+
+	struct PartitionedProgram
+	{
+		// Largest first
+		std::vector<Partition> partitions;
+
+		// Where each netlist gate went
+		std::vector<uint32_t> partitionOfGate;
+		std::vector<GateID> gateInPartition;
+
+		uint64_t tick = 0;
+	};
+
+	void CompilePartitioned(const Netlist& netlist, PartitionedProgram& partitioned);
+
+	void ResetPartitioned(PartitionedProgram& partitioned);
+
+	// Steps every partition once, in parallel.
+	// Ticks are lock-step: no partition starts tick `n + 1` before every partition has finished tick `n`.
+	void StepPartitioned(PartitionedProgram& partitioned);
+
+	bool GetOutput(const PartitionedProgram& partitioned, GateID netlistGate);
+
+	void SetInput(PartitionedProgram& partitioned, GateID netlistGate, bool value);
+}
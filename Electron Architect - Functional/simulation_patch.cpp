@@ -0,0 +1,994 @@
+#include <algorithm>
+#include <bit>
+#include <functional>
+#include <queue>
+#include "simulation_patch.hpp"
+
+namespace simulation
+{
+	constexpr Instruction HOLE = { .type = NodeType::Any, .inLoop = false, .numInputs = 0, .firstInput = 0 };
+
+	// Holes laid out after each level: an eighth of its gates, and a few more
+	constexpr uint32_t ROOM_FRACTION = 8;
+	constexpr uint32_t MIN_ROOM = 4;
+
+	// Every added gate starts out as a source, so the sources get more
+	constexpr uint32_t MIN_SOURCE_ROOM = 4096;
+
+	// Holes added at the end when a gate has to move past the last one
+	constexpr uint32_t END_ROOM = 256;
+
+	constexpr size_t NO_LOOP = (size_t)(-1);
+
+	NodeType TypeOfGate(const Program& program, GateID gate)
+	{
+		return gate < program.numSources ? program.sourceTypes[gate] : program.code[gate - program.numSources].type;
+	}
+
+	uint32_t NumInputsOf(const Program& program, GateID gate)
+	{
+		return gate < program.numSources ? 0 : program.code[gate - program.numSources].numInputs;
+	}
+
+	const GateID* InputsOf(const Program& program, GateID gate)
+	{
+		return gate < program.numSources ? nullptr : program.operands.data() + program.code[gate - program.numSources].firstInput;
+	}
+
+	// Index of the loop the gate is in, or NO_LOOP
+	size_t LoopOf(const Program& program, GateID gate)
+	{
+		if (gate < program.numSources || !program.code[gate - program.numSources].inLoop)
+		{
+			return NO_LOOP;
+		}
+		auto it = std::upper_bound(program.loops.begin(), program.loops.end(), gate,
+			[](GateID gate, const Loop& loop) { return gate < loop.first; }) - 1;
+		return it - program.loops.begin();
+	}
+
+	void SortLoops(Program& program)
+	{
+		std::sort(program.loops.begin(), program.loops.end(), [](const Loop& a, const Loop& b) { return a.first < b.first; });
+	}
+
+	// Lays a tightly compiled program out with room after every level.
+	// Gates keep their order, so loops stay contiguous and every other wire still goes forward.
+	void SpreadProgram(const Program& tight, PatchableProgram& patchable)
+	{
+		Program& program = patchable.program;
+		const uint32_t numLevels = (uint32_t)tight.levelStart.size();
+
+		std::vector<GateID> newGate(tight.numGates);
+		std::vector<GateID> levelEnd(numLevels);
+		std::vector<GateID> roomStart(numLevels);
+		GateID cursor = 0;
+		for (uint32_t level = 0; level < numLevels; ++level)
+		{
+			GateID begin = level == 0 ? 0 : tight.numSources + tight.levelStart[level - 1];
+			GateID end = tight.numSources + tight.levelStart[level];
+			for (GateID gate = begin; gate < end; ++gate)
+			{
+				newGate[gate] = cursor++;
+			}
+			roomStart[level] = cursor;
+			cursor += (end - begin) / ROOM_FRACTION + (level == 0 ? MIN_SOURCE_ROOM : MIN_ROOM);
+			levelEnd[level] = cursor;
+		}
+
+		const GateID n = cursor;
+		const GateID numSources = levelEnd[0];
+		program.numGates = n;
+		program.numSources = numSources;
+
+		program.levelStart.resize(numLevels);
+		patchable.isHole.assign((n + 63) / 64, 0);
+		for (uint32_t level = 0; level < numLevels; ++level)
+		{
+			program.levelStart[level] = levelEnd[level] - numSources;
+			for (GateID gate = roomStart[level]; gate < levelEnd[level]; ++gate)
+			{
+				SetBit(patchable.isHole.data(), gate, true);
+			}
+		}
+
+		program.sourceTypes.assign(numSources, NodeType::Any);
+		for (GateID gate = 0; gate < tight.numSources; ++gate)
+		{
+			program.sourceTypes[newGate[gate]] = tight.sourceTypes[gate];
+		}
+
+		program.code.assign(n - numSources, HOLE);
+		program.operands.clear();
+		program.operands.reserve(tight.operands.size());
+		for (GateID gate = tight.numSources; gate < tight.numGates; ++gate)
+		{
+			Instruction instruction = tight.code[gate - tight.numSources];
+			const GateID* inputs = tight.operands.data() + instruction.firstInput;
+			instruction.firstInput = (uint32_t)program.operands.size();
+			for (uint32_t i = 0; i < instruction.numInputs; ++i)
+			{
+				program.operands.push_back(newGate[inputs[i]]);
+			}
+			program.code[newGate[gate] - numSources] = instruction;
+		}
+
+		program.loops.clear();
+		for (const Loop& loop : tight.loops)
+		{
+			program.loops.push_back({ newGate[loop.first], newGate[loop.end - 1] + 1 });
+		}
+
+		program.gateOfNetlistGate.resize(tight.gateOfNetlistGate.size());
+		for (GateID netlistGate = 0; netlistGate < tight.gateOfNetlistGate.size(); ++netlistGate)
+		{
+			program.gateOfNetlistGate[netlistGate] = newGate[tight.gateOfNetlistGate[netlistGate]];
+		}
+		program.netlistGateOfGate.assign(n, NULL_GATE);
+		for (GateID gate = 0; gate < tight.numGates; ++gate)
+		{
+			program.netlistGateOfGate[newGate[gate]] = tight.netlistGateOfGate[gate];
+		}
+		program.numWiresMerged = tight.numWiresMerged;
+		program.numDuplicatesMerged = tight.numDuplicatesMerged;
+
+		program.outStart.assign(n + 1, 0);
+		for (GateID input : program.operands)
+		{
+			++program.outStart[input + 1];
+		}
+		for (GateID gate = 0; gate < n; ++gate)
+		{
+			program.outStart[gate + 1] += program.outStart[gate];
+		}
+		program.outEnd.assign(program.outStart.begin(), program.outStart.end() - 1);
+		program.outGates.resize(program.operands.size());
+		for (GateID gate = numSources; gate < n; ++gate)
+		{
+			const Instruction& instruction = program.code[gate - numSources];
+			for (uint32_t i = 0; i < instruction.numInputs; ++i)
+			{
+				program.outGates[program.outEnd[program.operands[instruction.firstInput + i]]++] = gate;
+			}
+		}
+
+		program.state.assign((n + 63) / 64, 0);
+		program.scheduled.assign((n + 63) / 64, 0);
+		program.scheduledWords.assign((program.scheduled.size() + 63) / 64, 0);
+		Reset(program);
+
+		patchable.numWires = program.operands.size();
+	}
+
+	uint64_t LayoutPosition(const PatchableProgram& patchable)
+	{
+		return patchable.layoutStart + patchable.layoutChanges.size();
+	}
+
+	void CompilePatchable(const Netlist& netlist, PatchableProgram& patchable)
+	{
+		CompileBoard(netlist, {}, patchable);
+	}
+
+	// Compiles `netlist` gate for gate and lays it out with room
+	void LayOut(PatchableProgram& patchable, const Netlist& netlist)
+	{
+		Program tight;
+		CompileUnoptimized(netlist, tight);
+		SpreadProgram(tight, patchable);
+	}
+
+	void CompileBoard(const Netlist& netlist, const std::vector<uint32_t>& instanceGateCounts, PatchableProgram& patchable)
+	{
+		LayOut(patchable, netlist);
+
+		// Nothing before this layout can be translated into it
+		patchable.layoutStart = LayoutPosition(patchable) + 1;
+		patchable.layoutChanges.clear();
+		patchable.relayouts.clear();
+
+		// The nodes' gates first, then each instance's
+		GateID numNodeGates = (GateID)NumGates(netlist);
+		for (uint32_t count : instanceGateCounts)
+		{
+			numNodeGates -= count;
+		}
+		patchable.gateOfNode.resize(numNodeGates);
+		patchable.ownerOfGate.resize(NumGates(netlist));
+		for (GateID gate = 0; gate < numNodeGates; ++gate)
+		{
+			patchable.gateOfNode[gate] = gate;
+			patchable.ownerOfGate[gate] = { NO_INSTANCE, gate };
+		}
+		patchable.gatesOfInstance.assign(instanceGateCounts.size(), {});
+		GateID gate = numNodeGates;
+		for (uint32_t instance = 0; instance < instanceGateCounts.size(); ++instance)
+		{
+			for (uint32_t i = 0; i < instanceGateCounts[instance]; ++i)
+			{
+				patchable.gatesOfInstance[instance].push_back(gate);
+				patchable.ownerOfGate[gate++] = { instance, i };
+			}
+		}
+	}
+
+	// The netlist the program was compiled from, with every edit since applied
+	void NetlistOfPatchable(const PatchableProgram& patchable, Netlist& netlist)
+	{
+		static std::vector<GateID> inputs;
+
+		const Program& program = patchable.program;
+		netlist = {};
+		for (GateID netlistGate = 0; netlistGate < program.gateOfNetlistGate.size(); ++netlistGate)
+		{
+			GateID gate = program.gateOfNetlistGate[netlistGate];
+			inputs.clear();
+			for (uint32_t i = 0; i < NumInputsOf(program, gate); ++i)
+			{
+				inputs.push_back(program.netlistGateOfGate[InputsOf(program, gate)[i]]);
+			}
+			AddGate(netlist, TypeOfGate(program, gate), inputs.data(), inputs.size());
+		}
+	}
+
+	// Lays the program out again from `netlist`, keeping the value of every netlist gate it shares with the program, and the tick
+	void RebuildFrom(PatchableProgram& patchable, const Netlist& netlist)
+	{
+		Program& program = patchable.program;
+		std::vector<bool> values(program.gateOfNetlistGate.size());
+		for (GateID netlistGate = 0; netlistGate < values.size(); ++netlistGate)
+		{
+			values[netlistGate] = GetBit(program.state.data(), program.gateOfNetlistGate[netlistGate]);
+		}
+		uint64_t tick = program.tick;
+		std::vector<GateID> oldGateOfNetlistGate = program.gateOfNetlistGate;
+
+		LayOut(patchable, netlist);
+		Relayout& relayout = patchable.relayouts.emplace_back();
+		relayout.layout = LayoutPosition(patchable);
+		relayout.gateWas.assign(program.numGates, NULL_GATE);
+		for (GateID gate = 0; gate < program.numGates; ++gate)
+		{
+			GateID netlistGate = program.netlistGateOfGate[gate];
+			if (netlistGate != NULL_GATE && netlistGate < values.size())
+			{
+				SetBit(program.state.data(), gate, values[netlistGate]);
+				relayout.gateWas[gate] = oldGateOfNetlistGate[netlistGate];
+			}
+		}
+		patchable.layoutChanges.push_back({ NULL_GATE, NULL_GATE });
+		program.tick = tick;
+		++patchable.numRebuilds;
+	}
+
+	void Rebuild(PatchableProgram& patchable)
+	{
+		Netlist netlist;
+		NetlistOfPatchable(patchable, netlist);
+		RebuildFrom(patchable, netlist);
+	}
+
+	// Appends `room` holes to the end of the program
+	void AddRoom(PatchableProgram& patchable, uint32_t room)
+	{
+		Program& program = patchable.program;
+		GateID begin = program.numGates;
+		GateID end = begin + room;
+		program.numGates = end;
+		program.code.resize(end - program.numSources, HOLE);
+		program.outStart.resize(end + 1);
+		std::fill(program.outStart.begin() + begin, program.outStart.end(), 0); // Including the old end marker
+		program.outEnd.resize(end, 0);
+		program.netlistGateOfGate.resize(end, NULL_GATE);
+		program.state.resize((end + 63) / 64, 0);
+		program.scheduled.resize((end + 63) / 64, 0);
+		program.scheduledWords.resize((program.scheduled.size() + 63) / 64, 0);
+		if (!program.levelStart.empty())
+		{
+			program.levelStart.back() = end - program.numSources;
+		}
+
+		patchable.isHole.resize((end + 63) / 64, 0);
+		for (GateID gate = begin; gate < end; ++gate)
+		{
+			SetBit(patchable.isHole.data(), gate, true);
+		}
+	}
+
+	// First of `count` adjacent holes in `[gate, end)`, or NULL_GATE if there's no such run
+	GateID FindHoles(const PatchableProgram& patchable, GateID gate, GateID end, uint32_t count)
+	{
+		const uint64_t* isHole = patchable.isHole.data();
+		while (gate < end)
+		{
+			// Skipping to the next hole a word at a time
+			size_t word = gate / 64;
+			uint64_t bits = isHole[word] & (~0ull << (gate % 64));
+			while (bits == 0)
+			{
+				if (++word * 64 >= end)
+				{
+					return NULL_GATE;
+				}
+				bits = isHole[word];
+			}
+			gate = (GateID)(word * 64 + std::countr_zero(bits));
+			if (gate + count > end)
+			{
+				return NULL_GATE;
+			}
+
+			uint32_t run = 1;
+			while (run < count && GetBit(isHole, gate + run))
+			{
+				++run;
+			}
+			if (run == count)
+			{
+				return gate;
+			}
+			gate += run;
+		}
+		return NULL_GATE;
+	}
+
+	// Takes the nearest `count` adjacent holes after `gate` that aren't sources, making more at the end if there are none
+	GateID TakeHolesAfter(PatchableProgram& patchable, GateID gate, uint32_t count)
+	{
+		Program& program = patchable.program;
+		GateID first = FindHoles(patchable, std::max(gate + 1, program.numSources), program.numGates, count);
+		if (first == NULL_GATE)
+		{
+			first = program.numGates;
+			AddRoom(patchable, count + END_ROOM);
+		}
+		for (GateID hole = first; hole < first + count; ++hole)
+		{
+			SetBit(patchable.isHole.data(), hole, false);
+		}
+		return first;
+	}
+
+	// Takes a hole among the sources, or returns NULL_GATE if there are none
+	GateID TakeSourceHole(PatchableProgram& patchable)
+	{
+		GateID hole = FindHoles(patchable, 0, patchable.program.numSources, 1);
+		if (hole != NULL_GATE)
+		{
+			SetBit(patchable.isHole.data(), hole, false);
+		}
+		return hole;
+	}
+
+	// Turns a gate with no inputs or outputs into a hole
+	void MakeHole(PatchableProgram& patchable, GateID gate)
+	{
+		Program& program = patchable.program;
+		if (gate < program.numSources)
+		{
+			program.sourceTypes[gate] = NodeType::Any;
+		}
+		else
+		{
+			program.code[gate - program.numSources] = HOLE;
+		}
+		SetBit(program.state.data(), gate, false);
+		program.outEnd[gate] = program.outStart[gate];
+		program.netlistGateOfGate[gate] = NULL_GATE;
+		SetBit(patchable.isHole.data(), gate, true);
+	}
+
+	// Moves a gate into a hole, along with its value, its wires, and the references to it from its inputs and outputs.
+	// Where it was becomes a hole. A gate can only become a source if it has no inputs.
+	void MoveGate(PatchableProgram& patchable, GateID from, GateID to)
+	{
+		Program& program = patchable.program;
+		const GateID numSources = program.numSources;
+
+		Instruction instruction = from < numSources
+			? Instruction{ .type = program.sourceTypes[from], .inLoop = false, .numInputs = 0, .firstInput = (uint32_t)program.operands.size() }
+			: program.code[from - numSources];
+		if (to < numSources)
+		{
+			program.sourceTypes[to] = instruction.type;
+		}
+		else
+		{
+			program.code[to - numSources] = instruction;
+		}
+		SetBit(program.state.data(), to, GetBit(program.state.data(), from));
+		program.outStart[to] = program.outStart[from];
+		program.outEnd[to] = program.outEnd[from];
+		GateID netlistGate = program.netlistGateOfGate[from];
+		program.netlistGateOfGate[to] = netlistGate;
+		program.gateOfNetlistGate[netlistGate] = to;
+		patchable.layoutChanges.push_back({ from, to });
+
+		// The lists are shared with `from` until it's made a hole, so a gate wired to itself is fixed up by both loops
+		GateID* inputs = program.operands.data() + instruction.firstInput;
+		for (uint32_t i = 0; i < instruction.numInputs; ++i)
+		{
+			GateID input = inputs[i] == from ? to : inputs[i];
+			std::replace(program.outGates.data() + program.outStart[input], program.outGates.data() + program.outEnd[input], from, to);
+		}
+		for (uint32_t i = program.outStart[to]; i < program.outEnd[to]; ++i)
+		{
+			GateID output = program.outGates[i];
+			const Instruction& outputInstruction = program.code[output - numSources];
+			GateID* outputInputs = program.operands.data() + outputInstruction.firstInput;
+			std::replace(outputInputs, outputInputs + outputInstruction.numInputs, from, to);
+		}
+
+		MakeHole(patchable, from);
+	}
+
+	// The gate right after the last input into `[first, end)` from outside them - or NULL_GATE if nothing is wired into any of them
+	GateID LowestPlace(const Program& program, GateID first, GateID end)
+	{
+		GateID lowest = NULL_GATE;
+		for (GateID gate = first; gate < end; ++gate)
+		{
+			const GateID* inputs = InputsOf(program, gate);
+			for (uint32_t i = 0; i < NumInputsOf(program, gate); ++i)
+			{
+				if (lowest == NULL_GATE)
+				{
+					lowest = 0;
+				}
+				if ((inputs[i] < first || inputs[i] >= end) && inputs[i] + 1 > lowest)
+				{
+					lowest = inputs[i] + 1;
+				}
+			}
+		}
+		return lowest;
+	}
+
+	// Moves the gates, and everything downstream of them, that are no longer after all of their inputs - each into the nearest
+	// holes after its last input. Gates that are already after their inputs stay put,
+	// except that a gate left with no inputs becomes a source again.
+	// Gates are visited in layout order, which puts every gate after the inputs that could have moved -
+	// so each gate (or loop) is settled once, and only ever moves to where it stays.
+	// Returns false if the sources ran out of room, leaving the rest for a rebuild.
+	bool Reorder(PatchableProgram& patchable, const std::vector<GateID>& starts)
+	{
+		static std::priority_queue<GateID, std::vector<GateID>, std::greater<GateID>> queue;
+
+		Program& program = patchable.program;
+		queue = {};
+		for (GateID gate : starts)
+		{
+			queue.push(gate);
+		}
+
+		// Gates are only queued from before they move, so anything below this was already visited
+		GateID visitedEnd = 0;
+		while (!queue.empty())
+		{
+			GateID gate = queue.top();
+			queue.pop();
+			if (gate < visitedEnd || GetBit(patchable.isHole.data(), gate))
+			{
+				continue;
+			}
+
+			size_t loop = LoopOf(program, gate);
+			GateID first = loop == NO_LOOP ? gate : program.loops[loop].first;
+			GateID end = loop == NO_LOOP ? gate + 1 : program.loops[loop].end;
+			visitedEnd = end;
+
+			GateID lowest = LowestPlace(program, first, end);
+			GateID to;
+			if (lowest == NULL_GATE)
+			{
+				if (first < program.numSources)
+				{
+					continue;
+				}
+				to = TakeSourceHole(patchable);
+				if (to == NULL_GATE)
+				{
+					return false;
+				}
+			}
+			else if (first >= lowest && first >= program.numSources)
+			{
+				continue;
+			}
+			else
+			{
+				to = TakeHolesAfter(patchable, lowest - 1, end - first);
+			}
+
+			for (GateID i = 0; i < end - first; ++i)
+			{
+				MoveGate(patchable, first + i, to + i);
+			}
+			if (loop != NO_LOOP)
+			{
+				program.loops[loop] = { to, to + (end - first) };
+				SortLoops(program);
+			}
+
+			for (GateID moved = to; moved < to + (end - first); ++moved)
+			{
+				for (uint32_t i = program.outStart[moved]; i < program.outEnd[moved]; ++i)
+				{
+					GateID output = program.outGates[i];
+					if (output < to || output >= to + (end - first))
+					{
+						queue.push(output);
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	// Whether `target` is downstream of `gate`. Only wires within loops go backwards,
+	// so it only searches up to the end of `target`'s loop, past which it can't be.
+	bool Reaches(const PatchableProgram& patchable, GateID gate, GateID target)
+	{
+		static std::vector<uint32_t> visitStamp;
+		static uint32_t stamp = 0;
+		static std::vector<GateID> stack;
+
+		const Program& program = patchable.program;
+		if (visitStamp.size() < program.numGates)
+		{
+			visitStamp.resize(program.numGates, 0);
+		}
+		if (++stamp == 0)
+		{
+			std::fill(visitStamp.begin(), visitStamp.end(), 0);
+			stamp = 1;
+		}
+
+		size_t loop = LoopOf(program, target);
+		const GateID limit = loop == NO_LOOP ? target + 1 : program.loops[loop].end;
+		stack.assign(1, gate);
+		visitStamp[gate] = stamp;
+		while (!stack.empty())
+		{
+			GateID current = stack.back();
+			stack.pop_back();
+			if (current == target)
+			{
+				return true;
+			}
+			for (uint32_t i = program.outStart[current]; i < program.outEnd[current]; ++i)
+			{
+				GateID output = program.outGates[i];
+				if (visitStamp[output] != stamp && output < limit)
+				{
+					visitStamp[output] = stamp;
+					stack.push_back(output);
+				}
+			}
+		}
+		return false;
+	}
+
+	// Adds `input` to the gate's operands, moving them to the end if they can't grow where they are
+	void AppendInput(Program& program, GateID gate, GateID input)
+	{
+		Instruction& instruction = program.code[gate - program.numSources];
+		if (instruction.numInputs == 0 || instruction.firstInput + instruction.numInputs != program.operands.size())
+		{
+			size_t first = program.operands.size();
+			program.operands.resize(first + instruction.numInputs);
+			std::copy_n(program.operands.begin() + instruction.firstInput, instruction.numInputs, program.operands.begin() + first);
+			instruction.firstInput = (uint32_t)first;
+		}
+		program.operands.push_back(input);
+		++instruction.numInputs;
+	}
+
+	void AppendOutput(Program& program, GateID gate, GateID output)
+	{
+		uint32_t count = program.outEnd[gate] - program.outStart[gate];
+		if (count == 0 || program.outEnd[gate] != program.outGates.size())
+		{
+			size_t first = program.outGates.size();
+			program.outGates.resize(first + count);
+			std::copy_n(program.outGates.begin() + program.outStart[gate], count, program.outGates.begin() + first);
+			program.outStart[gate] = (uint32_t)first;
+			program.outEnd[gate] = (uint32_t)(first + count);
+		}
+		program.outGates.push_back(output);
+		++program.outEnd[gate];
+	}
+
+	// Removes one `value` from the list, swapping the last item into its place. Returns false if it isn't there.
+	bool RemoveOne(GateID* begin, GateID* end, GateID value)
+	{
+		GateID* it = std::find(begin, end, value);
+		if (it == end)
+		{
+			return false;
+		}
+		*it = *(end - 1);
+		return true;
+	}
+
+	// Once edits are done: the event-driven bookkeeping may name gates that moved, and gates whose inputs changed
+	// haven't been evaluated with them, so the next tick sweeps. Also reclaims space left behind by moved lists.
+	void FinishPatch(PatchableProgram& patchable)
+	{
+		Program& program = patchable.program;
+		program.pending.clear();
+		program.needsSweep = true;
+
+		constexpr size_t minWasteToReclaim = 1 << 16;
+		if (program.operands.size() > 2 * patchable.numWires + minWasteToReclaim ||
+			program.outGates.size() > 2 * patchable.numWires + minWasteToReclaim ||
+			program.numGates > 2 * program.gateOfNetlistGate.size() + minWasteToReclaim)
+		{
+			Rebuild(patchable);
+		}
+	}
+
+	void PatchAddGate(PatchableProgram& patchable, NodeType type)
+	{
+		Program& program = patchable.program;
+		GateID gate = TakeSourceHole(patchable);
+		if (gate == NULL_GATE)
+		{
+			Rebuild(patchable);
+			gate = TakeSourceHole(patchable);
+		}
+		program.sourceTypes[gate] = type;
+		SetBit(program.state.data(), gate, SourceDefault(type));
+		patchable.layoutChanges.push_back({ NULL_GATE, gate });
+		program.outEnd[gate] = program.outStart[gate];
+		program.netlistGateOfGate[gate] = (GateID)program.gateOfNetlistGate.size();
+		program.gateOfNetlistGate.push_back(gate);
+	}
+
+	void PatchRemoveGate(PatchableProgram& patchable, GateID netlistGate)
+	{
+		Program& program = patchable.program;
+
+		// The gate can move as its wires go, so it's looked up again each time
+		while (NumInputsOf(program, program.gateOfNetlistGate[netlistGate]) != 0)
+		{
+			GateID gate = program.gateOfNetlistGate[netlistGate];
+			PatchRemoveWire(patchable, program.netlistGateOfGate[InputsOf(program, gate)[0]], netlistGate);
+		}
+		while (program.outEnd[program.gateOfNetlistGate[netlistGate]] != program.outStart[program.gateOfNetlistGate[netlistGate]])
+		{
+			GateID gate = program.gateOfNetlistGate[netlistGate];
+			PatchRemoveWire(patchable, netlistGate, program.netlistGateOfGate[program.outGates[program.outStart[gate]]]);
+		}
+
+		patchable.layoutChanges.push_back({ program.gateOfNetlistGate[netlistGate], NULL_GATE });
+		MakeHole(patchable, program.gateOfNetlistGate[netlistGate]);
+
+		GateID last = (GateID)program.gateOfNetlistGate.size() - 1;
+		if (netlistGate != last)
+		{
+			GateID moved = program.gateOfNetlistGate[last];
+			program.gateOfNetlistGate[netlistGate] = moved;
+			program.netlistGateOfGate[moved] = netlistGate;
+		}
+		program.gateOfNetlistGate.pop_back();
+		FinishPatch(patchable);
+	}
+
+	void PatchAddWire(PatchableProgram& patchable, GateID from, GateID to)
+	{
+		Program& program = patchable.program;
+		GateID input = program.gateOfNetlistGate[from];
+		GateID gate = program.gateOfNetlistGate[to];
+
+		// A gate can only reach gates after it, or of its own loop
+		size_t loop = LoopOf(program, gate);
+		bool isWithinLoop = loop != NO_LOOP && loop == LoopOf(program, input);
+		bool makesLoop = input == gate || (!isWithinLoop && input > gate && Reaches(patchable, gate, input));
+
+		GateID moveTo = NULL_GATE;
+		if (!makesLoop && gate < program.numSources)
+		{
+			// A source can't take inputs, so it becomes a gate after its new input
+			moveTo = TakeHolesAfter(patchable, input, 1);
+		}
+		if (makesLoop)
+		{
+			Netlist netlist;
+			NetlistOfPatchable(patchable, netlist);
+			netlist.inputs.insert(netlist.inputs.begin() + netlist.inputStart[to + 1], from);
+			for (GateID g = to; g < NumGates(netlist); ++g)
+			{
+				++netlist.inputStart[g + 1];
+			}
+			RebuildFrom(patchable, netlist);
+			++patchable.numWires;
+			FinishPatch(patchable);
+			return;
+		}
+
+		std::vector<GateID> starts;
+		if (moveTo != NULL_GATE)
+		{
+			MoveGate(patchable, gate, moveTo);
+			gate = moveTo;
+			starts.assign(program.outGates.begin() + program.outStart[gate], program.outGates.begin() + program.outEnd[gate]);
+		}
+		else if (!isWithinLoop)
+		{
+			starts.push_back(gate);
+		}
+		AppendInput(program, gate, input);
+		AppendOutput(program, input, gate);
+		++patchable.numWires;
+
+		if (!Reorder(patchable, starts))
+		{
+			Rebuild(patchable);
+		}
+		FinishPatch(patchable);
+	}
+
+	void PatchRemoveWire(PatchableProgram& patchable, GateID from, GateID to)
+	{
+		Program& program = patchable.program;
+		GateID input = program.gateOfNetlistGate[from];
+		GateID gate = program.gateOfNetlistGate[to];
+		if (gate < program.numSources)
+		{
+			return;
+		}
+
+		Instruction& instruction = program.code[gate - program.numSources];
+		GateID* inputs = program.operands.data() + instruction.firstInput;
+		if (!RemoveOne(inputs, inputs + instruction.numInputs, input))
+		{
+			return;
+		}
+		--instruction.numInputs;
+		RemoveOne(program.outGates.data() + program.outStart[input], program.outGates.data() + program.outEnd[input], gate);
+		--program.outEnd[input];
+		--patchable.numWires;
+
+		// The loop may come apart
+		size_t loop = LoopOf(program, gate);
+		if (loop != NO_LOOP && loop == LoopOf(program, input))
+		{
+			Rebuild(patchable);
+		}
+		else if (!Reorder(patchable, { gate }))
+		{
+			Rebuild(patchable);
+		}
+		FinishPatch(patchable);
+	}
+
+	// Adds a source as the next netlist gate, on behalf of `owner`
+	GateID AddOwnedGate(PatchableProgram& patchable, NodeType type, GateOwner owner)
+	{
+		PatchAddGate(patchable, type);
+		patchable.ownerOfGate.push_back(owner);
+		return (GateID)(patchable.ownerOfGate.size() - 1);
+	}
+
+	// Removes the gate, and gives whichever node or instance owns the netlist gate renumbered into its place the new number
+	void RemoveOwnedGate(PatchableProgram& patchable, GateID netlistGate)
+	{
+		PatchRemoveGate(patchable, netlistGate);
+		GateID last = (GateID)(patchable.ownerOfGate.size() - 1);
+		if (netlistGate != last)
+		{
+			GateOwner owner = patchable.ownerOfGate[last];
+			patchable.ownerOfGate[netlistGate] = owner;
+			if (owner.instance == NO_INSTANCE)
+			{
+				patchable.gateOfNode[owner.index] = netlistGate;
+			}
+			else
+			{
+				patchable.gatesOfInstance[owner.instance][owner.index] = netlistGate;
+			}
+		}
+		patchable.ownerOfGate.pop_back();
+	}
+
+	void PatchPlaceInstance(PatchableProgram& patchable, const PlacedInstance& placed)
+	{
+		static std::vector<uint32_t> sccStart;
+		static std::vector<GateID> sccGates;
+
+		const Netlist& netlist = placed.netlist;
+		const uint32_t instance = (uint32_t)patchable.gatesOfInstance.size();
+		patchable.gatesOfInstance.emplace_back();
+		for (GateID gate = 0; gate < NumGates(netlist); ++gate)
+		{
+			GateID added = AddOwnedGate(patchable, netlist.types[gate], { instance, gate });
+			patchable.gatesOfInstance[instance].push_back(added);
+		}
+
+		// Wired in evaluation order, so that each gate only moves once its inputs are where they'll stay
+		const std::vector<GateID>& gates = patchable.gatesOfInstance[instance];
+		GroupGatesByScc(netlist, sccStart, sccGates);
+		for (GateID gate : sccGates)
+		{
+			for (uint32_t i = netlist.inputStart[gate]; i < netlist.inputStart[gate + 1]; ++i)
+			{
+				PatchAddWire(patchable, gates[netlist.inputs[i]], gates[gate]);
+			}
+		}
+		for (const std::pair<GateID, uint32_t>& port : placed.inputPorts)
+		{
+			PatchAddWire(patchable, patchable.gateOfNode[port.second], gates[port.first]);
+		}
+		for (const std::pair<GateID, uint32_t>& port : placed.outputPorts)
+		{
+			PatchAddWire(patchable, gates[port.first], patchable.gateOfNode[port.second]);
+		}
+	}
+
+	// Removes the instance's gates, then moves the gates of instance `last` into its index
+	void PatchRemoveInstance(PatchableProgram& patchable, uint32_t instance, uint32_t last)
+	{
+		static std::vector<GateID> gates;
+
+		// From the back, so that no gate of the instance is renumbered before it's removed
+		gates = patchable.gatesOfInstance[instance];
+		std::sort(gates.begin(), gates.end(), std::greater<GateID>());
+		for (GateID gate : gates)
+		{
+			RemoveOwnedGate(patchable, gate);
+		}
+
+		if (instance != last)
+		{
+			patchable.gatesOfInstance[instance] = std::move(patchable.gatesOfInstance[last]);
+			for (GateID gate : patchable.gatesOfInstance[instance])
+			{
+				patchable.ownerOfGate[gate].instance = instance;
+			}
+		}
+		patchable.gatesOfInstance.pop_back();
+	}
+
+	void PatchEdits(PatchableProgram& patchable, const std::vector<graph::Edit>& edits, const std::vector<PlacedInstance>& placed)
+	{
+		std::vector<GateID>& gateOfNode = patchable.gateOfNode;
+		size_t numPlaced = 0;
+		for (const graph::Edit& edit : edits)
+		{
+			switch (edit.kind)
+			{
+			case graph::EditKind::AddNode:
+				gateOfNode.push_back(AddOwnedGate(patchable, edit.type, { NO_INSTANCE, (uint32_t)gateOfNode.size() }));
+				break;
+
+			case graph::EditKind::RemoveNode:
+				RemoveOwnedGate(patchable, gateOfNode[edit.node]);
+				if (edit.node != gateOfNode.size() - 1)
+				{
+					gateOfNode[edit.node] = gateOfNode.back();
+					patchable.ownerOfGate[gateOfNode[edit.node]].index = edit.node;
+				}
+				gateOfNode.pop_back();
+				break;
+
+			case graph::EditKind::AddWire:
+				PatchAddWire(patchable, gateOfNode[edit.node], gateOfNode[edit.endNode]);
+				break;
+
+			case graph::EditKind::RemoveWire:
+				PatchRemoveWire(patchable, gateOfNode[edit.node], gateOfNode[edit.endNode]);
+				break;
+
+			case graph::EditKind::PlaceInstance:
+				PatchPlaceInstance(patchable, placed[numPlaced++]);
+				break;
+
+			case graph::EditKind::RemoveInstance:
+				PatchRemoveInstance(patchable, edit.node, edit.endNode);
+				break;
+			}
+		}
+	}
+
+	bool TranslateState(const PatchableProgram& patchable, uint64_t layout, std::vector<uint64_t>& state)
+	{
+		// Set for gates made since, which take their value from the program
+		static std::vector<uint64_t> isNew;
+		static std::vector<uint64_t> relaidState;
+		static std::vector<uint64_t> relaidIsNew;
+
+		if (layout < patchable.layoutStart || layout > LayoutPosition(patchable))
+		{
+			return false;
+		}
+		const Program& program = patchable.program;
+		isNew.assign(state.size(), 0);
+		auto Fit = [](std::vector<uint64_t>& bits, GateID gate)
+		{
+			if (gate / 64 >= bits.size())
+			{
+				bits.resize(gate / 64 + 1, 0);
+			}
+		};
+		auto Get = [](const std::vector<uint64_t>& bits, GateID gate)
+		{
+			return gate / 64 < bits.size() && GetBit(bits.data(), gate);
+		};
+
+		auto relayout = std::lower_bound(patchable.relayouts.begin(), patchable.relayouts.end(), layout,
+			[](const Relayout& relayout, uint64_t layout) { return relayout.layout < layout; });
+		for (size_t i = layout - patchable.layoutStart; i < patchable.layoutChanges.size(); ++i)
+		{
+			const LayoutChange change = patchable.layoutChanges[i];
+			if (change.from == NULL_GATE && change.to == NULL_GATE)
+			{
+				relaidState.clear();
+				relaidIsNew.clear();
+				for (GateID gate = 0; gate < relayout->gateWas.size(); ++gate)
+				{
+					GateID was = relayout->gateWas[gate];
+					if (was == NULL_GATE)
+					{
+						continue;
+					}
+					Fit(relaidState, gate);
+					Fit(relaidIsNew, gate);
+					SetBit(relaidState.data(), gate, Get(state, was));
+					SetBit(relaidIsNew.data(), gate, Get(isNew, was));
+				}
+				state.swap(relaidState);
+				isNew.swap(relaidIsNew);
+				++relayout;
+			}
+			else if (change.from == NULL_GATE)
+			{
+				Fit(isNew, change.to);
+				SetBit(isNew.data(), change.to, true);
+			}
+			else
+			{
+				bool value = Get(state, change.from);
+				bool wasNew = Get(isNew, change.from);
+				if (change.from / 64 < state.size())
+				{
+					SetBit(state.data(), change.from, false);
+				}
+				if (change.from / 64 < isNew.size())
+				{
+					SetBit(isNew.data(), change.from, false);
+				}
+				if (change.to != NULL_GATE)
+				{
+					Fit(state, change.to);
+					Fit(isNew, change.to);
+					SetBit(state.data(), change.to, value);
+					SetBit(isNew.data(), change.to, wasNew);
+				}
+			}
+		}
+
+		state.resize(program.state.size(), 0);
+		isNew.resize(program.state.size(), 0);
+		for (size_t word = 0; word < state.size(); ++word)
+		{
+			state[word] = (state[word] & ~isNew[word]) | (program.state[word] & isNew[word]);
+		}
+		return true;
+	}
+
+	void ForgetLayoutsBefore(PatchableProgram& patchable, uint64_t layout)
+	{
+		// Only once there's enough to forget to be worth moving the rest down
+		size_t numForgotten = (size_t)std::min<uint64_t>(layout - std::min(layout, patchable.layoutStart), patchable.layoutChanges.size());
+		if (numForgotten * 2 < patchable.layoutChanges.size() || numForgotten == 0)
+		{
+			return;
+		}
+		patchable.layoutChanges.erase(patchable.layoutChanges.begin(), patchable.layoutChanges.begin() + numForgotten);
+		patchable.layoutStart += numForgotten;
+		auto firstKept = std::lower_bound(patchable.relayouts.begin(), patchable.relayouts.end(), patchable.layoutStart,
+			[](const Relayout& relayout, uint64_t layout) { return relayout.layout < layout; });
+		patchable.relayouts.erase(patchable.relayouts.begin(), firstKept);
+	}
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <utility>
+#include <vector>
+#include "simulation.hpp"
+
+// Keeping a compiled program up to date as the netlist it was compiled from is edited, without compiling it again.
+//
+// A sweep only needs every wire from outside a loop to go forward - levels are just how Compile gets there.
+// So a patchable program is laid out level by level, with spare gates ("holes") after every level, and from then on
+// only keeps its wires going forward. Holes have no inputs or outputs, so a sweep spends next to nothing on them
+// and event-driven steps never visit them.
+//
+// Most edits move nothing. A gate only moves when it gets an input from after it: into the nearest hole after that input,
+// taking its value along and fixing up the references to it from its inputs and outputs - and then whatever it now feeds
+// from behind follows, in evaluation order. A gate left with no inputs becomes a source again.
+//
+// Every netlist gate is compiled as its own gate, without Compile's merging (see simulation_optimize.hpp):
+// a merged gate would have to be split back out whenever its inputs or those of a gate merged through it changed,
+// so the program can stand for the netlist, and every edit is local.
+// An edit that makes or breaks a loop, or adds a source when the sources have no room left, lays the whole program out again,
+// as does reclaiming the space that moved gates and wire lists leave behind.
+// That is O(gates); every other edit is O(the gates it moves and their wires).
+// Either way every gate keeps its value, and the tick carries on.
+//
+// Every change to where gates are is logged, so that a state recorded under an earlier layout (see simulation_history.hpp)
+// can be translated into the current one - history doesn't have to be thrown away with each edit.
+namespace simulation
+{
+	constexpr uint32_t NO_INSTANCE = (uint32_t)(-1);
+
+	// Which node or instance on the board a netlist gate was built from
+	struct GateOwner
+	{
+		uint32_t instance; // NO_INSTANCE for a node's gate
+		uint32_t index;    // Node index, or which of the instance's gates it is
+	};
+
+	// A gate moved from `from` to `to`. A NULL_GATE `from` is a gate made where there was a hole,
+	// a NULL_GATE `to` is a gate made a hole, and both NULL_GATE is the whole program laid out again (see Relayout).
+	struct LayoutChange
+	{
+		GateID from;
+		GateID to;
+	};
+
+	struct Relayout
+	{
+		// Layout position of its LayoutChange
+		uint64_t layout;
+
+		// Where each gate was before - NULL_GATE for holes
+		std::vector<GateID> gateWas;
+	};
+
+	struct PatchableProgram
+	{
+		Program program;
+
+		// One bit per gate, set for the holes
+		std::vector<uint64_t> isHole;
+
+		// Wires in the program - operands and fan-out lists that were moved leave unused space behind,
+		// which is reclaimed by laying the program out again once it outgrows this by enough
+		size_t numWires = 0;
+
+		// Number of edits that had to lay the program out again
+		uint64_t numRebuilds = 0;
+
+		// For PatchEdits, which keeps a program of the whole board: the netlist gate of each node, by node index,
+		// the netlist gates of each instance on the board, and which of those each netlist gate is
+		std::vector<GateID> gateOfNode;
+		std::vector<std::vector<GateID>> gatesOfInstance;
+		std::vector<GateOwner> ownerOfGate;
+
+		// Every change to where gates are since layout position `layoutStart`
+		std::vector<LayoutChange> layoutChanges;
+		uint64_t layoutStart = 0;
+		std::vector<Relayout> relayouts;
+	};
+
+	// The gates of an instance placed on the board, flattened where the definitions are (see FlattenDefinition)
+	struct PlacedInstance
+	{
+		Netlist netlist;
+
+		// (Gate of the instance, node index) for the wire from each bound input port's node, and to each bound output port's node.
+		// Node indices are as they were just after the instance was placed.
+		std::vector<std::pair<GateID, uint32_t>> inputPorts;
+		std::vector<std::pair<GateID, uint32_t>> outputPorts;
+	};
+
+	// Compiles with room for edits. Edits refer to gates by the netlist's gate IDs.
+	// States recorded under any earlier program can't be translated into this one.
+	void CompilePatchable(const Netlist& netlist, PatchableProgram& patchable);
+
+	// Compiles a program of the whole board, from BuildNetlistFromGraph, for PatchEdits to keep up to date.
+	// `instanceGateCounts` is the number of gates of each instance on the board, in order.
+	void CompileBoard(const Netlist& netlist, const std::vector<uint32_t>& instanceGateCounts, PatchableProgram& patchable);
+
+	// Adds a source of the given type, as the next netlist gate ID
+	void PatchAddGate(PatchableProgram& patchable, NodeType type);
+
+	// Removes the gate and its wires, then renumbers the last netlist gate to take its ID
+	void PatchRemoveGate(PatchableProgram& patchable, GateID netlistGate);
+
+	void PatchAddWire(PatchableProgram& patchable, GateID from, GateID to);
+
+	// Removes one wire from `from` to `to`, if there is one
+	void PatchRemoveWire(PatchableProgram& patchable, GateID from, GateID to);
+
+	// Applies edits journaled by the graph to a program from CompileBoard - or from CompilePatchable, for a board without instances.
+	// `placed` has the gates of each instance the edits place, in order.
+	void PatchEdits(PatchableProgram& patchable, const std::vector<graph::Edit>& edits, const std::vector<PlacedInstance>& placed = {});
+
+	// Where the log of layout changes is up to. Pass to RecordTick, and later to TranslateState.
+	uint64_t LayoutPosition(const PatchableProgram& patchable);
+
+	// Translates a state recorded at layout position `layout` into the program's layout as it is now.
+	// Gates made since then take the value they have now. Returns false if the changes since then have been forgotten.
+	bool TranslateState(const PatchableProgram& patchable, uint64_t layout, std::vector<uint64_t>& state);
+
+	// Forgets the changes before layout position `layout`, once nothing recorded before it is kept
+	void ForgetLayoutsBefore(PatchableProgram& patchable, uint64_t layout);
+}
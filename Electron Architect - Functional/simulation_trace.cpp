@@ -0,0 +1,430 @@
+#include <algorithm>
+#include <bit>
+#include "console_log.hpp"
+#include "simulation_history.hpp"
+#include "simulation_trace.hpp"
+
+namespace simulation
+{
+	constexpr char TRACE_MAGIC[4] = { 'E', 'A', 'T', 'R' };
+	constexpr uint32_t TRACE_VERSION = 2;
+
+	// Records are handed to the writer this many bytes at a time
+	constexpr size_t TRACE_CHUNK_BYTES = 1 << 16;
+
+	// Chunks waiting for the writer before the run waits for it instead - bounds how much of the trace is in memory
+	constexpr size_t MAX_PENDING_TRACE_CHUNKS = 64;
+
+	void WriteTraceChunks(Trace* trace)
+	{
+		std::vector<std::vector<uint8_t>> writing;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(trace->mutex);
+				trace->wake.wait(lock, [trace] { return !trace->fullChunks.empty() || trace->ending; });
+				if (trace->fullChunks.empty())
+				{
+					return;
+				}
+				writing.swap(trace->fullChunks);
+			}
+			trace->drained.notify_all();
+
+			for (const std::vector<uint8_t>& chunk : writing)
+			{
+				trace->file.write((const char*)chunk.data(), chunk.size());
+			}
+
+			std::lock_guard<std::mutex> lock(trace->mutex);
+			for (std::vector<uint8_t>& chunk : writing)
+			{
+				chunk.clear();
+				trace->spareChunks.push_back(std::move(chunk));
+			}
+			writing.clear();
+		}
+	}
+
+	void HandOffChunk(Trace& trace)
+	{
+		std::unique_lock<std::mutex> lock(trace.mutex);
+		trace.drained.wait(lock, [&trace] { return trace.fullChunks.size() < MAX_PENDING_TRACE_CHUNKS; });
+		trace.fullChunks.push_back(std::move(trace.filling));
+		if (trace.spareChunks.empty())
+		{
+			trace.filling = {};
+			trace.filling.reserve(TRACE_CHUNK_BYTES + 64);
+		}
+		else
+		{
+			trace.filling = std::move(trace.spareChunks.back());
+			trace.spareChunks.pop_back();
+		}
+		lock.unlock();
+		trace.wake.notify_one();
+	}
+
+	// `probes` are state bit indices
+	bool StartTraceBits(Trace& trace, const uint64_t* bits, uint64_t tick, const std::vector<GateID>& probes, const std::vector<std::string>& names, const char* filename)
+	{
+		if (trace.isOpen)
+		{
+			EndTrace(trace);
+		}
+
+		trace.file.open(filename, std::ios::binary);
+		if (!trace.file)
+		{
+			console::Errorf("simulation: Could not write \"%s\".", filename);
+			return false;
+		}
+
+		// Ascending by bit, with the names of repeats gathered onto the first - gates merged by Compile share a bit
+		std::vector<uint32_t> order(probes.size());
+		for (uint32_t i = 0; i < order.size(); ++i)
+		{
+			order[i] = i;
+		}
+		std::stable_sort(order.begin(), order.end(), [&probes](uint32_t a, uint32_t b) { return probes[a] < probes[b]; });
+
+		trace.probeBits.clear();
+		trace.groupWord.clear();
+		trace.groupMask.clear();
+		trace.groupFirstProbe.clear();
+		trace.groupLast.clear();
+		std::vector<std::vector<const std::string*>> probeNames;
+		for (uint32_t i : order)
+		{
+			uint32_t bit = probes[i];
+			if (!trace.probeBits.empty() && trace.probeBits.back() == bit)
+			{
+				std::vector<const std::string*>& aliases = probeNames.back();
+				if (std::none_of(aliases.begin(), aliases.end(), [&](const std::string* name) { return *name == names[i]; }))
+				{
+					aliases.push_back(&names[i]);
+				}
+				continue;
+			}
+			if (trace.groupWord.empty() || trace.groupWord.back() != bit / 64)
+			{
+				trace.groupWord.push_back(bit / 64);
+				trace.groupMask.push_back(0);
+				trace.groupFirstProbe.push_back((uint32_t)trace.probeBits.size());
+			}
+			trace.groupMask.back() |= 1ull << (bit % 64);
+			trace.probeBits.push_back(bit);
+			probeNames.push_back({ &names[i] });
+		}
+		for (size_t g = 0; g < trace.groupWord.size(); ++g)
+		{
+			trace.groupLast.push_back(bits[trace.groupWord[g]] & trace.groupMask[g]);
+		}
+
+		const uint32_t numProbes = (uint32_t)trace.probeBits.size();
+		trace.file.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+		trace.file.write((const char*)&TRACE_VERSION, sizeof(TRACE_VERSION));
+		trace.file.write((const char*)&numProbes, sizeof(numProbes));
+		trace.file.write((const char*)&tick, sizeof(tick));
+		for (const std::vector<const std::string*>& aliases : probeNames)
+		{
+			uint32_t numNames = (uint32_t)aliases.size();
+			trace.file.write((const char*)&numNames, sizeof(numNames));
+			for (const std::string* name : aliases)
+			{
+				uint32_t length = (uint32_t)name->size();
+				trace.file.write((const char*)&length, sizeof(length));
+				trace.file.write(name->data(), length);
+			}
+		}
+		std::vector<uint64_t> values((numProbes + 63) / 64, 0);
+		for (uint32_t p = 0; p < numProbes; ++p)
+		{
+			SetBit(values.data(), p, GetBit(bits, trace.probeBits[p]));
+		}
+		trace.file.write((const char*)values.data(), values.size() * sizeof(uint64_t));
+
+		trace.lastRecordTick = tick;
+		trace.numTransitions = 0;
+		trace.filling.clear();
+		trace.filling.reserve(TRACE_CHUNK_BYTES + 64);
+		trace.ending = false;
+		trace.isOpen = true;
+		trace.writer = std::thread(WriteTraceChunks, &trace);
+		return true;
+	}
+
+	bool StartTrace(Trace& trace, const Program& program, const std::vector<GateID>& probes, const std::vector<std::string>& names, const char* filename)
+	{
+		std::vector<GateID> bits(probes.size());
+		for (size_t i = 0; i < probes.size(); ++i)
+		{
+			bits[i] = program.gateOfNetlistGate[probes[i]];
+		}
+		return StartTraceBits(trace, program.state.data(), program.tick, bits, names, filename);
+	}
+
+	bool StartTrace(Trace& trace, const Bytecode& bytecode, const BytecodeState& state, uint64_t tick, const std::vector<GateID>& probes, const std::vector<std::string>& names, const char* filename)
+	{
+		std::vector<GateID> bits(probes.size());
+		for (size_t i = 0; i < probes.size(); ++i)
+		{
+			bits[i] = bytecode.gateOfNetlistGate[probes[i]];
+		}
+		return StartTraceBits(trace, state.bits.data(), tick, bits, names, filename);
+	}
+
+	void TraceTickBits(Trace& trace, const uint64_t* bits, uint64_t tick)
+	{
+		static std::vector<uint32_t> changed;
+		changed.clear();
+
+		const size_t numGroups = trace.groupWord.size();
+		for (size_t g = 0; g < numGroups; ++g)
+		{
+			const uint64_t mask = trace.groupMask[g];
+			const uint64_t now = bits[trace.groupWord[g]] & mask;
+			uint64_t flipped = now ^ trace.groupLast[g];
+			if (flipped == 0) [[likely]]
+			{
+				continue;
+			}
+			trace.groupLast[g] = now;
+			for (; flipped; flipped &= flipped - 1)
+			{
+				uint64_t below = (1ull << std::countr_zero(flipped)) - 1;
+				changed.push_back(trace.groupFirstProbe[g] + std::popcount(mask & below));
+			}
+		}
+		if (changed.empty())
+		{
+			return;
+		}
+
+		WriteVarint(trace.filling, tick - trace.lastRecordTick);
+		WriteVarint(trace.filling, changed.size());
+		uint32_t next = 0;
+		for (uint32_t probe : changed)
+		{
+			WriteVarint(trace.filling, probe - next);
+			next = probe + 1;
+		}
+		trace.lastRecordTick = tick;
+		trace.numTransitions += changed.size();
+
+		if (trace.filling.size() >= TRACE_CHUNK_BYTES)
+		{
+			HandOffChunk(trace);
+		}
+	}
+
+	void TraceTick(Trace& trace, const Program& program)
+	{
+		TraceTickBits(trace, program.state.data(), program.tick);
+	}
+
+	void TraceTick(Trace& trace, const BytecodeState& state, uint64_t tick)
+	{
+		TraceTickBits(trace, state.bits.data(), tick);
+	}
+
+	void EndTrace(Trace& trace)
+	{
+		if (!trace.isOpen)
+		{
+			return;
+		}
+		if (!trace.filling.empty())
+		{
+			HandOffChunk(trace);
+		}
+		{
+			std::lock_guard<std::mutex> lock(trace.mutex);
+			trace.ending = true;
+		}
+		trace.wake.notify_one();
+		trace.writer.join();
+		trace.file.close();
+		trace.fullChunks.clear();
+		trace.spareChunks.clear();
+		trace.filling = {};
+		trace.isOpen = false;
+	}
+
+	// Reads a trace file a block at a time, so exporting a long trace doesn't load all of it
+	struct TraceReader
+	{
+		std::ifstream file;
+		std::vector<uint8_t> buffer = std::vector<uint8_t>(1 << 20);
+		size_t at = 0;
+		size_t end = 0;
+	};
+
+	bool ReadTraceByte(TraceReader& reader, uint8_t& byte)
+	{
+		if (reader.at == reader.end)
+		{
+			reader.file.read((char*)reader.buffer.data(), reader.buffer.size());
+			reader.end = (size_t)reader.file.gcount();
+			reader.at = 0;
+			if (reader.end == 0)
+			{
+				return false;
+			}
+		}
+		byte = reader.buffer[reader.at++];
+		return true;
+	}
+
+	bool ReadTraceBytes(TraceReader& reader, void* data, size_t size)
+	{
+		uint8_t* bytes = (uint8_t*)data;
+		for (size_t i = 0; i < size; ++i)
+		{
+			if (!ReadTraceByte(reader, bytes[i]))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool ReadTraceVarint(TraceReader& reader, uint64_t& value)
+	{
+		value = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			uint8_t byte;
+			if (!ReadTraceByte(reader, byte))
+			{
+				return false;
+			}
+			value |= (uint64_t)(byte & 0x7F) << shift;
+			if (!(byte & 0x80))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Identifier codes are printable ASCII, '!' through '~', least significant digit first
+	std::string VcdIdentifier(uint32_t index)
+	{
+		std::string id;
+		do
+		{
+			id += (char)('!' + index % 94);
+			index /= 94;
+		} while (index != 0);
+		return id;
+	}
+
+	bool ExportVcd(const char* traceFilename, const char* vcdFilename)
+	{
+		TraceReader reader;
+		reader.file.open(traceFilename, std::ios::binary);
+		char magic[4];
+		uint32_t version = 0, numProbes = 0;
+		uint64_t tick = 0;
+		if (!reader.file
+			|| !ReadTraceBytes(reader, magic, sizeof(magic)) || !std::equal(magic, magic + 4, TRACE_MAGIC)
+			|| !ReadTraceBytes(reader, &version, sizeof(version)) || version == 0 || version > TRACE_VERSION
+			|| !ReadTraceBytes(reader, &numProbes, sizeof(numProbes))
+			|| !ReadTraceBytes(reader, &tick, sizeof(tick)))
+		{
+			console::Errorf("simulation: \"%s\" is not a trace.", traceFilename);
+			return false;
+		}
+
+		// Version 1 had exactly one name per probe, without a count
+		std::vector<std::vector<std::string>> names(numProbes);
+		for (std::vector<std::string>& aliases : names)
+		{
+			uint32_t numNames = 1;
+			if (version >= 2 && (!ReadTraceBytes(reader, &numNames, sizeof(numNames)) || numNames > (1u << 16)))
+			{
+				console::Errorf("simulation: \"%s\" is not a trace.", traceFilename);
+				return false;
+			}
+			aliases.resize(numNames);
+			for (std::string& name : aliases)
+			{
+				uint32_t length;
+				if (!ReadTraceBytes(reader, &length, sizeof(length)) || length > (1u << 16))
+				{
+					console::Errorf("simulation: \"%s\" is not a trace.", traceFilename);
+					return false;
+				}
+				name.resize(length);
+				ReadTraceBytes(reader, name.data(), length);
+			}
+		}
+		std::vector<uint64_t> values((numProbes + 63) / 64);
+		if (!ReadTraceBytes(reader, values.data(), values.size() * sizeof(uint64_t)))
+		{
+			console::Errorf("simulation: \"%s\" is not a trace.", traceFilename);
+			return false;
+		}
+
+		std::ofstream vcd(vcdFilename);
+		if (!vcd)
+		{
+			console::Errorf("simulation: Could not write \"%s\".", vcdFilename);
+			return false;
+		}
+
+		std::vector<std::string> ids(numProbes);
+		vcd << "$timescale 1ns $end\n$scope module board $end\n";
+		for (uint32_t p = 0; p < numProbes; ++p)
+		{
+			// Probes sharing a bit are declared once per name under the same identifier, which VCD readers show as separate signals
+			ids[p] = VcdIdentifier(p);
+			for (const std::string& alias : names[p])
+			{
+				// VCD names can't hold whitespace
+				std::string name = alias.empty() ? "probe" + std::to_string(p) : alias;
+				std::replace_if(name.begin(), name.end(), [](char c) { return c == ' ' || c == '\t' || c == '\n'; }, '_');
+				vcd << "$var wire 1 " << ids[p] << ' ' << name << " $end\n";
+			}
+		}
+		vcd << "$upscope $end\n$enddefinitions $end\n";
+
+		vcd << '#' << tick << "\n$dumpvars\n";
+		for (uint32_t p = 0; p < numProbes; ++p)
+		{
+			vcd << (GetBit(values.data(), p) ? '1' : '0') << ids[p] << '\n';
+		}
+		vcd << "$end\n";
+
+		uint64_t tickDelta;
+		while (ReadTraceVarint(reader, tickDelta))
+		{
+			uint64_t numChanges;
+			if (!ReadTraceVarint(reader, numChanges))
+			{
+				console::Warnf("simulation: \"%s\" ends partway through a record.", traceFilename);
+				break;
+			}
+			tick += tickDelta;
+			vcd << '#' << tick << '\n';
+
+			uint64_t probe = 0;
+			for (uint64_t i = 0; i < numChanges; ++i)
+			{
+				uint64_t gap;
+				if (!ReadTraceVarint(reader, gap) || probe + gap >= numProbes)
+				{
+					console::Errorf("simulation: \"%s\" has a damaged record at tick %llu.", traceFilename, (unsigned long long)tick);
+					return false;
+				}
+				probe += gap;
+				bool value = !GetBit(values.data(), probe);
+				SetBit(values.data(), probe, value);
+				vcd << (value ? '1' : '0') << ids[probe] << '\n';
+				++probe;
+			}
+		}
+		return true;
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "simulation.hpp"
+#include "simulation_bytecode.hpp"
+
+// Waveform capture: the values of chosen gates ("probes") over a run, written to an append-only binary trace.
+//
+// Only transitions are recorded. Each tick with any is one record: the ticks since the last record,
+// the number of probes that flipped, and the gap in probe index before each one - all as varints.
+// Records are collected into chunks, which a writer thread appends to the file, so the run never waits on the disk
+// unless the disk falls far behind.
+//
+// Probes of gates that share a state bit are recorded once, under all of their names.
+// File layout: "EATR", version, number of probes, starting tick, each probe's names (a count, then each one's length and characters),
+// one bit per probe of its starting value (in uint64s), then records until the end of the file.
+namespace simulation
+{
+	struct Trace
+	{
+		// State bit of each probe, ascending - probes are numbered in this order
+		std::vector<uint32_t> probeBits;
+
+		// Probes grouped by the state word they are in: group `g` is probes `groupFirstProbe[g]` onward,
+		// at the bits of `groupMask[g]` within word `groupWord[g]`
+		std::vector<uint32_t> groupWord;
+		std::vector<uint64_t> groupMask;
+		std::vector<uint32_t> groupFirstProbe;
+
+		// Masked value of each group's word as of the last tick traced
+		std::vector<uint64_t> groupLast;
+
+		uint64_t lastRecordTick = 0;
+		uint64_t numTransitions = 0;
+
+		// Records not yet handed to the writer
+		std::vector<uint8_t> filling;
+
+		std::ofstream file;
+		std::thread writer;
+		std::mutex mutex;
+		std::condition_variable wake;    // Signalled when there are chunks to write, or the trace ends
+		std::condition_variable drained; // Signalled when the writer has taken chunks
+		std::vector<std::vector<uint8_t>> fullChunks;
+		std::vector<std::vector<uint8_t>> spareChunks;
+		bool ending = false;
+		bool isOpen = false;
+	};
+
+	// Starts tracing the netlist gates `probes` of a compiled program, named `names`, from the program's current state.
+	// Returns false if the file can't be written.
+	bool StartTrace(Trace& trace, const Program& program, const std::vector<GateID>& probes, const std::vector<std::string>& names, const char* filename);
+	bool StartTrace(Trace& trace, const Bytecode& bytecode, const BytecodeState& state, uint64_t tick, const std::vector<GateID>& probes, const std::vector<std::string>& names, const char* filename);
+
+	// Records any probes that changed since the last call. Call after each tick.
+	void TraceTick(Trace& trace, const Program& program);
+	void TraceTick(Trace& trace, const BytecodeState& state, uint64_t tick);
+
+	// Writes everything recorded and closes the file
+	void EndTrace(Trace& trace);
+
+	// Converts a trace to a Value Change Dump, with one time unit per tick.
+	// Returns false if the trace can't be read or the VCD can't be written.
+	bool ExportVcd(const char* traceFilename, const char* vcdFilename);
+}
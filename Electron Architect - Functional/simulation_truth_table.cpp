@@ -0,0 +1,246 @@
+#include <chrono>
+#include <fstream>
+#include "console_log.hpp"
+#include "graph_adjacency.hpp"
+#include "simulation_lanes.hpp"
+#include "simulation_optimize.hpp"
+#include "workers.hpp"
+#include "simulation_truth_table.hpp"
+
+namespace simulation
+{
+	constexpr char TRUTH_TABLE_MAGIC[4] = { 'E', 'A', 'T', 'T' };
+	constexpr uint32_t TRUTH_TABLE_VERSION = 1;
+
+	// Blocks evaluated between writes, which bounds how much of the table is in memory at once
+	constexpr uint64_t TRUTH_TABLE_BATCH_BLOCKS = 1024;
+
+	// Blocks per job, so that each job is worth handing to another thread
+	constexpr uint64_t TRUTH_TABLE_JOB_BLOCKS = 16;
+
+	// Gate of each selected node within the selection's netlist, indexed by node index - NULL_GATE for unselected nodes.
+	// Numbered in selection order, skipping repeats.
+	GateID NumberSelection(const ChunkedList<graph::NodeHandle>& selection, std::vector<GateID>& gateOfNode)
+	{
+		gateOfNode.assign(graph::numNodes, NULL_GATE);
+		GateID numGates = 0;
+		for (size_t i = 0; i < selection.num; ++i)
+		{
+			graph::NodeHandle node = At(selection, i);
+			if (graph::IsNodeValid(node) && gateOfNode[graph::NodeIndex(node)] == NULL_GATE)
+			{
+				gateOfNode[graph::NodeIndex(node)] = numGates++;
+			}
+		}
+		return numGates;
+	}
+
+	GateID GateOfNode(const std::vector<GateID>& gateOfNode, graph::NodeHandle node)
+	{
+		return graph::IsNodeValid(node) ? gateOfNode[graph::NodeIndex(node)] : NULL_GATE;
+	}
+
+	void FindSelectionPins(const ChunkedList<graph::NodeHandle>& selection, std::vector<graph::NodeHandle>& inputs, std::vector<graph::NodeHandle>& outputs)
+	{
+		std::vector<GateID> gateOfNode;
+		NumberSelection(selection, gateOfNode);
+
+		inputs.clear();
+		outputs.clear();
+		GateID nextGate = 0;
+		for (size_t i = 0; i < selection.num; ++i)
+		{
+			graph::NodeHandle node = At(selection, i);
+			if (GateOfNode(gateOfNode, node) != nextGate)
+			{
+				continue; // Invalid, or a repeat
+			}
+			++nextGate;
+
+			bool isFedFromInside = false;
+			for (graph::WireHandle w = graph::FirstWireIn(node); w != graph::NULL_WIRE; w = graph::NextWireIn(w))
+			{
+				isFedFromInside |= gateOfNode[graph::NodeIndex(At(graph::wires, graph::WireIndex(w)).startNode)] != NULL_GATE;
+			}
+			bool feedsOutside = graph::FirstWireOut(node) == graph::NULL_WIRE;
+			for (graph::WireHandle w = graph::FirstWireOut(node); w != graph::NULL_WIRE; w = graph::NextWireOut(w))
+			{
+				feedsOutside |= gateOfNode[graph::NodeIndex(At(graph::wires, graph::WireIndex(w)).endNode)] == NULL_GATE;
+			}
+
+			if (!isFedFromInside)
+			{
+				inputs.push_back(node);
+			}
+			if (feedsOutside)
+			{
+				outputs.push_back(node);
+			}
+		}
+	}
+
+	void WriteName(std::ofstream& file, graph::NodeHandle node)
+	{
+		graph::NameID name = At(graph::nodeName, graph::NodeIndex(node));
+		uint32_t length = (uint32_t)graph::NameLength(name);
+		file.write((const char*)&length, sizeof(length));
+		file.write(graph::NameString(name), length);
+	}
+
+	bool BuildSelectionNetlist(const ChunkedList<graph::NodeHandle>& selection,
+		const std::vector<graph::NodeHandle>& inputs, const std::vector<graph::NodeHandle>& outputs,
+		Netlist& netlist, std::vector<GateID>& inputGates, std::vector<GateID>& outputGates)
+	{
+		std::vector<GateID> gateOfNode;
+		const GateID numGates = NumberSelection(selection, gateOfNode);
+		inputGates.resize(inputs.size());
+		outputGates.resize(outputs.size());
+		std::vector<bool> isInput(numGates, false);
+		for (size_t i = 0; i < inputs.size(); ++i)
+		{
+			inputGates[i] = GateOfNode(gateOfNode, inputs[i]);
+			if (inputGates[i] == NULL_GATE)
+			{
+				console::Error("simulation: Every input must be a selected node.");
+				return false;
+			}
+			isInput[inputGates[i]] = true;
+		}
+		for (size_t i = 0; i < outputs.size(); ++i)
+		{
+			outputGates[i] = GateOfNode(gateOfNode, outputs[i]);
+			if (outputGates[i] == NULL_GATE)
+			{
+				console::Error("simulation: Every output must be a selected node.");
+				return false;
+			}
+		}
+
+		netlist = {};
+		std::vector<GateID> gateInputs;
+		for (size_t i = 0; i < selection.num; ++i)
+		{
+			graph::NodeHandle node = At(selection, i);
+			GateID gate = GateOfNode(gateOfNode, node);
+			if (gate != NumGates(netlist))
+			{
+				continue; // Invalid, or a repeat
+			}
+			gateInputs.clear();
+			for (graph::WireHandle w = graph::FirstWireIn(node); w != graph::NULL_WIRE && !isInput[gate]; w = graph::NextWireIn(w))
+			{
+				GateID input = gateOfNode[graph::NodeIndex(At(graph::wires, graph::WireIndex(w)).startNode)];
+				if (input != NULL_GATE)
+				{
+					gateInputs.push_back(input);
+				}
+			}
+			AddGate(netlist, At(graph::nodeType, graph::NodeIndex(node)), gateInputs.data(), gateInputs.size(), node);
+		}
+		return true;
+	}
+
+	bool WriteTruthTable(const ChunkedList<graph::NodeHandle>& selection,
+		const std::vector<graph::NodeHandle>& inputs, const std::vector<graph::NodeHandle>& outputs, const char* filename)
+	{
+		if (inputs.size() > MAX_TRUTH_TABLE_INPUTS)
+		{
+			console::Errorf("simulation: A truth table of %zu inputs would have too many rows (the limit is %zu inputs).", inputs.size(), MAX_TRUTH_TABLE_INPUTS);
+			return false;
+		}
+
+		Netlist netlist;
+		std::vector<GateID> inputGates;
+		std::vector<GateID> outputGates;
+		if (!BuildSelectionNetlist(selection, inputs, outputs, netlist, inputGates, outputGates))
+		{
+			return false;
+		}
+
+		// Only the table's pins are read, and every other source is stuck, so the rest can be folded and trimmed away
+		Program program;
+		Compile(netlist, inputGates, outputGates, program);
+		LogCompiled(program);
+
+		std::ofstream file(filename, std::ios::binary);
+		if (!file)
+		{
+			console::Errorf("simulation: Could not write \"%s\".", filename);
+			return false;
+		}
+		const uint32_t header[3] = { TRUTH_TABLE_VERSION, (uint32_t)inputs.size(), (uint32_t)outputs.size() };
+		file.write(TRUTH_TABLE_MAGIC, sizeof(TRUTH_TABLE_MAGIC));
+		file.write((const char*)header, sizeof(header));
+		for (graph::NodeHandle node : inputs)
+		{
+			WriteName(file, node);
+		}
+		for (graph::NodeHandle node : outputs)
+		{
+			WriteName(file, node);
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		// Each block is NUM_LANES rows, so one block covers LANE_WORDS groups of 64 rows
+		const uint64_t numRows = 1ull << inputs.size();
+		const uint64_t numGroups = (numRows + 63) / 64;
+		const uint64_t numBlocks = (numRows + NUM_LANES - 1) / NUM_LANES;
+		const size_t numOutputs = outputs.size();
+
+		std::vector<uint64_t> batch;
+		for (uint64_t batchStart = 0; batchStart < numBlocks; batchStart += TRUTH_TABLE_BATCH_BLOCKS)
+		{
+			const uint64_t batchBlocks = numBlocks - batchStart < TRUTH_TABLE_BATCH_BLOCKS ? numBlocks - batchStart : TRUTH_TABLE_BATCH_BLOCKS;
+			batch.resize((size_t)(batchBlocks * LANE_WORDS * numOutputs));
+
+			workers::ParallelFor((size_t)((batchBlocks + TRUTH_TABLE_JOB_BLOCKS - 1) / TRUTH_TABLE_JOB_BLOCKS), [&](size_t job)
+			{
+				LaneState lanes;
+				uint64_t words[LANE_WORDS];
+				const uint64_t jobEnd = (job + 1) * TRUTH_TABLE_JOB_BLOCKS < batchBlocks ? (job + 1) * TRUTH_TABLE_JOB_BLOCKS : batchBlocks;
+				for (uint64_t b = job * TRUTH_TABLE_JOB_BLOCKS; b < jobEnd; ++b)
+				{
+					// Starting over for each block, so that loops don't carry anything from one row to the next
+					ResetLanes(program, lanes);
+					for (size_t i = 0; i < inputGates.size(); ++i)
+					{
+						SetInputLanes(program, lanes, inputGates[i], CountingPattern(i, batchStart + b));
+					}
+					StepLanes(program, lanes);
+
+					for (size_t o = 0; o < numOutputs; ++o)
+					{
+						LanesStore(words, GetOutputLanes(program, lanes, outputGates[o]));
+						for (size_t w = 0; w < LANE_WORDS; ++w)
+						{
+							batch[(size_t)((b * LANE_WORDS + w) * numOutputs + o)] = words[w];
+						}
+					}
+				}
+			});
+
+			// The last block can run past the end of the table - the groups there are dropped, and unused rows cleared
+			uint64_t firstGroup = batchStart * LANE_WORDS;
+			uint64_t batchGroups = numGroups - firstGroup < batchBlocks * LANE_WORDS ? numGroups - firstGroup : batchBlocks * LANE_WORDS;
+			if (numRows < 64)
+			{
+				for (size_t o = 0; o < numOutputs; ++o)
+				{
+					batch[o] &= (1ull << numRows) - 1;
+				}
+			}
+			file.write((const char*)batch.data(), (std::streamsize)(batchGroups * numOutputs * sizeof(uint64_t)));
+		}
+
+		if (!file)
+		{
+			console::Errorf("simulation: Ran out of room while writing \"%s\".", filename);
+			return false;
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		console::Logf("simulation: Wrote %llu rows of %zu inputs and %zu outputs to \"%s\" in %.2f seconds.",
+			(unsigned long long)numRows, inputs.size(), numOutputs, filename, seconds);
+		return true;
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <vector>
+#include "chunked_list.hpp"
+#include "simulation.hpp"
+
+// Exhaustive truth tables of part of the graph, evaluated bit-parallel across the worker pool and streamed to a file.
+//
+// File layout (native byte order):
+//   "EATT", version (uint32), number of inputs (uint32), number of outputs (uint32)
+//   The name of each input and then each output: length (uint32) and characters, not terminated
+//   For each group of 64 rows: one uint64 per output, where bit `r` is the output's value in row `group * 64 + r`
+// Row `r` sets input `i` to bit `i` of `r`. Tables of fewer than 64 rows still fill one group, with the unused bits off.
+namespace simulation
+{
+	// Enough to take minutes, even bit-parallel
+	constexpr size_t MAX_TRUTH_TABLE_INPUTS = 32;
+
+	// Inputs are selected nodes that nothing else in the selection feeds.
+	// Outputs are selected nodes that feed something outside of the selection, or nothing at all.
+	void FindSelectionPins(const ChunkedList<graph::NodeHandle>& selection, std::vector<graph::NodeHandle>& inputs, std::vector<graph::NodeHandle>& outputs);
+
+	// Netlist of the selected nodes and the wires between them, in selection order, with the inputs cut off from whatever fed them.
+	// Fills in the netlist gate of each input and output. Returns false if any of them isn't selected.
+	bool BuildSelectionNetlist(const ChunkedList<graph::NodeHandle>& selection,
+		const std::vector<graph::NodeHandle>& inputs, const std::vector<graph::NodeHandle>& outputs,
+		Netlist& netlist, std::vector<GateID>& inputGates, std::vector<GateID>& outputGates);
+
+	// Writes the truth table of the selected nodes, with the wires between them.
+	// Inputs are cut off from whatever fed them, so each is free to take any value. Other sources keep their starting value.
+	// Every input and output must be in the selection. Returns false if the table couldn't be written.
+	bool WriteTruthTable(const ChunkedList<graph::NodeHandle>& selection,
+		const std::vector<graph::NodeHandle>& inputs, const std::vector<graph::NodeHandle>& outputs, const char* filename);
+}
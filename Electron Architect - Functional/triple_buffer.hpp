@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Hands the newest of a stream of values from one thread to another, without either ever waiting on the other.
+//
+// There are three copies of the value: the writer fills one ("back"), the reader holds one ("front"),
+// and the third ("middle") is whichever was published last. Publishing swaps back with middle,
+// and acquiring swaps front with middle if middle is newer - each a single atomic exchange.
+// Neither thread ever touches the copy the other holds, so the reader always sees one whole value,
+// and values the reader is too slow to take are simply replaced.
+template<typename T>
+struct TripleBuffer
+{
+	static constexpr uint8_t INDEX_MASK = 3;
+	static constexpr uint8_t FRESH = 4; // Set on `middle` when it was published after the reader last acquired
+
+	T items[3];
+
+	// Kept off the line the two threads' own indices are on
+	alignas(64) std::atomic<uint8_t> middle = 1;
+	alignas(64) uint8_t back = 0;  // Only touched by the writer
+	alignas(64) uint8_t front = 2; // Only touched by the reader
+};
+
+// The copy the writer fills. Writer only.
+template<typename T>
+inline T& BackItem(TripleBuffer<T>& buffer)
+{
+	return buffer.items[buffer.back];
+}
+
+// Makes the back copy the newest value, and gives the writer another to fill. Writer only.
+// What the writer gets back may hold any older value, so it has to be overwritten in full.
+template<typename T>
+inline void Publish(TripleBuffer<T>& buffer)
+{
+	// Release so the reader sees everything written to the copy; acquire so the reader is done with the one coming back
+	uint8_t previous = buffer.middle.exchange(buffer.back | TripleBuffer<T>::FRESH, std::memory_order_acq_rel);
+	buffer.back = previous & TripleBuffer<T>::INDEX_MASK;
+}
+
+// Takes the newest published value, if there's one the reader doesn't already have. Reader only.
+// Returns whether the front copy changed.
+template<typename T>
+inline bool Acquire(TripleBuffer<T>& buffer)
+{
+	if (!(buffer.middle.load(std::memory_order_relaxed) & TripleBuffer<T>::FRESH))
+	{
+		return false;
+	}
+	uint8_t previous = buffer.middle.exchange(buffer.front, std::memory_order_acq_rel);
+	buffer.front = previous & TripleBuffer<T>::INDEX_MASK;
+	return true;
+}
+
+// The copy the reader holds, as of the last Acquire. Stays the same until the next. Reader only.
+template<typename T>
+inline const T& FrontItem(const TripleBuffer<T>& buffer)
+{
+	return buffer.items[buffer.front];
+}
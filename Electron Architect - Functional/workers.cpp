@@ -0,0 +1,184 @@
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "workers.hpp"
+
+namespace workers
+{
+	// Owner takes from the back, thieves take from the front
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<size_t> items;
+	};
+
+	// Index 0 belongs to whichever thread calls ParallelFor
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+	std::vector<std::thread> threads;
+
+	std::mutex wakeMutex;
+	std::condition_variable wake;
+	uint64_t generation = 0;
+	bool stopping = false;
+
+	const std::function<void(size_t)>* currentJob = nullptr;
+	std::atomic<size_t> remaining = 0;
+	std::mutex doneMutex;
+	std::condition_variable done;
+
+	bool TakeItem(size_t self, size_t& item)
+	{
+		{
+			WorkQueue& own = *queues[self];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if (!own.items.empty())
+			{
+				item = own.items.back();
+				own.items.pop_back();
+				return true;
+			}
+		}
+		for (size_t i = 1; i < queues.size(); ++i)
+		{
+			WorkQueue& victim = *queues[(self + i) % queues.size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.items.empty())
+			{
+				item = victim.items.front();
+				victim.items.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void Work(size_t self)
+	{
+		size_t item;
+		while (TakeItem(self, item))
+		{
+			(*currentJob)(item);
+			if (--remaining == 0)
+			{
+				std::lock_guard<std::mutex> lock(doneMutex);
+				done.notify_one();
+			}
+		}
+	}
+
+	void WorkerMain(size_t self)
+	{
+		uint64_t seenGeneration = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(wakeMutex);
+				wake.wait(lock, [&] { return stopping || generation != seenGeneration; });
+				if (stopping)
+				{
+					return;
+				}
+				seenGeneration = generation;
+			}
+			Work(self);
+		}
+	}
+
+	// Joins the threads before statics they use are destroyed
+	struct StopAtExit
+	{
+		~StopAtExit()
+		{
+			Stop();
+		}
+	} stopAtExit;
+
+	void Start(size_t numThreads)
+	{
+		if (!queues.empty())
+		{
+			return;
+		}
+		if (numThreads == 0)
+		{
+			numThreads = std::thread::hardware_concurrency();
+			if (numThreads == 0)
+			{
+				numThreads = 1;
+			}
+		}
+
+		stopping = false;
+		for (size_t i = 0; i < numThreads; ++i)
+		{
+			queues.push_back(std::make_unique<WorkQueue>());
+		}
+		for (size_t i = 1; i < numThreads; ++i)
+		{
+			threads.emplace_back(WorkerMain, i);
+		}
+	}
+
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		threads.clear();
+		queues.clear();
+	}
+
+	size_t NumThreads()
+	{
+		Start();
+		return queues.size();
+	}
+
+	void ParallelFor(size_t count, const std::function<void(size_t)>& job)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+		Start();
+		if (queues.size() == 1 || count == 1)
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				job(i);
+			}
+			return;
+		}
+
+		// Set before any item is visible - a worker still finishing the last call may pick up new items right away
+		currentJob = &job;
+		remaining = count;
+		for (size_t i = 0; i < count; ++i)
+		{
+			WorkQueue& queue = *queues[i % queues.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			// Pushed to the front so that each owner starts on its earliest (most expensive) item
+			queue.items.push_front(i);
+		}
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex);
+			++generation;
+		}
+		wake.notify_all();
+
+		Work(0);
+
+		std::unique_lock<std::mutex> lock(doneMutex);
+		done.wait(lock, [] { return remaining == 0; });
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <functional>
+
+// A pool of threads shared by everything that runs in parallel.
+// Work is dealt out evenly up front, and threads that run out steal from the others, so uneven jobs still balance.
+namespace workers
+{
+	// Starts the threads if they aren't running. 0 means one per hardware thread, counting the caller.
+	void Start(size_t numThreads = 0);
+
+	// Joins the threads. Called automatically at exit.
+	void Stop();
+
+	// Threads that ParallelFor spreads work across, including the calling thread. Starts the pool if needed.
+	size_t NumThreads();
+
+	// Calls `job(i)` for every `i` in [0, count) across the pool, and returns once every call has finished.
+	// Indices are dealt out in order, so put the most expensive first.
+	// The calling thread works too. Don't call from within a job.
+	void ParallelFor(size_t count, const std::function<void(size_t)>& job);
+}
@@ -0,0 +1,101 @@
+#include <cstdarg>
+#include <stdio.h>
+#include "console_log.hpp"
+
+// The console for the headless runner: logs go straight to the terminal instead of the Console panel.
+// Everything goes to stderr, so that stdout only carries the runner's results.
+namespace console
+{
+	size_t currentIndent = 0;
+
+	void Print(FILE* stream, const char* prefix, const char* fmt, va_list args)
+	{
+		for (size_t i = 0; i < currentIndent; ++i)
+		{
+			fputs("  ", stream);
+		}
+		fputs(prefix, stream);
+		vfprintf(stream, fmt, args);
+		fputc('\n', stream);
+	}
+
+	void Print(FILE* stream, const char* prefix, const char* text)
+	{
+		for (size_t i = 0; i < currentIndent; ++i)
+		{
+			fputs("  ", stream);
+		}
+		fputs(prefix, stream);
+		fputs(text, stream);
+		fputc('\n', stream);
+	}
+
+	void Log(const char* text)
+	{
+		Print(stderr, "", text);
+	}
+
+	void Logf(const char* fmt...)
+	{
+		va_list args;
+		va_start(args, fmt);
+		Print(stderr, "", fmt, args);
+		va_end(args);
+	}
+
+	void Warn(const char* text)
+	{
+		Print(stderr, "warning: ", text);
+	}
+
+	void Warnf(const char* fmt...)
+	{
+		va_list args;
+		va_start(args, fmt);
+		Print(stderr, "warning: ", fmt, args);
+		va_end(args);
+	}
+
+	void Error(const char* text)
+	{
+		Print(stderr, "error: ", text);
+	}
+
+	void Errorf(const char* fmt...)
+	{
+		va_list args;
+		va_start(args, fmt);
+		Print(stderr, "error: ", fmt, args);
+		va_end(args);
+	}
+
+	void Assert(bool condition, const char* text)
+	{
+		if (!condition)
+		{
+			Print(stderr, "assertion failed: ", text);
+		}
+	}
+
+	void Assertf(bool condition, const char* fmt...)
+	{
+		if (!condition)
+		{
+			va_list args;
+			va_start(args, fmt);
+			Print(stderr, "assertion failed: ", fmt, args);
+			va_end(args);
+		}
+	}
+
+	void Group(const char* groupName)
+	{
+		Print(stderr, "", groupName);
+		++currentIndent;
+	}
+
+	void GroupEnd()
+	{
+		--currentIndent;
+	}
+}
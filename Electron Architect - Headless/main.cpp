@@ -0,0 +1,507 @@
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "console_log.hpp"
+#include "graph_storage.hpp"
+#include "simulation.hpp"
+#include "simulation_bytecode.hpp"
+#include "simulation_optimize.hpp"
+#include "simulation_parallel.hpp"
+#include "simulation_trace.hpp"
+#include "workers.hpp"
+#include "benchmark.hpp"
+
+// Runs a saved board without a window, for batch runs on build servers and overnight soak runs.
+// Only the graph, simulation and benchmark sources are linked - nothing that draws.
+
+const char* usage =
+    "usage: \"Electron Architect - Headless\" <file> [options]\n"
+    "       \"Electron Architect - Headless\" --bench\n"
+    "\n"
+    "Loads a graph saved by the editor and simulates it.\n"
+    "Named sources are inputs, and named gates with inputs are outputs.\n"
+    "If no gate with inputs is named, every gate that feeds nothing is an output, named by its node index.\n"
+    "\n"
+    "  --ticks N       Run N ticks (default 1)\n"
+    "  --vectors FILE  Run one tick per line of a test-vector file, instead of --ticks\n"
+    "  --every N       With --ticks, write outputs every N ticks rather than only after the last\n"
+    "  --out FILE      Write outputs to FILE rather than stdout\n"
+    "  --mode MODE     auto, sweep or event (default auto)\n"
+    "  --bytecode      Run the bytecode saved next to the graph, compiling and saving it first if it is out of date\n"
+    "  --trace FILE    Record every transition of the inputs and outputs to a binary trace\n"
+    "  --vcd FILE      With --trace, also convert the trace to a Value Change Dump once the run ends\n"
+    "  --threads N     Step the board's connected parts in parallel on N threads (0 for one per core), timing each part\n"
+    "\n"
+    "A test-vector file names the inputs it drives on its first line, then gives one 0 or 1 per input on each line after.\n"
+    "Blank lines and lines starting with # are skipped. Inputs it doesn't name keep their starting value.\n"
+    "Timing is written to stderr.\n";
+
+using Clock = std::chrono::steady_clock;
+
+double SecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct Options
+{
+    const char* graphFile = nullptr;
+    const char* vectorFile = nullptr;
+    const char* outFile = nullptr;
+    const char* traceFile = nullptr;
+    const char* vcdFile = nullptr;
+    uint64_t ticks = 1;
+    uint64_t every = 0;
+    simulation::StepMode mode = simulation::StepMode::Auto;
+    bool useBytecode = false;
+    bool usePartitions = false;
+    size_t numThreads = 0;
+};
+
+// The board being run, as either a program, its bytecode, or a program per connected part
+struct Board
+{
+    bool useBytecode = false;
+    bool usePartitions = false;
+    simulation::Program program;
+    simulation::PartitionedProgram partitioned;
+    simulation::Bytecode bytecode;
+    simulation::BytecodeState bytecodeState;
+    uint64_t evaluations = 0;
+    uint64_t tick = 0;
+
+    bool isTracing = false;
+    simulation::Trace trace;
+};
+
+void Step(Board& board)
+{
+    if (board.useBytecode)
+    {
+        simulation::RunBytecode(board.bytecode, board.bytecodeState);
+        board.evaluations += board.bytecode.numGates - board.bytecode.numSources;
+    }
+    else if (board.usePartitions)
+    {
+        simulation::StepPartitioned(board.partitioned);
+        for (const simulation::Partition& partition : board.partitioned.partitions)
+        {
+            board.evaluations += partition.program.evaluations;
+        }
+    }
+    else
+    {
+        simulation::Step(board.program);
+        board.evaluations += board.program.evaluations;
+    }
+    ++board.tick;
+
+    if (board.isTracing)
+    {
+        if (board.useBytecode)
+        {
+            simulation::TraceTick(board.trace, board.bytecodeState, board.tick);
+        }
+        else
+        {
+            simulation::TraceTick(board.trace, board.program);
+        }
+    }
+}
+
+bool GetOutput(const Board& board, simulation::GateID gate)
+{
+    if (board.useBytecode)
+    {
+        return simulation::GetOutput(board.bytecode, board.bytecodeState, gate);
+    }
+    if (board.usePartitions)
+    {
+        return simulation::GetOutput(board.partitioned, gate);
+    }
+    return simulation::GetOutput(board.program, gate);
+}
+
+void SetInput(Board& board, simulation::GateID gate, bool value)
+{
+    if (board.useBytecode)
+    {
+        simulation::SetInput(board.bytecode, board.bytecodeState, gate, value);
+    }
+    else if (board.usePartitions)
+    {
+        simulation::SetInput(board.partitioned, gate, value);
+    }
+    else
+    {
+        simulation::SetInput(board.program, gate, value);
+    }
+}
+
+bool ParseOptions(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        bool takesValue = true;
+        if (strcmp(arg, "--ticks") == 0 && value)
+        {
+            options.ticks = strtoull(value, nullptr, 10);
+        }
+        else if (strcmp(arg, "--every") == 0 && value)
+        {
+            options.every = strtoull(value, nullptr, 10);
+        }
+        else if (strcmp(arg, "--vectors") == 0 && value)
+        {
+            options.vectorFile = value;
+        }
+        else if (strcmp(arg, "--out") == 0 && value)
+        {
+            options.outFile = value;
+        }
+        else if (strcmp(arg, "--trace") == 0 && value)
+        {
+            options.traceFile = value;
+        }
+        else if (strcmp(arg, "--vcd") == 0 && value)
+        {
+            options.vcdFile = value;
+        }
+        else if (strcmp(arg, "--threads") == 0 && value)
+        {
+            options.usePartitions = true;
+            options.numThreads = strtoull(value, nullptr, 10);
+        }
+        else if (strcmp(arg, "--mode") == 0 && value)
+        {
+            if      (strcmp(value, "auto")  == 0) options.mode = simulation::StepMode::Auto;
+            else if (strcmp(value, "sweep") == 0) options.mode = simulation::StepMode::Sweep;
+            else if (strcmp(value, "event") == 0) options.mode = simulation::StepMode::Event;
+            else
+            {
+                console::Errorf("Unknown step mode \"%s\".", value);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--bytecode") == 0)
+        {
+            options.useBytecode = true;
+            takesValue = false;
+        }
+        else if (arg[0] != '-' && !options.graphFile)
+        {
+            options.graphFile = arg;
+            takesValue = false;
+        }
+        else
+        {
+            console::Errorf("Unexpected argument \"%s\".", arg);
+            return false;
+        }
+        i += takesValue;
+    }
+    if (!options.graphFile)
+    {
+        console::Error("No graph file given.");
+        return false;
+    }
+    if (options.vcdFile && !options.traceFile)
+    {
+        console::Error("--vcd needs --trace.");
+        return false;
+    }
+    if (options.usePartitions && (options.useBytecode || options.traceFile))
+    {
+        console::Error("--threads can't be used with --bytecode or --trace.");
+        return false;
+    }
+    return true;
+}
+
+// The board's pins, as netlist gates with their names
+struct Pins
+{
+    std::vector<simulation::GateID> inputs;
+    std::vector<std::string> inputNames;
+    std::vector<simulation::GateID> outputs;
+    std::vector<std::string> outputNames;
+};
+
+void FindPins(const simulation::Netlist& netlist, Pins& pins)
+{
+    const size_t n = simulation::NumGates(netlist);
+    std::vector<bool> hasFanOut(n, false);
+    for (simulation::GateID input : netlist.inputs)
+    {
+        hasFanOut[input] = true;
+    }
+
+    // Named as simulation::Optimize finds them - the gates of component instances have no node, so no name
+    for (simulation::GateID g = 0; g < n; ++g)
+    {
+        if (!graph::IsNodeValid(netlist.nodes[g]))
+        {
+            continue;
+        }
+        const char* name = graph::NameString(At(graph::nodeName, graph::NodeIndex(netlist.nodes[g])));
+        if (*name == '\0')
+        {
+            continue;
+        }
+        bool isSource = netlist.inputStart[g] == netlist.inputStart[g + 1];
+        (isSource ? pins.inputs : pins.outputs).push_back(g);
+        (isSource ? pins.inputNames : pins.outputNames).push_back(name);
+    }
+    if (pins.outputs.empty())
+    {
+        for (simulation::GateID g = 0; g < n; ++g)
+        {
+            if (!hasFanOut[g])
+            {
+                pins.outputs.push_back(g);
+                pins.outputNames.push_back("#" + std::to_string(g));
+            }
+        }
+    }
+}
+
+void WriteOutputs(FILE* out, uint64_t tick, const Board& board, const Pins& pins)
+{
+    fprintf(out, "%llu", (unsigned long long)tick);
+    for (simulation::GateID gate : pins.outputs)
+    {
+        fprintf(out, " %c", GetOutput(board, gate) ? '1' : '0');
+    }
+    fputc('\n', out);
+}
+
+// Reads the next line that isn't blank or a comment, split on whitespace
+bool ReadVectorLine(std::ifstream& file, std::vector<std::string>& tokens)
+{
+    std::string line;
+    while (std::getline(file, line))
+    {
+        tokens.clear();
+        size_t at = 0;
+        while (true)
+        {
+            at = line.find_first_not_of(" \t\r", at);
+            if (at == std::string::npos)
+            {
+                break;
+            }
+            size_t end = line.find_first_of(" \t\r", at);
+            tokens.push_back(line.substr(at, end - at));
+            at = end;
+        }
+        if (!tokens.empty() && tokens[0][0] != '#')
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int RunVectors(const Options& options, Board& board, const Pins& pins, FILE* out, uint64_t& ticks)
+{
+    std::ifstream file(options.vectorFile);
+    if (!file)
+    {
+        console::Errorf("Could not open \"%s\".", options.vectorFile);
+        return 1;
+    }
+
+    std::vector<std::string> tokens;
+    std::vector<simulation::GateID> columns;
+    if (ReadVectorLine(file, tokens))
+    {
+        for (const std::string& name : tokens)
+        {
+            size_t i = 0;
+            while (i < pins.inputNames.size() && pins.inputNames[i] != name)
+            {
+                ++i;
+            }
+            if (i == pins.inputNames.size())
+            {
+                console::Errorf("\"%s\" names \"%s\", which is not an input of the board.", options.vectorFile, name.c_str());
+                return 1;
+            }
+            columns.push_back(pins.inputs[i]);
+        }
+    }
+
+    while (ReadVectorLine(file, tokens))
+    {
+        if (tokens.size() != columns.size())
+        {
+            console::Errorf("\"%s\": Vector %llu has %zu values, but there are %zu inputs.",
+                options.vectorFile, (unsigned long long)ticks + 1, tokens.size(), columns.size());
+            return 1;
+        }
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            SetInput(board, columns[i], tokens[i] == "1");
+        }
+        Step(board);
+        ++ticks;
+        WriteOutputs(out, ticks, board, pins);
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+    {
+        benchmark::RunAll();
+        return 0;
+    }
+
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        fputs(usage, stderr);
+        return 2;
+    }
+    if (!std::ifstream(options.graphFile))
+    {
+        console::Errorf("Could not open \"%s\".", options.graphFile);
+        return 1;
+    }
+
+    Board board;
+    board.useBytecode = options.useBytecode;
+    board.usePartitions = options.usePartitions;
+    simulation::Netlist netlist;
+
+    Clock::time_point loadStart = Clock::now();
+    if (options.useBytecode)
+    {
+        if (!simulation::LoadGraphAndBytecode(options.graphFile, board.bytecode))
+        {
+            simulation::SaveBytecode(board.bytecode, simulation::BytecodePath(options.graphFile).c_str());
+        }
+        simulation::ResetBytecode(board.bytecode, board.bytecodeState);
+    }
+    else
+    {
+        graph::Load(options.graphFile);
+    }
+    double loadSeconds = SecondsSince(loadStart);
+
+    Clock::time_point compileStart = Clock::now();
+    simulation::BuildNetlistFromGraph(netlist);
+    if (options.usePartitions)
+    {
+        workers::Start(options.numThreads);
+        simulation::CompilePartitioned(netlist, board.partitioned);
+        for (simulation::Partition& partition : board.partitioned.partitions)
+        {
+            partition.program.mode = options.mode;
+        }
+    }
+    else if (!options.useBytecode)
+    {
+        // Only the pins are driven or read, so everything else can be folded and trimmed away
+        simulation::Compile(netlist, simulation::Pins::Named, board.program);
+        simulation::LogCompiled(board.program);
+        board.program.mode = options.mode;
+    }
+    double compileSeconds = SecondsSince(compileStart);
+
+    Pins pins;
+    FindPins(netlist, pins);
+
+    FILE* out = stdout;
+    if (options.outFile)
+    {
+        out = fopen(options.outFile, "w");
+        if (!out)
+        {
+            console::Errorf("Could not write \"%s\".", options.outFile);
+            return 1;
+        }
+    }
+    fputs("tick", out);
+    for (const std::string& name : pins.outputNames)
+    {
+        fprintf(out, " %s", name.c_str());
+    }
+    fputc('\n', out);
+
+    if (options.traceFile)
+    {
+        std::vector<simulation::GateID> probes = pins.inputs;
+        probes.insert(probes.end(), pins.outputs.begin(), pins.outputs.end());
+        std::vector<std::string> probeNames = pins.inputNames;
+        probeNames.insert(probeNames.end(), pins.outputNames.begin(), pins.outputNames.end());
+
+        board.isTracing = options.useBytecode
+            ? simulation::StartTrace(board.trace, board.bytecode, board.bytecodeState, board.tick, probes, probeNames, options.traceFile)
+            : simulation::StartTrace(board.trace, board.program, probes, probeNames, options.traceFile);
+        if (!board.isTracing)
+        {
+            return 1;
+        }
+    }
+
+    int result = 0;
+    uint64_t ticks = 0;
+    Clock::time_point runStart = Clock::now();
+    if (options.vectorFile)
+    {
+        result = RunVectors(options, board, pins, out, ticks);
+    }
+    else
+    {
+        for (ticks = 0; ticks < options.ticks;)
+        {
+            Step(board);
+            ++ticks;
+            if ((options.every && ticks % options.every == 0) || ticks == options.ticks)
+            {
+                WriteOutputs(out, ticks, board, pins);
+            }
+        }
+    }
+    double runSeconds = SecondsSince(runStart);
+
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+
+    if (board.isTracing)
+    {
+        simulation::EndTrace(board.trace);
+        fprintf(stderr, "trace:   %10llu transitions\n", (unsigned long long)board.trace.numTransitions);
+        if (options.vcdFile && !simulation::ExportVcd(options.traceFile, options.vcdFile))
+        {
+            result = 1;
+        }
+    }
+
+    fprintf(stderr, "load:    %10.3f ms  (%zu nodes, %zu wires, %zu inputs, %zu outputs)\n",
+        loadSeconds * 1000.0, graph::numNodes, graph::numWires, pins.inputs.size(), pins.outputs.size());
+    fprintf(stderr, "compile: %10.3f ms\n", compileSeconds * 1000.0);
+    fprintf(stderr, "run:     %10.3f ms  (%llu ticks, %.0f ticks/s, %.0f gate evals/s)\n",
+        runSeconds * 1000.0, (unsigned long long)ticks, ticks / runSeconds, board.evaluations / runSeconds);
+    if (board.usePartitions)
+    {
+        const std::vector<simulation::Partition>& partitions = board.partitioned.partitions;
+        fprintf(stderr, "threads: %10zu      (%zu partitions)\n", workers::NumThreads(), partitions.size());
+        for (size_t p = 0; p < partitions.size(); ++p)
+        {
+            fprintf(stderr, "  %4zu:  %10.3f ms  (%zu gates, %u components, last tick %.3f us)\n", p, partitions[p].totalSeconds * 1000.0,
+                partitions[p].netlistGates.size(), partitions[p].numComponents, partitions[p].lastTickSeconds * 1e6);
+        }
+    }
+    return result;
+}
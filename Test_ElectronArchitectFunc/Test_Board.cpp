@@ -0,0 +1,433 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include "graph_components.hpp"
+#include "graph_storage.hpp"
+#include "simulation.hpp"
+#include "simulation_equivalence.hpp"
+#include "simulation_truth_table.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace graph;
+
+namespace TestElectronArchitectFunc
+{
+	std::string BoardTempPath(const char* filename)
+	{
+		return (std::filesystem::temp_directory_path() / filename).string();
+	}
+
+	std::string ReadWholeFile(const std::string& filename)
+	{
+		std::ifstream file(filename, std::ios::binary);
+		return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	NodeHandle CreateNamedNode(NodeType type, int x, int y, const char* name, ChunkedList<NodeHandle>& selection)
+	{
+		NodeHandle node = CreateNode(type, x, y);
+		if (name)
+		{
+			At(nodeName, NodeIndex(node)) = InternName(name, strlen(name));
+		}
+		Push(selection, node);
+		return node;
+	}
+
+	void Connect(NodeHandle startNode, NodeHandle endNode)
+	{
+		CreateWire(WireElbow::DiagonalHori, startNode, endNode);
+	}
+
+	// Sum = a ^ b ^ carry in, carry out = a & b | (a ^ b) & carry in
+	DefinitionID DefineFullAdder(int x)
+	{
+		ChunkedList<NodeHandle> selection;
+		NodeHandle a = CreateNamedNode(NodeType::Any, x, 0, "a", selection);
+		NodeHandle b = CreateNamedNode(NodeType::Any, x, 1, "b", selection);
+		NodeHandle carryIn = CreateNamedNode(NodeType::Any, x, 2, "cin", selection);
+		NodeHandle halfSum = CreateNamedNode(NodeType::One, x + 1, 0, nullptr, selection);
+		NodeHandle sum = CreateNamedNode(NodeType::One, x + 2, 0, "sum", selection);
+		NodeHandle bothInputs = CreateNamedNode(NodeType::All, x + 1, 1, nullptr, selection);
+		NodeHandle carried = CreateNamedNode(NodeType::All, x + 1, 2, nullptr, selection);
+		NodeHandle carryOut = CreateNamedNode(NodeType::Any, x + 2, 1, "cout", selection);
+		Connect(a, halfSum);
+		Connect(b, halfSum);
+		Connect(halfSum, sum);
+		Connect(carryIn, sum);
+		Connect(a, bothInputs);
+		Connect(b, bothInputs);
+		Connect(halfSum, carried);
+		Connect(carryIn, carried);
+		Connect(bothInputs, carryOut);
+		Connect(carried, carryOut);
+		return DefineComponent(InternName("full adder", 10), selection, { a, b, carryIn }, { sum, carryOut });
+	}
+
+	TEST_CLASS(TestSerialization)
+	{
+	public:
+
+		TEST_METHOD(SaveAndLoadKeepTheBoard)
+		{
+			ClearNodes();
+			std::mt19937 rng(2);
+			const NodeType types[] = { NodeType::Any, NodeType::All, NodeType::Non, NodeType::One };
+			const char* names[] = { "bus A", "carry", "x y", "bus A" };
+			std::vector<NodeHandle> nodes;
+			for (int i = 0; i < 300; ++i)
+			{
+				nodes.push_back(CreateNode(types[rng() % 4], (int)(rng() % 200) - 100, (int)(rng() % 200) - 100));
+				if (rng() % 8 == 0)
+				{
+					const char* name = names[rng() % 4];
+					At(nodeName, NodeIndex(nodes.back())) = InternName(name, strlen(name));
+				}
+			}
+			for (int i = 0; i < 500; ++i)
+			{
+				CreateWire((WireElbow)(rng() % 4), nodes[rng() % nodes.size()], nodes[rng() % nodes.size()]);
+			}
+			// Some nodes are destroyed, so that indices and handles no longer line up
+			for (int i = 0; i < 30; ++i)
+			{
+				DestroyNode(nodes[i * 7]);
+			}
+			DefinitionID adder = DefineFullAdder(300);
+			Assert::IsTrue(PlaceInstance(adder, 0, 150, 1, { nodes[1], nodes[2], nodes[3], nodes[4], nodes[5] }));
+
+			struct SavedNode
+			{
+				NodeType type;
+				int x;
+				int y;
+				std::string name;
+			};
+			std::vector<SavedNode> savedNodes;
+			for (size_t i = 0; i < numNodes; ++i)
+			{
+				savedNodes.push_back({ At(nodeType, i), At(nodeX, i), At(nodeY, i), NameString(At(nodeName, i)) });
+			}
+			std::vector<LocalWire> savedWires;
+			for (size_t i = 0; i < numWires; ++i)
+			{
+				const Wire& wire = At(wires, i);
+				savedWires.push_back({ wire.elbow, (uint32_t)NodeIndex(wire.startNode), (uint32_t)NodeIndex(wire.endNode) });
+			}
+			std::vector<ComponentDefinition> savedDefinitions = definitions;
+			std::vector<ComponentInstance> savedInstances = instances;
+			std::vector<size_t> savedPorts;
+			for (uint32_t port : instances[0].ports)
+			{
+				savedPorts.push_back(NodeIndex(port));
+			}
+
+			std::string first = BoardTempPath("test_board_first.txt");
+			std::string second = BoardTempPath("test_board_second.txt");
+			Save(first.c_str());
+			ClearNodes();
+			Assert::AreEqual((size_t)0, numNodes);
+			Assert::IsTrue(definitions.empty() && instances.empty());
+			Load(first.c_str());
+
+			Assert::AreEqual(savedNodes.size(), numNodes);
+			for (size_t i = 0; i < numNodes; ++i)
+			{
+				Assert::IsTrue(savedNodes[i].type == At(nodeType, i));
+				Assert::AreEqual(savedNodes[i].x, At(nodeX, i));
+				Assert::AreEqual(savedNodes[i].y, At(nodeY, i));
+				Assert::AreEqual(savedNodes[i].name, std::string(NameString(At(nodeName, i))));
+			}
+			// Names are interned again on loading, so equal names still share an ID
+			NameID busName = InternName("bus A", 5);
+			for (size_t i = 0; i < numNodes; ++i)
+			{
+				Assert::AreEqual(savedNodes[i].name == "bus A", At(nodeName, i) == busName);
+			}
+			Assert::AreEqual(savedWires.size(), numWires);
+			for (size_t i = 0; i < numWires; ++i)
+			{
+				const Wire& wire = At(wires, i);
+				Assert::IsTrue(savedWires[i].elbow == wire.elbow);
+				Assert::AreEqual((size_t)savedWires[i].startNode, NodeIndex(wire.startNode));
+				Assert::AreEqual((size_t)savedWires[i].endNode, NodeIndex(wire.endNode));
+			}
+			Assert::AreEqual(savedDefinitions.size(), definitions.size());
+			Assert::IsTrue(savedDefinitions[0].nodeTypes == definitions[0].nodeTypes);
+			Assert::IsTrue(savedDefinitions[0].inputs == definitions[0].inputs);
+			Assert::IsTrue(savedDefinitions[0].outputs == definitions[0].outputs);
+			Assert::AreEqual(savedDefinitions[0].wires.size(), definitions[0].wires.size());
+			Assert::AreEqual(std::string("full adder"), std::string(NameString(definitions[0].name)));
+			Assert::AreEqual(savedInstances.size(), instances.size());
+			Assert::AreEqual(savedInstances[0].x, instances[0].x);
+			Assert::AreEqual(savedInstances[0].y, instances[0].y);
+			Assert::AreEqual(savedInstances[0].rotation, instances[0].rotation);
+			for (size_t i = 0; i < instances[0].ports.size(); ++i)
+			{
+				Assert::AreEqual(savedPorts[i], NodeIndex(instances[0].ports[i]));
+			}
+
+			// Saving what was loaded writes the same file
+			Save(second.c_str());
+			Assert::IsTrue(ReadWholeFile(first) == ReadWholeFile(second));
+			std::filesystem::remove(first);
+			std::filesystem::remove(second);
+		}
+	};
+
+	TEST_CLASS(TestComponents)
+	{
+	public:
+
+		// Ports of a ripple-carry adder on the board, by node index
+		struct AdderPins
+		{
+			std::vector<simulation::GateID> a;
+			std::vector<simulation::GateID> b;
+			std::vector<simulation::GateID> sum;
+			simulation::GateID carryIn;
+			simulation::GateID carryOut;
+		};
+
+		static void CheckAdds(const AdderPins& pins)
+		{
+			simulation::Netlist netlist;
+			simulation::BuildNetlistFromGraph(netlist);
+			simulation::Program program;
+			simulation::Compile(netlist, program);
+
+			std::mt19937 rng(5);
+			const size_t numBits = pins.a.size();
+			for (int tick = 0; tick < 200; ++tick)
+			{
+				uint32_t a = rng() & ((1u << numBits) - 1);
+				uint32_t b = rng() & ((1u << numBits) - 1);
+				uint32_t carry = rng() & 1;
+				for (size_t i = 0; i < numBits; ++i)
+				{
+					simulation::SetInput(program, pins.a[i], (a >> i) & 1);
+					simulation::SetInput(program, pins.b[i], (b >> i) & 1);
+				}
+				simulation::SetInput(program, pins.carryIn, carry);
+				simulation::Step(program);
+
+				uint32_t sum = (uint32_t)simulation::GetOutput(program, pins.carryOut) << numBits;
+				for (size_t i = 0; i < numBits; ++i)
+				{
+					sum |= (uint32_t)simulation::GetOutput(program, pins.sum[i]) << i;
+				}
+				Assert::AreEqual(a + b + carry, sum);
+			}
+		}
+
+		TEST_METHOD(NestedInstancesAddBeforeAndAfterLoading)
+		{
+			ClearNodes();
+			DefinitionID fullAdder = DefineFullAdder(0);
+			Assert::AreEqual((DefinitionID)0, fullAdder);
+
+			// Two bits, from two instances of the full adder
+			ChunkedList<NodeHandle> selection;
+			NodeHandle a0 = CreateNamedNode(NodeType::Any, 10, 0, nullptr, selection);
+			NodeHandle b0 = CreateNamedNode(NodeType::Any, 10, 1, nullptr, selection);
+			NodeHandle a1 = CreateNamedNode(NodeType::Any, 10, 2, nullptr, selection);
+			NodeHandle b1 = CreateNamedNode(NodeType::Any, 10, 3, nullptr, selection);
+			NodeHandle carry0 = CreateNamedNode(NodeType::Any, 10, 4, nullptr, selection);
+			NodeHandle sum0 = CreateNamedNode(NodeType::Any, 20, 0, nullptr, selection);
+			NodeHandle sum1 = CreateNamedNode(NodeType::Any, 20, 1, nullptr, selection);
+			NodeHandle carry1 = CreateNamedNode(NodeType::Any, 20, 2, nullptr, selection);
+			NodeHandle carry2 = CreateNamedNode(NodeType::Any, 20, 3, nullptr, selection);
+			Assert::IsTrue(PlaceInstance(fullAdder, 100, 0, 0, { a0, b0, carry0, sum0, carry1 }));
+			Assert::IsTrue(PlaceInstance(fullAdder, 100, 10, 1, { a1, b1, carry1, sum1, carry2 }));
+			DefinitionID twoBitAdder = DefineComponent(InternName("2-bit adder", 11), selection, { a0, b0, a1, b1, carry0 }, { sum0, sum1, carry2 });
+			Assert::AreEqual((DefinitionID)1, twoBitAdder);
+			Assert::AreEqual((size_t)2, definitions[twoBitAdder].instances.size());
+
+			// Every port has to be selected
+			ChunkedList<NodeHandle> unrelated;
+			CreateNamedNode(NodeType::Any, 30, 0, nullptr, unrelated);
+			Assert::AreEqual(NULL_DEFINITION, DefineComponent(InternName("broken", 6), unrelated, { a0 }, {}));
+
+			// Sixteen bits, from eight instances of the two-bit adder
+			AdderPins pins;
+			NodeHandle carry = CreateNode(NodeType::Any, 0, 0);
+			pins.carryIn = (simulation::GateID)NodeIndex(carry);
+			for (int k = 0; k < 8; ++k)
+			{
+				NodeHandle ports[7];
+				for (int i = 0; i < 7; ++i)
+				{
+					ports[i] = CreateNode(NodeType::Any, i, 20 + k * 5);
+				}
+				Assert::IsTrue(PlaceInstance(twoBitAdder, 0, 20 + k * 5, 0, { ports[0], ports[1], ports[2], ports[3], carry, ports[4], ports[5], ports[6] }));
+				pins.a.push_back((simulation::GateID)NodeIndex(ports[0]));
+				pins.a.push_back((simulation::GateID)NodeIndex(ports[2]));
+				pins.b.push_back((simulation::GateID)NodeIndex(ports[1]));
+				pins.b.push_back((simulation::GateID)NodeIndex(ports[3]));
+				pins.sum.push_back((simulation::GateID)NodeIndex(ports[4]));
+				pins.sum.push_back((simulation::GateID)NodeIndex(ports[5]));
+				carry = ports[6];
+			}
+			pins.carryOut = (simulation::GateID)NodeIndex(carry);
+			CheckAdds(pins);
+
+			std::string filename = BoardTempPath("test_board_components.txt");
+			Save(filename.c_str());
+			size_t numInstances = instances.size();
+			ClearNodes();
+			Load(filename.c_str());
+			std::filesystem::remove(filename);
+			Assert::AreEqual((size_t)2, definitions.size());
+			Assert::AreEqual(numInstances, instances.size());
+			CheckAdds(pins);
+		}
+	};
+
+	TEST_CLASS(TestTruthTable)
+	{
+	public:
+
+		TEST_METHOD(FullAdderTableAddsEveryRow)
+		{
+			ClearNodes();
+			ChunkedList<NodeHandle> selection;
+			NodeHandle a = CreateNamedNode(NodeType::Any, 0, 0, "a", selection);
+			NodeHandle b = CreateNamedNode(NodeType::Any, 0, 1, "b", selection);
+			NodeHandle carryIn = CreateNamedNode(NodeType::Any, 0, 2, "cin", selection);
+			NodeHandle halfSum = CreateNamedNode(NodeType::One, 1, 0, nullptr, selection);
+			NodeHandle sum = CreateNamedNode(NodeType::One, 2, 0, "sum", selection);
+			NodeHandle bothInputs = CreateNamedNode(NodeType::All, 1, 1, nullptr, selection);
+			NodeHandle carried = CreateNamedNode(NodeType::All, 1, 2, nullptr, selection);
+			NodeHandle carryOut = CreateNamedNode(NodeType::Any, 2, 1, "cout", selection);
+			Connect(a, halfSum);
+			Connect(b, halfSum);
+			Connect(halfSum, sum);
+			Connect(carryIn, sum);
+			Connect(a, bothInputs);
+			Connect(b, bothInputs);
+			Connect(halfSum, carried);
+			Connect(carryIn, carried);
+			Connect(bothInputs, carryOut);
+			Connect(carried, carryOut);
+			// Something outside the selection driving an input, which the table cuts off
+			Connect(CreateNode(NodeType::Non, -1, 0), a);
+
+			std::vector<NodeHandle> inputs, outputs;
+			simulation::FindSelectionPins(selection, inputs, outputs);
+			Assert::AreEqual((size_t)3, inputs.size());
+			Assert::AreEqual((size_t)2, outputs.size());
+
+			std::string filename = BoardTempPath("test_board_table.bin");
+			Assert::IsTrue(simulation::WriteTruthTable(selection, inputs, outputs, filename.c_str()));
+			std::ifstream file(filename, std::ios::binary);
+			char magic[4];
+			uint32_t version, numInputs, numOutputs;
+			file.read(magic, 4);
+			file.read((char*)&version, 4);
+			file.read((char*)&numInputs, 4);
+			file.read((char*)&numOutputs, 4);
+			Assert::IsTrue(memcmp(magic, "EATT", 4) == 0);
+			Assert::AreEqual(3u, numInputs);
+			Assert::AreEqual(2u, numOutputs);
+			std::vector<std::string> names(numInputs + numOutputs);
+			for (std::string& name : names)
+			{
+				uint32_t length;
+				file.read((char*)&length, 4);
+				name.resize(length);
+				file.read(name.data(), length);
+			}
+			uint64_t table[2];
+			file.read((char*)table, sizeof(table));
+			Assert::IsTrue(file.good());
+			Assert::IsTrue(file.peek() == EOF);
+			file.close();
+			std::filesystem::remove(filename);
+
+			// The pins may come in any order, so each is told apart by its name
+			for (uint32_t row = 0; row < 8; ++row)
+			{
+				uint32_t total = 0;
+				for (uint32_t i = 0; i < numInputs; ++i)
+				{
+					total += (row >> i) & 1;
+				}
+				for (uint32_t o = 0; o < numOutputs; ++o)
+				{
+					bool expected = names[numInputs + o] == "sum" ? (total & 1) : (total >> 1);
+					Assert::AreEqual(expected, (bool)((table[o] >> row) & 1));
+				}
+			}
+			// Rows past the end of a small table are off
+			Assert::AreEqual((uint64_t)0, table[0] >> 8);
+			Assert::AreEqual((uint64_t)0, table[1] >> 8);
+		}
+	};
+
+	TEST_CLASS(TestEquivalence)
+	{
+	public:
+
+		TEST_METHOD(XorMatchesItsGatesAndNotOr)
+		{
+			ClearNodes();
+			// Exclusive or, as a single gate
+			ChunkedList<NodeHandle> single;
+			{
+				NodeHandle a = CreateNamedNode(NodeType::Any, 0, 0, "a", single);
+				NodeHandle b = CreateNamedNode(NodeType::Any, 0, 1, "b", single);
+				NodeHandle out = CreateNamedNode(NodeType::One, 1, 0, "out", single);
+				Connect(a, out);
+				Connect(b, out);
+			}
+			// Exclusive or, as (a | b) & !(a & b), with its pins made in another order
+			ChunkedList<NodeHandle> composed;
+			{
+				NodeHandle b = CreateNamedNode(NodeType::Any, 10, 1, "b", composed);
+				NodeHandle a = CreateNamedNode(NodeType::Any, 10, 0, "a", composed);
+				NodeHandle either = CreateNamedNode(NodeType::Any, 11, 0, nullptr, composed);
+				NodeHandle both = CreateNamedNode(NodeType::All, 11, 1, nullptr, composed);
+				NodeHandle notBoth = CreateNamedNode(NodeType::Non, 12, 1, nullptr, composed);
+				NodeHandle out = CreateNamedNode(NodeType::All, 13, 0, "out", composed);
+				Connect(a, either);
+				Connect(b, either);
+				Connect(a, both);
+				Connect(b, both);
+				Connect(both, notBoth);
+				Connect(either, out);
+				Connect(notBoth, out);
+			}
+			ChunkedList<NodeHandle> inclusive;
+			{
+				NodeHandle a = CreateNamedNode(NodeType::Any, 20, 0, "a", inclusive);
+				NodeHandle b = CreateNamedNode(NodeType::Any, 20, 1, "b", inclusive);
+				NodeHandle out = CreateNamedNode(NodeType::Any, 21, 0, "out", inclusive);
+				Connect(a, out);
+				Connect(b, out);
+			}
+
+			simulation::EquivalenceResult result;
+			Assert::IsTrue(simulation::CheckEquivalence(single, composed, 1000, 7, result));
+			Assert::IsTrue(result.isEquivalent);
+			// A budget that doesn't fill the last batch of vectors is still kept to
+			Assert::AreEqual((uint64_t)1000, result.numVectors);
+
+			Assert::IsTrue(simulation::CheckEquivalence(single, inclusive, 1000, 7, result));
+			Assert::IsFalse(result.isEquivalent);
+			// Only both inputs on tells them apart
+			Assert::AreEqual((size_t)2, result.counterexample.size());
+			Assert::IsTrue(result.counterexample[0] && result.counterexample[1]);
+			Assert::IsFalse(result.outputA);
+			Assert::IsTrue(result.outputB);
+
+			// Pins are matched up by name, so every one needs a name
+			At(nodeName, NodeIndex(At(inclusive, 0))) = EMPTY_NAME;
+			Assert::IsFalse(simulation::CheckEquivalence(single, inclusive, 1000, 7, result));
+		}
+	};
+}
@@ -0,0 +1,656 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include <algorithm>
+#include <random>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "graph_adjacency.hpp"
+#include "graph_scc.hpp"
+#include "graph_spatial.hpp"
+#include "graph_storage.hpp"
+#include "graph_timing.hpp"
+#include "simulation.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace graph;
+
+namespace TestElectronArchitectFunc
+{
+	constexpr NodeType NODE_TYPES[] = { NodeType::Any, NodeType::All, NodeType::Non, NodeType::One };
+
+	// Adds a random selection of `count` nodes, repeats and all
+	void SelectRandomNodes(ChunkedList<NodeHandle>& selection, size_t count, std::mt19937& rng)
+	{
+		for (size_t i = 0; i < count && numNodes != 0; ++i)
+		{
+			Push(selection, At(nodeHandles, rng() % numNodes));
+		}
+	}
+
+	// A wire between two nodes near each other in the node columns, so that the wires bunch up enough to make loops.
+	// Mostly from the lower index to the higher, but one in four runs back, joining loops.
+	void CreateRandomWire(std::mt19937& rng)
+	{
+		size_t start = rng() % numNodes;
+		size_t end = (start + rng() % 8) % numNodes;
+		if ((start > end) != (rng() % 4 == 0))
+		{
+			std::swap(start, end);
+		}
+		CreateWire(WireElbow::DiagonalHori, At(nodeHandles, start), At(nodeHandles, end));
+	}
+
+	// One random edit. Destroying wires and nodes splits the loops wires have joined.
+	// Now and then a few hundred nodes come and go at once, through DestroyNodes' batch path.
+	void MakeRandomEdit(std::mt19937& rng)
+	{
+		const int kind = rng() % 100;
+		if (kind < 10 || numNodes < 2)
+		{
+			CreateNode(NODE_TYPES[rng() % 4], rng() % 32, rng() % 32);
+		}
+		else if (kind < 75)
+		{
+			CreateRandomWire(rng);
+		}
+		else if (kind < 88)
+		{
+			if (numWires != 0)
+			{
+				DestroyWire(At(wireHandles, rng() % numWires));
+			}
+		}
+		else if (kind < 98)
+		{
+			ChunkedList<NodeHandle> selection;
+			SelectRandomNodes(selection, 1 + rng() % 4, rng);
+			DestroyNodes(selection);
+		}
+		else
+		{
+			for (int i = 0; i < 300; ++i)
+			{
+				CreateNode(NODE_TYPES[rng() % 4], rng() % 32, rng() % 32);
+			}
+			for (int i = 0; i < 600; ++i)
+			{
+				CreateRandomWire(rng);
+			}
+			ChunkedList<NodeHandle> selection;
+			SelectRandomNodes(selection, 300 + rng() % 100, rng);
+			DestroyNodes(selection);
+		}
+	}
+
+	// Every node's component, found from scratch by Compile's own search over a netlist built from the graph, one gate per node:
+	// grouped as by GroupGatesByScc, in evaluation order, with `sccOfNode` giving each node's component by node index
+	void FindFreshSccs(simulation::Netlist& netlist, std::vector<uint32_t>& sccStart, std::vector<simulation::GateID>& sccNodes, std::vector<uint32_t>& sccOfNode)
+	{
+		netlist = {};
+		simulation::BuildNetlistFromGraph(netlist);
+		// Otherwise the graph's own components are used
+		netlist.sccOrder.clear();
+		simulation::GroupGatesByScc(netlist, sccStart, sccNodes);
+		sccOfNode.resize(numNodes);
+		for (uint32_t scc = 0; scc + 1 < sccStart.size(); ++scc)
+		{
+			for (uint32_t i = sccStart[scc]; i < sccStart[scc + 1]; ++i)
+			{
+				sccOfNode[sccNodes[i]] = scc;
+			}
+		}
+	}
+
+	// A random board the same every time for the same seed, returning every node's handle in the order it was created.
+	// Cells hold a few nodes each, and wires go every which way, loops and all.
+	std::vector<NodeHandle> BuildRandomBoard(uint32_t seed, size_t numBoardNodes, size_t numBoardWires)
+	{
+		ClearNodes();
+		std::mt19937 rng(seed);
+		std::vector<NodeHandle> created;
+		for (size_t i = 0; i < numBoardNodes; ++i)
+		{
+			created.push_back(CreateNode(NODE_TYPES[rng() % 4], rng() % 24, rng() % 24));
+		}
+		for (size_t i = 0; i < numBoardWires; ++i)
+		{
+			CreateWire((WireElbow)(rng() % 4), created[rng() % numBoardNodes], created[rng() % numBoardNodes]);
+		}
+		return created;
+	}
+
+	// What's left of a board from BuildRandomBoard, by node id - the order the node was created in -
+	// so that boards whose handles and node order differ can be compared
+	struct BoardSnapshot
+	{
+		std::vector<std::tuple<uint32_t, NodeType, int, int>> nodes;
+		std::vector<std::tuple<uint32_t, uint32_t, WireElbow>> wires;
+
+		// By node id, each sorted: the nodes in its cell, and the nodes at the other end of the wires listed out of and into it
+		std::vector<std::vector<uint32_t>> cellmates;
+		std::vector<std::vector<uint32_t>> wiredTo;
+		std::vector<std::vector<uint32_t>> wiredFrom;
+
+		bool operator==(const BoardSnapshot&) const = default;
+	};
+
+	void TakeSnapshot(const std::vector<NodeHandle>& created, BoardSnapshot& snapshot)
+	{
+		std::unordered_map<NodeHandle, uint32_t> idOf;
+		for (uint32_t id = 0; id < created.size(); ++id)
+		{
+			idOf[created[id]] = id;
+		}
+		snapshot = {};
+		snapshot.cellmates.resize(created.size());
+		snapshot.wiredTo.resize(created.size());
+		snapshot.wiredFrom.resize(created.size());
+		for (size_t i = 0; i < numNodes; ++i)
+		{
+			NodeHandle node = At(nodeHandles, i);
+			uint32_t id = idOf.at(node);
+			snapshot.nodes.push_back({ id, At(nodeType, i), At(nodeX, i), At(nodeY, i) });
+			for (NodeHandle other = FirstNodeInCell(At(nodeX, i), At(nodeY, i)); other != NULL_NODE; other = NextNodeInCell(other))
+			{
+				snapshot.cellmates[id].push_back(idOf.at(other));
+			}
+			for (WireHandle wire = FirstWireOut(node); wire != NULL_WIRE; wire = NextWireOut(wire))
+			{
+				snapshot.wiredTo[id].push_back(idOf.at(At(wires, WireIndex(wire)).endNode));
+			}
+			for (WireHandle wire = FirstWireIn(node); wire != NULL_WIRE; wire = NextWireIn(wire))
+			{
+				snapshot.wiredFrom[id].push_back(idOf.at(At(wires, WireIndex(wire)).startNode));
+			}
+		}
+		for (size_t i = 0; i < numWires; ++i)
+		{
+			const Wire& wire = At(wires, i);
+			snapshot.wires.push_back({ idOf.at(wire.startNode), idOf.at(wire.endNode), wire.elbow });
+		}
+		std::sort(snapshot.nodes.begin(), snapshot.nodes.end());
+		std::sort(snapshot.wires.begin(), snapshot.wires.end());
+		for (uint32_t id = 0; id < created.size(); ++id)
+		{
+			std::sort(snapshot.cellmates[id].begin(), snapshot.cellmates[id].end());
+			std::sort(snapshot.wiredTo[id].begin(), snapshot.wiredTo[id].end());
+			std::sort(snapshot.wiredFrom[id].begin(), snapshot.wiredFrom[id].end());
+		}
+	}
+
+	TEST_CLASS(TestScc)
+	{
+	public:
+
+		TEST_METHOD(MatchesAFreshSearchAfterEveryEdit)
+		{
+			ClearNodes();
+			std::mt19937 rng(13);
+			simulation::Netlist netlist;
+			std::vector<uint32_t> sccStart;
+			std::vector<simulation::GateID> sccNodes;
+			std::vector<uint32_t> sccOfNode;
+			std::vector<bool> isWiredToItself;
+			std::unordered_set<uint32_t> seen;
+			for (int edit = 0; edit < 3000; ++edit)
+			{
+				MakeRandomEdit(rng);
+				FindFreshSccs(netlist, sccStart, sccNodes, sccOfNode);
+
+				// The same partition: each fresh component is one whole component, and no two share one
+				seen.clear();
+				for (uint32_t scc = 0; scc + 1 < sccStart.size(); ++scc)
+				{
+					NodeHandle first = At(nodeHandles, sccNodes[sccStart[scc]]);
+					Assert::IsTrue(seen.insert(NodeScc(first)).second);
+					Assert::AreEqual(sccStart[scc + 1] - sccStart[scc], SccSize(NodeScc(first)));
+					for (uint32_t i = sccStart[scc] + 1; i < sccStart[scc + 1]; ++i)
+					{
+						NodeHandle member = At(nodeHandles, sccNodes[i]);
+						Assert::AreEqual(NodeScc(first), NodeScc(member));
+						Assert::AreEqual(NodeSccOrder(first), NodeSccOrder(member));
+					}
+				}
+
+				// A topological order: every wire between components runs forward
+				isWiredToItself.assign(numNodes, false);
+				for (size_t i = 0; i < numWires; ++i)
+				{
+					const Wire& wire = At(wires, i);
+					size_t start = NodeIndex(wire.startNode);
+					size_t end = NodeIndex(wire.endNode);
+					if (sccOfNode[start] != sccOfNode[end])
+					{
+						Assert::IsTrue(NodeSccOrder(wire.startNode) < NodeSccOrder(wire.endNode));
+					}
+					if (start == end)
+					{
+						isWiredToItself[start] = true;
+					}
+				}
+
+				for (size_t i = 0; i < numNodes; ++i)
+				{
+					uint32_t scc = sccOfNode[i];
+					bool isInLoop = isWiredToItself[i] || sccStart[scc + 1] - sccStart[scc] > 1;
+					Assert::AreEqual(isInLoop, IsNodeInLoop(At(nodeHandles, i)));
+				}
+			}
+		}
+	};
+
+	TEST_CLASS(TestTiming)
+	{
+	public:
+
+		TEST_METHOD(MatchesLongestPathsAfterEveryEdit)
+		{
+			ClearNodes();
+			std::mt19937 rng(18);
+			simulation::Netlist netlist;
+			std::vector<uint32_t> sccStart;
+			std::vector<simulation::GateID> sccNodes;
+			std::vector<uint32_t> sccOfNode;
+			std::vector<uint32_t> sccDepth;
+			for (int edit = 0; edit < 3000; ++edit)
+			{
+				MakeRandomEdit(rng);
+				FindFreshSccs(netlist, sccStart, sccNodes, sccOfNode);
+
+				// Longest paths from scratch: components come in evaluation order, so every input from outside one is already settled
+				const uint32_t numSccs = (uint32_t)sccStart.size() - 1;
+				sccDepth.assign(numSccs, 0);
+				uint32_t deepest = 0;
+				for (uint32_t scc = 0; scc < numSccs; ++scc)
+				{
+					for (uint32_t i = sccStart[scc]; i < sccStart[scc + 1]; ++i)
+					{
+						simulation::GateID node = sccNodes[i];
+						for (uint32_t j = netlist.inputStart[node]; j < netlist.inputStart[node + 1]; ++j)
+						{
+							uint32_t inputScc = sccOfNode[netlist.inputs[j]];
+							if (inputScc != scc)
+							{
+								sccDepth[scc] = std::max(sccDepth[scc], sccDepth[inputScc] + 1);
+							}
+						}
+					}
+					deepest = std::max(deepest, sccDepth[scc]);
+				}
+
+				for (size_t i = 0; i < numNodes; ++i)
+				{
+					Assert::AreEqual(sccDepth[sccOfNode[i]], NodeDepth(At(nodeHandles, i)));
+				}
+				Assert::AreEqual(deepest, CriticalPathDepth());
+			}
+		}
+	};
+
+	TEST_CLASS(TestDestroyNodes)
+	{
+	public:
+
+		TEST_METHOD(BatchMatchesOneAtATime)
+		{
+			constexpr uint32_t SEED = 7;
+			constexpr size_t NUM_BOARD_NODES = 1200;
+			constexpr size_t NUM_BOARD_WIRES = 2400;
+			std::mt19937 rng(SEED);
+
+			// Enough victims for the batch path, with repeats
+			std::vector<uint32_t> victims;
+			for (size_t i = 0; i < 500; ++i)
+			{
+				victims.push_back(rng() % NUM_BOARD_NODES);
+			}
+
+			std::vector<NodeHandle> created = BuildRandomBoard(SEED, NUM_BOARD_NODES, NUM_BOARD_WIRES);
+			std::shuffle(victims.begin(), victims.end(), rng);
+			ChunkedList<NodeHandle> selection;
+			for (uint32_t id : victims)
+			{
+				Push(selection, created[id]);
+			}
+			// A stale handle is skipped
+			NodeHandle destroyed = CreateNode(NodeType::Any, 0, 0);
+			DestroyNode(destroyed);
+			Push(selection, destroyed);
+			DestroyNodes(selection);
+			BoardSnapshot batched;
+			TakeSnapshot(created, batched);
+
+			created = BuildRandomBoard(SEED, NUM_BOARD_NODES, NUM_BOARD_WIRES);
+			std::shuffle(victims.begin(), victims.end(), rng);
+			for (uint32_t id : victims)
+			{
+				if (IsNodeValid(created[id]))
+				{
+					DestroyNode(created[id]);
+				}
+			}
+			BoardSnapshot oneAtATime;
+			TakeSnapshot(created, oneAtATime);
+
+			Assert::IsTrue(batched.nodes.size() < NUM_BOARD_NODES - 256);
+			Assert::IsTrue(batched == oneAtATime);
+
+			// Both agree with the wires themselves
+			for (const auto& [startNode, endNode, elbow] : batched.wires)
+			{
+				const std::vector<uint32_t>& wiredTo = batched.wiredTo[startNode];
+				const std::vector<uint32_t>& wiredFrom = batched.wiredFrom[endNode];
+				Assert::IsTrue(std::binary_search(wiredTo.begin(), wiredTo.end(), endNode));
+				Assert::IsTrue(std::binary_search(wiredFrom.begin(), wiredFrom.end(), startNode));
+			}
+			size_t numWiresListed = 0;
+			for (const auto& [id, type, x, y] : batched.nodes)
+			{
+				numWiresListed += batched.wiredTo[id].size();
+				Assert::IsTrue(std::binary_search(batched.cellmates[id].begin(), batched.cellmates[id].end(), id));
+			}
+			Assert::AreEqual(batched.wires.size(), numWiresListed);
+		}
+	};
+	TEST_CLASS(TestHandles)
+	{
+	public:
+
+		TEST_METHOD(StaleHandlesStayInvalidAsSlotsAreReused)
+		{
+			ClearNodes();
+			NodeHandle fixed = CreateNode(NodeType::Any, 0, 0);
+			std::vector<NodeHandle> oldNodes;
+			std::vector<WireHandle> oldWires;
+			NodeHandle node = CreateNode(NodeType::Any, 1, 0);
+			WireHandle wire = CreateWire(WireElbow::DiagonalHori, fixed, node);
+			for (int cycle = 0; cycle < 20; ++cycle)
+			{
+				// Destroying the wire frees its slot for the next one
+				DestroyWire(wire);
+				oldWires.push_back(wire);
+				wire = CreateWire(WireElbow::DiagonalHori, fixed, node);
+				Assert::AreEqual(HandleSlot(oldWires.back()), HandleSlot(wire));
+				Assert::IsTrue(IsWireValid(wire));
+
+				// Destroying the node takes its wire with it, and frees both slots
+				DestroyNode(node);
+				oldNodes.push_back(node);
+				oldWires.push_back(wire);
+				Assert::IsFalse(IsWireValid(wire));
+				node = CreateNode(NodeType::Any, 1, 0);
+				Assert::AreEqual(HandleSlot(oldNodes.back()), HandleSlot(node));
+				Assert::IsTrue(IsNodeValid(node));
+				wire = CreateWire(WireElbow::DiagonalHori, fixed, node);
+
+				for (NodeHandle old : oldNodes)
+				{
+					Assert::IsFalse(IsNodeValid(old));
+				}
+				for (WireHandle old : oldWires)
+				{
+					Assert::IsFalse(IsWireValid(old));
+				}
+			}
+			Assert::IsTrue(IsNodeValid(fixed));
+			Assert::IsTrue(IsWireValid(wire));
+			Assert::IsFalse(IsNodeValid(NULL_NODE));
+			Assert::IsFalse(IsWireValid(NULL_WIRE));
+		}
+
+		TEST_METHOD(SlotIsRetiredBeforeItsGenerationWraps)
+		{
+			ClearNodes();
+			std::vector<NodeHandle> oldNodes;
+			NodeHandle node = CreateNode(NodeType::Any, 0, 0);
+			const uint32_t slot = HandleSlot(node);
+			// ClearNodes moves every slot on a generation, so this one may not start at 0
+			while (HandleSlot(node) == slot)
+			{
+				Assert::IsTrue(HandleGeneration(node) < HandleTable::RETIRED_GENERATION);
+				DestroyNode(node);
+				oldNodes.push_back(node);
+				node = CreateNode(NodeType::Any, 0, 0);
+				if (HandleSlot(node) == slot)
+				{
+					Assert::AreEqual(HandleGeneration(oldNodes.back()) + 1, HandleGeneration(node));
+				}
+			}
+
+			// The slot was given out at every generation but the retired one, and never again
+			Assert::AreEqual((uint32_t)HandleTable::RETIRED_GENERATION - 1, HandleGeneration(oldNodes.back()));
+			Assert::IsFalse(IsNodeValid(((uint32_t)HandleTable::RETIRED_GENERATION << HandleTable::SLOT_BITS) | slot));
+			for (NodeHandle old : oldNodes)
+			{
+				Assert::IsFalse(IsNodeValid(old));
+			}
+			for (int i = 0; i < 300; ++i)
+			{
+				NodeHandle other = CreateNode(NodeType::Any, 0, 0);
+				Assert::AreNotEqual(slot, HandleSlot(other));
+				if (i % 2 == 0)
+				{
+					DestroyNode(other);
+				}
+			}
+			Assert::IsTrue(IsNodeValid(node));
+
+			// Clearing keeps it retired
+			ClearNodes();
+			for (int i = 0; i < 300; ++i)
+			{
+				Assert::AreNotEqual(slot, HandleSlot(CreateNode(NodeType::Any, 0, 0)));
+			}
+		}
+	};
+	TEST_CLASS(TestSpatial)
+	{
+	public:
+
+		TEST_METHOD(MatchesAScanOfEveryNodeAfterEveryEdit)
+		{
+			ClearNodes();
+			std::mt19937 rng(4);
+			std::vector<std::vector<NodeHandle>> nodesInCell(34 * 34);
+			std::vector<NodeHandle> found;
+			std::vector<NodeHandle> expected;
+			ChunkedList<NodeHandle> results;
+			for (int edit = 0; edit < 1500; ++edit)
+			{
+				MakeRandomEdit(rng);
+
+				// Every cell MakeRandomEdit places nodes in, and a border of empty ones
+				for (std::vector<NodeHandle>& cell : nodesInCell)
+				{
+					cell.clear();
+				}
+				for (size_t i = 0; i < numNodes; ++i)
+				{
+					nodesInCell[(At(nodeY, i) + 1) * 34 + At(nodeX, i) + 1].push_back(At(nodeHandles, i));
+				}
+				for (int y = -1; y <= 32; ++y)
+				{
+					for (int x = -1; x <= 32; ++x)
+					{
+						found.clear();
+						for (NodeHandle node = FirstNodeInCell(x, y); node != NULL_NODE; node = NextNodeInCell(node))
+						{
+							found.push_back(node);
+						}
+						expected = nodesInCell[(y + 1) * 34 + x + 1];
+						std::sort(found.begin(), found.end());
+						std::sort(expected.begin(), expected.end());
+						Assert::IsTrue(found == expected);
+					}
+				}
+
+				// Up to three overlapping ranges, from a few cells, which are looked up cell by cell, to most of the board, which is scanned
+				CellRange ranges[3];
+				const size_t numRanges = 1 + rng() % 3;
+				for (size_t r = 0; r < numRanges; ++r)
+				{
+					int size = rng() % 2 == 0 ? rng() % 4 : rng() % 40;
+					ranges[r].xmin = (int)(rng() % 40) - 4;
+					ranges[r].ymin = (int)(rng() % 40) - 4;
+					ranges[r].xmax = ranges[r].xmin + size;
+					ranges[r].ymax = ranges[r].ymin + (int)(rng() % (size + 1));
+				}
+				Clear(results);
+				QueryRanges(ranges, numRanges, results);
+				found.clear();
+				for (size_t i = 0; i < results.num; ++i)
+				{
+					found.push_back(At(results, i));
+				}
+				expected.clear();
+				for (size_t i = 0; i < numNodes; ++i)
+				{
+					bool isInRanges = false;
+					for (size_t r = 0; r < numRanges; ++r)
+					{
+						isInRanges |= ranges[r].xmin <= At(nodeX, i) && At(nodeX, i) <= ranges[r].xmax &&
+							ranges[r].ymin <= At(nodeY, i) && At(nodeY, i) <= ranges[r].ymax;
+					}
+					if (isInRanges)
+					{
+						expected.push_back(At(nodeHandles, i));
+					}
+				}
+				// Sorting keeps any node listed twice next to itself, so it still fails the comparison
+				std::sort(found.begin(), found.end());
+				std::sort(expected.begin(), expected.end());
+				Assert::IsTrue(found == expected);
+			}
+		}
+	};
+
+	// Checks every node's fan-in and fan-out lists, and the CSR copy, against a scan of `wires`
+	void CheckAdjacencyMatchesWires()
+	{
+		std::vector<std::vector<WireHandle>> wiresOut(numNodes);
+		std::vector<std::vector<WireHandle>> wiresIn(numNodes);
+		std::vector<std::vector<uint32_t>> nodesOut(numNodes);
+		std::vector<std::vector<uint32_t>> nodesIn(numNodes);
+		for (size_t i = 0; i < numWires; ++i)
+		{
+			const Wire& wire = At(wires, i);
+			Assert::IsTrue(IsNodeValid(wire.startNode) && IsNodeValid(wire.endNode));
+			uint32_t start = (uint32_t)NodeIndex(wire.startNode);
+			uint32_t end = (uint32_t)NodeIndex(wire.endNode);
+			wiresOut[start].push_back(At(wireHandles, i));
+			wiresIn[end].push_back(At(wireHandles, i));
+			nodesOut[start].push_back(end);
+			nodesIn[end].push_back(start);
+		}
+
+		WireGraphCSR csr;
+		BuildWireGraphCSR(csr);
+		Assert::AreEqual(numNodes + 1, csr.outStart.size());
+		Assert::AreEqual(numNodes + 1, csr.inStart.size());
+
+		std::vector<WireHandle> listed;
+		std::vector<uint32_t> neighbors;
+		for (size_t i = 0; i < numNodes; ++i)
+		{
+			NodeHandle node = At(nodeHandles, i);
+
+			listed.clear();
+			for (WireHandle wire = FirstWireOut(node); wire != NULL_WIRE; wire = NextWireOut(wire))
+			{
+				Assert::IsTrue(IsWireValid(wire));
+				listed.push_back(wire);
+			}
+			std::sort(listed.begin(), listed.end());
+			std::sort(wiresOut[i].begin(), wiresOut[i].end());
+			Assert::IsTrue(listed == wiresOut[i]);
+			Assert::AreEqual((uint32_t)listed.size(), NumWiresOut(node));
+
+			listed.clear();
+			for (WireHandle wire = FirstWireIn(node); wire != NULL_WIRE; wire = NextWireIn(wire))
+			{
+				Assert::IsTrue(IsWireValid(wire));
+				listed.push_back(wire);
+			}
+			std::sort(listed.begin(), listed.end());
+			std::sort(wiresIn[i].begin(), wiresIn[i].end());
+			Assert::IsTrue(listed == wiresIn[i]);
+			Assert::AreEqual((uint32_t)listed.size(), NumWiresIn(node));
+
+			neighbors.assign(csr.outNodes.begin() + csr.outStart[i], csr.outNodes.begin() + csr.outStart[i + 1]);
+			std::sort(neighbors.begin(), neighbors.end());
+			std::sort(nodesOut[i].begin(), nodesOut[i].end());
+			Assert::IsTrue(neighbors == nodesOut[i]);
+
+			neighbors.assign(csr.inNodes.begin() + csr.inStart[i], csr.inNodes.begin() + csr.inStart[i + 1]);
+			std::sort(neighbors.begin(), neighbors.end());
+			std::sort(nodesIn[i].begin(), nodesIn[i].end());
+			Assert::IsTrue(neighbors == nodesIn[i]);
+		}
+	}
+
+	TEST_CLASS(TestAdjacency)
+	{
+	public:
+
+		TEST_METHOD(MatchesAScanOfEveryWireAfterEveryEdit)
+		{
+			ClearNodes();
+			std::mt19937 rng(5);
+			for (int edit = 0; edit < 1500; ++edit)
+			{
+				MakeRandomEdit(rng);
+				CheckAdjacencyMatchesWires();
+			}
+		}
+
+		TEST_METHOD(DestroyingANodeTakesItsWiresOffItsNeighbors)
+		{
+			ClearNodes();
+			NodeHandle hub = CreateNode(NodeType::Any, 0, 0);
+			std::vector<NodeHandle> neighbors;
+			for (int i = 0; i < 8; ++i)
+			{
+				neighbors.push_back(CreateNode(NodeType::Any, i, 1));
+			}
+			std::vector<WireHandle> hubWires;
+			for (int i = 0; i < 8; ++i)
+			{
+				hubWires.push_back(CreateWire(WireElbow::DiagonalHori, hub, neighbors[i]));
+				hubWires.push_back(CreateWire(WireElbow::DiagonalHori, neighbors[(i + 3) % 8], hub));
+				CreateWire(WireElbow::DiagonalHori, neighbors[i], neighbors[(i + 1) % 8]);
+			}
+			hubWires.push_back(CreateWire(WireElbow::DiagonalHori, hub, hub));
+
+			DestroyNode(hub);
+			for (WireHandle wire : hubWires)
+			{
+				Assert::IsFalse(IsWireValid(wire));
+			}
+			Assert::AreEqual((size_t)8, numWires);
+			for (NodeHandle neighbor : neighbors)
+			{
+				Assert::AreEqual(1u, NumWiresOut(neighbor));
+				Assert::AreEqual(1u, NumWiresIn(neighbor));
+			}
+			CheckAdjacencyMatchesWires();
+
+			// And the same through the batch path, where both ends of a wire can go at once
+			ChunkedList<NodeHandle> selection;
+			for (size_t i = 0; i < 300; ++i)
+			{
+				Push(selection, CreateNode(NodeType::Any, (int)i, 2));
+			}
+			for (size_t i = 0; i < 300; ++i)
+			{
+				CreateWire(WireElbow::DiagonalHori, At(selection, i), neighbors[i % 8]);
+				CreateWire(WireElbow::DiagonalHori, At(selection, i), At(selection, (i * 7) % 300));
+			}
+			DestroyNodes(selection);
+			Assert::AreEqual((size_t)8, numNodes);
+			Assert::AreEqual((size_t)8, numWires);
+			CheckAdjacencyMatchesWires();
+		}
+	};
+}
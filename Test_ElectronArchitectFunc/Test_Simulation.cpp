@@ -0,0 +1,801 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <random>
+#include "simulation.hpp"
+#include "simulation_bytecode.hpp"
+#include "simulation_hashing.hpp"
+#include "simulation_history.hpp"
+#include "simulation_optimize.hpp"
+#include "simulation_parallel.hpp"
+#include "simulation_patch.hpp"
+#include "simulation_trace.hpp"
+#include "triple_buffer.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace simulation;
+
+namespace TestElectronArchitectFunc
+{
+	constexpr NodeType GATE_TYPES[] = { NodeType::Any, NodeType::All, NodeType::Non, NodeType::One };
+
+	// A circuit without loops, full of what Compile merges: single-input gates, Nons of Nons, and copies of other gates
+	void MakeMergeableCircuit(Netlist& netlist, size_t numSources, size_t numGates, std::mt19937& rng)
+	{
+		for (size_t i = 0; i < numSources; ++i)
+		{
+			AddGate(netlist, GATE_TYPES[rng() % 4], nullptr, 0);
+		}
+		while (NumGates(netlist) < numSources + numGates)
+		{
+			GateID n = (GateID)NumGates(netlist);
+			if (rng() % 4 == 0)
+			{
+				// A copy of an earlier gate, with its inputs in another order
+				GateID copied = numSources + rng() % (n - numSources + 1);
+				if (copied < n)
+				{
+					std::vector<GateID> inputs(netlist.inputs.begin() + netlist.inputStart[copied], netlist.inputs.begin() + netlist.inputStart[copied + 1]);
+					std::shuffle(inputs.begin(), inputs.end(), rng);
+					AddGate(netlist, netlist.types[copied], inputs.data(), inputs.size());
+					continue;
+				}
+			}
+			GateID inputs[3];
+			size_t numInputs = 1 + rng() % 3;
+			for (size_t i = 0; i < numInputs; ++i)
+			{
+				inputs[i] = rng() % n;
+			}
+			AddGate(netlist, GATE_TYPES[rng() % 4], inputs, numInputs);
+		}
+	}
+
+	// A circuit of mostly one- to three-input gates. With `hasLoops`, some inputs come from later gates, making feedback loops.
+	void MakeRandomCircuit(Netlist& netlist, size_t numGates, bool hasLoops, std::mt19937& rng)
+	{
+		for (GateID gate = 0; gate < numGates; ++gate)
+		{
+			GateID inputs[3];
+			size_t numInputs = (gate == 0 || rng() % 5 == 0) ? 0 : 1 + rng() % 3;
+			for (size_t i = 0; i < numInputs; ++i)
+			{
+				inputs[i] = (hasLoops && rng() % 6 == 0) ? rng() % numGates : rng() % gate;
+			}
+			AddGate(netlist, GATE_TYPES[rng() % 4], inputs, numInputs);
+		}
+	}
+
+	// Flips a few gates. Only sources take the value, so any gate can be picked.
+	template<class SetInputOf>
+	void SetRandomInputs(size_t numGates, std::mt19937& rng, SetInputOf setInput)
+	{
+		for (size_t i = rng() % 4; i > 0; --i)
+		{
+			setInput((GateID)(rng() % numGates), rng() % 2 == 0);
+		}
+	}
+
+	std::string TempPath(const char* filename)
+	{
+		return (std::filesystem::temp_directory_path() / filename).string();
+	}
+
+	TEST_CLASS(TestStepModes)
+	{
+	public:
+
+		TEST_METHOD(SweepEventAndAutoAgree)
+		{
+			std::mt19937 rng(4);
+			for (int round = 0; round < 20; ++round)
+			{
+				Netlist netlist;
+				MakeRandomCircuit(netlist, 2 + rng() % 400, round % 2 == 1, rng);
+				const size_t n = NumGates(netlist);
+
+				Program sweep, event, automatic;
+				Compile(netlist, sweep);
+				Compile(netlist, event);
+				Compile(netlist, automatic);
+				sweep.mode = StepMode::Sweep;
+				event.mode = StepMode::Event;
+				automatic.mode = StepMode::Auto;
+				for (int tick = 0; tick < 60; ++tick)
+				{
+					SetRandomInputs(n, rng, [&](GateID gate, bool value)
+					{
+						SetInput(sweep, gate, value);
+						SetInput(event, gate, value);
+						SetInput(automatic, gate, value);
+					});
+					Step(sweep);
+					Step(event);
+					Step(automatic);
+					Assert::IsTrue(sweep.state == event.state);
+					Assert::IsTrue(sweep.state == automatic.state);
+				}
+			}
+		}
+
+		TEST_METHOD(PartitionedAgreesWithSweep)
+		{
+			std::mt19937 rng(5);
+			for (int round = 0; round < 10; ++round)
+			{
+				// Several circuits side by side, so there are components to spread across threads
+				Netlist netlist;
+				for (int part = 0; part < 8; ++part)
+				{
+					Netlist piece;
+					MakeRandomCircuit(piece, 2 + rng() % 200, round % 2 == 1, rng);
+					GateID base = (GateID)NumGates(netlist);
+					for (GateID gate = 0; gate < NumGates(piece); ++gate)
+					{
+						std::vector<GateID> inputs(piece.inputs.begin() + piece.inputStart[gate], piece.inputs.begin() + piece.inputStart[gate + 1]);
+						for (GateID& input : inputs)
+						{
+							input += base;
+						}
+						AddGate(netlist, piece.types[gate], inputs.data(), inputs.size());
+					}
+				}
+				const size_t n = NumGates(netlist);
+
+				Program sweep;
+				Compile(netlist, sweep);
+				sweep.mode = StepMode::Sweep;
+				PartitionedProgram partitioned;
+				CompilePartitioned(netlist, partitioned);
+				for (int tick = 0; tick < 30; ++tick)
+				{
+					SetRandomInputs(n, rng, [&](GateID gate, bool value)
+					{
+						SetInput(sweep, gate, value);
+						SetInput(partitioned, gate, value);
+					});
+					Step(sweep);
+					StepPartitioned(partitioned);
+					for (GateID gate = 0; gate < n; ++gate)
+					{
+						Assert::AreEqual(GetOutput(sweep, gate), GetOutput(partitioned, gate));
+					}
+				}
+			}
+		}
+	};
+
+	TEST_CLASS(TestBytecode)
+	{
+	public:
+
+		TEST_METHOD(RunsLikeTheProgram)
+		{
+			std::mt19937 rng(6);
+			for (int round = 0; round < 20; ++round)
+			{
+				Netlist netlist;
+				MakeRandomCircuit(netlist, 1 + rng() % 400, round % 2 == 1, rng);
+				const size_t n = NumGates(netlist);
+
+				Program program;
+				Compile(netlist, program);
+				program.mode = StepMode::Sweep;
+				program.maxLoopPasses = 1 + rng() % 63;
+				Bytecode bytecode;
+				Lower(program, bytecode);
+				BytecodeState state;
+				ResetBytecode(bytecode, state);
+				for (int tick = 0; tick < 20; ++tick)
+				{
+					SetRandomInputs(n, rng, [&](GateID gate, bool value)
+					{
+						SetInput(program, gate, value);
+						SetInput(bytecode, state, gate, value);
+					});
+					Step(program);
+					RunBytecode(bytecode, state);
+					for (GateID gate = 0; gate < n; ++gate)
+					{
+						Assert::AreEqual(GetOutput(program, gate), GetOutput(bytecode, state, gate));
+					}
+				}
+			}
+		}
+
+		TEST_METHOD(SurvivesSavingAndLoading)
+		{
+			std::mt19937 rng(7);
+			Netlist netlist;
+			MakeRandomCircuit(netlist, 300, true, rng);
+			Program program;
+			Compile(netlist, program);
+			Bytecode saved;
+			Lower(program, saved);
+			saved.netlistHash = HashNetlist(netlist);
+
+			const std::string path = TempPath("ea_test.eabc");
+			Assert::IsTrue(SaveBytecode(saved, path.c_str()));
+			Bytecode loaded;
+			Assert::IsTrue(LoadBytecode(loaded, path.c_str()));
+			std::filesystem::remove(path);
+
+			Assert::IsTrue(loaded.code == saved.code);
+			Assert::IsTrue(loaded.sourceTypes == saved.sourceTypes);
+			Assert::IsTrue(loaded.gateOfNetlistGate == saved.gateOfNetlistGate);
+			Assert::IsTrue(loaded.netlistGateOfGate == saved.netlistGateOfGate);
+			Assert::AreEqual(saved.numGates, loaded.numGates);
+			Assert::AreEqual(saved.maxLoopPasses, loaded.maxLoopPasses);
+			Assert::AreEqual(saved.netlistHash, loaded.netlistHash);
+
+			Bytecode missing;
+			Assert::IsFalse(LoadBytecode(missing, TempPath("ea_test_missing.eabc").c_str()));
+		}
+
+		TEST_METHOD(RejectsCodeThatReadsOutOfBounds)
+		{
+			// A source, and a loop of an All and a Non feeding each other
+			Netlist netlist;
+			AddGate(netlist, NodeType::Any, nullptr, 0);
+			GateID allInputs[] = { 0, 2 };
+			AddGate(netlist, NodeType::All, allInputs, 2);
+			GateID nonInput = 1;
+			AddGate(netlist, NodeType::Non, &nonInput, 1);
+			Program program;
+			CompileUnoptimized(netlist, program);
+			Bytecode good;
+			Lower(program, good);
+
+			// LoopBegin, its first gate, its end gate, its body size, then the All and its two inputs
+			Assert::AreEqual((uint32_t)Op::LoopBegin, good.code[0]);
+			Bytecode badOperand = good;
+			badOperand.code[5] = good.numGates;
+			Bytecode badLoop = good;
+			badLoop.code[3] = (uint32_t)good.code.size();
+
+			const std::string path = TempPath("ea_test_bad.eabc");
+			Bytecode loaded;
+			Assert::IsTrue(SaveBytecode(good, path.c_str()));
+			Assert::IsTrue(LoadBytecode(loaded, path.c_str()));
+			Assert::IsTrue(SaveBytecode(badOperand, path.c_str()));
+			Assert::IsFalse(LoadBytecode(loaded, path.c_str()));
+			Assert::IsTrue(SaveBytecode(badLoop, path.c_str()));
+			Assert::IsFalse(LoadBytecode(loaded, path.c_str()));
+			std::filesystem::remove(path);
+		}
+	};
+
+	TEST_CLASS(TestPatch)
+	{
+	public:
+
+		// Every edit is checked against compiling the edited netlist from scratch: from the same values, both must step the same
+		TEST_METHOD(PatchedProgramMatchesRecompile)
+		{
+			std::mt19937 rng(8);
+			for (int round = 0; round < 60; ++round)
+			{
+				Netlist start;
+				MakeRandomCircuit(start, 5 + rng() % 60, round % 2 == 1, rng);
+				std::vector<NodeType> types = start.types;
+				std::vector<std::vector<GateID>> inputs(NumGates(start));
+				for (GateID gate = 0; gate < NumGates(start); ++gate)
+				{
+					inputs[gate].assign(start.inputs.begin() + start.inputStart[gate], start.inputs.begin() + start.inputStart[gate + 1]);
+				}
+
+				PatchableProgram patchable;
+				patchable.program.mode = round % 3 == 0 ? StepMode::Event : StepMode::Auto;
+				CompilePatchable(start, patchable);
+				Run(patchable.program, 3);
+				for (int edit = 0; edit < 400; ++edit)
+				{
+					const GateID n = (GateID)types.size();
+					int kind = rng() % 10;
+					if (kind < 2)
+					{
+						NodeType type = GATE_TYPES[rng() % 4];
+						PatchAddGate(patchable, type);
+						types.push_back(type);
+						inputs.emplace_back();
+					}
+					else if (kind < 3 && n > 1)
+					{
+						// The last gate is renumbered into the removed one's place
+						GateID removed = rng() % n;
+						PatchRemoveGate(patchable, removed);
+						for (std::vector<GateID>& list : inputs)
+						{
+							list.erase(std::remove(list.begin(), list.end(), removed), list.end());
+						}
+						GateID last = n - 1;
+						types[removed] = types[last];
+						inputs[removed] = inputs[last];
+						for (std::vector<GateID>& list : inputs)
+						{
+							std::replace(list.begin(), list.end(), last, removed);
+						}
+						types.pop_back();
+						inputs.pop_back();
+					}
+					else if (kind < 7)
+					{
+						GateID from = rng() % n;
+						GateID to = rng() % n;
+						// Every other circuit stays free of loops, so every tick of it can be compared
+						if (round % 2 == 0 && from >= to)
+						{
+							if (from == to)
+							{
+								continue;
+							}
+							std::swap(from, to);
+						}
+						PatchAddWire(patchable, from, to);
+						inputs[to].push_back(from);
+					}
+					else
+					{
+						GateID to = rng() % n;
+						if (inputs[to].empty())
+						{
+							continue;
+						}
+						GateID from = inputs[to][rng() % inputs[to].size()];
+						PatchRemoveWire(patchable, from, to);
+						inputs[to].erase(std::find(inputs[to].begin(), inputs[to].end(), from));
+					}
+					if (rng() % 2 == 0)
+					{
+						Run(patchable.program, 1 + rng() % 3);
+					}
+
+					Netlist edited;
+					for (GateID gate = 0; gate < types.size(); ++gate)
+					{
+						AddGate(edited, types[gate], inputs[gate].data(), inputs[gate].size());
+					}
+					Program fresh;
+					CompileUnoptimized(edited, fresh);
+					fresh.mode = StepMode::Sweep;
+					Assert::AreEqual(types.size(), patchable.program.gateOfNetlistGate.size());
+					for (GateID gate : patchable.program.gateOfNetlistGate)
+					{
+						// A shared gate maps back to one of the netlist gates sharing it
+						GateID netlistGate = patchable.program.netlistGateOfGate[gate];
+						Assert::IsTrue(netlistGate < types.size());
+						Assert::AreEqual(gate, patchable.program.gateOfNetlistGate[netlistGate]);
+					}
+					for (GateID gate = 0; gate < types.size(); ++gate)
+					{
+						SetBit(fresh.state.data(), fresh.gateOfNetlistGate[gate], GetOutput(patchable.program, gate));
+					}
+					fresh.needsSweep = true;
+
+					Program patched = patchable.program;
+					for (int tick = 0; tick < 4; ++tick)
+					{
+						Step(patched);
+						Step(fresh);
+						// A loop that doesn't settle ends the tick wherever its gate order left it, which may differ between the two
+						if (!patched.pending.empty() || !fresh.pending.empty())
+						{
+							break;
+						}
+						for (GateID gate = 0; gate < types.size(); ++gate)
+						{
+							Assert::AreEqual(GetOutput(fresh, gate), GetOutput(patched, gate));
+						}
+					}
+				}
+			}
+		}
+	};
+
+	TEST_CLASS(TestOptimize)
+	{
+	public:
+
+		TEST_METHOD(CompiledProgramMatchesUnoptimized)
+		{
+			std::mt19937 rng(1);
+			Netlist netlist;
+			MakeMergeableCircuit(netlist, 32, 2000, rng);
+
+			Program merged, asIs;
+			Compile(netlist, merged);
+			CompileUnoptimized(netlist, asIs);
+			Assert::IsTrue(merged.numWiresMerged > 0 && merged.numDuplicatesMerged > 0);
+			Assert::IsTrue(merged.numGates < asIs.numGates);
+
+			for (int tick = 0; tick < 64; ++tick)
+			{
+				for (GateID gate = 0; gate < 32; ++gate)
+				{
+					bool value = rng() % 2;
+					SetInput(merged, gate, value);
+					SetInput(asIs, gate, value);
+				}
+				Step(merged);
+				Step(asIs);
+				for (GateID gate = 0; gate < NumGates(netlist); ++gate)
+				{
+					Assert::AreEqual(GetOutput(asIs, gate), GetOutput(merged, gate));
+				}
+			}
+		}
+
+		TEST_METHOD(OptimizedNetlistMatchesOriginal)
+		{
+			std::mt19937 rng(2);
+			Netlist netlist;
+			MakeMergeableCircuit(netlist, 32, 2000, rng);
+
+			// Without names, every source is an input and every gate that feeds nothing is an output
+			Optimized optimized;
+			Optimize(netlist, Pins::Named, optimized);
+			Assert::IsTrue(NumGates(optimized.netlist) < NumGates(netlist));
+
+			Program original, smaller;
+			CompileUnoptimized(netlist, original);
+			CompileUnoptimized(optimized.netlist, smaller);
+			for (int tick = 0; tick < 64; ++tick)
+			{
+				for (GateID gate = 0; gate < 32; ++gate)
+				{
+					bool value = rng() % 2;
+					SetInput(original, gate, value);
+					SetInput(smaller, optimized.gateOfOriginal[gate], value);
+				}
+				Step(original);
+				Step(smaller);
+				for (GateID gate = 0; gate < NumGates(netlist); ++gate)
+				{
+					GateID kept = optimized.gateOfOriginal[gate];
+					if (kept != NULL_GATE)
+					{
+						Assert::AreEqual(GetOutput(original, gate), GetOutput(smaller, kept));
+					}
+				}
+			}
+		}
+
+		TEST_METHOD(ProgramForPinsMatchesOnPins)
+		{
+			std::mt19937 rng(3);
+			Netlist netlist;
+			MakeMergeableCircuit(netlist, 32, 2000, rng);
+
+			std::vector<GateID> inputs, outputs;
+			for (GateID gate = 0; gate < 16; ++gate)
+			{
+				inputs.push_back(gate);
+			}
+			for (GateID gate = 0; gate < 8; ++gate)
+			{
+				outputs.push_back((GateID)NumGates(netlist) - 1 - gate);
+			}
+
+			// The sixteen sources that aren't inputs hold still, so whatever they alone feed folds away
+			Program forPins, asIs;
+			Compile(netlist, inputs, outputs, forPins);
+			CompileUnoptimized(netlist, asIs);
+			Assert::IsTrue(forPins.numConstantsFolded > 0 && forPins.numUnusedRemoved > 0);
+
+			for (int tick = 0; tick < 64; ++tick)
+			{
+				for (GateID gate : inputs)
+				{
+					bool value = rng() % 2;
+					SetInput(forPins, gate, value);
+					SetInput(asIs, gate, value);
+				}
+				Step(forPins);
+				Step(asIs);
+				for (GateID gate : outputs)
+				{
+					Assert::AreEqual(GetOutput(asIs, gate), GetOutput(forPins, gate));
+				}
+			}
+		}
+	};
+
+	TEST_CLASS(TestHashing)
+	{
+	public:
+
+		TEST_METHOD(CopiesOfABlockShareGates)
+		{
+			constexpr size_t NUM_SOURCES = 8;
+			constexpr size_t BLOCK_SIZE = 50;
+			constexpr size_t NUM_COPIES = 4;
+
+			// Copies of one block on the same sources, with every gate taking two or more distinct inputs so none are only wires
+			std::mt19937 rng(3);
+			Netlist netlist;
+			for (size_t i = 0; i < NUM_SOURCES; ++i)
+			{
+				AddGate(netlist, NodeType::Any, nullptr, 0);
+			}
+			std::vector<NodeType> types(BLOCK_SIZE);
+			std::vector<std::vector<GateID>> blockInputs(BLOCK_SIZE);
+			for (size_t g = 0; g < BLOCK_SIZE; ++g)
+			{
+				types[g] = GATE_TYPES[rng() % 4];
+				GateID first = rng() % (NUM_SOURCES + g);
+				GateID second = (first + 1 + rng() % (NUM_SOURCES + g - 1)) % (NUM_SOURCES + g);
+				blockInputs[g] = { first, second };
+			}
+			for (size_t copy = 0; copy < NUM_COPIES; ++copy)
+			{
+				GateID base = (GateID)NumGates(netlist);
+				for (size_t g = 0; g < BLOCK_SIZE; ++g)
+				{
+					GateID inputs[2];
+					for (size_t i = 0; i < 2; ++i)
+					{
+						GateID input = blockInputs[g][i];
+						inputs[i] = input < NUM_SOURCES ? input : base + (input - NUM_SOURCES);
+					}
+					AddGate(netlist, types[g], inputs, 2);
+				}
+			}
+
+			std::vector<GateID> originalOf;
+			Assert::AreEqual((size_t)((NUM_COPIES - 1) * BLOCK_SIZE), FindDuplicateGates(netlist, originalOf));
+
+			Program program;
+			Compile(netlist, program);
+			Assert::AreEqual((uint32_t)((NUM_COPIES - 1) * BLOCK_SIZE), program.numDuplicatesMerged);
+			Assert::AreEqual((GateID)(NUM_SOURCES + BLOCK_SIZE), program.numGates);
+			for (GateID gate = 0; gate < NumGates(netlist); ++gate)
+			{
+				Assert::AreEqual(program.gateOfNetlistGate[originalOf[gate]], program.gateOfNetlistGate[gate]);
+			}
+		}
+	};
+
+	TEST_CLASS(TestHistory)
+	{
+	public:
+
+		TEST_METHOD(SeeksBackToEveryRetainedTick)
+		{
+			std::mt19937 rng(19);
+			Netlist netlist;
+			MakeRandomCircuit(netlist, 2000, true, rng);
+			const size_t n = NumGates(netlist);
+			Program program;
+			Compile(netlist, program);
+
+			// Small enough that the oldest groups are forgotten well before the end
+			History history;
+			history.keyframeInterval = 16;
+			history.memoryBudget = 16 << 10;
+			std::vector<std::vector<uint64_t>> saved;
+			const uint64_t NUM_TICKS = 400;
+			for (uint64_t tick = 0; tick < NUM_TICKS; ++tick)
+			{
+				if (tick != 0)
+				{
+					SetRandomInputs(n, rng, [&](GateID gate, bool value) { SetInput(program, gate, value); });
+					Step(program);
+				}
+				Assert::AreEqual(tick, program.tick);
+				RecordTick(history, program);
+				saved.push_back(program.state);
+				if (history.groups.size() > 1)
+				{
+					Assert::IsTrue(history.bytesUsed <= history.memoryBudget);
+				}
+			}
+			Assert::IsTrue(OldestTick(history) > 0);
+			Assert::AreEqual(NUM_TICKS - 1, NewestTick(history));
+			Assert::IsFalse(SeekTick(history, program, OldestTick(history) - 1));
+			Assert::IsFalse(SeekTick(history, program, NUM_TICKS));
+
+			const uint64_t oldest = OldestTick(history);
+			for (int seek = 0; seek < 200; ++seek)
+			{
+				uint64_t tick = oldest + rng() % (NUM_TICKS - oldest);
+				Assert::IsTrue(SeekTick(history, program, tick));
+				Assert::AreEqual(tick, program.tick);
+				Assert::IsTrue(program.state == saved[tick]);
+			}
+
+			// Stepping on from a seek replaces the old future with the new one
+			const uint64_t from = oldest + 1 + rng() % (NUM_TICKS - oldest - 10);
+			Assert::IsTrue(SeekTick(history, program, from));
+			saved.resize(from + 1);
+			for (uint64_t tick = from + 1; tick < from + 6; ++tick)
+			{
+				SetRandomInputs(n, rng, [&](GateID gate, bool value) { SetInput(program, gate, value); });
+				Step(program);
+				RecordTick(history, program);
+				saved.push_back(program.state);
+				Assert::AreEqual(tick, NewestTick(history));
+				Assert::IsFalse(SeekTick(history, program, tick + 1));
+			}
+			Assert::AreEqual(oldest, OldestTick(history));
+			for (uint64_t tick = oldest; tick <= from + 5; ++tick)
+			{
+				Assert::IsTrue(SeekTick(history, program, tick));
+				Assert::IsTrue(program.state == saved[tick]);
+			}
+		}
+	};
+
+	TEST_CLASS(TestTrace)
+	{
+	public:
+
+		TEST_METHOD(VcdMatchesTheSteppedProgram)
+		{
+			// A Non wired to itself flips every tick; the rest follow it, gated by a source flipped now and then
+			Netlist netlist;
+			GateID loop = 0;
+			AddGate(netlist, NodeType::Non, &loop, 1);
+			AddGate(netlist, NodeType::Any, nullptr, 0);
+			GateID gatedInputs[] = { 0, 1 };
+			AddGate(netlist, NodeType::All, gatedInputs, 2);
+			GateID mixedInputs[] = { 0, 2 };
+			AddGate(netlist, NodeType::One, mixedInputs, 2);
+			GateID copyInputs[] = { 1 };
+			AddGate(netlist, NodeType::Any, copyInputs, 1);
+			const std::vector<GateID> probes = { 0, 1, 2, 3, 4 };
+			const std::vector<std::string> names = { "osc", "enable", "gated", "mixed", "enable copy" };
+			const std::vector<std::string> vcdNames = { "osc", "enable", "gated", "mixed", "enable_copy" };
+
+			Program program;
+			Compile(netlist, program);
+			const std::string tracePath = TempPath("ea_test.eatr");
+			const std::string vcdPath = TempPath("ea_test.vcd");
+			Trace trace;
+			Assert::IsTrue(StartTrace(trace, program, probes, names, tracePath.c_str()));
+
+			// What each probe reads on each tick, the first before any step
+			const uint64_t NUM_TICKS = 40;
+			std::vector<std::vector<bool>> expected;
+			for (uint64_t tick = 0; tick <= NUM_TICKS; ++tick)
+			{
+				if (tick != 0)
+				{
+					if (tick % 7 == 0)
+					{
+						SetInput(program, 1, tick % 14 != 0);
+					}
+					Step(program);
+					TraceTick(trace, program);
+				}
+				expected.push_back({});
+				for (GateID probe : probes)
+				{
+					expected.back().push_back(GetOutput(program, probe));
+				}
+			}
+			EndTrace(trace);
+			Assert::IsTrue(ExportVcd(tracePath.c_str(), vcdPath.c_str()));
+
+			// Replays the value changes, checking each one changes something and that time only moves forward
+			std::unordered_map<std::string, std::string> idOf;
+			std::unordered_map<std::string, bool> valueOf;
+			std::vector<std::vector<bool>> replayed;
+			int64_t time = -1;
+			bool isDumpingVars = false;
+			std::ifstream vcd(vcdPath);
+			std::string line;
+			auto replayUntil = [&](int64_t until)
+			{
+				while ((int64_t)replayed.size() < until && (int64_t)replayed.size() <= (int64_t)NUM_TICKS)
+				{
+					replayed.push_back({});
+					for (const std::string& name : vcdNames)
+					{
+						replayed.back().push_back(valueOf.at(idOf.at(name)));
+					}
+				}
+			};
+			while (std::getline(vcd, line))
+			{
+				if (line.starts_with("$var"))
+				{
+					// $var wire 1 <id> <name> $end
+					std::istringstream fields(line.substr(5));
+					std::string kind, width, id, name;
+					fields >> kind >> width >> id >> name;
+					idOf[name] = id;
+				}
+				else if (line == "$dumpvars")
+				{
+					isDumpingVars = true;
+				}
+				else if (line == "$end")
+				{
+					isDumpingVars = false;
+				}
+				else if (line.starts_with('#'))
+				{
+					int64_t next = std::stoll(line.substr(1));
+					Assert::IsTrue(next > time);
+					replayUntil(next);
+					time = next;
+				}
+				else if (line.starts_with('0') || line.starts_with('1'))
+				{
+					std::string id = line.substr(1);
+					bool value = line[0] == '1';
+					Assert::IsTrue(isDumpingVars || valueOf.at(id) != value);
+					valueOf[id] = value;
+				}
+			}
+			replayUntil(NUM_TICKS + 1);
+			vcd.close();
+			std::filesystem::remove(tracePath);
+			std::filesystem::remove(vcdPath);
+
+			Assert::AreEqual((size_t)5, idOf.size());
+			Assert::AreEqual(idOf.at("enable"), idOf.at("enable_copy"));
+			Assert::AreEqual((size_t)(NUM_TICKS + 1), replayed.size());
+			for (uint64_t tick = 0; tick <= NUM_TICKS; ++tick)
+			{
+				Assert::IsTrue(replayed[tick] == expected[tick]);
+				Assert::IsTrue(tick == 0 || expected[tick][0] != expected[tick - 1][0]);
+			}
+		}
+	};
+
+	TEST_CLASS(TestTripleBuffer)
+	{
+	public:
+
+		TEST_METHOD(ReaderOnlySeesWholeValuesInOrder)
+		{
+			// Large enough that a torn copy would be caught partway through
+			struct Counters
+			{
+				uint64_t fields[64] = {};
+			};
+			TripleBuffer<Counters> buffer;
+			const uint64_t NUM_VALUES = 200000;
+
+			// Joined on the way out, even when an assert below throws
+			std::jthread writer([&]
+			{
+				for (uint64_t value = 1; value <= NUM_VALUES; ++value)
+				{
+					Counters& back = BackItem(buffer);
+					for (uint64_t& field : back.fields)
+					{
+						field = value;
+					}
+					Publish(buffer);
+				}
+			});
+
+			uint64_t last = 0;
+			size_t numAcquired = 0;
+			while (last != NUM_VALUES)
+			{
+				if (!Acquire(buffer))
+				{
+					continue;
+				}
+				++numAcquired;
+				const Counters& front = FrontItem(buffer);
+				for (uint64_t field : front.fields)
+				{
+					Assert::AreEqual(front.fields[0], field);
+				}
+				Assert::IsTrue(front.fields[0] > last);
+				last = front.fields[0];
+			}
+			Assert::IsFalse(Acquire(buffer));
+			Assert::IsTrue(numAcquired > 1);
+		}
+	};
+}